@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * Measures dispatch_apply_f() for bodies of increasing cost, next to a plain
+ * loop running the same bodies, to show the fixed cost of an apply and the
+ * body size from which it pays off. The cost of a body is a number of
+ * dependent integer operations.
+ *
+ * usage: bench_apply_cost [-i indices] [-k body_cost]... [-r trials]
+ *		[-w warmup] [-c]
+ */
+
+#include "bench.h"
+
+#define MAX_COSTS 16
+
+struct apply_ctx {
+	size_t indices;
+	unsigned long cost;
+	uint64_t results[64];
+};
+
+static inline uint64_t
+body(size_t idx, unsigned long cost)
+{
+	uint64_t x = idx + 1;
+	for (unsigned long i = 0; i < cost; i++) {
+		x = x * 6364136223846793005ull + 1442695040888963407ull;
+	}
+	return x;
+}
+
+static void
+apply_body(void *ctxt, size_t idx)
+{
+	struct apply_ctx *ctx = ctxt;
+	// keep the optimizer from discarding the work
+	ctx->results[idx % 64] = body(idx, ctx->cost);
+}
+
+static void
+apply_one(void *ctxt)
+{
+	struct apply_ctx *ctx = ctxt;
+	dispatch_apply_f(ctx->indices, DISPATCH_APPLY_AUTO, ctx, apply_body);
+}
+
+static void
+loop_one(void *ctxt)
+{
+	struct apply_ctx *ctx = ctxt;
+	for (size_t i = 0; i < ctx->indices; i++) {
+		apply_body(ctx, i);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned long costs[MAX_COSTS] = { 0, 10, 100, 1000, 10000 };
+	size_t ncosts = 5, indices = 1024;
+	bool custom_costs = false;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "i:k:" BENCH_COMMON_OPTIONS)) != -1) {
+		switch (ch) {
+		case 'i':
+			indices = strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			if (!custom_costs) {
+				custom_costs = true;
+				ncosts = 0;
+			}
+			if (ncosts < MAX_COSTS) {
+				costs[ncosts++] = strtoul(optarg, NULL, 0);
+			}
+			break;
+		default:
+			if (bench_common_option(ch, optarg)) break;
+			fprintf(stderr, "usage: %s [-i indices] [-k body_cost]... "
+					BENCH_COMMON_USAGE "\n", argv[0]);
+			return 1;
+		}
+	}
+	if (!indices) indices = 1;
+
+	for (size_t i = 0; i < ncosts; i++) {
+		struct apply_ctx ctx = { .indices = indices, .cost = costs[i] };
+		char params[64];
+		// aim for about 10M body operations per trial
+		size_t work = indices * (costs[i] + 1);
+		size_t count = work < 10000000 ? 10000000 / work : 1;
+
+		snprintf(params, sizeof(params), "indices=%zu body_cost=%lu",
+				indices, costs[i]);
+		bench_run("apply_cost", "apply", params, count, indices, 1, &ctx,
+				apply_one);
+		bench_run("apply_cost", "loop", params, count, indices, 1, &ctx,
+				loop_one);
+	}
+	return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * Helpers shared by the microbenchmarks.
+ *
+ * Every measurement is reported on a single line of space separated key=value
+ * pairs, starting with bench= and case=, so that the output of two builds can
+ * be compared with standard text tools. Lines starting with '#' are comments.
+ *
+ * The measurements going through bench_run() use dispatch_benchmark_run_f()
+ * and accept the common options:
+ *   -r trials	number of measured trials (default 32)
+ *   -w warmup	number of warmup trials (default 2)
+ *   -c		collect hardware counters when available
+ */
+
+#ifndef __DISPATCH_BENCH_H__
+#define __DISPATCH_BENCH_H__
+
+#include <dispatch/dispatch.h>
+#include <dispatch/private.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_COMMON_OPTIONS "r:w:c"
+#define BENCH_COMMON_USAGE "[-r trials] [-w warmup] [-c]"
+
+static size_t bench_trials = DISPATCH_BENCHMARK_DEFAULT_TRIALS;
+static size_t bench_warmup = 2;
+static bool bench_counters;
+
+static inline uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+// returns false if ch isn't one of BENCH_COMMON_OPTIONS
+static inline bool
+bench_common_option(int ch, const char *arg)
+{
+	switch (ch) {
+	case 'r':
+		bench_trials = strtoul(arg, NULL, 0);
+		if (!bench_trials) bench_trials = 1;
+		return true;
+	case 'w':
+		bench_warmup = strtoul(arg, NULL, 0);
+		return true;
+	case 'c':
+		bench_counters = true;
+		return true;
+	}
+	return false;
+}
+
+static inline void *
+bench_calloc(size_t n, size_t size)
+{
+	void *p = calloc(n, size);
+	if (!p) {
+		perror("calloc");
+		exit(1);
+	}
+	return p;
+}
+
+/*
+ * Measures count calls of func per trial on the given number of threads and
+ * reports the time per operation, where a call performs ops_per_call
+ * operations. params is printed as is and may be NULL.
+ */
+static inline void
+bench_run(const char *bench, const char *name, const char *params,
+		size_t count, size_t ops_per_call, uint32_t threads,
+		void *ctxt, dispatch_function_t func)
+{
+	dispatch_benchmark_attr_s attr = {
+		.dba_version = DISPATCH_BENCHMARK_ATTR_VERSION,
+		.dba_count = count ? count : 1,
+		.dba_warmup = bench_warmup,
+		.dba_trials = bench_trials,
+		.dba_threads = threads,
+		.dba_flags = bench_counters ? DISPATCH_BENCHMARK_CPU_COUNTERS : 0,
+	};
+	dispatch_benchmark_result_s r;
+	double ops = ops_per_call ? (double)ops_per_call : 1.0;
+
+	dispatch_benchmark_run_f(&attr, ctxt, func, &r);
+
+	printf("bench=%s case=%s%s%s threads=%u ops=%zu trials=%zu "
+			"ns_per_op=%.2f min_ns=%.2f p50_ns=%.2f p90_ns=%.2f p99_ns=%.2f "
+			"max_ns=%.2f stddev_ns=%.2f", bench, name, params ? " " : "",
+			params ? params : "", threads ? threads : 1,
+			attr.dba_count * (ops_per_call ? ops_per_call : 1), r.dbr_trials,
+			r.dbr_mean / ops, r.dbr_min / ops, r.dbr_p50 / ops,
+			r.dbr_p90 / ops, r.dbr_p99 / ops, r.dbr_max / ops,
+			r.dbr_stddev / ops);
+	if (r.dbr_has_counters) {
+		printf(" cycles=%.1f instructions=%.1f cache_misses=%.3f "
+				"branch_misses=%.3f", r.dbr_cycles / ops,
+				r.dbr_instructions / ops, r.dbr_cache_misses / ops,
+				r.dbr_branch_misses / ops);
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
+#endif /* __DISPATCH_BENCH_H__ */
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * Measures dispatch_data operations on a composite object made of a number
+ * of equally sized regions: concat, subrange, apply and create_map, and the
+ * base64 and UTF-8 to UTF-16 transforms. The transforms report the time per
+ * input byte.
+ *
+ * usage: bench_data_ops [-n iterations] [-s region_size] [-p regions]
+ *		[-r trials] [-w warmup] [-c]
+ */
+
+#include "bench.h"
+#include <string.h>
+
+struct data_ctx {
+	dispatch_data_t leaf;
+	dispatch_data_t composite;
+	dispatch_data_t encoded;
+	size_t size;
+	size_t offset;
+	volatile size_t sink;
+};
+
+static void
+data_concat(void *ctxt)
+{
+	struct data_ctx *ctx = ctxt;
+	dispatch_data_t d = dispatch_data_create_concat(ctx->composite, ctx->leaf);
+	dispatch_release(d);
+}
+
+static void
+data_subrange(void *ctxt)
+{
+	struct data_ctx *ctx = ctxt;
+	// walk the offsets so that the subranges straddle regions differently
+	ctx->offset = (ctx->offset + 4099) % (ctx->size / 2);
+	dispatch_data_t d = dispatch_data_create_subrange(ctx->composite,
+			ctx->offset, ctx->size / 2);
+	dispatch_release(d);
+}
+
+static bool
+data_applier(void *ctxt, dispatch_data_t region, size_t offset,
+		const void *buffer, size_t size)
+{
+	struct data_ctx *ctx = ctxt;
+	(void)region; (void)offset;
+	ctx->sink += ((const unsigned char *)buffer)[size - 1];
+	return true;
+}
+
+static void
+data_apply(void *ctxt)
+{
+	struct data_ctx *ctx = ctxt;
+	dispatch_data_apply_f(ctx->composite, ctx, data_applier);
+}
+
+static void
+data_create_map(void *ctxt)
+{
+	struct data_ctx *ctx = ctxt;
+	const void *buffer;
+	size_t size;
+	dispatch_data_t d = dispatch_data_create_map(ctx->composite, &buffer,
+			&size);
+	ctx->sink += size;
+	dispatch_release(d);
+}
+
+static void
+data_base64_encode(void *ctxt)
+{
+	struct data_ctx *ctx = ctxt;
+	dispatch_data_t d = dispatch_data_create_with_transform(ctx->composite,
+			DISPATCH_DATA_FORMAT_TYPE_NONE, DISPATCH_DATA_FORMAT_TYPE_BASE64);
+	dispatch_release(d);
+}
+
+static void
+data_base64_decode(void *ctxt)
+{
+	struct data_ctx *ctx = ctxt;
+	dispatch_data_t d = dispatch_data_create_with_transform(ctx->encoded,
+			DISPATCH_DATA_FORMAT_TYPE_BASE64, DISPATCH_DATA_FORMAT_TYPE_NONE);
+	dispatch_release(d);
+}
+
+static void
+data_utf8_to_utf16(void *ctxt)
+{
+	struct data_ctx *ctx = ctxt;
+	dispatch_data_t d = dispatch_data_create_with_transform(ctx->composite,
+			DISPATCH_DATA_FORMAT_TYPE_UTF8, DISPATCH_DATA_FORMAT_TYPE_UTF16LE);
+	dispatch_release(d);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct data_ctx ctx = { };
+	size_t iterations = 100000, region_size = 4096, regions = 16;
+	char params[64];
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:s:p:" BENCH_COMMON_OPTIONS)) != -1) {
+		switch (ch) {
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			region_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			regions = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			if (bench_common_option(ch, optarg)) break;
+			fprintf(stderr, "usage: %s [-n iterations] [-s region_size] "
+					"[-p regions] " BENCH_COMMON_USAGE "\n", argv[0]);
+			return 1;
+		}
+	}
+	if (!iterations) iterations = 1;
+	if (region_size < 2) region_size = 2;
+	if (!regions) regions = 1;
+
+	// printable ASCII is valid in every input format we transform from
+	ctx.composite = dispatch_data_empty;
+	for (size_t i = 0; i < regions; i++) {
+		char *buf = bench_calloc(1, region_size);
+		memset(buf, 'a' + (int)(i % 26), region_size);
+		dispatch_data_t leaf = dispatch_data_create(buf, region_size, NULL,
+				DISPATCH_DATA_DESTRUCTOR_FREE);
+		dispatch_data_t d = dispatch_data_create_concat(ctx.composite, leaf);
+		dispatch_release(ctx.composite);
+		if (i == 0) {
+			ctx.leaf = leaf;
+		} else {
+			dispatch_release(leaf);
+		}
+		ctx.composite = d;
+	}
+	ctx.size = dispatch_data_get_size(ctx.composite);
+	ctx.encoded = dispatch_data_create_with_transform(ctx.composite,
+			DISPATCH_DATA_FORMAT_TYPE_NONE, DISPATCH_DATA_FORMAT_TYPE_BASE64);
+	if (!ctx.encoded) {
+		fprintf(stderr, "base64 transform failed\n");
+		return 1;
+	}
+
+	snprintf(params, sizeof(params), "region_size=%zu regions=%zu",
+			region_size, regions);
+	bench_run("data_ops", "concat", params, iterations, 1, 1, &ctx,
+			data_concat);
+	bench_run("data_ops", "subrange", params, iterations, 1, 1, &ctx,
+			data_subrange);
+	bench_run("data_ops", "apply", params, iterations, 1, 1, &ctx,
+			data_apply);
+	// the remaining cases touch every byte, scale the number of calls down
+	iterations = iterations / ctx.size ? iterations / ctx.size : 1;
+	bench_run("data_ops", "create_map", params, iterations * 100, ctx.size, 1,
+			&ctx, data_create_map);
+	bench_run("data_ops", "base64_encode", params, iterations * 10, ctx.size,
+			1, &ctx, data_base64_encode);
+	bench_run("data_ops", "base64_decode", params, iterations * 10,
+			dispatch_data_get_size(ctx.encoded), 1, &ctx, data_base64_decode);
+	bench_run("data_ops", "utf8_to_utf16le", params, iterations * 10,
+			ctx.size, 1, &ctx, data_utf8_to_utf16);
+
+	dispatch_release(ctx.encoded);
+	dispatch_release(ctx.leaf);
+	dispatch_release(ctx.composite);
+	return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * Measures dispatch_io throughput writing and reading a temporary file
+ * through a stream and a random access channel, for a few high water marks.
+ * Times are per byte; the file normally sits in the page cache, so this is
+ * the overhead of dispatch_io rather than the speed of the disk.
+ *
+ * usage: bench_io_throughput [-s file_size] [-d directory] [-r trials]
+ *		[-w warmup] [-c]
+ */
+
+#include "bench.h"
+#include <string.h>
+
+struct io_ctx {
+	dispatch_queue_t dq;
+	dispatch_semaphore_t sema;
+	dispatch_io_t channel;
+	dispatch_data_t data;
+	int fd;
+	size_t size;
+	size_t transferred;
+	int error;
+};
+
+static void
+io_handler(void *ctxt, bool done, dispatch_data_t data, int error)
+{
+	struct io_ctx *ctx = ctxt;
+	if (error) ctx->error = error;
+	if (data) ctx->transferred += dispatch_data_get_size(data);
+	if (done) dispatch_semaphore_signal(ctx->sema);
+}
+
+static void
+io_check(struct io_ctx *ctx, const char *what)
+{
+	if (ctx->error) {
+		fprintf(stderr, "%s: %s\n", what, strerror(ctx->error));
+		exit(1);
+	}
+}
+
+static void
+io_rewind(void *ctxt)
+{
+	struct io_ctx *ctx = ctxt;
+	if (lseek(ctx->fd, 0, SEEK_SET) == -1) {
+		perror("lseek");
+		exit(1);
+	}
+}
+
+// stream channels go on from the current position of the fd, every trial
+// rewinds it first so that stream and random channels do the same work
+static void
+io_write(void *ctxt)
+{
+	struct io_ctx *ctx = ctxt;
+	dispatch_io_barrier_f(ctx->channel, ctx, io_rewind);
+	dispatch_io_write_f(ctx->channel, 0, ctx->data, ctx->dq, ctx, io_handler);
+	dispatch_semaphore_wait(ctx->sema, DISPATCH_TIME_FOREVER);
+	io_check(ctx, "write");
+}
+
+static void
+io_read(void *ctxt)
+{
+	struct io_ctx *ctx = ctxt;
+	ctx->transferred = 0;
+	dispatch_io_barrier_f(ctx->channel, ctx, io_rewind);
+	dispatch_io_read_f(ctx->channel, 0, ctx->size, ctx->dq, ctx, io_handler);
+	dispatch_semaphore_wait(ctx->sema, DISPATCH_TIME_FOREVER);
+	io_check(ctx, "read");
+	if (ctx->transferred != ctx->size) {
+		fprintf(stderr, "read: short read (%zu != %zu)\n", ctx->transferred,
+				ctx->size);
+		exit(1);
+	}
+}
+
+static void
+run_channel(struct io_ctx *ctx, dispatch_io_type_t type,
+		const char *type_name, size_t high_water)
+{
+	char params[96];
+
+	snprintf(params, sizeof(params), "channel=%s size=%zu high_water=%zu",
+			type_name, ctx->size, high_water);
+	ctx->channel = dispatch_io_create_f(type, ctx->fd, ctx->dq, NULL, NULL);
+	if (!ctx->channel) {
+		fprintf(stderr, "dispatch_io_create_f failed\n");
+		exit(1);
+	}
+	dispatch_io_set_high_water(ctx->channel, high_water);
+	bench_run("io_throughput", "write", params, 1, ctx->size, 1, ctx,
+			io_write);
+	bench_run("io_throughput", "read", params, 1, ctx->size, 1, ctx,
+			io_read);
+	dispatch_io_close(ctx->channel, 0);
+	dispatch_release(ctx->channel);
+}
+
+int
+main(int argc, char *argv[])
+{
+	static const size_t high_waters[] = { 16 << 10, 256 << 10, 4 << 20 };
+	struct io_ctx ctx = { .size = 64 << 20 };
+	const char *dir = getenv("TMPDIR");
+	char path[1024];
+	void *buf;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "s:d:" BENCH_COMMON_OPTIONS)) != -1) {
+		switch (ch) {
+		case 's':
+			ctx.size = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			dir = optarg;
+			break;
+		default:
+			if (bench_common_option(ch, optarg)) break;
+			fprintf(stderr, "usage: %s [-s file_size] [-d directory] "
+					BENCH_COMMON_USAGE "\n", argv[0]);
+			return 1;
+		}
+	}
+	if (!ctx.size) ctx.size = 1;
+
+	snprintf(path, sizeof(path), "%s/bench_io.XXXXXX", dir ? dir : "/tmp");
+	ctx.fd = mkstemp(path);
+	if (ctx.fd == -1) {
+		perror("mkstemp");
+		return 1;
+	}
+	unlink(path);
+
+	buf = bench_calloc(1, ctx.size);
+	memset(buf, 0x5a, ctx.size);
+	ctx.data = dispatch_data_create(buf, ctx.size, NULL,
+			DISPATCH_DATA_DESTRUCTOR_FREE);
+	ctx.dq = dispatch_queue_create("bench.io", NULL);
+	ctx.sema = dispatch_semaphore_create(0);
+
+	for (size_t i = 0; i < sizeof(high_waters) / sizeof(high_waters[0]); i++) {
+		run_channel(&ctx, DISPATCH_IO_STREAM, "stream", high_waters[i]);
+		run_channel(&ctx, DISPATCH_IO_RANDOM, "random", high_waters[i]);
+	}
+
+	dispatch_release(ctx.sema);
+	dispatch_release(ctx.dq);
+	dispatch_release(ctx.data);
+	close(ctx.fd);
+	return 0;
+}
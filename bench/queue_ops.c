@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * Measures dispatch_sync_f() and dispatch_async_f() of empty work items on a
+ * serial queue, a concurrent queue and the default global queue.
+ *
+ * The async cases submit a batch of items and wait for all of them (with a
+ * barrier on the queues we own, with a group on the global queue), so they
+ * include the drain and the wakeup of the workers.
+ *
+ * usage: bench_queue_ops [-n iterations] [-b batch] [-r trials] [-w warmup] [-c]
+ */
+
+#include "bench.h"
+#include <string.h>
+
+struct queue_ctx {
+	dispatch_queue_t dq;
+	dispatch_group_t dg;
+	size_t batch;
+	volatile size_t executed;
+};
+
+static void
+nop(void *ctxt)
+{
+	(void)ctxt;
+}
+
+static void
+count_item(void *ctxt)
+{
+	struct queue_ctx *ctx = ctxt;
+	__atomic_fetch_add(&ctx->executed, 1, __ATOMIC_RELAXED);
+}
+
+static void
+sync_one(void *ctxt)
+{
+	struct queue_ctx *ctx = ctxt;
+	dispatch_sync_f(ctx->dq, NULL, nop);
+}
+
+static void
+async_batch_barrier(void *ctxt)
+{
+	struct queue_ctx *ctx = ctxt;
+	for (size_t i = 0; i < ctx->batch; i++) {
+		dispatch_async_f(ctx->dq, ctx, count_item);
+	}
+	dispatch_barrier_sync_f(ctx->dq, NULL, nop);
+}
+
+static void
+async_batch_group(void *ctxt)
+{
+	struct queue_ctx *ctx = ctxt;
+	for (size_t i = 0; i < ctx->batch; i++) {
+		dispatch_group_async_f(ctx->dg, ctx->dq, ctx, count_item);
+	}
+	dispatch_group_wait(ctx->dg, DISPATCH_TIME_FOREVER);
+}
+
+static void
+run_queue(const char *kind, dispatch_queue_t dq, size_t iterations,
+		size_t batch)
+{
+	struct queue_ctx ctx = { .dq = dq, .batch = batch };
+	char name[64], params[64];
+	bool global = !strcmp(kind, "global");
+
+	snprintf(name, sizeof(name), "sync_%s", kind);
+	bench_run("queue_ops", name, NULL, iterations, 1, 1, &ctx, sync_one);
+
+	snprintf(name, sizeof(name), "async_%s", kind);
+	snprintf(params, sizeof(params), "batch=%zu wait=%s", batch,
+			global ? "group" : "barrier");
+	if (global) ctx.dg = dispatch_group_create();
+	bench_run("queue_ops", name, params, iterations / batch, batch, 1, &ctx,
+			global ? async_batch_group : async_batch_barrier);
+	if (global) dispatch_release(ctx.dg);
+
+	if (ctx.executed % batch) {
+		fprintf(stderr, "%s: lost work items (%zu)\n", name, ctx.executed);
+		exit(1);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t iterations = 100000, batch = 1000;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:b:" BENCH_COMMON_OPTIONS)) != -1) {
+		switch (ch) {
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			batch = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			if (bench_common_option(ch, optarg)) break;
+			fprintf(stderr, "usage: %s [-n iterations] [-b batch] "
+					BENCH_COMMON_USAGE "\n", argv[0]);
+			return 1;
+		}
+	}
+	if (!batch) batch = 1;
+	if (iterations < batch) iterations = batch;
+
+	dispatch_queue_t serial = dispatch_queue_create("bench.serial", NULL);
+	dispatch_queue_t concurrent = dispatch_queue_create("bench.concurrent",
+			DISPATCH_QUEUE_CONCURRENT);
+
+	run_queue("serial", serial, iterations, batch);
+	run_queue("concurrent", concurrent, iterations, batch);
+	run_queue("global", dispatch_get_global_queue(
+			DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), iterations, batch);
+
+	dispatch_release(concurrent);
+	dispatch_release(serial);
+	return 0;
+}
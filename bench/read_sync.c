@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * Measures reader throughput on a concurrent queue used as a reader-writer
+ * lock, with dispatch_sync_f() next to dispatch_read_sync_f(), while one
+ * writer submits a barrier every so many reads.
+ *
+ * usage: bench_read_sync [-n iterations] [-t max_threads] [-w write_every]
+ */
+
+#include "bench.h"
+#include <pthread.h>
+
+static dispatch_queue_t rw_queue;
+static uint64_t shared_value;
+static size_t iterations = 1000000;
+static size_t write_every = 10000;
+
+typedef void (*read_fn_t)(dispatch_queue_t, void *, dispatch_function_t);
+
+static void
+reader(void *ctxt)
+{
+	*(uint64_t *)ctxt += shared_value;
+}
+
+static void
+writer(void *ctxt)
+{
+	(void)ctxt;
+	shared_value++;
+}
+
+static void *
+bench_thread(void *ctxt)
+{
+	read_fn_t read_fn = (read_fn_t)ctxt;
+	uint64_t sum = 0;
+
+	for (size_t i = 0; i < iterations; i++) {
+		read_fn(rw_queue, &sum, reader);
+		if (write_every && i % write_every == 0) {
+			dispatch_barrier_async_f(rw_queue, NULL, writer);
+		}
+	}
+	return (void *)(uintptr_t)sum;
+}
+
+static void
+run(const char *name, read_fn_t fn, unsigned int nthreads)
+{
+	pthread_t *threads = calloc(nthreads, sizeof(pthread_t));
+	uint64_t start, elapsed;
+
+	if (!threads) {
+		perror("calloc");
+		exit(1);
+	}
+	start = now_ns();
+	for (unsigned int i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, bench_thread, (void *)fn)) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+	for (unsigned int i = 0; i < nthreads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	elapsed = now_ns() - start;
+	// let the pending barriers run before the next round
+	dispatch_barrier_sync_f(rw_queue, NULL, writer);
+
+	printf("bench=read_sync case=%s threads=%u reads=%llu ns_per_read=%.1f\n",
+			name, nthreads, (unsigned long long)iterations * nthreads,
+			(double)elapsed / (double)(iterations * nthreads));
+	free(threads);
+}
+
+int
+main(int argc, char *argv[])
+{
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int max_threads = ncpu > 1 ? (unsigned int)ncpu : 2;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:t:w:")) != -1) {
+		switch (ch) {
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			max_threads = (unsigned int)strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			write_every = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n iterations] [-t max_threads] "
+					"[-w write_every]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (!iterations) iterations = 1;
+	if (max_threads < 1) max_threads = 1;
+
+	rw_queue = dispatch_queue_create("bench.read_sync",
+			DISPATCH_QUEUE_CONCURRENT);
+	for (unsigned int n = 1; n <= max_threads; n = n < 2 ? 2 : n * 2) {
+		run("dispatch_sync", dispatch_sync_f, n);
+		run("dispatch_read_sync", dispatch_read_sync_f, n);
+	}
+	dispatch_release(rw_queue);
+	return 0;
+}
@@ -0,0 +1,35 @@
+
+# Runs every command in BENCHMARKS ('|' separated "executable args..." strings)
+# and collects their output into OUTPUT, one key=value line per measurement,
+# so that the results of two builds can be diffed or fed to a script.
+
+if(NOT BENCHMARKS OR NOT OUTPUT)
+  message(FATAL_ERROR "usage: cmake -DBENCHMARKS=... -DOUTPUT=... -P run_benchmarks.cmake")
+endif()
+
+string(TIMESTAMP timestamp UTC)
+cmake_host_system_information(RESULT host QUERY HOSTNAME)
+cmake_host_system_information(RESULT ncpu QUERY NUMBER_OF_LOGICAL_CORES)
+file(WRITE ${OUTPUT} "# libdispatch benchmarks date=${timestamp} host=${host} ncpu=${ncpu}\n")
+
+string(REPLACE "|" ";" commands "${BENCHMARKS}")
+set(failed)
+foreach(command ${commands})
+  separate_arguments(argv UNIX_COMMAND "${command}")
+  list(GET argv 0 executable)
+  get_filename_component(name ${executable} NAME)
+  message(STATUS "${name}")
+  execute_process(COMMAND ${argv}
+                  OUTPUT_VARIABLE output
+                  RESULT_VARIABLE result)
+  file(APPEND ${OUTPUT} "${output}")
+  if(NOT result EQUAL 0)
+    file(APPEND ${OUTPUT} "# ${name} failed: ${result}\n")
+    list(APPEND failed ${name})
+  endif()
+endforeach()
+
+message(STATUS "results written to ${OUTPUT}")
+if(failed)
+  message(FATAL_ERROR "failed benchmarks: ${failed}")
+endif()
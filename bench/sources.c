@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * Measures dispatch sources:
+ * - creating, arming and cancelling a timer, and re-arming a live one,
+ * - how late one-shot timers fire past their deadline,
+ * - the round trip from an event to its handler, for a DATA_ADD source
+ *   (dispatch_source_merge_data) and a READ source on a pipe.
+ *
+ * usage: bench_sources [-n iterations] [-i interval_usec] [-r trials]
+ *		[-w warmup] [-c]
+ */
+
+#include "bench.h"
+
+struct source_ctx {
+	dispatch_queue_t dq;
+	dispatch_source_t ds;
+	dispatch_semaphore_t sema;
+	int fds[2];
+	uint64_t deadline;
+	uint64_t lateness;
+};
+
+static int
+compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+static void
+timer_arm_cancel(void *ctxt)
+{
+	struct source_ctx *ctx = ctxt;
+	dispatch_source_t ds = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER,
+			0, 0, ctx->dq);
+	dispatch_source_set_timer(ds, dispatch_time(DISPATCH_TIME_NOW,
+			60 * NSEC_PER_SEC), DISPATCH_TIME_FOREVER, 0);
+	dispatch_activate(ds);
+	dispatch_source_cancel(ds);
+	dispatch_release(ds);
+}
+
+static void
+timer_rearm(void *ctxt)
+{
+	struct source_ctx *ctx = ctxt;
+	dispatch_source_set_timer(ctx->ds, dispatch_time(DISPATCH_TIME_NOW,
+			60 * NSEC_PER_SEC), DISPATCH_TIME_FOREVER, 0);
+}
+
+static void
+timer_fired(void *ctxt)
+{
+	struct source_ctx *ctx = ctxt;
+	uint64_t now = now_ns();
+	ctx->lateness = now > ctx->deadline ? now - ctx->deadline : 0;
+	dispatch_semaphore_signal(ctx->sema);
+}
+
+static void
+event_delivered(void *ctxt)
+{
+	struct source_ctx *ctx = ctxt;
+	dispatch_semaphore_signal(ctx->sema);
+}
+
+static void
+pipe_readable(void *ctxt)
+{
+	struct source_ctx *ctx = ctxt;
+	char buf[64];
+	if (read(ctx->fds[0], buf, sizeof(buf)) < 0) {
+		perror("read");
+		exit(1);
+	}
+	dispatch_semaphore_signal(ctx->sema);
+}
+
+static void
+merge_data_round_trip(void *ctxt)
+{
+	struct source_ctx *ctx = ctxt;
+	dispatch_source_merge_data(ctx->ds, 1);
+	dispatch_semaphore_wait(ctx->sema, DISPATCH_TIME_FOREVER);
+}
+
+static void
+pipe_round_trip(void *ctxt)
+{
+	struct source_ctx *ctx = ctxt;
+	if (write(ctx->fds[1], "x", 1) != 1) {
+		perror("write");
+		exit(1);
+	}
+	dispatch_semaphore_wait(ctx->sema, DISPATCH_TIME_FOREVER);
+}
+
+static void
+run_timer_fire(struct source_ctx *ctx, size_t iterations,
+		unsigned long interval_usec)
+{
+	uint64_t *samples = bench_calloc(iterations, sizeof(uint64_t));
+	uint64_t sum = 0;
+
+	ctx->ds = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0,
+			ctx->dq);
+	dispatch_set_context(ctx->ds, ctx);
+	dispatch_source_set_event_handler_f(ctx->ds, timer_fired);
+	dispatch_activate(ctx->ds);
+	for (size_t i = 0; i < iterations; i++) {
+		ctx->deadline = now_ns() + interval_usec * NSEC_PER_USEC;
+		dispatch_source_set_timer(ctx->ds, dispatch_time(DISPATCH_TIME_NOW,
+				(int64_t)(interval_usec * NSEC_PER_USEC)),
+				DISPATCH_TIME_FOREVER, 0);
+		dispatch_semaphore_wait(ctx->sema, DISPATCH_TIME_FOREVER);
+		samples[i] = ctx->lateness;
+		sum += ctx->lateness;
+	}
+	dispatch_source_cancel(ctx->ds);
+	dispatch_release(ctx->ds);
+	qsort(samples, iterations, sizeof(uint64_t), compare_u64);
+
+	printf("bench=sources case=timer_fire interval_us=%lu n=%zu "
+			"late_mean_ns=%llu late_p50_ns=%llu late_p90_ns=%llu "
+			"late_p99_ns=%llu late_max_ns=%llu\n", interval_usec, iterations,
+			(unsigned long long)(sum / iterations),
+			(unsigned long long)samples[iterations / 2],
+			(unsigned long long)samples[iterations * 90 / 100],
+			(unsigned long long)samples[iterations * 99 / 100],
+			(unsigned long long)samples[iterations - 1]);
+	fflush(stdout);
+	free(samples);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct source_ctx ctx = { };
+	unsigned long interval_usec = 1000;
+	size_t iterations = 100000;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:i:" BENCH_COMMON_OPTIONS)) != -1) {
+		switch (ch) {
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			interval_usec = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			if (bench_common_option(ch, optarg)) break;
+			fprintf(stderr, "usage: %s [-n iterations] [-i interval_usec] "
+					BENCH_COMMON_USAGE "\n", argv[0]);
+			return 1;
+		}
+	}
+	if (iterations < 100) iterations = 100;
+
+	ctx.dq = dispatch_queue_create("bench.sources", NULL);
+	ctx.sema = dispatch_semaphore_create(0);
+
+	bench_run("sources", "timer_arm_cancel", NULL, iterations, 1, 1, &ctx,
+			timer_arm_cancel);
+
+	ctx.ds = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, ctx.dq);
+	dispatch_activate(ctx.ds);
+	bench_run("sources", "timer_rearm", NULL, iterations, 1, 1, &ctx,
+			timer_rearm);
+	dispatch_source_cancel(ctx.ds);
+	dispatch_release(ctx.ds);
+
+	// each firing takes at least the interval, keep the sample count sane
+	run_timer_fire(&ctx, iterations / 100, interval_usec);
+
+	ctx.ds = dispatch_source_create(DISPATCH_SOURCE_TYPE_DATA_ADD, 0, 0,
+			ctx.dq);
+	dispatch_set_context(ctx.ds, &ctx);
+	dispatch_source_set_event_handler_f(ctx.ds, event_delivered);
+	dispatch_activate(ctx.ds);
+	bench_run("sources", "data_add_round_trip", NULL, iterations / 10, 1, 1,
+			&ctx, merge_data_round_trip);
+	dispatch_source_cancel(ctx.ds);
+	dispatch_release(ctx.ds);
+
+	if (pipe(ctx.fds)) {
+		perror("pipe");
+		return 1;
+	}
+	ctx.ds = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ,
+			(uintptr_t)ctx.fds[0], 0, ctx.dq);
+	dispatch_set_context(ctx.ds, &ctx);
+	dispatch_source_set_event_handler_f(ctx.ds, pipe_readable);
+	dispatch_source_set_cancel_handler_f(ctx.ds, event_delivered);
+	dispatch_activate(ctx.ds);
+	bench_run("sources", "read_round_trip", NULL, iterations / 10, 1, 1,
+			&ctx, pipe_round_trip);
+	// the fds can only be closed once the cancel handler has run
+	dispatch_source_cancel(ctx.ds);
+	dispatch_semaphore_wait(ctx.sema, DISPATCH_TIME_FOREVER);
+	dispatch_release(ctx.ds);
+	close(ctx.fds[0]);
+	close(ctx.fds[1]);
+
+	dispatch_release(ctx.sema);
+	dispatch_release(ctx.dq);
+	return 0;
+}
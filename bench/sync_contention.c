@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * Measures the cost of dispatch_sync_f() on a serial queue used as a lock
+ * around a tiny critical section, uncontended and with 2 to N threads
+ * hammering the same queue, next to a pthread mutex doing the same work.
+ *
+ * usage: bench_sync_contention [-n iterations] [-t max_threads]
+ */
+
+#include "bench.h"
+#include <pthread.h>
+
+static dispatch_queue_t sync_queue;
+static pthread_mutex_t sync_mutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile uint64_t shared_counter;
+static size_t iterations = 1000000;
+
+typedef void (*bench_fn_t)(void);
+
+static void
+critical_section(void *ctxt)
+{
+	(void)ctxt;
+	shared_counter++;
+}
+
+static void
+bench_dispatch_sync(void)
+{
+	for (size_t i = 0; i < iterations; i++) {
+		dispatch_sync_f(sync_queue, NULL, critical_section);
+	}
+}
+
+static void
+bench_mutex(void)
+{
+	for (size_t i = 0; i < iterations; i++) {
+		pthread_mutex_lock(&sync_mutex);
+		critical_section(NULL);
+		pthread_mutex_unlock(&sync_mutex);
+	}
+}
+
+static void *
+bench_thread(void *ctxt)
+{
+	((bench_fn_t)ctxt)();
+	return NULL;
+}
+
+static void
+run(const char *name, bench_fn_t fn, unsigned int nthreads)
+{
+	pthread_t *threads = calloc(nthreads, sizeof(pthread_t));
+	uint64_t start, elapsed;
+
+	if (!threads) {
+		perror("calloc");
+		exit(1);
+	}
+	shared_counter = 0;
+	start = now_ns();
+	for (unsigned int i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, bench_thread, (void *)fn)) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+	for (unsigned int i = 0; i < nthreads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	elapsed = now_ns() - start;
+
+	if (shared_counter != (uint64_t)iterations * nthreads) {
+		fprintf(stderr, "%s: lost updates (%llu != %llu)\n", name,
+				(unsigned long long)shared_counter,
+				(unsigned long long)iterations * nthreads);
+		exit(1);
+	}
+	printf("bench=sync_contention case=%s threads=%u ops=%llu ns_per_op=%.1f\n",
+			name, nthreads, (unsigned long long)iterations * nthreads,
+			(double)elapsed / (double)(iterations * nthreads));
+	free(threads);
+}
+
+int
+main(int argc, char *argv[])
+{
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int max_threads = ncpu > 1 ? (unsigned int)ncpu : 2;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:t:")) != -1) {
+		switch (ch) {
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			max_threads = (unsigned int)strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n iterations] [-t max_threads]\n",
+					argv[0]);
+			return 1;
+		}
+	}
+	if (!iterations) iterations = 1;
+	if (max_threads < 1) max_threads = 1;
+
+	sync_queue = dispatch_queue_create("bench.sync", NULL);
+	for (unsigned int n = 1; n <= max_threads; n = n < 2 ? 2 : n * 2) {
+		run("dispatch_sync", bench_dispatch_sync, n);
+		run("pthread_mutex", bench_mutex, n);
+	}
+	dispatch_release(sync_queue);
+	return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * Measures the synchronization primitives:
+ * - dispatch_group_enter/leave, with and without a wait on the empty group,
+ * - dispatch_semaphore_signal/wait uncontended, and a ping-pong between two
+ *   threads where every round trip blocks and wakes up a thread twice,
+ * - the dispatch_once_f() hot path, from one thread and from all CPUs.
+ *
+ * usage: bench_sync_primitives [-n iterations] [-t max_threads] [-r trials]
+ *		[-w warmup] [-c]
+ */
+
+#include "bench.h"
+#include <pthread.h>
+
+static dispatch_group_t group;
+static dispatch_semaphore_t sema_ping, sema_pong;
+static volatile bool pong_exit;
+static dispatch_once_t once_pred;
+static volatile uint64_t once_count;
+
+static void
+group_enter_leave(void *ctxt)
+{
+	(void)ctxt;
+	dispatch_group_enter(group);
+	dispatch_group_leave(group);
+}
+
+static void
+group_enter_leave_wait(void *ctxt)
+{
+	(void)ctxt;
+	dispatch_group_enter(group);
+	dispatch_group_leave(group);
+	dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+}
+
+static void
+sema_signal_wait(void *ctxt)
+{
+	(void)ctxt;
+	dispatch_semaphore_signal(sema_ping);
+	dispatch_semaphore_wait(sema_ping, DISPATCH_TIME_FOREVER);
+}
+
+static void
+sema_ping_pong(void *ctxt)
+{
+	(void)ctxt;
+	dispatch_semaphore_signal(sema_ping);
+	dispatch_semaphore_wait(sema_pong, DISPATCH_TIME_FOREVER);
+}
+
+static void *
+pong_thread(void *ctxt)
+{
+	(void)ctxt;
+	for (;;) {
+		dispatch_semaphore_wait(sema_ping, DISPATCH_TIME_FOREVER);
+		if (pong_exit) break;
+		dispatch_semaphore_signal(sema_pong);
+	}
+	return NULL;
+}
+
+static void
+once_init(void *ctxt)
+{
+	(void)ctxt;
+	once_count++;
+}
+
+static void
+once_hot(void *ctxt)
+{
+	(void)ctxt;
+	dispatch_once_f(&once_pred, NULL, once_init);
+}
+
+int
+main(int argc, char *argv[])
+{
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int max_threads = ncpu > 1 ? (unsigned int)ncpu : 2;
+	size_t iterations = 1000000;
+	pthread_t pong;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:t:" BENCH_COMMON_OPTIONS)) != -1) {
+		switch (ch) {
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			max_threads = (unsigned int)strtoul(optarg, NULL, 0);
+			break;
+		default:
+			if (bench_common_option(ch, optarg)) break;
+			fprintf(stderr, "usage: %s [-n iterations] [-t max_threads] "
+					BENCH_COMMON_USAGE "\n", argv[0]);
+			return 1;
+		}
+	}
+	if (!iterations) iterations = 1;
+	if (max_threads < 1) max_threads = 1;
+
+	group = dispatch_group_create();
+	bench_run("sync_primitives", "group_enter_leave", NULL, iterations, 1, 1,
+			NULL, group_enter_leave);
+	bench_run("sync_primitives", "group_enter_leave_wait", NULL, iterations,
+			1, 1, NULL, group_enter_leave_wait);
+	dispatch_release(group);
+
+	sema_ping = dispatch_semaphore_create(0);
+	sema_pong = dispatch_semaphore_create(0);
+	bench_run("sync_primitives", "semaphore_signal_wait", NULL, iterations,
+			1, 1, NULL, sema_signal_wait);
+	if (pthread_create(&pong, NULL, pong_thread, NULL)) {
+		perror("pthread_create");
+		return 1;
+	}
+	// every round trip goes through the kernel twice, keep the trials short
+	bench_run("sync_primitives", "semaphore_ping_pong", NULL,
+			iterations / 100 ? iterations / 100 : 1, 1, 1, NULL,
+			sema_ping_pong);
+	pong_exit = true;
+	dispatch_semaphore_signal(sema_ping);
+	pthread_join(pong, NULL);
+	dispatch_release(sema_pong);
+	dispatch_release(sema_ping);
+
+	for (unsigned int n = 1; n <= max_threads; n = n < 2 ? 2 : n * 2) {
+		bench_run("sync_primitives", "once_hot", NULL, iterations, 1, n,
+				NULL, once_hot);
+	}
+	if (once_count != 1) {
+		fprintf(stderr, "once_hot: initializer ran %llu times\n",
+				(unsigned long long)once_count);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * Measures the time between dispatch_async_f() on a global queue and the
+ * start of the work item, for items submitted at a fixed interval so that
+ * the pool is idle in between. This is the latency that idle worker spinning
+ * (LIBDISPATCH_WORKER_SPIN_USEC / LIBDISPATCH_WORKER_SPINNERS) trades CPU for.
+ *
+ * usage: bench_worker_wake_latency [-n iterations] [-g gap_usec]...
+ */
+
+#include "bench.h"
+#include <string.h>
+
+#define MAX_GAPS 16
+
+struct sample_ctx {
+	dispatch_semaphore_t sema;
+	uint64_t start;
+	uint64_t latency;
+};
+
+static void
+sample_work(void *context)
+{
+	struct sample_ctx *ctx = context;
+	ctx->latency = now_ns() - ctx->start;
+	dispatch_semaphore_signal(ctx->sema);
+}
+
+static int
+compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+static void
+run(dispatch_queue_t dq, unsigned long gap_usec, size_t iterations,
+		bool report)
+{
+	struct sample_ctx ctx = { .sema = dispatch_semaphore_create(0) };
+	uint64_t *samples = calloc(iterations, sizeof(uint64_t));
+	uint64_t sum = 0;
+
+	if (!samples) {
+		perror("calloc");
+		exit(1);
+	}
+	for (size_t i = 0; i < iterations; i++) {
+		if (gap_usec) usleep((useconds_t)gap_usec);
+		ctx.start = now_ns();
+		dispatch_async_f(dq, &ctx, sample_work);
+		dispatch_semaphore_wait(ctx.sema, DISPATCH_TIME_FOREVER);
+		samples[i] = ctx.latency;
+		sum += ctx.latency;
+	}
+	qsort(samples, iterations, sizeof(uint64_t), compare_u64);
+
+	if (report) printf("bench=worker_wake_latency case=async_global "
+			"gap_us=%lu n=%zu mean_ns=%llu p50_ns=%llu p90_ns=%llu "
+			"p99_ns=%llu max_ns=%llu\n",
+			gap_usec, iterations,
+			(unsigned long long)(sum / iterations),
+			(unsigned long long)samples[iterations / 2],
+			(unsigned long long)samples[iterations * 90 / 100],
+			(unsigned long long)samples[iterations * 99 / 100],
+			(unsigned long long)samples[iterations - 1]);
+	free(samples);
+	dispatch_release(ctx.sema);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned long gaps[MAX_GAPS] = { 0, 5, 20, 50, 200, 1000 };
+	size_t ngaps = 6, iterations = 10000;
+	bool custom_gaps = false;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:g:")) != -1) {
+		switch (ch) {
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'g':
+			if (!custom_gaps) {
+				custom_gaps = true;
+				ngaps = 0;
+			}
+			if (ngaps < MAX_GAPS) {
+				gaps[ngaps++] = strtoul(optarg, NULL, 0);
+			}
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n iterations] [-g gap_usec]...\n",
+					argv[0]);
+			return 1;
+		}
+	}
+	if (!iterations) iterations = 1;
+
+	const char *spin = getenv("LIBDISPATCH_WORKER_SPIN_USEC");
+	const char *spinners = getenv("LIBDISPATCH_WORKER_SPINNERS");
+	printf("# worker_wake_latency spin_usec=%s spinners=%s\n",
+			spin ? spin : "default", spinners ? spinners : "default");
+
+	dispatch_queue_t dq = dispatch_get_global_queue(
+			DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+	for (size_t i = 0; i < ngaps; i++) {
+		// warm up the pool and the spin heuristics for this arrival rate
+		run(dq, gaps[i], iterations / 10 ? iterations / 10 : 1, false);
+		run(dq, gaps[i], iterations, true);
+	}
+	return 0;
+}
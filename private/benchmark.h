@@ -82,6 +82,180 @@ uint64_t
 dispatch_benchmark_f(size_t count, void *_Nullable ctxt,
 		dispatch_function_t func);
 
+/*!
+ * @typedef dispatch_benchmark_flags_t
+ *
+ * @constant DISPATCH_BENCHMARK_CPU_COUNTERS
+ * Collect hardware counters (cycles, instructions, cache and branch misses)
+ * for the measured trials. This is only supported on Linux, through
+ * perf_event_open(2), and is silently ignored when the counters can't be
+ * opened (e.g. because of the perf_event_paranoid setting).
+ *
+ * @constant DISPATCH_BENCHMARK_PER_THREAD_CONTEXT
+ * The context passed to dispatch_benchmark_run_f() is an array of
+ * dba_threads contexts, thread i calling the function with the i-th one.
+ * Comparing runs with and without this flag separates the cost of contention
+ * on the shared context from the cost of the threads themselves. Not
+ * supported by dispatch_benchmark_run().
+ */
+DISPATCH_OPTIONS(dispatch_benchmark_flags, uint32_t,
+	DISPATCH_BENCHMARK_CPU_COUNTERS = 0x1,
+	DISPATCH_BENCHMARK_PER_THREAD_CONTEXT = 0x2,
+);
+
+/*!
+ * @typedef dispatch_benchmark_attr_s
+ *
+ * @abstract
+ * Parameters of a dispatch_benchmark_run_f() measurement.
+ *
+ * @field dba_version
+ * Must be set to DISPATCH_BENCHMARK_ATTR_VERSION.
+ *
+ * @field dba_count
+ * Number of times each thread calls the function during a trial.
+ *
+ * @field dba_warmup
+ * Number of trials run before the measured ones, and discarded.
+ *
+ * @field dba_trials
+ * Number of measured trials, 0 for DISPATCH_BENCHMARK_DEFAULT_TRIALS.
+ *
+ * @field dba_threads
+ * Number of threads calling the function concurrently during each trial,
+ * 0 for 1. The calling thread is one of them, the other ones are created for
+ * the duration of the run and released together at the start of every trial.
+ *
+ * @field dba_flags
+ * See dispatch_benchmark_flags_t.
+ *
+ * @field dba_trial_ns
+ * Optional array receiving the time per call of each measured trial, in the
+ * order they ran. It must have room for the number of measured trials.
+ */
+typedef struct dispatch_benchmark_attr_s {
+	unsigned long dba_version;
+	size_t dba_count;
+	size_t dba_warmup;
+	size_t dba_trials;
+	uint32_t dba_threads;
+	dispatch_benchmark_flags_t dba_flags;
+	double *_Nullable dba_trial_ns;
+} dispatch_benchmark_attr_s;
+
+#define DISPATCH_BENCHMARK_ATTR_VERSION 1
+#define DISPATCH_BENCHMARK_DEFAULT_TRIALS 32
+#define DISPATCH_BENCHMARK_HISTOGRAM_BUCKETS 16
+
+/*!
+ * @typedef dispatch_benchmark_result_s
+ *
+ * @abstract
+ * Statistics of a dispatch_benchmark_run_f() measurement.
+ *
+ * @discussion
+ * All times are in nanoseconds per call: the duration of a trial divided by
+ * dba_count, minus the cost of the benchmark loop itself. With several
+ * threads, this is the time per call as seen by each of them.
+ *
+ * @field dbr_trials
+ * Number of measured trials.
+ *
+ * @field dbr_min, dbr_max, dbr_mean, dbr_stddev
+ * Minimum, maximum, mean and standard deviation of the trials.
+ *
+ * @field dbr_p50, dbr_p90, dbr_p99
+ * Percentiles of the trials (nearest rank).
+ *
+ * @field dbr_histogram
+ * Number of trials in each of DISPATCH_BENCHMARK_HISTOGRAM_BUCKETS buckets
+ * of equal width between dbr_min and dbr_max.
+ *
+ * @field dbr_has_counters
+ * Whether the hardware counters below were collected.
+ *
+ * @field dbr_cycles, dbr_instructions, dbr_cache_misses, dbr_branch_misses
+ * Hardware counters of all the threads, averaged per call, including the
+ * cost of the benchmark loop.
+ */
+typedef struct dispatch_benchmark_result_s {
+	size_t dbr_trials;
+	double dbr_min;
+	double dbr_max;
+	double dbr_mean;
+	double dbr_stddev;
+	double dbr_p50;
+	double dbr_p90;
+	double dbr_p99;
+	uint32_t dbr_histogram[DISPATCH_BENCHMARK_HISTOGRAM_BUCKETS];
+	bool dbr_has_counters;
+	double dbr_cycles;
+	double dbr_instructions;
+	double dbr_cache_misses;
+	double dbr_branch_misses;
+} dispatch_benchmark_result_s, *dispatch_benchmark_result_t;
+
+/*!
+ * @function dispatch_benchmark_run
+ *
+ * @abstract
+ * Measures a block over repeated trials and returns their statistics.
+ *
+ * @discussion
+ * Unlike dispatch_benchmark(), which returns a single mean, this runs
+ * warmup trials, then dba_trials measured trials of dba_count calls each,
+ * optionally on several threads at once, so that two builds of a library or
+ * two implementations can be compared with their variance in mind.
+ *
+ * See dispatch_benchmark() for advice on benchmarking concurrent code.
+ *
+ * @param attr
+ * The parameters of the measurement.
+ *
+ * @param block
+ * The block to execute.
+ *
+ * @param result
+ * Filled with the statistics of the measured trials.
+ */
+#ifdef __BLOCKS__
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL_ALL DISPATCH_NOTHROW
+void
+dispatch_benchmark_run(const dispatch_benchmark_attr_s *attr,
+		dispatch_block_t block, dispatch_benchmark_result_t result);
+#endif
+
+/*!
+ * @function dispatch_benchmark_run_f
+ *
+ * @abstract
+ * Measures a function over repeated trials and returns their statistics.
+ *
+ * @discussion
+ * See dispatch_benchmark_run() for details.
+ *
+ * @param attr
+ * The parameters of the measurement.
+ *
+ * @param ctxt
+ * The context passed to the function, or an array of dba_threads contexts
+ * with DISPATCH_BENCHMARK_PER_THREAD_CONTEXT.
+ *
+ * @param func
+ * The function to execute.
+ *
+ * @param result
+ * Filled with the statistics of the measured trials.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL1 DISPATCH_NONNULL3 DISPATCH_NONNULL4
+DISPATCH_NOTHROW
+void
+dispatch_benchmark_run_f(const dispatch_benchmark_attr_s *attr,
+		void *_Nullable ctxt, dispatch_function_t func,
+		dispatch_benchmark_result_t result);
+
 __END_DECLS
 
 DISPATCH_ASSUME_NONNULL_END
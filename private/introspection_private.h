@@ -559,6 +559,13 @@ typedef void (*dispatch_introspection_hook_queue_item_complete_t)(
  * A worker thread is about to park (sent from the context of the thread).
  * `ptr` and `value` are 0.
  *
+ * @const dispatch_introspection_runtime_event_worker_wakeup
+ * A parked pool worker thread was woken up to process new work (sent from the
+ * context of the thread).
+ * `ptr` is the queue for which the thread was woken up.
+ * `value` is the time in nanoseconds between the wakeup request and the
+ * thread running.
+ *
  * @const dispatch_introspection_runtime_event_sync_wait
  * A caller of dispatch_sync or dispatch_async_and_wait hit contention.
  * `ptr` is the queue that caused the initial contention.
@@ -582,6 +589,7 @@ enum dispatch_introspection_runtime_event {
 	dispatch_introspection_runtime_event_worker_unpark = 2,
 	dispatch_introspection_runtime_event_worker_request = 3,
 	dispatch_introspection_runtime_event_worker_park = 4,
+	dispatch_introspection_runtime_event_worker_wakeup = 5,
 
 	dispatch_introspection_runtime_event_sync_wait = 10,
 	dispatch_introspection_runtime_event_async_sync_handoff = 11,
@@ -73,6 +73,7 @@
 #include <dispatch/layout_private.h>
 #include <dispatch/time_private.h>
 #include <dispatch/apply_private.h>
+#include <dispatch/tracebuf_private.h>
 
 #undef __DISPATCH_INDIRECT__
 #endif /* !__DISPATCH_BUILDING_DISPATCH__ */
@@ -418,6 +418,773 @@ dispatch_pthread_root_queue_copy_current(void);
 
 #endif /* defined(__BLOCKS__) && defined(__APPLE__) */
 
+/*!
+ * @typedef dispatch_pthread_pool_policy_s
+ *
+ * @abstract
+ * Elasticity policy of the pool of pthreads servicing a root queue.
+ *
+ * @field dpp_version
+ * Must be set to DISPATCH_PTHREAD_POOL_POLICY_VERSION.
+ *
+ * @field dpp_min_threads
+ * Number of threads the pool keeps around. Setting the policy creates the
+ * missing ones ahead of demand, at the pace dpp_spawn_interval allows, and
+ * idle threads are kept parked instead of exiting once the idle timeout
+ * expires while the pool has no more than this number.
+ *
+ * @field dpp_max_threads
+ * Maximum number of threads in the pool. Pass 0 to use the default size
+ * (the number of active CPUs for non overcommit global queues, the pool size
+ * the root queue was created with otherwise).
+ *
+ * @field dpp_idle_timeout
+ * Time in nanoseconds an idle thread waits for work before it exits.
+ * Pass 0 to use the default (5 seconds), or DISPATCH_TIME_FOREVER for idle
+ * threads to never exit.
+ *
+ * @field dpp_spawn_interval
+ * Minimum time in nanoseconds between two thread creations while the pool
+ * already has threads, 0 for no rate limiting. A root queue with no threads
+ * always creates one immediately. Creations over that rate are delayed, not
+ * dropped: they are requested again by the first submission to the queue
+ * after the interval elapsed. The worker threads of the global queues are
+ * also asked for again periodically if the queue still has pending work.
+ */
+typedef struct dispatch_pthread_pool_policy_s {
+	unsigned long dpp_version;
+	uint32_t dpp_min_threads;
+	uint32_t dpp_max_threads;
+	uint64_t dpp_idle_timeout;
+	uint64_t dpp_spawn_interval;
+} dispatch_pthread_pool_policy_s, *dispatch_pthread_pool_policy_t;
+
+#define DISPATCH_PTHREAD_POOL_POLICY_VERSION 1
+
+/*!
+ * @typedef dispatch_pthread_pool_stats_s
+ *
+ * @abstract
+ * Counters describing the activity of the pool of pthreads of a root queue.
+ *
+ * @field dpps_threads
+ * Number of threads currently in the pool.
+ *
+ * @field dpps_spawned
+ * Number of threads created since the pool was created.
+ *
+ * @field dpps_exited
+ * Number of threads that exited after being idle for the idle timeout.
+ *
+ * @field dpps_throttled
+ * Number of thread creation requests delayed by the spawn rate limit.
+ */
+typedef struct dispatch_pthread_pool_stats_s {
+	uint32_t dpps_threads;
+	uint64_t dpps_spawned;
+	uint64_t dpps_exited;
+	uint64_t dpps_throttled;
+} dispatch_pthread_pool_stats_s, *dispatch_pthread_pool_stats_t;
+
+/*!
+ * @function dispatch_pthread_pool_set_policy
+ *
+ * @abstract
+ * Changes the elasticity policy of the pthread pool servicing a root queue.
+ *
+ * @discussion
+ * This may be called at any time. Lowering the maximum number of threads
+ * does not terminate running threads, the pool shrinks as they become idle.
+ * The new idle timeout applies the next time a thread parks.
+ *
+ * This is only supported for pthread root queues, and for the global root
+ * queues when libdispatch manages its own workqueue (e.g. on Linux).
+ *
+ * @param queue
+ * The root queue whose pool to configure.
+ *
+ * @param policy
+ * The new policy.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL_ALL DISPATCH_NOTHROW
+void
+dispatch_pthread_pool_set_policy(dispatch_queue_global_t queue,
+		const dispatch_pthread_pool_policy_s *policy);
+
+/*!
+ * @function dispatch_pthread_pool_get_policy
+ *
+ * @abstract
+ * Returns the elasticity policy of the pthread pool servicing a root queue,
+ * with defaults resolved to their actual values.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL_ALL DISPATCH_NOTHROW
+void
+dispatch_pthread_pool_get_policy(dispatch_queue_global_t queue,
+		dispatch_pthread_pool_policy_t policy);
+
+/*!
+ * @function dispatch_pthread_pool_get_stats
+ *
+ * @abstract
+ * Returns the thread counters of the pthread pool servicing a root queue.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL_ALL DISPATCH_NOTHROW
+void
+dispatch_pthread_pool_get_stats(dispatch_queue_global_t queue,
+		dispatch_pthread_pool_stats_t stats);
+
+/*!
+ * @typedef dispatch_qos_sched_stats_s
+ *
+ * @abstract
+ * Scheduling statistics of the worker threads of the global queues of a QoS
+ * class.
+ *
+ * @field dqss_threads
+ * Number of worker threads currently servicing the QoS class.
+ *
+ * @field dqss_overrides
+ * Number of times a worker thread of this QoS class was temporarily moved to
+ * a higher QoS because such work was enqueued on a queue it was draining.
+ *
+ * @field dqss_run_time
+ * Cumulative time in nanoseconds the worker threads spent running.
+ *
+ * @field dqss_runqueue_wait
+ * Cumulative time in nanoseconds the worker threads spent runnable, waiting
+ * for a CPU in the kernel run queue.
+ *
+ * @field dqss_timeslices
+ * Number of times the worker threads were scheduled on a CPU.
+ */
+typedef struct dispatch_qos_sched_stats_s {
+	uint32_t dqss_threads;
+	uint64_t dqss_overrides;
+	uint64_t dqss_run_time;
+	uint64_t dqss_runqueue_wait;
+	uint64_t dqss_timeslices;
+} dispatch_qos_sched_stats_s, *dispatch_qos_sched_stats_t;
+
+/*!
+ * @function dispatch_qos_get_sched_stats
+ *
+ * @abstract
+ * Returns the scheduling statistics of the worker threads of a QoS class.
+ *
+ * @discussion
+ * This is only supported when libdispatch manages its own workqueue on
+ * Linux, where worker threads are given the nice value and scheduling policy
+ * matching the QoS class of their queue.
+ *
+ * Times include the worker threads that already exited. They come from the
+ * scheduler statistics of the kernel and stay 0 when it doesn't collect them.
+ *
+ * @param qos_class
+ * A QoS class other than QOS_CLASS_UNSPECIFIED.
+ *
+ * @param stats
+ * Filled with the statistics of the QoS class.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL2 DISPATCH_NOTHROW
+void
+dispatch_qos_get_sched_stats(dispatch_qos_class_t qos_class,
+		dispatch_qos_sched_stats_t stats);
+
+/*!
+ * @typedef dispatch_worker_pool_health_s
+ *
+ * @abstract
+ * A snapshot of the worker threads of the global queues of a QoS class.
+ *
+ * @discussion
+ * Worker threads are either idle, waiting for work, running, or blocked in
+ * the middle of a work item. Pending requests with as many running threads
+ * as the target point at CPU saturation, pending requests with blocked
+ * threads and few running ones point at thread starvation.
+ *
+ * @field dwph_qos_class
+ * The QoS class of the global queues.
+ *
+ * @field dwph_threads
+ * Number of worker threads alive, overcommit ones included.
+ *
+ * @field dwph_overcommit_threads
+ * Number of worker threads alive servicing the overcommit global queue.
+ *
+ * @field dwph_idle
+ * Number of worker threads parked or spinning, waiting for work.
+ *
+ * @field dwph_running
+ * Number of worker threads running a work item or runnable, waiting for a
+ * CPU.
+ *
+ * @field dwph_blocked
+ * Number of worker threads sleeping in the middle of a work item, on I/O or
+ * a lock for instance.
+ *
+ * @field dwph_target_running
+ * Number of running threads the workqueue tries to maintain for the
+ * non-overcommit global queue, it adds threads while there is work pending
+ * and fewer threads are running.
+ *
+ * @field dwph_pending
+ * Number of worker thread requests which weren't serviced yet.
+ *
+ * @field dwph_spawned
+ * Number of worker threads created, overcommit ones included.
+ *
+ * @field dwph_exited
+ * Number of worker threads which exited, overcommit ones included.
+ *
+ * @field dwph_overcommit_spawned
+ * Number of worker threads created for the overcommit global queue.
+ *
+ * @field dwph_pokes
+ * Number of times work was made available to the queues with no worker
+ * thread spinning for it, each of which wakes or creates threads.
+ */
+typedef struct dispatch_worker_pool_health_s {
+	dispatch_qos_class_t dwph_qos_class;
+	uint32_t dwph_threads;
+	uint32_t dwph_overcommit_threads;
+	uint32_t dwph_idle;
+	uint32_t dwph_running;
+	uint32_t dwph_blocked;
+	uint32_t dwph_target_running;
+	uint32_t dwph_pending;
+	uint64_t dwph_spawned;
+	uint64_t dwph_exited;
+	uint64_t dwph_overcommit_spawned;
+	uint64_t dwph_pokes;
+} dispatch_worker_pool_health_s, *dispatch_worker_pool_health_t;
+
+/*!
+ * @function dispatch_worker_pool_get_health
+ *
+ * @abstract
+ * Returns a snapshot of the worker threads of the global queues, one QoS
+ * class at a time.
+ *
+ * @discussion
+ * This is only supported when libdispatch manages its own workqueue on
+ * Linux. The state of the threads is read from /proc and the counters while
+ * threads keep running, so they are only consistent with each other
+ * approximately.
+ *
+ * @param health
+ * An array filled with one entry per QoS class, from the lowest to the
+ * highest one.
+ *
+ * @param count
+ * The number of entries of the array.
+ *
+ * @result
+ * The number of entries filled.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL1 DISPATCH_NOTHROW
+size_t
+dispatch_worker_pool_get_health(dispatch_worker_pool_health_t health,
+		size_t count);
+
+/*!
+ * @typedef dispatch_worker_pool_health_handler_t
+ *
+ * @abstract
+ * The type of functions called by dispatch_worker_pool_set_health_handler_f().
+ */
+typedef void (*dispatch_worker_pool_health_handler_t)(void *_Nullable context,
+		const dispatch_worker_pool_health_s *health, size_t count);
+
+/*!
+ * @function dispatch_worker_pool_set_health_handler_f
+ *
+ * @abstract
+ * Calls a function periodically with the snapshots returned by
+ * dispatch_worker_pool_get_health().
+ *
+ * @discussion
+ * The function runs on an overcommit global queue, so that it keeps being
+ * called when the worker threads of the other queues are all blocked.
+ * Setting a handler replaces the previous one, a call to the previous handler
+ * which already started may still be running when this function returns.
+ *
+ * @param interval
+ * The interval between calls, in nanoseconds.
+ *
+ * @param context
+ * The application-defined context parameter to pass to the function.
+ *
+ * @param handler
+ * The function to call, or NULL to stop calling the current one.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NOTHROW
+void
+dispatch_worker_pool_set_health_handler_f(uint64_t interval,
+		void *_Nullable context,
+		dispatch_worker_pool_health_handler_t _Nullable handler);
+
+/*!
+ * @typedef dispatch_blocked_worker_flags_t
+ *
+ * @abstract
+ * Options of dispatch_blocked_worker_detector_enable().
+ *
+ * @const DISPATCH_BLOCKED_WORKER_COMPENSATE
+ * Create a new worker thread for the non-overcommit global queue of a
+ * blocked worker if it has work pending, even when the thread pool is full,
+ * like the workqueue does when none of its threads are runnable.
+ */
+DISPATCH_OPTIONS(dispatch_blocked_worker_flags, unsigned long,
+	DISPATCH_BLOCKED_WORKER_COMPENSATE = 0x1,
+);
+
+/*!
+ * @typedef dispatch_blocked_worker_s
+ *
+ * @abstract
+ * A worker thread found blocked in a work item, see
+ * dispatch_blocked_worker_detector_enable().
+ *
+ * @field dbw_function
+ * The function, or the invoke function of the block, that was called out.
+ *
+ * @field dbw_label
+ * The label of the queue of the work item, possibly truncated.
+ *
+ * @field dbw_qos_class
+ * The QoS class of the global queue the worker thread belongs to.
+ *
+ * @field dbw_thread
+ * The kernel identifier of the worker thread.
+ *
+ * @field dbw_state
+ * The state of the thread, as shown by /proc: 'S' for an interruptible
+ * sleep, 'D' for an uninterruptible one, usually on I/O.
+ *
+ * @field dbw_compensated
+ * Whether a worker thread was requested to replace this one.
+ *
+ * @field dbw_duration
+ * Time in nanoseconds since the callout started.
+ */
+typedef struct dispatch_blocked_worker_s {
+	dispatch_function_t dbw_function;
+	char dbw_label[64];
+	dispatch_qos_class_t dbw_qos_class;
+	uint32_t dbw_thread;
+	char dbw_state;
+	bool dbw_compensated;
+	uint64_t dbw_duration;
+} dispatch_blocked_worker_s, *dispatch_blocked_worker_t;
+
+/*!
+ * @typedef dispatch_blocked_worker_handler_t
+ *
+ * @abstract
+ * The type of functions called by the detector enabled with
+ * dispatch_blocked_worker_detector_enable().
+ */
+typedef void (*dispatch_blocked_worker_handler_t)(void *_Nullable context,
+		const dispatch_blocked_worker_s *worker);
+
+/*!
+ * @function dispatch_blocked_worker_detector_enable
+ *
+ * @abstract
+ * Reports the worker threads of the global queues that stay blocked in a
+ * callout to client code for longer than a threshold.
+ *
+ * @discussion
+ * Worker threads record when they enter and leave callouts, and the
+ * workqueue monitor, which runs every second, reports those which have been
+ * in the same callout for longer than threshold and aren't runnable. Every
+ * callout is reported at most once. The handler runs on an overcommit global
+ * queue, so that it still runs when the worker threads are all blocked.
+ *
+ * When the detector is enabled, callouts read the clock when they start and
+ * end. Enabling the detector again replaces its parameters.
+ *
+ * @param threshold
+ * The duration of a callout, in nanoseconds, past which a blocked worker
+ * thread is reported. The monitor only checks workers once a second.
+ *
+ * @param flags
+ * Options of the detector.
+ *
+ * @param context
+ * The application-defined context parameter to pass to the handler.
+ *
+ * @param handler
+ * The function to call for every blocked worker thread.
+ *
+ * @result
+ * false if blocked workers can't be detected on this platform, which is only
+ * supported when libdispatch manages its own workqueue on Linux.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL4 DISPATCH_NOTHROW
+bool
+dispatch_blocked_worker_detector_enable(uint64_t threshold,
+		dispatch_blocked_worker_flags_t flags, void *_Nullable context,
+		dispatch_blocked_worker_handler_t handler);
+
+/*!
+ * @function dispatch_blocked_worker_detector_disable
+ *
+ * @abstract
+ * Stops reporting blocked worker threads.
+ *
+ * @discussion
+ * A report which was already submitted to the handler may still be delivered
+ * after this function returns.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NOTHROW
+void
+dispatch_blocked_worker_detector_disable(void);
+
+/*!
+ * @typedef dispatch_queue_graph_format_t
+ *
+ * @abstract
+ * The output formats of dispatch_queue_graph_dump().
+ *
+ * @const DISPATCH_QUEUE_GRAPH_TEXT
+ * An indented tree of the queues under their target queue, followed by the
+ * threads blocked in dispatch_sync(), meant to be read by humans.
+ *
+ * @const DISPATCH_QUEUE_GRAPH_JSON
+ * A single JSON object with a "queues" array, whose entries refer to their
+ * target queue by address, and a "sync_waiters" array.
+ */
+DISPATCH_ENUM(dispatch_queue_graph_format, unsigned long,
+	DISPATCH_QUEUE_GRAPH_TEXT = 1,
+	DISPATCH_QUEUE_GRAPH_JSON = 2,
+);
+
+/*!
+ * @function dispatch_queue_graph_dump
+ *
+ * @abstract
+ * Writes a snapshot of the target queue hierarchy of the process.
+ *
+ * @discussion
+ * Every queue is described with the state decoded from its dq_state: the
+ * suspend count, the width in flight or whether a barrier is held, whether it
+ * is enqueued on its target, its maximum QoS and the thread draining it. The
+ * number of pending work items is included for the queues which collect
+ * statistics, see dispatch_queue_enable_stats().
+ *
+ * The root queues, the main queue and the manager queue are always described,
+ * along with the queues threads are blocked on in dispatch_sync() and the
+ * targets of all the described queues. Other queues are described if they
+ * collect statistics, which LIBDISPATCH_QUEUE_STATS=1 enables for every queue,
+ * or if libdispatch is built with introspection.
+ *
+ * Threads blocked in dispatch_sync() are only tracked once a dump has been
+ * requested, or a trigger installed with dispatch_queue_graph_dump_on_signal(),
+ * or the wait analyzer enabled, so the first dump doesn't list the threads that
+ * were already blocked when it was requested.
+ *
+ * The snapshot isn't atomic: the state of every queue is read once, at a
+ * slightly different time.
+ *
+ * @param fd
+ * The file descriptor to write to, which isn't closed.
+ *
+ * @param format
+ * The format of the output.
+ *
+ * @result
+ * false if writing to the file descriptor failed.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NOTHROW
+bool
+dispatch_queue_graph_dump(int fd, dispatch_queue_graph_format_t format);
+
+/*!
+ * @function dispatch_queue_graph_dump_on_signal
+ *
+ * @abstract
+ * Writes a snapshot of the queue graph every time the process receives a
+ * signal.
+ *
+ * @discussion
+ * The dump is written by dispatch_queue_graph_dump() from an overcommit root
+ * queue, so that it is written even when all the worker threads are blocked.
+ * The default action of the signal should be disabled by the caller, as for
+ * DISPATCH_SOURCE_TYPE_SIGNAL sources.
+ *
+ * Calling this function again replaces the previous signal, and a signal of 0
+ * stops dumping. Setting LIBDISPATCH_QUEUE_GRAPH_SIGNAL=<signal number> in the
+ * environment dumps in the text format to stderr on that signal.
+ *
+ * @param signo
+ * The signal number, or 0.
+ *
+ * @param fd
+ * The file descriptor to write to, which must stay open until dumping stops.
+ *
+ * @param format
+ * The format of the output.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NOTHROW
+void
+dispatch_queue_graph_dump_on_signal(int signo, int fd,
+		dispatch_queue_graph_format_t format);
+
+/*!
+ * @typedef dispatch_wait_kind_t
+ *
+ * @abstract
+ * What a thread found by the wait analyzer is blocked in.
+ *
+ * @const DISPATCH_WAIT_SYNC
+ * dispatch_sync(), dispatch_barrier_sync() or dispatch_async_and_wait().
+ *
+ * @const DISPATCH_WAIT_GROUP
+ * dispatch_group_wait().
+ *
+ * @const DISPATCH_WAIT_SEMAPHORE
+ * dispatch_semaphore_wait().
+ */
+DISPATCH_ENUM(dispatch_wait_kind, unsigned long,
+	DISPATCH_WAIT_SYNC = 1,
+	DISPATCH_WAIT_GROUP = 2,
+	DISPATCH_WAIT_SEMAPHORE = 3,
+);
+
+/*!
+ * @typedef dispatch_wait_report_kind_t
+ *
+ * @abstract
+ * The problems reported by the wait analyzer.
+ *
+ * @const DISPATCH_WAIT_REPORT_DEADLOCK
+ * Threads which wait for each other in a cycle. Every entry of the report
+ * waits for the thread of the next entry, and the last one for the thread of
+ * the first one.
+ *
+ * @const DISPATCH_WAIT_REPORT_QOS_INVERSION
+ * A thread waiting, possibly through other waiting threads, for a thread which
+ * runs at a lower QoS. Every entry of the report waits for the thread of the
+ * next entry, and the last one for its dwre_owner thread.
+ */
+DISPATCH_ENUM(dispatch_wait_report_kind, unsigned long,
+	DISPATCH_WAIT_REPORT_DEADLOCK = 1,
+	DISPATCH_WAIT_REPORT_QOS_INVERSION = 2,
+);
+
+#define DISPATCH_WAIT_REPORT_FRAMES 16
+
+/*!
+ * @typedef dispatch_wait_report_entry_s
+ *
+ * @abstract
+ * A blocked thread of a dispatch_wait_report_s.
+ *
+ * @field dwre_kind
+ * What the thread is blocked in.
+ *
+ * @field dwre_object
+ * The queue, group or semaphore the thread waits for.
+ *
+ * @field dwre_label
+ * The label of the queue the thread waits for, possibly truncated.
+ *
+ * @field dwre_thread
+ * The identifier of the blocked thread.
+ *
+ * @field dwre_owner
+ * The thread draining the queue the thread waits for, or 0 if it isn't known,
+ * which is always the case for groups and semaphores.
+ *
+ * @field dwre_qos_class
+ * The QoS class of the blocked thread when it started waiting.
+ *
+ * @field dwre_owner_qos_class
+ * The QoS class the owner thread runs at, not counting overrides, or
+ * QOS_CLASS_UNSPECIFIED if it isn't known.
+ *
+ * @field dwre_duration
+ * Time in nanoseconds since the thread started waiting.
+ *
+ * @field dwre_nframes
+ * The number of return addresses in dwre_frames.
+ *
+ * @field dwre_frames
+ * The backtrace of the thread when it started waiting, innermost frame first.
+ */
+typedef struct dispatch_wait_report_entry_s {
+	dispatch_wait_kind_t dwre_kind;
+	const void *dwre_object;
+	char dwre_label[64];
+	uint64_t dwre_thread;
+	uint64_t dwre_owner;
+	dispatch_qos_class_t dwre_qos_class;
+	dispatch_qos_class_t dwre_owner_qos_class;
+	uint64_t dwre_duration;
+	uint32_t dwre_nframes;
+	void *_Nullable dwre_frames[DISPATCH_WAIT_REPORT_FRAMES];
+} dispatch_wait_report_entry_s;
+
+/*!
+ * @typedef dispatch_wait_report_s
+ *
+ * @abstract
+ * A problem found by the wait analyzer, see dispatch_wait_analyzer_enable().
+ *
+ * @field dwr_kind
+ * The kind of problem.
+ *
+ * @field dwr_count
+ * The number of entries.
+ *
+ * @field dwr_entries
+ * The threads involved, in the order they wait for each other.
+ */
+typedef struct dispatch_wait_report_s {
+	dispatch_wait_report_kind_t dwr_kind;
+	size_t dwr_count;
+	const dispatch_wait_report_entry_s *dwr_entries;
+} dispatch_wait_report_s;
+
+/*!
+ * @typedef dispatch_wait_report_handler_t
+ *
+ * @abstract
+ * The type of functions called by the analyzer enabled with
+ * dispatch_wait_analyzer_enable(). The report is only valid for the duration
+ * of the call.
+ */
+typedef void (*dispatch_wait_report_handler_t)(void *_Nullable context,
+		const dispatch_wait_report_s *report);
+
+/*!
+ * @function dispatch_wait_analyzer_enable
+ *
+ * @abstract
+ * Reports deadlocks and QoS inversions between threads blocked in
+ * dispatch_sync(), dispatch_group_wait() and dispatch_semaphore_wait().
+ *
+ * @discussion
+ * The analyzer maintains a wait-for graph between threads: a thread blocked in
+ * dispatch_sync() waits for the thread draining the queue, or one of its
+ * target queues. Group and semaphore waits end chains of waiting threads, as
+ * the thread which will signal them can't be known.
+ *
+ * Every threshold / 2, the graph is checked for cycles and for threads waiting
+ * for a thread of a lower QoS, among the waits that lasted for at least
+ * threshold. Every problem is reported once, from an overcommit global queue.
+ *
+ * dispatch_sync() waits are always tracked, and group and semaphore waits
+ * which block only while the analyzer is enabled. The backtraces of the
+ * waiting threads are captured while it is enabled, which is the main cost
+ * of the analyzer.
+ *
+ * Calling this function again replaces the threshold and handler.
+ * Setting LIBDISPATCH_WAIT_ANALYZER=<threshold in milliseconds> in the
+ * environment enables the analyzer with a handler that logs the reports.
+ *
+ * @param threshold
+ * The duration in nanoseconds after which a wait is analyzed, or 0 for one
+ * second.
+ *
+ * @param context
+ * The context to pass to the handler.
+ *
+ * @param handler
+ * The function to call for every report.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL3 DISPATCH_NOTHROW
+void
+dispatch_wait_analyzer_enable(uint64_t threshold, void *_Nullable context,
+		dispatch_wait_report_handler_t handler);
+
+/*!
+ * @function dispatch_wait_analyzer_disable
+ *
+ * @abstract
+ * Stops the analyzer enabled with dispatch_wait_analyzer_enable().
+ *
+ * @discussion
+ * A report which is being delivered may still be when this function returns.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NOTHROW
+void
+dispatch_wait_analyzer_disable(void);
+
+/*!
+ * @function dispatch_semaphore_acquire_async_f
+ *
+ * @abstract
+ * Decrements a semaphore, and submits a function to a queue once it was
+ * acquired, instead of blocking the calling thread.
+ *
+ * @discussion
+ * If the value of the semaphore is positive, the function is submitted right
+ * away. Otherwise it is kept in a FIFO inside the semaphore until
+ * dispatch_semaphore_signal() hands it the semaphore, so that any number of
+ * pending acquirers can be gated without blocking a single thread.
+ *
+ * Asynchronous acquirers are served before threads blocked in
+ * dispatch_semaphore_wait() on the same semaphore. The function owns the
+ * semaphore and must eventually call dispatch_semaphore_signal(), which makes
+ * the caller responsible for keeping the semaphore alive until then.
+ *
+ * @param dsema
+ * The semaphore to acquire.
+ * The result of passing NULL in this parameter is undefined.
+ *
+ * @param queue
+ * The queue to which the function is submitted once the semaphore is
+ * acquired. The queue is retained by the system until then.
+ * The result of passing NULL in this parameter is undefined.
+ *
+ * @param context
+ * The application-defined context parameter to pass to the function.
+ *
+ * @param work
+ * The application-defined function to invoke on the queue.
+ * The result of passing NULL in this parameter is undefined.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL1 DISPATCH_NONNULL2 DISPATCH_NONNULL4
+DISPATCH_NOTHROW
+void
+dispatch_semaphore_acquire_async_f(dispatch_semaphore_t dsema,
+		dispatch_queue_t queue, void *_Nullable context,
+		dispatch_function_t work);
+
+#ifdef __BLOCKS__
+/*!
+ * @function dispatch_semaphore_acquire_async
+ *
+ * @abstract
+ * Decrements a semaphore, and submits a block to a queue once it was
+ * acquired, instead of blocking the calling thread.
+ *
+ * @discussion
+ * See dispatch_semaphore_acquire_async_f() for details.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL_ALL DISPATCH_NOTHROW
+void
+dispatch_semaphore_acquire_async(dispatch_semaphore_t dsema,
+		dispatch_queue_t queue, dispatch_block_t handler);
+#endif
+
 /*!
  * @function dispatch_async_enforce_qos_class_f
  *
@@ -454,6 +1221,545 @@ void
 dispatch_async_enforce_qos_class_f(dispatch_queue_t queue,
 		void *_Nullable context, dispatch_function_t work);
 
+/*!
+ * @function dispatch_async_batch_f
+ *
+ * @abstract
+ * Submits a batch of functions for asynchronous execution on a dispatch queue.
+ *
+ * @discussion
+ * Behaves as if dispatch_async_f() was called for each context in order, but
+ * the work items are published to the queue at once, and the queue is woken
+ * up (or worker threads requested) a single time for the whole batch.
+ *
+ * Items are still executed individually and in submission order with respect
+ * to the queue's own ordering guarantees. Queues that do not support batched
+ * submission (for example the main queue or workloops) fall back to
+ * submitting items one at a time.
+ *
+ * @param queue
+ * The target dispatch queue to which the functions are submitted.
+ * The system will hold a reference on the target queue until all the
+ * functions have returned.
+ * The result of passing NULL in this parameter is undefined.
+ *
+ * @param count
+ * The number of entries in the contexts array.
+ *
+ * @param contexts
+ * The application-defined context parameters to pass to the function, one per
+ * work item.
+ *
+ * @param work
+ * The application-defined function to invoke for each context on the target
+ * queue. The result of passing NULL in this parameter is undefined.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL1 DISPATCH_NONNULL4 DISPATCH_NOTHROW
+void
+dispatch_async_batch_f(dispatch_queue_t queue, size_t count,
+		void *_Nullable const *_Nonnull contexts, dispatch_function_t work);
+
+/*!
+ * @function dispatch_read_sync_f
+ *
+ * @abstract
+ * Submits a read-only function for synchronous execution on a concurrent
+ * dispatch queue.
+ *
+ * @discussion
+ * Behaves like dispatch_sync_f(), but optimized for concurrent queues that
+ * are mostly read with dispatch_read_sync_f() and occasionally written to with
+ * barriers: when no barrier is pending, readers register in a per-CPU reader
+ * indicator instead of the shared queue state, and the function is invoked
+ * on the calling thread without the readers contending with each other.
+ *
+ * Barriers on the queue wait for all such readers to return before they
+ * execute. After a barrier had to wait, and whenever work items are pending
+ * on the queue, readers take the regular dispatch_sync_f() path for a while
+ * so that writers are not starved.
+ *
+ * The function must not modify the state protected by the queue, and must
+ * not submit barriers to the same queue synchronously: doing so deadlocks.
+ *
+ * On serial queues, and on queues whose target is not a global root queue,
+ * this function is equivalent to dispatch_sync_f().
+ *
+ * @param queue
+ * The target dispatch queue to which the function is submitted.
+ * The result of passing NULL in this parameter is undefined.
+ *
+ * @param context
+ * The application-defined context parameter to pass to the function.
+ *
+ * @param work
+ * The application-defined function to invoke on the target queue. The first
+ * parameter passed to this function is the context provided to
+ * dispatch_read_sync_f().
+ * The result of passing NULL in this parameter is undefined.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL1 DISPATCH_NONNULL3 DISPATCH_NOTHROW
+void
+dispatch_read_sync_f(dispatch_queue_t queue, void *_Nullable context,
+		dispatch_function_t work);
+
+#ifdef __BLOCKS__
+/*!
+ * @function dispatch_read_sync
+ *
+ * @abstract
+ * Submits a read-only block for synchronous execution on a concurrent
+ * dispatch queue.
+ *
+ * @discussion
+ * See dispatch_read_sync_f() for details.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL_ALL DISPATCH_NOTHROW
+void
+dispatch_read_sync(dispatch_queue_t queue,
+		DISPATCH_NOESCAPE dispatch_block_t block);
+#endif
+
+/*!
+ * @function dispatch_async_coalesced_f
+ *
+ * @abstract
+ * Submits a function for asynchronous execution on a dispatch queue, unless
+ * the same function and context pair is already pending on that queue.
+ *
+ * @discussion
+ * Behaves like dispatch_async_f(), except that while a work item submitted
+ * with dispatch_async_coalesced_f() for a given function and context has not
+ * started executing, further submissions of the same pair to the same queue
+ * are folded into it: no new work item is enqueued and the queue is not woken
+ * up again. This is meant for notifications such as "refresh" or "flush" where
+ * only the last request matters.
+ *
+ * The function is guaranteed to start executing after the last submission.
+ * Submissions made while it runs enqueue a new work item. The work item runs
+ * with the priority and voucher captured by the submission that enqueued it.
+ *
+ * Queues other than serial and concurrent queues (for example workloops)
+ * do not coalesce, and this function behaves like dispatch_async_f().
+ *
+ * @param queue
+ * The target dispatch queue to which the function is submitted.
+ * The system will hold a reference on the target queue until the function
+ * has returned.
+ * The result of passing NULL in this parameter is undefined.
+ *
+ * @param context
+ * The application-defined context parameter to pass to the function.
+ * Together with the function, it identifies the work items to coalesce.
+ *
+ * @param work
+ * The application-defined function to invoke on the target queue.
+ * The result of passing NULL in this parameter is undefined.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL1 DISPATCH_NONNULL3 DISPATCH_NOTHROW
+void
+dispatch_async_coalesced_f(dispatch_queue_t queue, void *_Nullable context,
+		dispatch_function_t work);
+
+/*!
+ * @typedef dispatch_queue_overflow_t
+ *
+ * @abstract
+ * What happens to asynchronous submissions to a queue that has reached its
+ * pending work items limit (see dispatch_queue_set_pending_limit()).
+ *
+ * @const DISPATCH_QUEUE_OVERFLOW_BLOCK
+ * Submissions wait until the queue has room for the work item.
+ *
+ * @const DISPATCH_QUEUE_OVERFLOW_FAIL
+ * dispatch_async_bounded_f() returns without submitting the work item.
+ * dispatch_async() and the other submission functions which can't report
+ * failure wait for room instead.
+ *
+ * @const DISPATCH_QUEUE_OVERFLOW_DROP_OLDEST
+ * Submissions always succeed, and the queue discards its oldest pending work
+ * items as it drains, until it is back within its limit. Discarded functions
+ * are not invoked and discarded blocks are released. Barriers and blocks made
+ * with dispatch_block_create() are never discarded.
+ */
+DISPATCH_ENUM(dispatch_queue_overflow, unsigned long,
+	DISPATCH_QUEUE_OVERFLOW_BLOCK = 0,
+	DISPATCH_QUEUE_OVERFLOW_FAIL = 1,
+	DISPATCH_QUEUE_OVERFLOW_DROP_OLDEST = 2,
+);
+
+/*!
+ * @function dispatch_queue_set_pending_limit
+ *
+ * @abstract
+ * Bounds the number of work items submitted asynchronously to a queue that
+ * have not started executing yet.
+ *
+ * @discussion
+ * The limit counts all the work items submitted with dispatch_async() and
+ * its variants (barriers, groups, ...) while the queue is busy. The count is
+ * kept with the limit, away from the queue state, so that queues which aren't
+ * bounded don't pay for it. What happens when the queue is full is controlled
+ * by the overflow parameter.
+ *
+ * dispatch_async(), dispatch_async_f(), dispatch_barrier_async(),
+ * dispatch_barrier_async_f() and dispatch_async_bounded_f() enforce the
+ * limit. Work items pushed by other means, such as dispatch_group_async() or
+ * source handlers, are counted but never wait, and may take the queue past
+ * its limit.
+ *
+ * Work items submitted from the queue itself never wait for it to drain.
+ * Work items that run right away on an idle concurrent queue are not counted.
+ *
+ * This function must be called on an inactive queue (see
+ * dispatch_queue_attr_make_initially_inactive()), and only serial and
+ * concurrent queues can be bounded.
+ *
+ * @param queue
+ * The serial or concurrent dispatch queue to bound.
+ *
+ * @param limit
+ * The maximum number of pending work items, must be greater than 0.
+ *
+ * @param overflow
+ * The behavior for submissions past the limit.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL1 DISPATCH_NOTHROW
+void
+dispatch_queue_set_pending_limit(dispatch_queue_t queue, size_t limit,
+		dispatch_queue_overflow_t overflow);
+
+/*!
+ * @function dispatch_async_bounded_f
+ *
+ * @abstract
+ * Submits a function for asynchronous execution on a dispatch queue, honoring
+ * the pending limit of the queue.
+ *
+ * @discussion
+ * Behaves like dispatch_async_f(), except that if the queue has reached the
+ * pending limit set with dispatch_queue_set_pending_limit(), it waits for room
+ * with the DISPATCH_QUEUE_OVERFLOW_BLOCK overflow behavior, and with the
+ * DISPATCH_QUEUE_OVERFLOW_FAIL overflow behavior the function is not submitted
+ * and a non-zero value is returned.
+ *
+ * @param queue
+ * The target dispatch queue to which the function is submitted.
+ * The result of passing NULL in this parameter is undefined.
+ *
+ * @param context
+ * The application-defined context parameter to pass to the function.
+ *
+ * @param work
+ * The application-defined function to invoke on the target queue.
+ * The result of passing NULL in this parameter is undefined.
+ *
+ * @result
+ * Returns zero on success, or non-zero if the queue was full.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL1 DISPATCH_NONNULL3 DISPATCH_WARN_RESULT
+DISPATCH_NOTHROW
+long
+dispatch_async_bounded_f(dispatch_queue_t queue, void *_Nullable context,
+		dispatch_function_t work);
+
+/*!
+ * @const DISPATCH_QUEUE_STATS_HISTOGRAM_BUCKETS
+ *
+ * @discussion
+ * Number of buckets of the latency histograms of dispatch_queue_stats_s.
+ * Bucket 0 counts durations under 1024ns, bucket i counts durations in
+ * [2^(i+9), 2^(i+10)) nanoseconds, and the last bucket is open ended (about
+ * 268ms and above).
+ */
+#define DISPATCH_QUEUE_STATS_HISTOGRAM_BUCKETS 20
+
+/*!
+ * @typedef dispatch_queue_stats_s
+ *
+ * @abstract
+ * Statistics of a queue set up with dispatch_queue_enable_stats().
+ *
+ * @field dqst_label
+ * The label of the queue when statistics were enabled, possibly truncated.
+ *
+ * @field dqst_serialnum
+ * The serial number of the queue, unique in the process.
+ *
+ * @field dqst_enqueued
+ * Number of work items submitted asynchronously to the queue, including the
+ * queues and sources targeting it each time they have work pending.
+ *
+ * @field dqst_dequeued
+ * Number of work items that started executing or were discarded.
+ *
+ * @field dqst_depth
+ * Number of work items submitted but not started yet.
+ *
+ * @field dqst_wakeups
+ * Number of times a submission found the queue idle and had to wake it up.
+ *
+ * @field dqst_latency
+ * Histogram of the time between the submission of a work item and the moment
+ * it started executing, see DISPATCH_QUEUE_STATS_HISTOGRAM_BUCKETS.
+ *
+ * @field dqst_execution
+ * Histogram of the execution time of work items.
+ */
+typedef struct dispatch_queue_stats_s {
+	char dqst_label[64];
+	unsigned long dqst_serialnum;
+	uint64_t dqst_enqueued;
+	uint64_t dqst_dequeued;
+	uint64_t dqst_depth;
+	uint64_t dqst_wakeups;
+	uint64_t dqst_latency[DISPATCH_QUEUE_STATS_HISTOGRAM_BUCKETS];
+	uint64_t dqst_execution[DISPATCH_QUEUE_STATS_HISTOGRAM_BUCKETS];
+} dispatch_queue_stats_s, *dispatch_queue_stats_t;
+
+/*!
+ * @function dispatch_queue_enable_stats
+ *
+ * @abstract
+ * Starts collecting statistics about the work items of a queue.
+ *
+ * @discussion
+ * The counters are kept per CPU with relaxed atomic operations, and only one
+ * work item in 16 is timestamped for the histograms, so that statistics can
+ * be left enabled in production. Queues that don't have statistics enabled
+ * only pay a test of the queue specific data on submission and drain.
+ *
+ * Statistics can be enabled at any time and stay enabled for the lifetime of
+ * the queue. Work items submitted before that are not accounted for.
+ *
+ * Setting the LIBDISPATCH_QUEUE_STATS environment variable enables statistics
+ * for all serial and concurrent queues.
+ *
+ * @param queue
+ * The serial or concurrent queue to collect statistics for.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL_ALL DISPATCH_NOTHROW
+void
+dispatch_queue_enable_stats(dispatch_queue_t queue);
+
+/*!
+ * @function dispatch_queue_get_stats
+ *
+ * @abstract
+ * Returns the statistics of a queue.
+ *
+ * @discussion
+ * The counters are read one CPU at a time while the queue keeps running, so
+ * they are only consistent with each other approximately.
+ *
+ * @param queue
+ * The queue to query.
+ *
+ * @param stats
+ * Filled with the statistics of the queue.
+ *
+ * @result
+ * false if statistics are not enabled for this queue, in which case stats is
+ * left untouched.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL_ALL DISPATCH_NOTHROW
+bool
+dispatch_queue_get_stats(dispatch_queue_t queue, dispatch_queue_stats_t stats);
+
+/*!
+ * @typedef dispatch_queue_stats_applier_t
+ *
+ * @abstract
+ * The type of functions called by dispatch_queue_stats_apply_f().
+ */
+typedef void (*dispatch_queue_stats_applier_t)(void *_Nullable context,
+		const dispatch_queue_stats_s *stats);
+
+/*!
+ * @function dispatch_queue_stats_apply_f
+ *
+ * @abstract
+ * Calls a function with the statistics of every queue that has them enabled.
+ *
+ * @discussion
+ * This answers "which queue is backed up" without having to know the queues
+ * of the process beforehand. The statistics of all the queues are captured
+ * first, then the function is called synchronously for each of them, without
+ * any lock held.
+ *
+ * @param context
+ * The application-defined context parameter to pass to the function.
+ *
+ * @param applier
+ * The function to call for each queue.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL2 DISPATCH_NOTHROW
+void
+dispatch_queue_stats_apply_f(void *_Nullable context,
+		dispatch_queue_stats_applier_t applier);
+
+/*!
+ * @typedef dispatch_callout_profile_mode_t
+ *
+ * @abstract
+ * How dispatch_callout_profile_enable() picks the callouts it samples.
+ *
+ * @const DISPATCH_CALLOUT_PROFILE_EVERY_NTH
+ * Every thread samples one callout in interval.
+ *
+ * @const DISPATCH_CALLOUT_PROFILE_PERIODIC
+ * Every thread samples the first callout it starts once interval nanoseconds
+ * have passed since its previous sample. Long callouts are not more likely to
+ * be sampled than short ones in this mode, which only reads the clock at the
+ * start of every callout.
+ */
+DISPATCH_ENUM(dispatch_callout_profile_mode, unsigned long,
+	DISPATCH_CALLOUT_PROFILE_EVERY_NTH = 1,
+	DISPATCH_CALLOUT_PROFILE_PERIODIC = 2,
+);
+
+/*!
+ * @typedef dispatch_callout_profile_entry_s
+ *
+ * @abstract
+ * Aggregated samples of the callouts of a function, see
+ * dispatch_callout_profile_copy_top().
+ *
+ * @field dcpe_function
+ * The function, or the invoke function of the block, that was called out.
+ *
+ * @field dcpe_label
+ * The label of the queue of its most recent sample, possibly truncated.
+ *
+ * @field dcpe_qos
+ * The QoS class of the thread for its most recent sample.
+ *
+ * @field dcpe_samples
+ * Number of callouts of the function that were sampled.
+ *
+ * @field dcpe_cpu_time
+ * Total CPU time of the sampled callouts in nanoseconds.
+ *
+ * @field dcpe_run_time
+ * Total wall clock time of the sampled callouts in nanoseconds.
+ *
+ * @field dcpe_max_run_time
+ * Longest wall clock time of a sampled callout in nanoseconds.
+ *
+ * @field dcpe_wait_samples
+ * Number of work items of the function whose wait time was measured.
+ *
+ * @field dcpe_wait_time
+ * Total time between the submission and the start of these work items, in
+ * nanoseconds.
+ */
+typedef struct dispatch_callout_profile_entry_s {
+	dispatch_function_t dcpe_function;
+	char dcpe_label[64];
+	dispatch_qos_class_t dcpe_qos;
+	uint64_t dcpe_samples;
+	uint64_t dcpe_cpu_time;
+	uint64_t dcpe_run_time;
+	uint64_t dcpe_max_run_time;
+	uint64_t dcpe_wait_samples;
+	uint64_t dcpe_wait_time;
+} dispatch_callout_profile_entry_s, *dispatch_callout_profile_entry_t;
+
+/*!
+ * @function dispatch_callout_profile_enable
+ *
+ * @abstract
+ * Starts sampling the callouts of the process to client functions and blocks.
+ *
+ * @discussion
+ * Sampled callouts record their function, the label of their queue, their
+ * QoS, wall clock and CPU time into a buffer of the thread that ran them,
+ * without taking locks. dispatch_callout_profile_copy_top() aggregates these
+ * buffers. Work items submitted asynchronously also get their wait time
+ * measured, for one submission in 16 per submitting thread.
+ *
+ * Callouts that are not sampled only pay a per-thread counter, or a clock
+ * read in DISPATCH_CALLOUT_PROFILE_PERIODIC mode. When profiling is disabled,
+ * callouts only test a global.
+ *
+ * Enabling profiling again changes the mode, and discards the samples
+ * aggregated so far.
+ *
+ * Setting the LIBDISPATCH_CALLOUT_PROFILE environment variable to N enables
+ * profiling in DISPATCH_CALLOUT_PROFILE_EVERY_NTH mode at startup.
+ *
+ * @param mode
+ * How callouts are sampled.
+ *
+ * @param interval
+ * The sampling interval, in callouts or nanoseconds depending on mode.
+ *
+ * @result
+ * false if callout profiling isn't supported on this platform.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NOTHROW
+bool
+dispatch_callout_profile_enable(dispatch_callout_profile_mode_t mode,
+		uint64_t interval);
+
+/*!
+ * @function dispatch_callout_profile_disable
+ *
+ * @abstract
+ * Stops sampling callouts.
+ *
+ * @discussion
+ * The samples taken so far can still be read with
+ * dispatch_callout_profile_copy_top().
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NOTHROW
+void
+dispatch_callout_profile_disable(void);
+
+/*!
+ * @function dispatch_callout_profile_copy_top
+ *
+ * @abstract
+ * Returns the functions that used the most CPU time in sampled callouts.
+ *
+ * @discussion
+ * The samples of every thread since the previous call are added to the
+ * totals kept since profiling was enabled, which are then returned sorted by
+ * decreasing dcpe_cpu_time. Multiplying the totals by the sampling interval
+ * estimates the time spent in every function.
+ *
+ * A thread that takes samples faster than they are read overwrites its
+ * oldest ones, which are counted in dropped.
+ *
+ * @param entries
+ * An array of count entries to fill.
+ *
+ * @param count
+ * The number of functions to return at most.
+ *
+ * @param dropped
+ * If not NULL, filled with the number of samples lost since profiling was
+ * enabled.
+ *
+ * @result
+ * The number of entries filled.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL1 DISPATCH_NOTHROW
+size_t
+dispatch_callout_profile_copy_top(dispatch_callout_profile_entry_t entries,
+		size_t count, uint64_t *_Nullable dropped);
+
 #ifdef __ANDROID__
 /*!
  * @function _dispatch_install_thread_detach_callback
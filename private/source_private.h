@@ -369,6 +369,35 @@ enum {
 			0x00008000,
 };
 
+/*!
+ * @enum dispatch_source_fd_flags_t
+ *
+ * @constant DISPATCH_FD_EDGE_TRIGGERED
+ * The file descriptor is monitored in edge-triggered mode: the descriptor
+ * stays registered with the event loop across event deliveries and is never
+ * re-armed when the source is resumed. Readiness edges observed while the
+ * event handler is running are remembered and delivered once it returns.
+ * The event handler is expected to read (or write) until the operation
+ * fails with EAGAIN, otherwise no further event may be delivered.
+ * Only one such read source and one such write source may monitor a given
+ * file descriptor, unless DISPATCH_FD_EXCLUSIVE is also specified.
+ *
+ * @constant DISPATCH_FD_EXCLUSIVE
+ * Implies DISPATCH_FD_EDGE_TRIGGERED. Several sources may monitor the same
+ * file descriptor, and each readiness edge is delivered to only one of them
+ * whose event handler isn't already running. The descriptor is registered
+ * with EPOLLEXCLUSIVE, so that when a listening socket is shared with other
+ * processes, only one of them is woken up per incoming connection.
+ *
+ * These flags are only supported by the epoll event backend, they can be
+ * passed in the mask of DISPATCH_SOURCE_TYPE_READ and
+ * DISPATCH_SOURCE_TYPE_WRITE sources.
+ */
+enum {
+	DISPATCH_FD_EDGE_TRIGGERED = 0x1,
+	DISPATCH_FD_EXCLUSIVE = 0x2,
+};
+
 /*!
  * @enum dispatch_source_proc_flags_t
  *
@@ -0,0 +1,344 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * IMPORTANT: This header file describes INTERNAL interfaces to libdispatch
+ * which are subject to change in future releases. Any applications relying on
+ * these interfaces WILL break.
+ */
+
+#ifndef __DISPATCH_TRACEBUF_PRIVATE__
+#define __DISPATCH_TRACEBUF_PRIVATE__
+
+#ifndef __DISPATCH_INDIRECT__
+#error "Please #include <dispatch/private.h> instead of this file directly."
+#include <dispatch/base.h> // for HeaderDoc
+#endif
+
+#if !defined(_WIN32)
+
+DISPATCH_ASSUME_NONNULL_BEGIN
+
+__BEGIN_DECLS
+
+/*!
+ * @typedef dispatch_tracebuf_t
+ *
+ * @abstract
+ * A shared memory buffer that tracepoints are written to.
+ *
+ * @discussion
+ * Trace buffers are the firehose buffer design without its dependencies on
+ * Mach and logd: the buffer is a set of fixed size chunks in a shared memory
+ * region, every CPU writes to its own current chunk, and chunks that are full
+ * go to a ring that a reader drains, possibly from another process, before
+ * handing them back to writers.
+ *
+ * Reserving a tracepoint is one compare and swap in the current chunk of the
+ * CPU, and publishing it one atomic decrement. Writers never wait for the
+ * reader: when it falls behind, tracepoints are dropped and counted.
+ */
+typedef struct dispatch_tracebuf_s *dispatch_tracebuf_t;
+
+/*!
+ * @typedef dispatch_tracepoint_s
+ *
+ * @abstract
+ * A tracepoint, as laid out in the trace buffer.
+ *
+ * @field dtp_id
+ * The identifier passed to dispatch_tracebuf_tracepoint_flush(), 0 until
+ * then. Its meaning is up to the client.
+ *
+ * @field dtp_stamp
+ * The time of the reservation, in nanoseconds of the uptime clock.
+ *
+ * @field dtp_tid
+ * The thread that reserved the tracepoint.
+ *
+ * @field dtp_length
+ * The size of dtp_data.
+ *
+ * @field dtp_data
+ * The payload of the tracepoint, 8 bytes aligned.
+ */
+typedef struct dispatch_tracepoint_s {
+	uint64_t volatile dtp_id;
+	uint64_t dtp_stamp;
+	uint32_t dtp_tid;
+	uint16_t dtp_length;
+	uint16_t _dtp_unused;
+	uint8_t dtp_data[];
+} dispatch_tracepoint_s, *dispatch_tracepoint_t;
+
+/*!
+ * @const DISPATCH_TRACEBUF_TRACEPOINT_MAX_SIZE
+ *
+ * @discussion
+ * The largest payload that fits in a tracepoint.
+ */
+#define DISPATCH_TRACEBUF_TRACEPOINT_MAX_SIZE 4056u
+
+/*!
+ * @function dispatch_tracebuf_create
+ *
+ * @abstract
+ * Creates a trace buffer.
+ *
+ * @discussion
+ * The buffer lives in an anonymous shared memory object (a memfd on Linux),
+ * which readers in other processes access through the file descriptor
+ * returned by dispatch_tracebuf_get_fd(), for example by opening
+ * /proc/<pid>/fd/<fd>, or by receiving it over a UNIX domain socket.
+ *
+ * @param name
+ * A name for the buffer, recorded in it for the readers.
+ *
+ * @param size
+ * The size of the buffer in bytes, rounded to a number of 4k chunks. It is
+ * raised to at least 2 chunks per CPU.
+ *
+ * @result
+ * The new trace buffer, or NULL with errno set if the shared memory could not
+ * be set up.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_MALLOC DISPATCH_WARN_RESULT DISPATCH_NOTHROW
+dispatch_tracebuf_t _Nullable
+dispatch_tracebuf_create(const char *name, size_t size);
+
+/*!
+ * @function dispatch_tracebuf_get_fd
+ *
+ * @abstract
+ * Returns the file descriptor of the shared memory of a trace buffer.
+ *
+ * @discussion
+ * The file descriptor is owned by the trace buffer.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL_ALL DISPATCH_NOTHROW
+int
+dispatch_tracebuf_get_fd(dispatch_tracebuf_t tb);
+
+/*!
+ * @function dispatch_tracebuf_dispose
+ *
+ * @abstract
+ * Unmaps a trace buffer and closes its file descriptor.
+ *
+ * @discussion
+ * No thread may use the trace buffer anymore. Readers that have it mapped can
+ * keep draining it.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL_ALL DISPATCH_NOTHROW
+void
+dispatch_tracebuf_dispose(dispatch_tracebuf_t tb);
+
+/*!
+ * @function dispatch_tracebuf_tracepoint_reserve
+ *
+ * @abstract
+ * Reserves a tracepoint in the current chunk of the calling CPU.
+ *
+ * @discussion
+ * The caller fills dtp_data and must then publish the tracepoint with
+ * dispatch_tracebuf_tracepoint_flush(), promptly: the chunk of the tracepoint
+ * cannot be read until every tracepoint reserved in it is flushed.
+ *
+ * @param tb
+ * The trace buffer.
+ *
+ * @param length
+ * The size of the payload, at most DISPATCH_TRACEBUF_TRACEPOINT_MAX_SIZE.
+ *
+ * @result
+ * The tracepoint, or NULL if no chunk was available, in which case the loss
+ * is accounted for in the buffer.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL_ALL DISPATCH_NOTHROW
+dispatch_tracepoint_t _Nullable
+dispatch_tracebuf_tracepoint_reserve(dispatch_tracebuf_t tb, size_t length);
+
+/*!
+ * @function dispatch_tracebuf_tracepoint_flush
+ *
+ * @abstract
+ * Publishes a tracepoint returned by dispatch_tracebuf_tracepoint_reserve().
+ *
+ * @param tb
+ * The trace buffer.
+ *
+ * @param tp
+ * The tracepoint.
+ *
+ * @param id
+ * The identifier of the tracepoint, must not be 0.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL_ALL DISPATCH_NOTHROW
+void
+dispatch_tracebuf_tracepoint_flush(dispatch_tracebuf_t tb,
+		dispatch_tracepoint_t tp, uint64_t id);
+
+/*!
+ * @function dispatch_tracebuf_write
+ *
+ * @abstract
+ * Reserves, fills and flushes a tracepoint.
+ *
+ * @result
+ * false if the tracepoint was dropped.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL1 DISPATCH_NOTHROW
+bool
+dispatch_tracebuf_write(dispatch_tracebuf_t tb, uint64_t id,
+		const void *_Nullable data, size_t length);
+
+/*!
+ * @function dispatch_tracebuf_push
+ *
+ * @abstract
+ * Makes the chunks that CPUs are currently writing to available to readers.
+ *
+ * @discussion
+ * Readers only see chunks once they are full. This pushes the partially
+ * filled ones, so that a quiet buffer can be read too, e.g. periodically or
+ * before exiting.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL_ALL DISPATCH_NOTHROW
+void
+dispatch_tracebuf_push(dispatch_tracebuf_t tb);
+
+/*!
+ * @typedef dispatch_tracebuf_reader_t
+ *
+ * @abstract
+ * A mapping of a trace buffer for reading, see
+ * dispatch_tracebuf_reader_create().
+ */
+typedef struct dispatch_tracebuf_reader_s *dispatch_tracebuf_reader_t;
+
+/*!
+ * @typedef dispatch_tracebuf_reader_function_t
+ *
+ * @abstract
+ * The type of the functions called by dispatch_tracebuf_reader_drain_f().
+ *
+ * @param context
+ * The context passed to dispatch_tracebuf_reader_drain_f().
+ *
+ * @param tp
+ * The tracepoint, only valid for the duration of the call.
+ *
+ * @param cpu
+ * The CPU that wrote the chunk the tracepoint is in.
+ */
+typedef void (*dispatch_tracebuf_reader_function_t)(void *_Nullable context,
+		const dispatch_tracepoint_s *tp, uint32_t cpu);
+
+/*!
+ * @function dispatch_tracebuf_reader_create
+ *
+ * @abstract
+ * Maps a trace buffer for reading.
+ *
+ * @discussion
+ * A trace buffer supports a single reader at a time.
+ *
+ * @param fd
+ * A file descriptor of the shared memory of the buffer. It is not retained
+ * and may be closed once this returns.
+ *
+ * @result
+ * The reader, or NULL with errno set if fd is not a trace buffer (EINVAL) or
+ * could not be mapped.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_MALLOC DISPATCH_WARN_RESULT DISPATCH_NOTHROW
+dispatch_tracebuf_reader_t _Nullable
+dispatch_tracebuf_reader_create(int fd);
+
+/*!
+ * @function dispatch_tracebuf_reader_drain_f
+ *
+ * @abstract
+ * Calls a function for every tracepoint of the chunks that are ready, and
+ * returns the chunks to the writers.
+ *
+ * @discussion
+ * Tracepoints come in chunk order, and in reservation order within a chunk.
+ * Tracepoints of different CPUs can be ordered with their dtp_stamp.
+ *
+ * @result
+ * The number of tracepoints read.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL1 DISPATCH_NONNULL3 DISPATCH_NOTHROW
+size_t
+dispatch_tracebuf_reader_drain_f(dispatch_tracebuf_reader_t reader,
+		void *_Nullable context, dispatch_tracebuf_reader_function_t function);
+
+/*!
+ * @function dispatch_tracebuf_reader_get_info
+ *
+ * @abstract
+ * Returns information about the buffer a reader maps.
+ *
+ * @param reader
+ * The reader.
+ *
+ * @param pid
+ * Filled with the process that created the buffer.
+ *
+ * @param lost
+ * Filled with the number of tracepoints that writers dropped so far.
+ *
+ * @result
+ * The name of the buffer.
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL1 DISPATCH_NOTHROW
+const char *
+dispatch_tracebuf_reader_get_info(dispatch_tracebuf_reader_t reader,
+		pid_t *_Nullable pid, uint64_t *_Nullable lost);
+
+/*!
+ * @function dispatch_tracebuf_reader_dispose
+ *
+ * @abstract
+ * Unmaps a trace buffer mapped with dispatch_tracebuf_reader_create().
+ */
+SPI_AVAILABLE(macos(16.0), ios(19.0))
+DISPATCH_EXPORT DISPATCH_NONNULL_ALL DISPATCH_NOTHROW
+void
+dispatch_tracebuf_reader_dispose(dispatch_tracebuf_reader_t reader);
+
+__END_DECLS
+
+DISPATCH_ASSUME_NONNULL_END
+
+#endif // !defined(_WIN32)
+
+#endif // __DISPATCH_TRACEBUF_PRIVATE__
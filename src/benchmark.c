@@ -20,6 +20,12 @@
 
 #include "internal.h"
 
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
 struct __dispatch_benchmark_data_s {
 #if HAVE_MACH_ABSOLUTE_TIME
 	mach_timebase_info_data_t tbi;
@@ -83,15 +89,17 @@ _dispatch_benchmark_dummy_function(void *ctxt DISPATCH_UNUSED)
 {
 }
 
+static struct __dispatch_benchmark_data_s _dispatch_benchmark_data = {
+	.func = _dispatch_benchmark_dummy_function,
+	.count = 10000000ul, // ten million
+};
+static dispatch_once_t _dispatch_benchmark_pred;
+
 uint64_t
 dispatch_benchmark_f(size_t count, register void *ctxt,
 		register void (*func)(void *))
 {
-	static struct __dispatch_benchmark_data_s bdata = {
-		.func = _dispatch_benchmark_dummy_function,
-		.count = 10000000ul, // ten million
-	};
-	static dispatch_once_t pred;
+	struct __dispatch_benchmark_data_s *bdata = &_dispatch_benchmark_data;
 	uint64_t ns, start, delta;
 #if DISPATCH_SIZEOF_PTR == 8 && !defined(_WIN32)
 	__uint128_t conversion, big_denom;
@@ -100,7 +108,7 @@ dispatch_benchmark_f(size_t count, register void *ctxt,
 #endif
 	size_t i = 0;
 
-	dispatch_once_f(&pred, &bdata, _dispatch_benchmark_init);
+	dispatch_once_f(&_dispatch_benchmark_pred, bdata, _dispatch_benchmark_init);
 
 	if (unlikely(count == 0)) {
 		return 0;
@@ -115,14 +123,412 @@ dispatch_benchmark_f(size_t count, register void *ctxt,
 
 	conversion = (typeof(conversion)) delta;
 #if HAVE_MACH_ABSOLUTE_TIME
-	conversion *= bdata.tbi.numer;
-	big_denom = bdata.tbi.denom;
+	conversion *= bdata->tbi.numer;
+	big_denom = bdata->tbi.denom;
 #else
-	big_denom = delta;
+	big_denom = 1;
 #endif
 	big_denom *= count;
 	conversion /= big_denom;
 	ns = (uint64_t) conversion > UINT64_MAX ? UINT64_MAX : (uint64_t)conversion;
 
-	return ns - bdata.loop_cost;
+	return ns > bdata->loop_cost ? ns - bdata->loop_cost : 0;
+}
+
+#pragma mark -
+#pragma mark dispatch_benchmark_run
+
+#define DISPATCH_BENCHMARK_NCOUNTERS 4
+
+typedef struct dispatch_benchmark_thread_s {
+	struct dispatch_benchmark_state_s *dbt_state;
+	void *dbt_ctxt;
+#if !defined(_WIN32)
+	pthread_t dbt_thread;
+#endif
+#if defined(__linux__)
+	int dbt_perf_fds[DISPATCH_BENCHMARK_NCOUNTERS];
+#endif
+	bool dbt_has_counters;
+	uint64_t dbt_counters[DISPATCH_BENCHMARK_NCOUNTERS];
+} dispatch_benchmark_thread_s, *dispatch_benchmark_thread_t;
+
+typedef struct dispatch_benchmark_state_s {
+	void (*dbs_func)(void *);
+	size_t dbs_count;
+	uint32_t dbs_threads;
+	bool dbs_counters;
+	// helper threads spin on dbs_generation between trials
+	uint32_t volatile dbs_generation;
+	uint32_t volatile dbs_finished;
+	bool volatile dbs_exiting;
+	dispatch_benchmark_thread_s *dbs_thread_state;
+} dispatch_benchmark_state_s, *dispatch_benchmark_state_t;
+
+#if defined(__linux__)
+static const uint64_t
+_dispatch_benchmark_perf_events[DISPATCH_BENCHMARK_NCOUNTERS] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_MISSES,
+	PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+struct dispatch_benchmark_perf_read_s {
+	uint64_t nr;
+	uint64_t time_enabled;
+	uint64_t time_running;
+	uint64_t values[DISPATCH_BENCHMARK_NCOUNTERS];
+};
+#endif
+
+static void
+_dispatch_benchmark_counters_close(dispatch_benchmark_thread_t dbt)
+{
+#if defined(__linux__)
+	for (int i = 0; i < DISPATCH_BENCHMARK_NCOUNTERS; i++) {
+		if (dbt->dbt_perf_fds[i] != -1) {
+			(void)close(dbt->dbt_perf_fds[i]);
+			dbt->dbt_perf_fds[i] = -1;
+		}
+	}
+#endif
+}
+
+// counts the calling thread only, so every benchmark thread opens its own
+static void
+_dispatch_benchmark_counters_open(dispatch_benchmark_thread_t dbt)
+{
+#if defined(__linux__)
+	for (int i = 0; i < DISPATCH_BENCHMARK_NCOUNTERS; i++) {
+		dbt->dbt_perf_fds[i] = -1;
+	}
+	if (!dbt->dbt_state->dbs_counters) {
+		return;
+	}
+	for (int i = 0; i < DISPATCH_BENCHMARK_NCOUNTERS; i++) {
+		struct perf_event_attr pea = {
+			.type = PERF_TYPE_HARDWARE,
+			.size = sizeof(pea),
+			.config = _dispatch_benchmark_perf_events[i],
+			.read_format = PERF_FORMAT_GROUP |
+					PERF_FORMAT_TOTAL_TIME_ENABLED |
+					PERF_FORMAT_TOTAL_TIME_RUNNING,
+			.disabled = (i == 0),
+			.exclude_kernel = 1,
+			.exclude_hv = 1,
+		};
+		int group = i ? dbt->dbt_perf_fds[0] : -1;
+		long fd = syscall(SYS_perf_event_open, &pea, 0, -1, group,
+				PERF_FLAG_FD_CLOEXEC);
+		if (fd == -1) {
+			_dispatch_debug("benchmark: perf_event_open failed: %d", errno);
+			return _dispatch_benchmark_counters_close(dbt);
+		}
+		dbt->dbt_perf_fds[i] = (int)fd;
+	}
+	dbt->dbt_has_counters = true;
+#else
+	(void)dbt;
+#endif
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_benchmark_counters_start(dispatch_benchmark_thread_t dbt)
+{
+#if defined(__linux__)
+	if (dbt->dbt_has_counters) {
+		int fd = dbt->dbt_perf_fds[0];
+		(void)ioctl(fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		(void)ioctl(fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+#else
+	(void)dbt;
+#endif
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_benchmark_counters_stop(dispatch_benchmark_thread_t dbt)
+{
+#if defined(__linux__)
+	struct dispatch_benchmark_perf_read_s data;
+	int fd = dbt->dbt_perf_fds[0];
+
+	if (!dbt->dbt_has_counters) {
+		return;
+	}
+	(void)ioctl(fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+	if (read(fd, &data, sizeof(data)) != (ssize_t)sizeof(data) ||
+			data.nr != DISPATCH_BENCHMARK_NCOUNTERS ||
+			data.time_running == 0) {
+		return;
+	}
+	for (int i = 0; i < DISPATCH_BENCHMARK_NCOUNTERS; i++) {
+		uint64_t value = data.values[i];
+		if (data.time_running < data.time_enabled) {
+			// the group was multiplexed with other events, extrapolate
+			value = (uint64_t)((long double)value * data.time_enabled /
+					data.time_running);
+		}
+		dbt->dbt_counters[i] += value;
+	}
+#else
+	(void)dbt;
+#endif
+}
+
+static void
+_dispatch_benchmark_loop(dispatch_benchmark_thread_t dbt)
+{
+	// keep 'f', 'c' and 'cnt' in registers, like dispatch_benchmark_f()
+	register void (*f)(void *) = dbt->dbt_state->dbs_func;
+	register void *c = dbt->dbt_ctxt;
+	register size_t cnt = dbt->dbt_state->dbs_count;
+	size_t i = 0;
+
+	_dispatch_benchmark_counters_start(dbt);
+	do {
+		i++;
+		f(c);
+	} while (i < cnt);
+	_dispatch_benchmark_counters_stop(dbt);
+}
+
+#if !defined(_WIN32)
+static void *
+_dispatch_benchmark_thread(void *context)
+{
+	dispatch_benchmark_thread_t dbt = context;
+	dispatch_benchmark_state_t dbs = dbt->dbt_state;
+	uint32_t generation = 0, next;
+
+	_dispatch_benchmark_counters_open(dbt);
+	for (;;) {
+		while ((next = os_atomic_load(&dbs->dbs_generation, acquire)) ==
+				generation) {
+			dispatch_hardware_pause();
+		}
+		generation = next;
+		if (os_atomic_load(&dbs->dbs_exiting, relaxed)) {
+			break;
+		}
+		_dispatch_benchmark_loop(dbt);
+		os_atomic_inc(&dbs->dbs_finished, release);
+	}
+	_dispatch_benchmark_counters_close(dbt);
+	return NULL;
+}
+#endif
+
+// returns the duration of the trial, in nanoseconds
+static uint64_t
+_dispatch_benchmark_trial(dispatch_benchmark_state_t dbs)
+{
+	uint32_t helpers = dbs->dbs_threads - 1;
+	uint64_t start;
+
+	os_atomic_store(&dbs->dbs_finished, 0, relaxed);
+	start = _dispatch_uptime();
+	if (helpers) {
+		os_atomic_inc(&dbs->dbs_generation, release);
+	}
+	_dispatch_benchmark_loop(&dbs->dbs_thread_state[0]);
+	while (os_atomic_load(&dbs->dbs_finished, acquire) < helpers) {
+		dispatch_hardware_pause();
+	}
+	return _dispatch_time_mach2nano(_dispatch_uptime() - start);
+}
+
+static int
+_dispatch_benchmark_compare(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static double
+_dispatch_benchmark_sqrt(double x)
+{
+	// libdispatch doesn't link against libm
+	double r = x, prev = 0;
+
+	if (!(x > 0)) {
+		return 0;
+	}
+	for (int i = 0; i < 64 && (r > prev || r < prev); i++) {
+		prev = r;
+		r = (r + x / r) / 2;
+	}
+	return r;
+}
+
+static double
+_dispatch_benchmark_percentile(const double *sorted, size_t n, size_t p)
+{
+	size_t rank = (n * p + 99) / 100;
+	return sorted[rank ? rank - 1 : 0];
+}
+
+static void
+_dispatch_benchmark_summarize(double *trials, size_t n,
+		dispatch_benchmark_result_t result)
+{
+	double sum = 0, sq = 0, width;
+
+	qsort(trials, n, sizeof(double), _dispatch_benchmark_compare);
+	for (size_t i = 0; i < n; i++) {
+		sum += trials[i];
+	}
+	result->dbr_trials = n;
+	result->dbr_min = trials[0];
+	result->dbr_max = trials[n - 1];
+	result->dbr_mean = sum / (double)n;
+	for (size_t i = 0; i < n; i++) {
+		double d = trials[i] - result->dbr_mean;
+		sq += d * d;
+	}
+	result->dbr_stddev = n > 1 ? _dispatch_benchmark_sqrt(sq / (double)(n - 1)) : 0;
+	result->dbr_p50 = _dispatch_benchmark_percentile(trials, n, 50);
+	result->dbr_p90 = _dispatch_benchmark_percentile(trials, n, 90);
+	result->dbr_p99 = _dispatch_benchmark_percentile(trials, n, 99);
+
+	width = (result->dbr_max - result->dbr_min) /
+			DISPATCH_BENCHMARK_HISTOGRAM_BUCKETS;
+	for (size_t i = 0; i < n; i++) {
+		size_t bucket = 0;
+		if (width > 0) {
+			bucket = (size_t)((trials[i] - result->dbr_min) / width);
+			bucket = MIN(bucket, DISPATCH_BENCHMARK_HISTOGRAM_BUCKETS - 1);
+		}
+		result->dbr_histogram[bucket]++;
+	}
+}
+
+#ifdef __BLOCKS__
+void
+dispatch_benchmark_run(const dispatch_benchmark_attr_s *attr,
+		dispatch_block_t block, dispatch_benchmark_result_t result)
+{
+	if (unlikely(attr->dba_flags & DISPATCH_BENCHMARK_PER_THREAD_CONTEXT)) {
+		DISPATCH_CLIENT_CRASH(attr->dba_flags, "Per thread contexts require "
+				"dispatch_benchmark_run_f()");
+	}
+	dispatch_benchmark_run_f(attr, block, _dispatch_Block_invoke(block),
+			result);
+}
+#endif
+
+void
+dispatch_benchmark_run_f(const dispatch_benchmark_attr_s *attr, void *ctxt,
+		dispatch_function_t func, dispatch_benchmark_result_t result)
+{
+	dispatch_benchmark_state_s dbs = {
+		.dbs_func = func,
+		.dbs_count = attr->dba_count,
+		.dbs_threads = attr->dba_threads ? attr->dba_threads : 1,
+		.dbs_counters = (attr->dba_flags & DISPATCH_BENCHMARK_CPU_COUNTERS),
+	};
+	size_t trials = attr->dba_trials ?: DISPATCH_BENCHMARK_DEFAULT_TRIALS;
+	uint64_t counters[DISPATCH_BENCHMARK_NCOUNTERS] = { };
+	bool has_counters = dbs.dbs_counters;
+	uint64_t loop_cost;
+	double *samples;
+
+	if (unlikely(attr->dba_version != DISPATCH_BENCHMARK_ATTR_VERSION)) {
+		DISPATCH_CLIENT_CRASH(attr->dba_version,
+				"Unsupported dispatch_benchmark_attr_s version");
+	}
+	if (unlikely(attr->dba_count == 0)) {
+		DISPATCH_CLIENT_CRASH(0, "Benchmark iteration count must be > 0");
+	}
+	if ((attr->dba_flags & DISPATCH_BENCHMARK_PER_THREAD_CONTEXT) && !ctxt) {
+		DISPATCH_CLIENT_CRASH(0, "Per thread contexts require a context array");
+	}
+#if defined(_WIN32)
+	if (unlikely(dbs.dbs_threads > 1)) {
+		DISPATCH_CLIENT_CRASH(dbs.dbs_threads,
+				"Multi-threaded benchmarks are not supported on this platform");
+	}
+#endif
+
+	dispatch_once_f(&_dispatch_benchmark_pred, &_dispatch_benchmark_data,
+			_dispatch_benchmark_init);
+	loop_cost = _dispatch_benchmark_data.loop_cost;
+
+	dbs.dbs_thread_state = _dispatch_calloc(dbs.dbs_threads,
+			sizeof(dispatch_benchmark_thread_s));
+	for (uint32_t i = 0; i < dbs.dbs_threads; i++) {
+		dispatch_benchmark_thread_t dbt = &dbs.dbs_thread_state[i];
+		dbt->dbt_state = &dbs;
+		dbt->dbt_ctxt = ctxt;
+		if (attr->dba_flags & DISPATCH_BENCHMARK_PER_THREAD_CONTEXT) {
+			dbt->dbt_ctxt = ((void **)ctxt)[i];
+		}
+	}
+	_dispatch_benchmark_counters_open(&dbs.dbs_thread_state[0]);
+#if !defined(_WIN32)
+	for (uint32_t i = 1; i < dbs.dbs_threads; i++) {
+		dispatch_benchmark_thread_t dbt = &dbs.dbs_thread_state[i];
+		int r;
+		while ((r = pthread_create(&dbt->dbt_thread, NULL,
+				_dispatch_benchmark_thread, dbt))) {
+			if (r != EAGAIN) {
+				(void)dispatch_assume_zero(r);
+			}
+			_dispatch_temporary_resource_shortage();
+		}
+	}
+#endif
+
+	for (size_t i = 0; i < attr->dba_warmup; i++) {
+		(void)_dispatch_benchmark_trial(&dbs);
+	}
+	for (uint32_t i = 0; i < dbs.dbs_threads; i++) {
+		memset(dbs.dbs_thread_state[i].dbt_counters, 0,
+				sizeof(dbs.dbs_thread_state[i].dbt_counters));
+	}
+
+	samples = _dispatch_calloc(trials, sizeof(double));
+	for (size_t i = 0; i < trials; i++) {
+		double ns = (double)_dispatch_benchmark_trial(&dbs);
+		ns = ns / (double)dbs.dbs_count - (double)loop_cost;
+		samples[i] = ns > 0 ? ns : 0;
+		if (attr->dba_trial_ns) {
+			attr->dba_trial_ns[i] = samples[i];
+		}
+	}
+
+#if !defined(_WIN32)
+	os_atomic_store(&dbs.dbs_exiting, true, relaxed);
+	os_atomic_inc(&dbs.dbs_generation, release);
+	for (uint32_t i = 1; i < dbs.dbs_threads; i++) {
+		(void)dispatch_assume_zero(pthread_join(
+				dbs.dbs_thread_state[i].dbt_thread, NULL));
+	}
+#endif
+	_dispatch_benchmark_counters_close(&dbs.dbs_thread_state[0]);
+
+	*result = (dispatch_benchmark_result_s){ };
+	_dispatch_benchmark_summarize(samples, trials, result);
+	for (uint32_t i = 0; i < dbs.dbs_threads; i++) {
+		dispatch_benchmark_thread_t dbt = &dbs.dbs_thread_state[i];
+		has_counters = has_counters && dbt->dbt_has_counters;
+		for (int j = 0; j < DISPATCH_BENCHMARK_NCOUNTERS; j++) {
+			counters[j] += dbt->dbt_counters[j];
+		}
+	}
+	if (has_counters) {
+		double calls = (double)trials * (double)dbs.dbs_count *
+				(double)dbs.dbs_threads;
+		result->dbr_cycles = (double)counters[0] / calls;
+		result->dbr_instructions = (double)counters[1] / calls;
+		result->dbr_cache_misses = (double)counters[2] / calls;
+		result->dbr_branch_misses = (double)counters[3] / calls;
+	}
+	result->dbr_has_counters = has_counters;
+
+	free(samples);
+	free(dbs.dbs_thread_state);
 }
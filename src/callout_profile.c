@@ -0,0 +1,504 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+#include "internal.h"
+
+#if DISPATCH_USE_CALLOUT_PROFILE
+
+/*
+ * Callout profiling: sampling of the client callouts, see
+ * dispatch_callout_profile_enable().
+ *
+ * Every thread appends its samples to a ring in its
+ * dispatch_callout_profile_key TSD without synchronizing with anybody.
+ * dispatch_callout_profile_copy_top() walks the rings under
+ * _dispatch_callout_profile_lock, and folds the samples it has not seen yet
+ * into a table of totals per function.
+ *
+ * The wait time of a work item is the time between dx_push() and its
+ * invocation, it is measured for one asynchronous submission in
+ * DISPATCH_CALLOUT_PROFILE_WAIT_INTERVAL per thread, independently of the
+ * callout sampling, so that both remain unbiased.
+ */
+
+DISPATCH_GLOBAL(bool _dispatch_callout_profile_enabled);
+static dispatch_callout_profile_mode_t _dispatch_callout_profile_mode;
+static uint64_t _dispatch_callout_profile_interval;
+
+static dispatch_unfair_lock_s _dispatch_callout_profile_lock;
+static TAILQ_HEAD(, dispatch_callout_profile_thread_s)
+		_dispatch_callout_profile_threads =
+		TAILQ_HEAD_INITIALIZER(_dispatch_callout_profile_threads);
+static dispatch_callout_profile_entry_t _dispatch_callout_profile_table;
+static size_t _dispatch_callout_profile_table_count;
+static uint64_t _dispatch_callout_profile_dropped;
+static uint64_t _dispatch_callout_profile_epoch;
+
+#pragma mark -
+#pragma mark sampling
+
+DISPATCH_ALWAYS_INLINE
+static inline uint64_t
+_dispatch_callout_profile_cpu_time(void)
+{
+	struct timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+		return 0;
+	}
+	return _dispatch_timespec_to_nano(ts);
+}
+
+DISPATCH_NOINLINE
+static dispatch_callout_profile_thread_t
+_dispatch_callout_profile_thread_create(void)
+{
+	dispatch_callout_profile_thread_t dcpt;
+
+	dcpt = _dispatch_calloc(1, sizeof(struct dispatch_callout_profile_thread_s));
+	_dispatch_unfair_lock_lock(&_dispatch_callout_profile_lock);
+	TAILQ_INSERT_TAIL(&_dispatch_callout_profile_threads, dcpt, dcpt_list);
+	_dispatch_unfair_lock_unlock(&_dispatch_callout_profile_lock);
+	_dispatch_thread_setspecific(dispatch_callout_profile_key, dcpt);
+	return dcpt;
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline dispatch_callout_profile_thread_t
+_dispatch_callout_profile_thread(void)
+{
+	dispatch_callout_profile_thread_t dcpt;
+
+	dcpt = _dispatch_thread_getspecific(dispatch_callout_profile_key);
+	if (unlikely(!dcpt)) {
+		dcpt = _dispatch_callout_profile_thread_create();
+	}
+	return dcpt;
+}
+
+/*
+ * One push in DISPATCH_CALLOUT_PROFILE_WAIT_INTERVAL on each thread records
+ * the submission time of its item in the table of the queue, which the
+ * thread invoking the item consumes, see _dispatch_queue_get_callout_samples()
+ */
+void
+_dispatch_callout_profile_push(dispatch_queue_t dq, dispatch_continuation_t dc)
+{
+	dispatch_callout_profile_thread_t dcpt;
+	dispatch_queue_sample_t samples;
+	bool sample;
+
+	if (_dispatch_object_has_vtable(dc)) {
+		return;
+	}
+	dcpt = _dispatch_callout_profile_thread();
+	sample = ++dcpt->dcpt_pushes % DISPATCH_CALLOUT_PROFILE_WAIT_INTERVAL == 0;
+	samples = _dispatch_queue_get_callout_samples(dq, sample);
+	if (samples) {
+		_dispatch_queue_sample_push(samples, (struct dispatch_object_s *)dc,
+				sample);
+	}
+}
+
+void
+_dispatch_callout_profile_invoke(dispatch_queue_t dq,
+		dispatch_continuation_t dc)
+{
+	dispatch_queue_sample_t samples;
+	uint64_t pushed, now;
+
+	samples = _dispatch_queue_get_callout_samples(dq, false);
+	if (likely(!samples)) {
+		return;
+	}
+	pushed = _dispatch_queue_sample_take(samples,
+			(struct dispatch_object_s *)dc);
+	// tables aren't reset, samples from before the last
+	// dispatch_callout_profile_enable() are stale
+	if (pushed < os_atomic_load(&_dispatch_callout_profile_epoch, relaxed)) {
+		return;
+	}
+	now = _dispatch_uptime();
+	// consumed by the callout of the item, which comes next
+	_dispatch_callout_profile_thread()->dcpt_wait_time =
+			_dispatch_time_mach2nano(now > pushed ? now - pushed : 0) ?: 1;
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline bool
+_dispatch_callout_profile_should_sample(dispatch_callout_profile_thread_t dcpt)
+{
+	uint64_t interval = _dispatch_callout_profile_interval;
+	uint64_t now;
+
+	if (_dispatch_callout_profile_mode == DISPATCH_CALLOUT_PROFILE_PERIODIC) {
+		now = _dispatch_uptime();
+		if (now < dcpt->dcpt_next_sample) {
+			return false;
+		}
+		dcpt->dcpt_next_sample = now + interval;
+		return true;
+	}
+	if (++dcpt->dcpt_callouts < interval) {
+		return false;
+	}
+	dcpt->dcpt_callouts = 0;
+	return true;
+}
+
+static void
+_dispatch_callout_profile_record(dispatch_callout_profile_thread_t dcpt,
+		dispatch_function_t func, uint8_t flags, uint64_t run_time,
+		uint64_t cpu_time, uint64_t wait_time)
+{
+	uint64_t idx = dcpt->dcpt_head;
+	dispatch_callout_profile_sample_t dcps;
+	dispatch_queue_t dq = _dispatch_queue_get_current();
+
+	dcps = &dcpt->dcpt_samples[idx & (DISPATCH_CALLOUT_PROFILE_SAMPLES - 1)];
+	os_atomic_store(&dcps->dcps_seq, 0, relaxed);
+	os_atomic_thread_fence(release);
+	dcps->dcps_function = func;
+	dcps->dcps_run_time = run_time;
+	dcps->dcps_cpu_time = cpu_time;
+	dcps->dcps_wait_time = wait_time;
+	dcps->dcps_qos = (uint8_t)_dispatch_qos_from_pp(_dispatch_get_priority());
+	dcps->dcps_flags = flags;
+	strlcpy(dcps->dcps_label, dq && dq->dq_label ? dq->dq_label : "",
+			sizeof(dcps->dcps_label));
+	os_atomic_store(&dcps->dcps_seq, idx + 1, release);
+	os_atomic_store(&dcpt->dcpt_head, idx + 1, release);
+}
+
+typedef struct dispatch_callout_profile_frame_s {
+	dispatch_callout_profile_thread_t dcpf_thread;
+	uint64_t dcpf_wait_time;
+	uint64_t dcpf_start;
+	uint64_t dcpf_cpu_start;
+} *dispatch_callout_profile_frame_t;
+
+// returns whether the callout needs to be accounted for once it returns
+DISPATCH_ALWAYS_INLINE
+static inline bool
+_dispatch_callout_profile_begin(dispatch_callout_profile_frame_t dcpf)
+{
+	dispatch_callout_profile_thread_t dcpt = _dispatch_callout_profile_thread();
+
+	dcpf->dcpf_thread = dcpt;
+	dcpf->dcpf_wait_time = dcpt->dcpt_wait_time;
+	dcpt->dcpt_wait_time = 0;
+	if (!_dispatch_callout_profile_should_sample(dcpt)) {
+		dcpf->dcpf_start = 0;
+		return dcpf->dcpf_wait_time != 0;
+	}
+	dcpf->dcpf_cpu_start = _dispatch_callout_profile_cpu_time();
+	dcpf->dcpf_start = _dispatch_uptime();
+	return true;
+}
+
+// nested callouts are accounted for in the callouts they are nested in too
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_callout_profile_end(dispatch_callout_profile_frame_t dcpf,
+		dispatch_function_t func)
+{
+	uint64_t run_time = 0, cpu_time = 0, end;
+	uint8_t flags = 0;
+
+	if (dcpf->dcpf_start) {
+		end = _dispatch_uptime();
+		cpu_time = _dispatch_callout_profile_cpu_time();
+		run_time = _dispatch_time_mach2nano(end - dcpf->dcpf_start);
+		cpu_time = cpu_time > dcpf->dcpf_cpu_start ?
+				cpu_time - dcpf->dcpf_cpu_start : 0;
+		flags |= DCPS_HAS_RUN_TIME;
+	}
+	if (dcpf->dcpf_wait_time) {
+		flags |= DCPS_HAS_WAIT_TIME;
+	}
+	_dispatch_callout_profile_record(dcpf->dcpf_thread, func, flags,
+			run_time, cpu_time, dcpf->dcpf_wait_time);
+}
+
+void
+_dispatch_callout_profile_callout(void *ctxt, dispatch_function_t f)
+{
+	struct dispatch_callout_profile_frame_s dcpf;
+	dispatch_function_t func;
+
+	if (!_dispatch_callout_profile_begin(&dcpf)) {
+		return f(ctxt);
+	}
+#ifdef __BLOCKS__
+	func = (f == _dispatch_call_block_and_release && ctxt) ?
+			_dispatch_Block_invoke(ctxt) : f;
+#else
+	func = f;
+#endif
+	f(ctxt);
+	_dispatch_callout_profile_end(&dcpf, func);
+}
+
+void
+_dispatch_callout_profile_callout2(void *ctxt, size_t i,
+		void (*f)(void *, size_t))
+{
+	struct dispatch_callout_profile_frame_s dcpf;
+
+	if (!_dispatch_callout_profile_begin(&dcpf)) {
+		return f(ctxt, i);
+	}
+	f(ctxt, i);
+	_dispatch_callout_profile_end(&dcpf, (dispatch_function_t)f);
+}
+
+#pragma mark -
+#pragma mark aggregation
+
+static dispatch_callout_profile_entry_t
+_dispatch_callout_profile_table_lookup(dispatch_function_t func)
+{
+	uintptr_t hash = (uintptr_t)func >> 4;
+	size_t idx;
+
+	hash ^= hash >> 12;
+	for (size_t i = 0; i < DISPATCH_CALLOUT_PROFILE_FUNCTIONS; i++) {
+		idx = (hash + i) % DISPATCH_CALLOUT_PROFILE_FUNCTIONS;
+		dispatch_callout_profile_entry_t dcpe =
+				&_dispatch_callout_profile_table[idx];
+		if (dcpe->dcpe_function == func) {
+			return dcpe;
+		}
+		if (dcpe->dcpe_function == NULL) {
+			dcpe->dcpe_function = func;
+			_dispatch_callout_profile_table_count++;
+			return dcpe;
+		}
+	}
+	return NULL;
+}
+
+static void
+_dispatch_callout_profile_aggregate(dispatch_callout_profile_sample_t dcps)
+{
+	dispatch_callout_profile_entry_t dcpe;
+
+	dcpe = _dispatch_callout_profile_table_lookup(dcps->dcps_function);
+	if (!dcpe) {
+		_dispatch_callout_profile_dropped++;
+		return;
+	}
+	strlcpy(dcpe->dcpe_label, dcps->dcps_label, sizeof(dcpe->dcpe_label));
+	dcpe->dcpe_qos = _dispatch_qos_to_qos_class(dcps->dcps_qos);
+	if (dcps->dcps_flags & DCPS_HAS_RUN_TIME) {
+		dcpe->dcpe_samples++;
+		dcpe->dcpe_cpu_time += dcps->dcps_cpu_time;
+		dcpe->dcpe_run_time += dcps->dcps_run_time;
+		dcpe->dcpe_max_run_time = MAX(dcpe->dcpe_max_run_time,
+				dcps->dcps_run_time);
+	}
+	if (dcps->dcps_flags & DCPS_HAS_WAIT_TIME) {
+		dcpe->dcpe_wait_samples++;
+		dcpe->dcpe_wait_time += dcps->dcps_wait_time;
+	}
+}
+
+// folds the samples of a thread taken since the last call, under the lock
+static void
+_dispatch_callout_profile_drain(dispatch_callout_profile_thread_t dcpt)
+{
+	uint64_t head = os_atomic_load(&dcpt->dcpt_head, acquire);
+	uint64_t idx = dcpt->dcpt_tail;
+	struct dispatch_callout_profile_sample_s dcps;
+
+	if (head - idx > DISPATCH_CALLOUT_PROFILE_SAMPLES) {
+		_dispatch_callout_profile_dropped +=
+				head - idx - DISPATCH_CALLOUT_PROFILE_SAMPLES;
+		idx = head - DISPATCH_CALLOUT_PROFILE_SAMPLES;
+	}
+	for (; idx < head; idx++) {
+		dispatch_callout_profile_sample_t s = &dcpt->dcpt_samples[
+				idx & (DISPATCH_CALLOUT_PROFILE_SAMPLES - 1)];
+		if (os_atomic_load(&s->dcps_seq, acquire) != idx + 1) {
+			_dispatch_callout_profile_dropped++;
+			continue;
+		}
+		dcps = *s;
+		// the thread may have wrapped around and rewritten it during the copy
+		os_atomic_thread_fence(acquire);
+		if (os_atomic_load(&s->dcps_seq, relaxed) != idx + 1) {
+			_dispatch_callout_profile_dropped++;
+			continue;
+		}
+		_dispatch_callout_profile_aggregate(&dcps);
+	}
+	dcpt->dcpt_tail = head;
+}
+
+void
+_dispatch_callout_profile_thread_cleanup(void *ctxt)
+{
+	dispatch_callout_profile_thread_t dcpt = ctxt;
+
+	_dispatch_unfair_lock_lock(&_dispatch_callout_profile_lock);
+	if (_dispatch_callout_profile_table) {
+		_dispatch_callout_profile_drain(dcpt);
+	}
+	TAILQ_REMOVE(&_dispatch_callout_profile_threads, dcpt, dcpt_list);
+	_dispatch_unfair_lock_unlock(&_dispatch_callout_profile_lock);
+	free(dcpt);
+}
+
+static int
+_dispatch_callout_profile_entry_cmp(const void *a, const void *b)
+{
+	const struct dispatch_callout_profile_entry_s *ea = a, *eb = b;
+
+	if (ea->dcpe_cpu_time != eb->dcpe_cpu_time) {
+		return ea->dcpe_cpu_time < eb->dcpe_cpu_time ? 1 : -1;
+	}
+	if (ea->dcpe_run_time != eb->dcpe_run_time) {
+		return ea->dcpe_run_time < eb->dcpe_run_time ? 1 : -1;
+	}
+	return 0;
+}
+
+#pragma mark -
+#pragma mark dispatch_callout_profile
+
+void
+_dispatch_callout_profile_init(void)
+{
+	const char *s = getenv("LIBDISPATCH_CALLOUT_PROFILE");
+	unsigned long n = s ? strtoul(s, NULL, 0) : 0;
+
+	if (n) {
+		(void)dispatch_callout_profile_enable(
+				DISPATCH_CALLOUT_PROFILE_EVERY_NTH, n);
+	}
+}
+
+bool
+dispatch_callout_profile_enable(dispatch_callout_profile_mode_t mode,
+		uint64_t interval)
+{
+	dispatch_callout_profile_thread_t dcpt;
+
+	switch (mode) {
+	case DISPATCH_CALLOUT_PROFILE_EVERY_NTH:
+		break;
+	case DISPATCH_CALLOUT_PROFILE_PERIODIC:
+		interval = _dispatch_time_nano2mach(interval);
+		break;
+	default:
+		DISPATCH_CLIENT_CRASH(mode,
+				"Invalid mode passed to dispatch_callout_profile_enable");
+	}
+
+	_dispatch_unfair_lock_lock(&_dispatch_callout_profile_lock);
+	if (!_dispatch_callout_profile_table) {
+		_dispatch_callout_profile_table = _dispatch_calloc(
+				DISPATCH_CALLOUT_PROFILE_FUNCTIONS,
+				sizeof(struct dispatch_callout_profile_entry_s));
+	} else {
+		memset(_dispatch_callout_profile_table, 0,
+				DISPATCH_CALLOUT_PROFILE_FUNCTIONS *
+				sizeof(struct dispatch_callout_profile_entry_s));
+	}
+	_dispatch_callout_profile_table_count = 0;
+	_dispatch_callout_profile_dropped = 0;
+	TAILQ_FOREACH(dcpt, &_dispatch_callout_profile_threads, dcpt_list) {
+		dcpt->dcpt_tail = os_atomic_load(&dcpt->dcpt_head, relaxed);
+	}
+	os_atomic_store(&_dispatch_callout_profile_epoch, _dispatch_uptime(),
+			relaxed);
+	_dispatch_callout_profile_mode = mode;
+	_dispatch_callout_profile_interval = interval ?: 1;
+	_dispatch_unfair_lock_unlock(&_dispatch_callout_profile_lock);
+
+	os_atomic_store(&_dispatch_callout_profile_enabled, true, release);
+	return true;
+}
+
+void
+dispatch_callout_profile_disable(void)
+{
+	os_atomic_store(&_dispatch_callout_profile_enabled, false, relaxed);
+}
+
+size_t
+dispatch_callout_profile_copy_top(dispatch_callout_profile_entry_t entries,
+		size_t count, uint64_t *dropped)
+{
+	dispatch_callout_profile_thread_t dcpt;
+	dispatch_callout_profile_entry_t sorted;
+	size_t n = 0;
+
+	_dispatch_unfair_lock_lock(&_dispatch_callout_profile_lock);
+	if (!_dispatch_callout_profile_table) {
+		_dispatch_unfair_lock_unlock(&_dispatch_callout_profile_lock);
+		if (dropped) *dropped = 0;
+		return 0;
+	}
+	TAILQ_FOREACH(dcpt, &_dispatch_callout_profile_threads, dcpt_list) {
+		_dispatch_callout_profile_drain(dcpt);
+	}
+	sorted = _dispatch_calloc(MAX(_dispatch_callout_profile_table_count, 1u),
+			sizeof(struct dispatch_callout_profile_entry_s));
+	for (size_t i = 0; i < DISPATCH_CALLOUT_PROFILE_FUNCTIONS; i++) {
+		if (_dispatch_callout_profile_table[i].dcpe_function) {
+			sorted[n++] = _dispatch_callout_profile_table[i];
+		}
+	}
+	if (dropped) *dropped = _dispatch_callout_profile_dropped;
+	_dispatch_unfair_lock_unlock(&_dispatch_callout_profile_lock);
+
+	qsort(sorted, n, sizeof(struct dispatch_callout_profile_entry_s),
+			_dispatch_callout_profile_entry_cmp);
+	n = MIN(n, count);
+	memcpy(entries, sorted, n * sizeof(struct dispatch_callout_profile_entry_s));
+	free(sorted);
+	return n;
+}
+
+#else // !DISPATCH_USE_CALLOUT_PROFILE
+
+bool
+dispatch_callout_profile_enable(dispatch_callout_profile_mode_t mode,
+		uint64_t interval)
+{
+	(void)mode; (void)interval;
+	return false;
+}
+
+void
+dispatch_callout_profile_disable(void)
+{
+}
+
+size_t
+dispatch_callout_profile_copy_top(dispatch_callout_profile_entry_t entries,
+		size_t count, uint64_t *dropped)
+{
+	(void)entries; (void)count;
+	if (dropped) *dropped = 0;
+	return 0;
+}
+
+#endif // !DISPATCH_USE_CALLOUT_PROFILE
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * IMPORTANT: This header file describes INTERNAL interfaces to libdispatch
+ * which are subject to change in future releases of Mac OS X. Any applications
+ * relying on these interfaces WILL break.
+ */
+
+#ifndef __DISPATCH_CALLOUT_PROFILE_INTERNAL__
+#define __DISPATCH_CALLOUT_PROFILE_INTERNAL__
+
+#ifndef __DISPATCH_INDIRECT__
+#error "Please #include <dispatch/dispatch.h> instead of this file directly."
+#include <dispatch/base.h> // for HeaderDoc
+#endif
+
+// The sampler lives in the _dispatch_client_callout() of init.c, and keeps
+// its per-thread buffer in a TSD key that only exists without direct TSD
+#if !defined(DISPATCH_USE_CALLOUT_PROFILE) && DISPATCH_USE_CLIENT_CALLOUT && \
+		!USE_OBJC && !DISPATCH_USE_DIRECT_TSD && !defined(_WIN32)
+#define DISPATCH_USE_CALLOUT_PROFILE 1
+#endif
+
+#if DISPATCH_USE_CALLOUT_PROFILE
+
+#define DISPATCH_CALLOUT_PROFILE_SAMPLES 128 // per thread, a power of 2
+#define DISPATCH_CALLOUT_PROFILE_FUNCTIONS 1024
+#define DISPATCH_CALLOUT_PROFILE_WAIT_INTERVAL 16
+#define DISPATCH_CALLOUT_PROFILE_LABEL_SIZE 64
+
+#define DCPS_HAS_RUN_TIME	0x1
+#define DCPS_HAS_WAIT_TIME	0x2
+
+/*
+ * A sample, written by its thread only. dcps_seq is the index of the sample
+ * + 1 once it is complete and 0 while it is written, so that the reader can
+ * tell samples it raced with from complete ones.
+ */
+typedef struct dispatch_callout_profile_sample_s {
+	uint64_t volatile dcps_seq;
+	dispatch_function_t dcps_function;
+	uint64_t dcps_cpu_time;
+	uint64_t dcps_run_time;
+	uint64_t dcps_wait_time;
+	uint8_t dcps_qos;
+	uint8_t dcps_flags;
+	char dcps_label[DISPATCH_CALLOUT_PROFILE_LABEL_SIZE];
+} *dispatch_callout_profile_sample_t;
+
+/*
+ * The profiling state of a thread, pointed to by its
+ * dispatch_callout_profile_key TSD.
+ *
+ * Only the thread updates dcpt_head and the fields above it. dcpt_tail and
+ * dcpt_list are protected by the profile lock, which only readers and the
+ * creation and destruction of these buffers take.
+ */
+typedef struct dispatch_callout_profile_thread_s {
+	TAILQ_ENTRY(dispatch_callout_profile_thread_s) dcpt_list;
+	uint64_t dcpt_callouts;
+	uint64_t dcpt_next_sample;
+	uint64_t dcpt_wait_time;
+	uint32_t dcpt_pushes;
+	uint64_t volatile dcpt_head;
+	uint64_t dcpt_tail;
+	struct dispatch_callout_profile_sample_s
+			dcpt_samples[DISPATCH_CALLOUT_PROFILE_SAMPLES];
+} *dispatch_callout_profile_thread_t;
+
+extern bool _dispatch_callout_profile_enabled;
+void _dispatch_callout_profile_init(void);
+void _dispatch_callout_profile_thread_cleanup(void *ctxt);
+void _dispatch_callout_profile_push(dispatch_queue_t dq,
+		dispatch_continuation_t dc);
+void _dispatch_callout_profile_invoke(dispatch_queue_t dq,
+		dispatch_continuation_t dc);
+void _dispatch_callout_profile_callout(void *ctxt, dispatch_function_t f);
+void _dispatch_callout_profile_callout2(void *ctxt, size_t i,
+		void (*f)(void *, size_t));
+dispatch_queue_sample_t _dispatch_queue_get_callout_samples(dispatch_queue_t dq,
+		bool create);
+
+#endif // DISPATCH_USE_CALLOUT_PROFILE
+
+#endif // __DISPATCH_CALLOUT_PROFILE_INTERNAL__
@@ -273,6 +273,10 @@ const dispatch_source_type_s _dispatch_source_type_read = {
 #endif
 	.dst_data       = 1,
 #endif // DISPATCH_EVENT_BACKEND_KEVENT
+#if DISPATCH_EVENT_BACKEND_EPOLL
+	.dst_mask       = DISPATCH_FD_EDGE_TRIGGERED|DISPATCH_FD_EXCLUSIVE,
+	.dst_allow_empty_mask = true,
+#endif // DISPATCH_EVENT_BACKEND_EPOLL
 	.dst_action     = DISPATCH_UNOTE_ACTION_SOURCE_SET_DATA,
 	.dst_size       = sizeof(struct dispatch_source_refs_s),
 
@@ -290,6 +294,10 @@ const dispatch_source_type_s _dispatch_source_type_write = {
 #endif
 	.dst_data       = 1,
 #endif // DISPATCH_EVENT_BACKEND_KEVENT
+#if DISPATCH_EVENT_BACKEND_EPOLL
+	.dst_mask       = DISPATCH_FD_EDGE_TRIGGERED|DISPATCH_FD_EXCLUSIVE,
+	.dst_allow_empty_mask = true,
+#endif // DISPATCH_EVENT_BACKEND_EPOLL
 	.dst_action     = DISPATCH_UNOTE_ACTION_SOURCE_SET_DATA,
 	.dst_size       = sizeof(struct dispatch_source_refs_s),
 
@@ -430,6 +438,41 @@ _dispatch_timer_heap_shrink(dispatch_timer_heap_t dth)
 	free(heap);
 }
 
+DISPATCH_ALWAYS_INLINE
+static inline bool
+_dispatch_timer_heap_can_shrink(dispatch_timer_heap_t dth, uint32_t count,
+		bool trim)
+{
+	uint32_t segments = dth->dth_segments;
+	if (segments == 0) {
+		return false;
+	}
+#if DISPATCH_USE_MEMORYPRESSURE_SOURCE
+	// Keep a spare segment so that a timer count oscillating around a
+	// segment boundary doesn't reallocate the heap each time, unless memory
+	// is tight.
+	if (!trim && !_dispatch_memory_warn && segments > 1) {
+		segments--;
+	}
+#else
+	(void)trim;
+#endif
+	return count <= _dispatch_timer_heap_capacity(segments - 1);
+}
+
+#if DISPATCH_USE_MEMORYPRESSURE_SOURCE
+void
+_dispatch_timer_heaps_trim(void)
+{
+	for (uint32_t tidx = 0; tidx < DISPATCH_TIMER_COUNT; tidx++) {
+		dispatch_timer_heap_t dth = &_dispatch_timers_heap[tidx];
+		while (_dispatch_timer_heap_can_shrink(dth, dth->dth_count, true)) {
+			_dispatch_timer_heap_shrink(dth);
+		}
+	}
+}
+#endif
+
 DISPATCH_ALWAYS_INLINE
 static inline dispatch_timer_source_refs_t *
 _dispatch_timer_heap_get_slot(dispatch_timer_heap_t dth, uint32_t idx)
@@ -743,7 +786,7 @@ _dispatch_timer_heap_remove(dispatch_timer_heap_t dth,
 			_dispatch_timer_heap_resift(dth, last_dt, removed_idx);
 		}
 	}
-	if (unlikely(idx <= _dispatch_timer_heap_capacity(dth->dth_segments - 1))) {
+	if (unlikely(_dispatch_timer_heap_can_shrink(dth, idx, false))) {
 		_dispatch_timer_heap_shrink(dth);
 	}
 
@@ -174,7 +174,14 @@
 #	define EVFILT_WRITE				(-2)
 #	define EVFILT_SIGNAL			(-3)
 #	define EVFILT_TIMER				(-4)
-#	define EVFILT_SYSCOUNT			4
+#	define EVFILT_PROC				(-5)
+#	define EVFILT_VNODE				(-6)
+#	if DISPATCH_EVENT_BACKEND_EPOLL
+#	define EVFILT_MEMORYSTATUS		(-7)
+#	define EVFILT_SYSCOUNT			7
+#	else
+#	define EVFILT_SYSCOUNT			6
+#	endif
 
 #	define DISPATCH_HAVE_TIMER_QOS 0
 #	define DISPATCH_HAVE_TIMER_COALESCING 0
@@ -22,26 +22,59 @@
 #include "internal.h"
 #if DISPATCH_EVENT_BACKEND_EPOLL
 #include <linux/sockios.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
+#include <sys/inotify.h>
 #include <sys/signalfd.h>
+#include <sys/syscall.h>
 #include <sys/timerfd.h>
+#include <sys/wait.h>
 
 #ifndef EPOLLFREE
 #define EPOLLFREE 0x4000
 #endif
 
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE (1u << 28)
+#endif
+
+#ifndef __NR_pidfd_open
+#define __NR_pidfd_open 434
+#endif
+
+#ifndef P_PIDFD
+#define P_PIDFD 3
+#endif
+
 #if !DISPATCH_USE_MGR_THREAD
 #error unsupported configuration
 #endif
 
 #define DISPATCH_EPOLL_MAX_EVENT_COUNT 16
 
+// PSI triggers, as "<some|full> <stall us> <window us>". Unprivileged
+// processes may only use windows that are a multiple of 2s.
+#define DISPATCH_PSI_WARN_TRIGGER      "some 200000 2000000"
+#define DISPATCH_PSI_CRITICAL_TRIGGER  "full 100000 2000000"
+// pressure is considered over once no trigger fired for that long
+#define DISPATCH_MEMORYSTATUS_RECHECK_INTERVAL 5 // seconds
+
+#ifndef DISPATCH_EPOLL_MAX_SHARD_COUNT
+#define DISPATCH_EPOLL_MAX_SHARD_COUNT 16
+#endif
+
 enum {
 	DISPATCH_EPOLL_EVENTFD         = 0x0001,
 	DISPATCH_EPOLL_CLOCK_WALL      = 0x0002,
 	DISPATCH_EPOLL_CLOCK_UPTIME    = 0x0003,
 	DISPATCH_EPOLL_CLOCK_MONOTONIC = 0x0004,
+	DISPATCH_EPOLL_INOTIFY         = 0x0005,
+	DISPATCH_EPOLL_MEMORYSTATUS_WARN     = 0x0006,
+	DISPATCH_EPOLL_MEMORYSTATUS_CRITICAL = 0x0007,
+	DISPATCH_EPOLL_MEMORYSTATUS_RECHECK  = 0x0008,
 };
 
 typedef struct dispatch_muxnote_s {
@@ -51,10 +84,32 @@ typedef struct dispatch_muxnote_s {
 	int       dmn_fd;
 	uint32_t  dmn_ident;
 	uint32_t  dmn_events;
+	uint32_t  dmn_gen;
 	uint16_t  dmn_disarmed_events;
+	uint16_t  dmn_pending_events; // edges seen with no armed unote
 	int8_t    dmn_filter;
+	uint8_t   dmn_shard;
 	bool      dmn_skip_outq_ioctl : 1;
 	bool      dmn_skip_inq_ioctl : 1;
+	bool      dmn_edge_triggered : 1;
+	bool      dmn_exclusive : 1;
+	union {
+		struct { // EVFILT_VNODE
+			LIST_ENTRY(dispatch_muxnote_s) dmn_wd_list;
+			off_t     dmn_vnode_size;
+			nlink_t   dmn_vnode_nlink;
+			uint32_t  dmn_vnode_fflags;
+			int       dmn_wd;
+		};
+		struct { // EVFILT_MEMORYSTATUS
+			int       dmn_critical_fd; // -1 when dmn_fd is memory.events
+			int       dmn_recheck_fd;
+			uint32_t  dmn_pressure;
+			uint32_t  dmn_pressure_seen; // since the last recheck
+			uint64_t  dmn_cgroup_high;
+			uint64_t  dmn_cgroup_max;
+		};
+	};
 } *dispatch_muxnote_t;
 
 typedef struct dispatch_epoll_timeout_s {
@@ -64,13 +119,51 @@ typedef struct dispatch_epoll_timeout_s {
 	bool      det_armed;
 } *dispatch_epoll_timeout_t;
 
-static int _dispatch_epfd, _dispatch_eventfd;
+LIST_HEAD(dispatch_muxnote_bucket_s, dispatch_muxnote_s);
+
+/*
+ * Epoll shards
+ *
+ * Shard 0 is the manager shard: it owns the eventfd used to poke the manager,
+ * the timerfds and every signalfd, and is drained by the manager queue exactly
+ * like the single epoll instance used to be.
+ *
+ * When LIBDISPATCH_EPOLL_SHARDS asks for more than one shard, file descriptor
+ * muxnotes are spread across additional epoll instances by fd, each drained
+ * by a dedicated thread. Registration, resumption and unregistration still
+ * happen on the manager queue, so the muxnote tables of a shard are protected
+ * by des_lock which is held while an event is merged. Because a muxnote can be
+ * unregistered (and freed) between epoll_wait() returning and the shard thread
+ * taking the lock, non manager shards never store muxnote pointers in the
+ * epoll data, but the (generation, fd) pair that is looked up under the lock.
+ */
+typedef struct dispatch_epoll_shard_s {
+	dispatch_unfair_lock_s des_lock;
+	int       des_epfd;
+	uint8_t   des_idx;
+	struct dispatch_muxnote_bucket_s des_sources[DSL_HASH_SIZE];
+} *dispatch_epoll_shard_t;
+
+static int _dispatch_eventfd, _dispatch_inotify_fd = -1;
+static uint8_t _dispatch_epoll_shard_count = 1;
+static uint32_t _dispatch_muxnote_generation;
+static struct dispatch_epoll_shard_s
+_dispatch_epoll_shards[DISPATCH_EPOLL_MAX_SHARD_COUNT];
 
 static dispatch_once_t epoll_init_pred;
 static void _dispatch_epoll_init(void *);
+#if DISPATCH_USE_MEMORYPRESSURE_SOURCE
+static void _dispatch_memorypressure_init(void);
+#endif
+
+// vnode muxnotes hashed by inotify watch descriptor, protected by the lock
+// of the manager shard. Several muxnotes share a watch descriptor when their
+// file descriptors point to the same inode.
+static LIST_HEAD(, dispatch_muxnote_s)
+_dispatch_inotify_watches[DSL_HASH_SIZE];
 
-static LIST_HEAD(dispatch_muxnote_bucket_s, dispatch_muxnote_s)
-_dispatch_sources[DSL_HASH_SIZE];
+// memory pressure sources have no handle, so there is at most one muxnote
+static dispatch_muxnote_t _dispatch_memorystatus_muxnote;
 
 #define DISPATCH_EPOLL_TIMEOUT_INITIALIZER(clock) \
 	[DISPATCH_CLOCK_##clock] = { \
@@ -92,14 +185,43 @@ _dispatch_muxnote_armed_events(dispatch_muxnote_t dmn)
 	return dmn->dmn_events & ~dmn->dmn_disarmed_events;
 }
 
+DISPATCH_ALWAYS_INLINE
+static inline dispatch_epoll_shard_t
+_dispatch_epoll_shard(uint32_t ident, int8_t filter)
+{
+	if ((filter != EVFILT_READ && filter != EVFILT_WRITE) ||
+			_dispatch_epoll_shard_count == 1) {
+		return &_dispatch_epoll_shards[0];
+	}
+	return &_dispatch_epoll_shards[ident % _dispatch_epoll_shard_count];
+}
+#define _dispatch_unote_epoll_shard(du) \
+	_dispatch_epoll_shard(du._du->du_ident, du._du->du_filter)
+#define _dispatch_muxnote_epoll_shard(dmn) \
+	(&_dispatch_epoll_shards[(dmn)->dmn_shard])
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_epoll_shard_lock(dispatch_epoll_shard_t des)
+{
+	_dispatch_unfair_lock_lock(&des->des_lock);
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_epoll_shard_unlock(dispatch_epoll_shard_t des)
+{
+	_dispatch_unfair_lock_unlock(&des->des_lock);
+}
+
 DISPATCH_ALWAYS_INLINE
 static inline struct dispatch_muxnote_bucket_s *
-_dispatch_muxnote_bucket(uint32_t ident)
+_dispatch_muxnote_bucket(dispatch_epoll_shard_t des, uint32_t ident)
 {
-	return &_dispatch_sources[DSL_HASH(ident)];
+	return &des->des_sources[DSL_HASH(ident)];
 }
-#define _dispatch_unote_muxnote_bucket(du) \
-	_dispatch_muxnote_bucket(du._du->du_ident)
+#define _dispatch_unote_muxnote_bucket(des, du) \
+	_dispatch_muxnote_bucket(des, du._du->du_ident)
 
 DISPATCH_ALWAYS_INLINE
 static inline dispatch_muxnote_t
@@ -121,12 +243,100 @@ _dispatch_muxnote_find(struct dispatch_muxnote_bucket_s *dmb,
 static void
 _dispatch_muxnote_dispose(dispatch_muxnote_t dmn)
 {
-	if (dmn->dmn_filter != EVFILT_READ || (uint32_t)dmn->dmn_fd != dmn->dmn_ident) {
+	if (dmn->dmn_filter == EVFILT_MEMORYSTATUS) {
+		if (dmn->dmn_critical_fd >= 0) close(dmn->dmn_critical_fd);
+		close(dmn->dmn_recheck_fd);
+	}
+	if (dmn->dmn_fd >= 0 && (dmn->dmn_filter != EVFILT_READ ||
+			(uint32_t)dmn->dmn_fd != dmn->dmn_ident)) {
 		close(dmn->dmn_fd);
 	}
 	free(dmn);
 }
 
+static int
+_dispatch_pidfd_open(pid_t pid)
+{
+	return (int)syscall(__NR_pidfd_open, pid, 0);
+}
+
+static int
+_dispatch_psi_trigger_open(const char *path, const char *trigger)
+{
+	int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0) {
+		return -1;
+	}
+	if (write(fd, trigger, strlen(trigger) + 1) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static bool
+_dispatch_memorystatus_cgroup_read(dispatch_muxnote_t dmn,
+		uint64_t *high, uint64_t *max)
+{
+	char buf[256], *p;
+	ssize_t n = pread(dmn->dmn_fd, buf, sizeof(buf) - 1, 0);
+
+	if (n <= 0) {
+		return false;
+	}
+	buf[n] = '\0';
+	*high = *max = 0;
+	if ((p = strstr(buf, "high "))) *high = strtoull(p + 5, NULL, 10);
+	if ((p = strstr(buf, "\nmax "))) *max += strtoull(p + 5, NULL, 10);
+	if ((p = strstr(buf, "\noom "))) *max += strtoull(p + 5, NULL, 10);
+	return true;
+}
+
+static int
+_dispatch_memorystatus_cgroup_open(void)
+{
+	char line[PATH_MAX], path[PATH_MAX + 32];
+	int fd = -1;
+	FILE *f;
+
+	// on the unified hierarchy, the line for our cgroup is "0::<path>"
+	if (!(f = fopen("/proc/self/cgroup", "re"))) {
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		if (strncmp(line, "0::", 3) == 0) {
+			line[strcspn(line, "\n")] = '\0';
+			snprintf(path, sizeof(path), "/sys/fs/cgroup%s/memory.events",
+					strcmp(line + 3, "/") ? line + 3 : "");
+			fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+			break;
+		}
+	}
+	fclose(f);
+	return fd;
+}
+
+static int
+_dispatch_memorystatus_open(int *critical_fd)
+{
+	int fd;
+
+	fd = _dispatch_psi_trigger_open("/proc/pressure/memory",
+			DISPATCH_PSI_WARN_TRIGGER);
+	if (fd >= 0) {
+		*critical_fd = _dispatch_psi_trigger_open("/proc/pressure/memory",
+				DISPATCH_PSI_CRITICAL_TRIGGER);
+		if (*critical_fd < 0) {
+			close(fd);
+			return -1;
+		}
+		return fd;
+	}
+	// without PSI, fall back to the high and max events of our cgroup
+	*critical_fd = -1;
+	return _dispatch_memorystatus_cgroup_open();
+}
+
 static pthread_t manager_thread;
 
 static void
@@ -154,6 +364,7 @@ _dispatch_muxnote_create(dispatch_unote_t du, uint32_t events)
 	int fd = (int)du._du->du_ident;
 	int8_t filter = du._du->du_filter;
 	bool skip_outq_ioctl = false, skip_inq_ioctl = false;
+	int critical_fd = -1, recheck_fd = -1;
 	sigset_t sigmask;
 
 	switch (filter) {
@@ -198,6 +409,35 @@ _dispatch_muxnote_create(dispatch_unote_t du, uint32_t events)
 		}
 		break;
 
+	case EVFILT_PROC:
+		// the pidfd becomes readable when the process exits
+		fd = _dispatch_pidfd_open((pid_t)du._du->du_ident);
+		if (fd < 0) {
+			return NULL;
+		}
+		break;
+
+	case EVFILT_VNODE:
+		if (fstat(fd, &sb) < 0) {
+			return NULL;
+		}
+		// events are delivered through the shared inotify descriptor
+		fd = -1;
+		break;
+
+	case EVFILT_MEMORYSTATUS:
+		fd = _dispatch_memorystatus_open(&critical_fd);
+		if (fd < 0) {
+			return NULL;
+		}
+		recheck_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+		if (recheck_fd < 0) {
+			if (critical_fd >= 0) close(critical_fd);
+			close(fd);
+			return NULL;
+		}
+		break;
+
 	default:
 		DISPATCH_INTERNAL_CRASH(0, "Unexpected filter");
 	}
@@ -209,22 +449,189 @@ _dispatch_muxnote_create(dispatch_unote_t du, uint32_t events)
 	dmn->dmn_ident = du._du->du_ident;
 	dmn->dmn_filter = filter;
 	dmn->dmn_events = events;
+	dmn->dmn_gen = os_atomic_inc(&_dispatch_muxnote_generation, relaxed);
+	dmn->dmn_shard = _dispatch_unote_epoll_shard(du)->des_idx;
 	dmn->dmn_skip_outq_ioctl = skip_outq_ioctl;
 	dmn->dmn_skip_inq_ioctl = skip_inq_ioctl;
+	dmn->dmn_edge_triggered = (events & EPOLLET) != 0;
+	dmn->dmn_exclusive = (events & EPOLLEXCLUSIVE) != 0;
+	if (filter == EVFILT_VNODE) {
+		dmn->dmn_vnode_size = sb.st_size;
+		dmn->dmn_vnode_nlink = sb.st_nlink;
+		dmn->dmn_vnode_fflags = du._du->du_fflags;
+		dmn->dmn_wd = -1;
+	} else if (filter == EVFILT_MEMORYSTATUS) {
+		dmn->dmn_critical_fd = critical_fd;
+		dmn->dmn_recheck_fd = recheck_fd;
+		dmn->dmn_pressure = DISPATCH_MEMORYPRESSURE_NORMAL;
+		if (critical_fd < 0) {
+			// only count the events that happen from now on
+			_dispatch_memorystatus_cgroup_read(dmn, &dmn->dmn_cgroup_high,
+					&dmn->dmn_cgroup_max);
+		}
+	}
 	return dmn;
 }
 
 #pragma mark dispatch_unote_t
 
+DISPATCH_ALWAYS_INLINE
+static inline uint64_t
+_dispatch_muxnote_shard_key(dispatch_muxnote_t dmn)
+{
+	return ((uint64_t)dmn->dmn_gen << 32) | dmn->dmn_ident;
+}
+
+static uint32_t
+_dispatch_vnode_inotify_mask(uint32_t fflags)
+{
+	uint32_t mask = 0;
+
+	if (fflags & (DISPATCH_VNODE_WRITE | DISPATCH_VNODE_EXTEND)) {
+		mask |= IN_MODIFY;
+	}
+	// unlink() only changes the link count while we hold the descriptor
+	// open, IN_DELETE_SELF would only fire once the inode is destroyed
+	if (fflags & (DISPATCH_VNODE_ATTRIB | DISPATCH_VNODE_LINK |
+			DISPATCH_VNODE_DELETE)) {
+		mask |= IN_ATTRIB;
+	}
+	if (fflags & DISPATCH_VNODE_DELETE) {
+		mask |= IN_DELETE_SELF;
+	}
+	if (fflags & DISPATCH_VNODE_RENAME) {
+		mask |= IN_MOVE_SELF;
+	}
+	return mask;
+}
+
+static int
+_dispatch_inotify_update(dispatch_muxnote_t dmn, int op)
+{
+	char path[sizeof("/proc/self/fd/") + 10];
+	int wd;
+
+	if (op == EPOLL_CTL_DEL) {
+		if (dmn->dmn_wd < 0) {
+			return 0;
+		}
+		LIST_REMOVE(dmn, dmn_wd_list);
+		dispatch_muxnote_t other;
+		LIST_FOREACH(other, &_dispatch_inotify_watches[DSL_HASH(
+				(uint32_t)dmn->dmn_wd)], dmn_wd_list) {
+			if (other->dmn_wd == dmn->dmn_wd) {
+				// the inode is still watched through another descriptor
+				dmn->dmn_wd = -1;
+				return 0;
+			}
+		}
+		wd = dmn->dmn_wd;
+		dmn->dmn_wd = -1;
+		return inotify_rm_watch(_dispatch_inotify_fd, wd);
+	}
+
+	if (unlikely(_dispatch_inotify_fd < 0)) {
+		int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (fd < 0) {
+			return -1;
+		}
+		struct epoll_event ev = {
+			.events = EPOLLIN,
+			.data = { .u32 = DISPATCH_EPOLL_INOTIFY, },
+		};
+		if (epoll_ctl(_dispatch_epoll_shards[0].des_epfd, EPOLL_CTL_ADD, fd,
+				&ev) < 0) {
+			close(fd);
+			return -1;
+		}
+		_dispatch_inotify_fd = fd;
+	}
+
+	// watching the magic link watches the inode the descriptor refers to
+	snprintf(path, sizeof(path), "/proc/self/fd/%u", dmn->dmn_ident);
+	wd = inotify_add_watch(_dispatch_inotify_fd, path, IN_MASK_ADD |
+			_dispatch_vnode_inotify_mask(dmn->dmn_vnode_fflags));
+	if (wd < 0) {
+		return -1;
+	}
+	if (dmn->dmn_wd < 0) {
+		dmn->dmn_wd = wd;
+		LIST_INSERT_HEAD(&_dispatch_inotify_watches[DSL_HASH((uint32_t)wd)],
+				dmn, dmn_wd_list);
+	}
+	return 0;
+}
+
+static int
+_dispatch_memorystatus_update(dispatch_muxnote_t dmn, int op)
+{
+	int epfd = _dispatch_epoll_shards[0].des_epfd;
+	struct epoll_event ev = { .events = EPOLLPRI, };
+
+	if (op == EPOLL_CTL_MOD) {
+		// the registration does not depend on the unotes
+		return 0;
+	}
+	if (op == EPOLL_CTL_DEL) {
+		epoll_ctl(epfd, op, dmn->dmn_fd, NULL);
+		if (dmn->dmn_critical_fd >= 0) {
+			epoll_ctl(epfd, op, dmn->dmn_critical_fd, NULL);
+		}
+		epoll_ctl(epfd, op, dmn->dmn_recheck_fd, NULL);
+		_dispatch_memorystatus_muxnote = NULL;
+		return 0;
+	}
+
+	ev.data.u32 = DISPATCH_EPOLL_MEMORYSTATUS_WARN;
+	if (epoll_ctl(epfd, op, dmn->dmn_fd, &ev) < 0) {
+		return -1;
+	}
+	if (dmn->dmn_critical_fd >= 0) {
+		ev.data.u32 = DISPATCH_EPOLL_MEMORYSTATUS_CRITICAL;
+		if (epoll_ctl(epfd, op, dmn->dmn_critical_fd, &ev) < 0) {
+			goto fail_critical;
+		}
+	}
+	ev.events = EPOLLIN;
+	ev.data.u32 = DISPATCH_EPOLL_MEMORYSTATUS_RECHECK;
+	if (epoll_ctl(epfd, op, dmn->dmn_recheck_fd, &ev) < 0) {
+		goto fail_recheck;
+	}
+	_dispatch_memorystatus_muxnote = dmn;
+	return 0;
+
+fail_recheck:
+	if (dmn->dmn_critical_fd >= 0) {
+		epoll_ctl(epfd, EPOLL_CTL_DEL, dmn->dmn_critical_fd, NULL);
+	}
+fail_critical:
+	epoll_ctl(epfd, EPOLL_CTL_DEL, dmn->dmn_fd, NULL);
+	return -1;
+}
+
 static int
 _dispatch_epoll_update(dispatch_muxnote_t dmn, uint32_t events, int op)
 {
-	dispatch_once_f(&epoll_init_pred, NULL, _dispatch_epoll_init);
+	dispatch_epoll_shard_t des = _dispatch_muxnote_epoll_shard(dmn);
+	if (dmn->dmn_filter == EVFILT_VNODE) {
+		return _dispatch_inotify_update(dmn, op);
+	}
+	if (dmn->dmn_filter == EVFILT_MEMORYSTATUS) {
+		return _dispatch_memorystatus_update(dmn, op);
+	}
 	struct epoll_event ev = {
 		.events = events,
 		.data = { .ptr = dmn },
 	};
-	return epoll_ctl(_dispatch_epfd, op, dmn->dmn_fd, &ev);
+	if (des->des_idx) {
+		ev.data.u64 = _dispatch_muxnote_shard_key(dmn);
+	}
+	if (dmn->dmn_exclusive && op == EPOLL_CTL_MOD) {
+		// EPOLLEXCLUSIVE registrations can't be modified, only replaced
+		(void)epoll_ctl(des->des_epfd, EPOLL_CTL_DEL, dmn->dmn_fd, NULL);
+		op = EPOLL_CTL_ADD;
+	}
+	return epoll_ctl(des->des_epfd, op, dmn->dmn_fd, &ev);
 }
 
 DISPATCH_ALWAYS_INLINE
@@ -246,25 +653,67 @@ _dispatch_unote_required_events(dispatch_unote_t du)
 		break;
 	}
 
-	if (dux_type(du._du)->dst_flags & EV_DISPATCH) {
+	// the fflags of other filters do not carry epoll modes
+	bool is_fd = (du._du->du_filter == EVFILT_READ ||
+			du._du->du_filter == EVFILT_WRITE);
+	if (is_fd && (du._du->du_fflags & DISPATCH_FD_EXCLUSIVE)) {
+		events |= EPOLLET | EPOLLEXCLUSIVE;
+	} else if (is_fd && (du._du->du_fflags & DISPATCH_FD_EDGE_TRIGGERED)) {
+		events |= EPOLLET;
+	} else if (dux_type(du._du)->dst_flags & EV_DISPATCH) {
 		events |= EPOLLONESHOT;
 	}
 
 	return events;
 }
 
+DISPATCH_ALWAYS_INLINE
+static inline bool
+_dispatch_muxnote_can_mux(dispatch_muxnote_t dmn, dispatch_unote_t du,
+		uint32_t events)
+{
+	if (dmn->dmn_edge_triggered != (bool)(events & EPOLLET) ||
+			dmn->dmn_exclusive != (bool)(events & EPOLLEXCLUSIVE)) {
+		return false;
+	}
+	if (dmn->dmn_edge_triggered && !dmn->dmn_exclusive) {
+		// edges are latched per muxnote, so without exclusive delivery
+		// there can be only one unote of each kind to hand them to
+		if (du._du->du_filter == EVFILT_WRITE) {
+			return LIST_EMPTY(&dmn->dmn_writers_head);
+		}
+		return LIST_EMPTY(&dmn->dmn_readers_head);
+	}
+	return true;
+}
+
+static void _dispatch_event_merge_edge(dispatch_muxnote_t dmn,
+		uint32_t event);
+
 bool
 _dispatch_unote_register_muxed(dispatch_unote_t du)
 {
 	struct dispatch_muxnote_bucket_s *dmb;
+	dispatch_epoll_shard_t des;
 	dispatch_muxnote_t dmn;
 	uint32_t events;
 
+	dispatch_once_f(&epoll_init_pred, NULL, _dispatch_epoll_init);
 	events = _dispatch_unote_required_events(du);
 
-	dmb = _dispatch_unote_muxnote_bucket(du);
+	des = _dispatch_unote_epoll_shard(du);
+	_dispatch_epoll_shard_lock(des);
+	dmb = _dispatch_unote_muxnote_bucket(des, du);
 	dmn = _dispatch_unote_muxnote_find(dmb, du);
-	if (dmn) {
+	if (dmn && !_dispatch_muxnote_can_mux(dmn, du, events)) {
+		dmn = NULL;
+	} else if (dmn && dmn->dmn_filter == EVFILT_VNODE &&
+			(du._du->du_fflags & ~dmn->dmn_vnode_fflags)) {
+		dmn->dmn_vnode_fflags |= du._du->du_fflags;
+		if (_dispatch_epoll_update(dmn, events, EPOLL_CTL_MOD) < 0) {
+			dmn = NULL;
+		}
+	} else if (dmn) {
 		if (events & ~_dispatch_muxnote_armed_events(dmn)) {
 			events |= _dispatch_muxnote_armed_events(dmn);
 			if (_dispatch_epoll_update(dmn, events, EPOLL_CTL_MOD) < 0) {
@@ -295,7 +744,14 @@ _dispatch_unote_register_muxed(dispatch_unote_t du)
 		}
 		dul->du_muxnote = dmn;
 		_dispatch_unote_state_set(du, DISPATCH_WLH_ANON, DU_STATE_ARMED);
+		if (dmn->dmn_pending_events & events & (EPOLLIN | EPOLLOUT)) {
+			// an edge fired while no other unote could take it
+			uint32_t event = events & (EPOLLIN | EPOLLOUT);
+			dmn->dmn_pending_events &= (uint16_t)~event;
+			_dispatch_event_merge_edge(dmn, event);
+		}
 	}
+	_dispatch_epoll_shard_unlock(des);
 	return dmn != NULL;
 }
 
@@ -303,14 +759,26 @@ void
 _dispatch_unote_resume_muxed(dispatch_unote_t du)
 {
 	dispatch_muxnote_t dmn = _dispatch_unote_get_linkage(du)->du_muxnote;
+	dispatch_epoll_shard_t des = _dispatch_muxnote_epoll_shard(dmn);
 	dispatch_assert(_dispatch_unote_registered(du));
 	uint32_t events = _dispatch_unote_required_events(du);
 
-	if (events & dmn->dmn_disarmed_events) {
+	_dispatch_epoll_shard_lock(des);
+	if (dmn->dmn_edge_triggered) {
+		// the registration is never disarmed, the unote only needs to be
+		// marked armed again, and to receive any edge it missed meanwhile
+		uint32_t event = events & (EPOLLIN | EPOLLOUT);
+		_dispatch_unote_state_set_bit(du, DU_STATE_ARMED);
+		if (dmn->dmn_pending_events & event) {
+			dmn->dmn_pending_events &= (uint16_t)~event;
+			_dispatch_event_merge_edge(dmn, event);
+		}
+	} else if (events & dmn->dmn_disarmed_events) {
 		dmn->dmn_disarmed_events &= ~events;
 		events = _dispatch_muxnote_armed_events(dmn);
 		_dispatch_epoll_update(dmn, events, EPOLL_CTL_MOD);
 	}
+	_dispatch_epoll_shard_unlock(des);
 }
 
 bool
@@ -318,6 +786,9 @@ _dispatch_unote_unregister_muxed(dispatch_unote_t du)
 {
 	dispatch_unote_linkage_t dul = _dispatch_unote_get_linkage(du);
 	dispatch_muxnote_t dmn = dul->du_muxnote;
+	dispatch_epoll_shard_t des = _dispatch_muxnote_epoll_shard(dmn);
+
+	_dispatch_epoll_shard_lock(des);
 	uint32_t events = dmn->dmn_events;
 
 	LIST_REMOVE(dul, du_link);
@@ -326,6 +797,7 @@ _dispatch_unote_unregister_muxed(dispatch_unote_t du)
 
 	if (LIST_EMPTY(&dmn->dmn_readers_head)) {
 		events &= (uint32_t)~EPOLLIN;
+		dmn->dmn_pending_events &= (uint16_t)~EPOLLIN;
 		if (dmn->dmn_disarmed_events & EPOLLIN) {
 			dmn->dmn_disarmed_events &= (uint16_t)~EPOLLIN;
 			dmn->dmn_events &= (uint32_t)~EPOLLIN;
@@ -333,6 +805,7 @@ _dispatch_unote_unregister_muxed(dispatch_unote_t du)
 	}
 	if (LIST_EMPTY(&dmn->dmn_writers_head)) {
 		events &= (uint32_t)~EPOLLOUT;
+		dmn->dmn_pending_events &= (uint16_t)~EPOLLOUT;
 		if (dmn->dmn_disarmed_events & EPOLLOUT) {
 			dmn->dmn_disarmed_events &= (uint16_t)~EPOLLOUT;
 			dmn->dmn_events &= (uint32_t)~EPOLLOUT;
@@ -346,11 +819,12 @@ _dispatch_unote_unregister_muxed(dispatch_unote_t du)
 			_dispatch_epoll_update(dmn, events, EPOLL_CTL_MOD);
 		}
 	} else {
-		epoll_ctl(_dispatch_epfd, EPOLL_CTL_DEL, dmn->dmn_fd, NULL);
+		_dispatch_epoll_update(dmn, 0, EPOLL_CTL_DEL);
 		LIST_REMOVE(dmn, dmn_list);
 		_dispatch_muxnote_dispose(dmn);
 	}
 	_dispatch_unote_state_set(du, DU_STATE_UNREGISTERED);
+	_dispatch_epoll_shard_unlock(des);
 	return true;
 }
 
@@ -424,7 +898,8 @@ _dispatch_timeout_program(uint32_t tidx, uint64_t target,
 	} else {
 		op = EPOLL_CTL_DEL;
 	}
-	dispatch_assume_zero(epoll_ctl(_dispatch_epfd, op, timer->det_fd, &ev));
+	dispatch_assume_zero(epoll_ctl(_dispatch_epoll_shards[0].des_epfd, op,
+			timer->det_fd, &ev));
 	timer->det_armed = timer->det_registered = (op != EPOLL_CTL_DEL);;
 }
 
@@ -452,14 +927,107 @@ _dispatch_event_loop_atfork_child(void)
 {
 }
 
+static void _dispatch_event_merge_epoll(dispatch_epoll_shard_t des,
+		struct epoll_event *ev);
+
+static int
+_dispatch_epoll_shard_wait(dispatch_epoll_shard_t des,
+		struct epoll_event *ev, int timeout)
+{
+	int r;
+
+retry:
+	r = epoll_wait(des->des_epfd, ev, DISPATCH_EPOLL_MAX_EVENT_COUNT, timeout);
+	if (unlikely(r == -1)) {
+		int err = errno;
+		switch (err) {
+		case EINTR:
+			goto retry;
+		case EBADF:
+			DISPATCH_CLIENT_CRASH(err, "Do not close random Unix descriptors");
+			break;
+		default:
+			(void)dispatch_assume_zero(err);
+			break;
+		}
+		return 0;
+	}
+	return r;
+}
+
+static void *
+_dispatch_epoll_shard_thread(void *context)
+{
+	dispatch_epoll_shard_t des = context;
+	struct epoll_event ev[DISPATCH_EPOLL_MAX_EVENT_COUNT];
+	dispatch_deferred_items_s ddi = {
+		.ddi_wlh = DISPATCH_WLH_ANON,
+	};
+	int i, r;
+
+	// signals are delivered through the manager shard signalfds
+	_dispatch_sigmask();
+	_dispatch_introspection_thread_add();
+	_dispatch_deferred_items_set(&ddi);
+
+	for (;;) {
+		r = _dispatch_epoll_shard_wait(des, ev, -1);
+		for (i = 0; i < r; i++) {
+			_dispatch_event_merge_epoll(des, &ev[i]);
+		}
+	}
+	return NULL;
+}
+
+static void
+_dispatch_epoll_shard_init(dispatch_epoll_shard_t des, uint8_t idx)
+{
+	des->des_idx = idx;
+	des->des_epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (des->des_epfd < 0) {
+		DISPATCH_INTERNAL_CRASH(errno, "epoll_create1() failed");
+	}
+	if (idx == 0) {
+		// drained by the manager queue
+		return;
+	}
+
+	pthread_attr_t attr;
+	pthread_t tid;
+	int r;
+	(void)dispatch_assume_zero(pthread_attr_init(&attr));
+	(void)dispatch_assume_zero(pthread_attr_setdetachstate(&attr,
+			PTHREAD_CREATE_DETACHED));
+#if !DISPATCH_DEBUG
+	(void)dispatch_assume_zero(pthread_attr_setstacksize(&attr, 64 * 1024));
+#endif
+	while ((r = pthread_create(&tid, &attr, _dispatch_epoll_shard_thread,
+			des))) {
+		if (r != EAGAIN) {
+			(void)dispatch_assume_zero(r);
+		}
+		_dispatch_temporary_resource_shortage();
+	}
+	(void)dispatch_assume_zero(pthread_attr_destroy(&attr));
+}
+
 static void
 _dispatch_epoll_init(void *context DISPATCH_UNUSED)
 {
 	_dispatch_fork_becomes_unsafe();
 
-	_dispatch_epfd = epoll_create1(EPOLL_CLOEXEC);
-	if (_dispatch_epfd < 0) {
-		DISPATCH_INTERNAL_CRASH(errno, "epoll_create1() failed");
+	char *e = getenv("LIBDISPATCH_EPOLL_SHARDS");
+	if (e) {
+		int n = atoi(e);
+		if (n > DISPATCH_EPOLL_MAX_SHARD_COUNT) {
+			n = DISPATCH_EPOLL_MAX_SHARD_COUNT;
+		}
+		if (n > 1) {
+			_dispatch_epoll_shard_count = (uint8_t)n;
+		}
+	}
+	for (uint8_t i = 0; i < _dispatch_epoll_shard_count; i++) {
+		_dispatch_epoll_shard_init(&_dispatch_epoll_shards[i], i);
 	}
 
 	_dispatch_eventfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
@@ -472,7 +1040,8 @@ _dispatch_epoll_init(void *context DISPATCH_UNUSED)
 		.data = { .u32 = DISPATCH_EPOLL_EVENTFD, },
 	};
 	int op = EPOLL_CTL_ADD;
-	if (epoll_ctl(_dispatch_epfd, op, _dispatch_eventfd, &ev) < 0) {
+	if (epoll_ctl(_dispatch_epoll_shards[0].des_epfd, op, _dispatch_eventfd,
+			&ev) < 0) {
 		DISPATCH_INTERNAL_CRASH(errno, "epoll_ctl() failed");
 	}
 
@@ -565,11 +1134,61 @@ _dispatch_event_merge_hangup(dispatch_unote_t du)
 }
 
 static void
-_dispatch_event_merge_fd(dispatch_muxnote_t dmn, uint32_t events)
+_dispatch_event_merge_edge(dispatch_muxnote_t dmn, uint32_t event)
+{
+	dispatch_unote_linkage_t dul, dul_next;
+	bool writer = (event == EPOLLOUT);
+	bool delivered = false;
+	uintptr_t data = 0;
+
+	LIST_FOREACH_SAFE(dul, writer ? &dmn->dmn_writers_head :
+			&dmn->dmn_readers_head, du_link, dul_next) {
+		dispatch_unote_t du = _dispatch_unote_linkage_get_unote(dul);
+		if (!_dispatch_unote_armed(du)) {
+			// the handler is running, it will drain the descriptor
+			continue;
+		}
+		if (!delivered) {
+			data = _dispatch_get_buffer_size(dmn, writer);
+			delivered = true;
+		}
+		// consumed by dux_merge_evt()
+		_dispatch_retain_unote_owner(du);
+		_dispatch_unote_state_clear_bit(du, DU_STATE_ARMED);
+		os_atomic_store(&du._dr->ds_pending_data, ~data, relaxed);
+		dux_merge_evt(du._du, EV_ADD|EV_ENABLE|EV_DISPATCH, data, 0);
+		if (dmn->dmn_exclusive) {
+			break;
+		}
+	}
+
+	if (!delivered) {
+		// no edge will come again until the descriptor has been drained,
+		// remember it for the next unote to be resumed
+		dmn->dmn_pending_events |= (uint16_t)event;
+	}
+}
+
+static void
+_dispatch_event_merge_fd(dispatch_epoll_shard_t des, dispatch_muxnote_t dmn,
+		uint32_t events)
 {
 	dispatch_unote_linkage_t dul, dul_next;
 	uintptr_t data;
 
+	// EPOLLERR is reported whatever events were asked for, the error is
+	// surfaced by the next read or write of the sources waiting for them.
+	// EPOLLHUP is always handled as a hangup below, in both modes.
+	if (events & EPOLLERR) {
+		events |= _dispatch_muxnote_armed_events(dmn) & (EPOLLIN | EPOLLOUT);
+	}
+
+	if (dmn->dmn_edge_triggered && !(events & EPOLLHUP)) {
+		if (events & EPOLLIN) _dispatch_event_merge_edge(dmn, EPOLLIN);
+		if (events & EPOLLOUT) _dispatch_event_merge_edge(dmn, EPOLLOUT);
+		return;
+	}
+
 	dmn->dmn_disarmed_events |= (events & (EPOLLIN | EPOLLOUT));
 
 	if (events & EPOLLIN) {
@@ -608,7 +1227,7 @@ _dispatch_event_merge_fd(dispatch_muxnote_t dmn, uint32_t events)
 			dispatch_unote_t du = _dispatch_unote_linkage_get_unote(dul);
 			_dispatch_event_merge_hangup(du);
 		}
-		epoll_ctl(_dispatch_epfd, EPOLL_CTL_DEL, dmn->dmn_fd, NULL);
+		epoll_ctl(des->des_epfd, EPOLL_CTL_DEL, dmn->dmn_fd, NULL);
 		return;
 	}
 
@@ -616,71 +1235,416 @@ _dispatch_event_merge_fd(dispatch_muxnote_t dmn, uint32_t events)
 	if (events) _dispatch_epoll_update(dmn, events, EPOLL_CTL_MOD);
 }
 
-DISPATCH_NOINLINE
-void
-_dispatch_event_loop_drain(uint32_t flags)
+static void
+_dispatch_event_merge_fflags(dispatch_muxnote_t dmn, uint32_t fflags,
+		uint32_t status)
 {
-	struct epoll_event ev[DISPATCH_EPOLL_MAX_EVENT_COUNT];
-	int i, r;
-	int timeout = (flags & KEVENT_FLAG_IMMEDIATE) ? 0 : -1;
+	dispatch_unote_linkage_t dul, dul_next;
 
-retry:
-	r = epoll_wait(_dispatch_epfd, ev, countof(ev), timeout);
-	if (unlikely(r == -1)) {
-		int err = errno;
-		switch (err) {
-		case EINTR:
-			goto retry;
-		case EBADF:
-			DISPATCH_CLIENT_CRASH(err, "Do not close random Unix descriptors");
+	LIST_FOREACH_SAFE(dul, &dmn->dmn_readers_head, du_link, dul_next) {
+		dispatch_unote_t du = _dispatch_unote_linkage_get_unote(dul);
+		uintptr_t data = fflags & du._du->du_fflags;
+		if (!data) {
+			continue;
+		}
+		// consumed by dux_merge_evt()
+		_dispatch_retain_unote_owner(du);
+		if (du._dr->du_has_extended_status) {
+			uint64_t odata, ndata, value;
+			value = DISPATCH_SOURCE_COMBINE_DATA_AND_STATUS(data, status);
+			os_atomic_rmw_loop(&du._dr->ds_pending_data, odata, ndata, relaxed, {
+				ndata = DISPATCH_SOURCE_GET_DATA(odata) | value;
+			});
+		} else {
+			os_atomic_or(&du._dr->ds_pending_data, data, relaxed);
+		}
+		dux_merge_evt(du._du, EV_ADD|EV_ENABLE|EV_CLEAR, data, 0);
+	}
+}
+
+static void
+_dispatch_event_merge_proc(dispatch_muxnote_t dmn)
+{
+	siginfo_t si = { .si_pid = 0 };
+	uint32_t status = 0;
+
+	// WNOWAIT leaves the zombie for the client to reap
+	if (waitid((idtype_t)P_PIDFD, (id_t)dmn->dmn_fd, &si,
+			WEXITED | WNOHANG | WNOWAIT) == 0 && si.si_pid) {
+		switch (si.si_code) {
+		case CLD_EXITED:
+			status = (uint32_t)(si.si_status & 0xff) << 8;
 			break;
-		default:
-			(void)dispatch_assume_zero(err);
+		case CLD_KILLED:
+			status = (uint32_t)si.si_status;
+			break;
+		case CLD_DUMPED:
+			status = (uint32_t)si.si_status | 0x80;
 			break;
 		}
+	}
+
+	// a pidfd stays readable forever once the process has exited
+	epoll_ctl(_dispatch_epoll_shards[0].des_epfd, EPOLL_CTL_DEL,
+			dmn->dmn_fd, NULL);
+	_dispatch_event_merge_fflags(dmn, DISPATCH_PROC_EXIT, status);
+}
+
+static uint32_t
+_dispatch_vnode_fflags(dispatch_muxnote_t dmn, uint32_t mask)
+{
+	uint32_t fflags = 0;
+	struct stat sb;
+
+	if (mask & IN_MODIFY) {
+		fflags |= DISPATCH_VNODE_WRITE;
+	}
+	if (mask & IN_ATTRIB) {
+		fflags |= DISPATCH_VNODE_ATTRIB;
+	}
+	if (mask & IN_DELETE_SELF) {
+		fflags |= DISPATCH_VNODE_DELETE;
+	}
+	if (mask & IN_MOVE_SELF) {
+		fflags |= DISPATCH_VNODE_RENAME;
+	}
+	if (mask & IN_UNMOUNT) {
+		fflags |= DISPATCH_VNODE_REVOKE;
+	}
+	// inotify has no notion of extension or link count changes, derive
+	// them from the inode itself
+	if ((mask & (IN_MODIFY | IN_ATTRIB)) &&
+			fstat((int)dmn->dmn_ident, &sb) == 0) {
+		if (sb.st_size > dmn->dmn_vnode_size) {
+			fflags |= DISPATCH_VNODE_EXTEND;
+		}
+		if (sb.st_nlink != dmn->dmn_vnode_nlink) {
+			fflags |= DISPATCH_VNODE_LINK;
+			if (sb.st_nlink == 0) {
+				fflags |= DISPATCH_VNODE_DELETE;
+			}
+		}
+		dmn->dmn_vnode_size = sb.st_size;
+		dmn->dmn_vnode_nlink = sb.st_nlink;
+	}
+	return fflags;
+}
+
+static void
+_dispatch_event_merge_inotify(void)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	struct inotify_event *ie;
+	dispatch_muxnote_t dmn, dmn_next;
+	ssize_t rc;
+
+	while ((rc = read(_dispatch_inotify_fd, buf, sizeof(buf))) > 0) {
+		for (char *p = buf; p < buf + rc; p += sizeof(*ie) + ie->len) {
+			ie = (struct inotify_event *)p;
+			LIST_FOREACH_SAFE(dmn, &_dispatch_inotify_watches[DSL_HASH(
+					(uint32_t)ie->wd)], dmn_wd_list, dmn_next) {
+				if (dmn->dmn_wd != ie->wd) {
+					continue;
+				}
+				if (ie->mask & IN_IGNORED) {
+					// the kernel dropped the watch (inode gone or unmounted)
+					LIST_REMOVE(dmn, dmn_wd_list);
+					dmn->dmn_wd = -1;
+					continue;
+				}
+				uint32_t fflags = _dispatch_vnode_fflags(dmn, ie->mask);
+				if (fflags) _dispatch_event_merge_fflags(dmn, fflags, 0);
+			}
+		}
+	}
+	dispatch_assume(rc == -1 && errno == EAGAIN);
+}
+
+static void
+_dispatch_memorystatus_deliver(dispatch_muxnote_t dmn, uint32_t pressure)
+{
+	struct itimerspec its = { };
+
+	if (dmn->dmn_pressure == DISPATCH_MEMORYPRESSURE_NORMAL) {
+		// pressure has no end event, poll for the triggers going quiet
+		its.it_value.tv_sec = DISPATCH_MEMORYSTATUS_RECHECK_INTERVAL;
+		its.it_interval.tv_sec = DISPATCH_MEMORYSTATUS_RECHECK_INTERVAL;
+		dispatch_assume_zero(timerfd_settime(dmn->dmn_recheck_fd, 0,
+				&its, NULL));
+	} else if (pressure == DISPATCH_MEMORYPRESSURE_NORMAL) {
+		dispatch_assume_zero(timerfd_settime(dmn->dmn_recheck_fd, 0,
+				&its, NULL));
+	}
+	dmn->dmn_pressure = pressure;
+	_dispatch_event_merge_fflags(dmn, pressure, 0);
+}
+
+static void
+_dispatch_event_merge_memorystatus(dispatch_muxnote_t dmn, uint32_t ident)
+{
+	uint32_t pressure = DISPATCH_MEMORYPRESSURE_NORMAL;
+	uint64_t high = 0, max = 0, expirations;
+
+	switch (ident) {
+	case DISPATCH_EPOLL_MEMORYSTATUS_WARN:
+		if (dmn->dmn_critical_fd >= 0) {
+			pressure = DISPATCH_MEMORYPRESSURE_WARN;
+		} else if (_dispatch_memorystatus_cgroup_read(dmn, &high, &max)) {
+			// memory.events also changes for events we do not care about
+			if (max > dmn->dmn_cgroup_max) {
+				pressure = DISPATCH_MEMORYPRESSURE_CRITICAL;
+			} else if (high > dmn->dmn_cgroup_high) {
+				pressure = DISPATCH_MEMORYPRESSURE_WARN;
+			}
+			dmn->dmn_cgroup_high = high;
+			dmn->dmn_cgroup_max = max;
+		}
+		break;
+
+	case DISPATCH_EPOLL_MEMORYSTATUS_CRITICAL:
+		pressure = DISPATCH_MEMORYPRESSURE_CRITICAL;
+		break;
+
+	case DISPATCH_EPOLL_MEMORYSTATUS_RECHECK:
+		if (read(dmn->dmn_recheck_fd, &expirations, sizeof(expirations)) < 0) {
+			return;
+		}
+		if (dmn->dmn_pressure_seen) {
+			pressure = dmn->dmn_pressure_seen;
+		}
+		dmn->dmn_pressure_seen = 0;
+		if (pressure != dmn->dmn_pressure) {
+			_dispatch_memorystatus_deliver(dmn, pressure);
+		}
 		return;
 	}
 
-	for (i = 0; i < r; i++) {
-		dispatch_muxnote_t dmn;
-		eventfd_t value;
+	if (pressure == DISPATCH_MEMORYPRESSURE_NORMAL) {
+		return;
+	}
+	dmn->dmn_pressure_seen = MAX(dmn->dmn_pressure_seen, pressure);
+	if (pressure > dmn->dmn_pressure) {
+		_dispatch_memorystatus_deliver(dmn, pressure);
+	}
+}
+
+static void
+_dispatch_event_merge_shard(dispatch_epoll_shard_t des, struct epoll_event *ev)
+{
+	struct dispatch_muxnote_bucket_s *dmb;
+	dispatch_muxnote_t dmn;
+	uint32_t ident = (uint32_t)ev->data.u64;
+	uint32_t gen = (uint32_t)(ev->data.u64 >> 32);
+
+	_dispatch_epoll_shard_lock(des);
+	dmb = _dispatch_muxnote_bucket(des, ident);
+	dmn = _dispatch_muxnote_find(dmb, ident, EVFILT_READ);
+	// the muxnote may have been unregistered, or even replaced by a new
+	// registration for a recycled descriptor, while the event was in flight
+	if (dmn && dmn->dmn_gen == gen) {
+		_dispatch_event_merge_fd(des, dmn, ev->events);
+	}
+	_dispatch_epoll_shard_unlock(des);
+}
+
+static void
+_dispatch_event_merge_epoll(dispatch_epoll_shard_t des, struct epoll_event *ev)
+{
+	dispatch_muxnote_t dmn;
+	eventfd_t value;
+
+	if (ev->events & EPOLLFREE) {
+		DISPATCH_CLIENT_CRASH(0, "Do not close random Unix descriptors");
+	}
+
+	if (des->des_idx) {
+		return _dispatch_event_merge_shard(des, ev);
+	}
+
+	switch (ev->data.u32) {
+	case DISPATCH_EPOLL_EVENTFD:
+		dispatch_assume_zero(eventfd_read(_dispatch_eventfd, &value));
+		break;
 
-		if (ev[i].events & EPOLLFREE) {
-			DISPATCH_CLIENT_CRASH(0, "Do not close random Unix descriptors");
+	case DISPATCH_EPOLL_CLOCK_WALL:
+		_dispatch_event_merge_timer(DISPATCH_CLOCK_WALL);
+		break;
+
+	case DISPATCH_EPOLL_CLOCK_UPTIME:
+		_dispatch_event_merge_timer(DISPATCH_CLOCK_UPTIME);
+		break;
+
+	case DISPATCH_EPOLL_CLOCK_MONOTONIC:
+		_dispatch_event_merge_timer(DISPATCH_CLOCK_MONOTONIC);
+		break;
+
+	case DISPATCH_EPOLL_INOTIFY:
+		_dispatch_epoll_shard_lock(des);
+		_dispatch_event_merge_inotify();
+		_dispatch_epoll_shard_unlock(des);
+		break;
+
+	case DISPATCH_EPOLL_MEMORYSTATUS_WARN:
+	case DISPATCH_EPOLL_MEMORYSTATUS_CRITICAL:
+	case DISPATCH_EPOLL_MEMORYSTATUS_RECHECK:
+		_dispatch_epoll_shard_lock(des);
+		// the muxnote may have been unregistered earlier in this batch
+		if (_dispatch_memorystatus_muxnote) {
+			_dispatch_event_merge_memorystatus(_dispatch_memorystatus_muxnote,
+					ev->data.u32);
 		}
+		_dispatch_epoll_shard_unlock(des);
+		break;
 
-		switch (ev[i].data.u32) {
-		case DISPATCH_EPOLL_EVENTFD:
-			dispatch_assume_zero(eventfd_read(_dispatch_eventfd, &value));
+	default:
+		dmn = ev->data.ptr;
+		_dispatch_epoll_shard_lock(des);
+		switch (dmn->dmn_filter) {
+		case EVFILT_SIGNAL:
+			_dispatch_event_merge_signal(dmn);
 			break;
 
-		case DISPATCH_EPOLL_CLOCK_WALL:
-			_dispatch_event_merge_timer(DISPATCH_CLOCK_WALL);
+		case EVFILT_READ:
+			_dispatch_event_merge_fd(des, dmn, ev->events);
 			break;
 
-		case DISPATCH_EPOLL_CLOCK_UPTIME:
-			_dispatch_event_merge_timer(DISPATCH_CLOCK_UPTIME);
+		case EVFILT_PROC:
+			_dispatch_event_merge_proc(dmn);
 			break;
+		}
+		_dispatch_epoll_shard_unlock(des);
+	}
+}
 
-		case DISPATCH_EPOLL_CLOCK_MONOTONIC:
-			_dispatch_event_merge_timer(DISPATCH_CLOCK_MONOTONIC);
-			break;
+DISPATCH_NOINLINE
+void
+_dispatch_event_loop_drain(uint32_t flags)
+{
+	dispatch_epoll_shard_t des = &_dispatch_epoll_shards[0];
+	struct epoll_event ev[DISPATCH_EPOLL_MAX_EVENT_COUNT];
+	int i, r;
+	int timeout = (flags & KEVENT_FLAG_IMMEDIATE) ? 0 : -1;
 
-		default:
-			dmn = ev[i].data.ptr;
-			switch (dmn->dmn_filter) {
-			case EVFILT_SIGNAL:
-				_dispatch_event_merge_signal(dmn);
-				break;
-
-			case EVFILT_READ:
-				_dispatch_event_merge_fd(dmn, ev[i].events);
-				break;
-			}
-		}
+#if DISPATCH_USE_MEMORYPRESSURE_SOURCE
+	static bool memorypressure_initialized;
+	if (unlikely(!memorypressure_initialized)) {
+		// The memory pressure source can't be created under the epoll
+		// dispatch_once as activating it pokes the manager, only the manager
+		// drains shard 0 so this doesn't need to be atomic.
+		memorypressure_initialized = true;
+		_dispatch_memorypressure_init();
+	}
+#endif
+
+	r = _dispatch_epoll_shard_wait(des, ev, timeout);
+	for (i = 0; i < r; i++) {
+		_dispatch_event_merge_epoll(des, &ev[i]);
 	}
 }
 
+#pragma mark epoll specific sources
+
+static dispatch_unote_t
+_dispatch_source_proc_create(dispatch_source_type_t dst, uintptr_t handle,
+		unsigned long mask)
+{
+	dispatch_unote_t du = _dispatch_unote_create_with_handle(dst, handle, mask);
+	if (du._du && (mask & DISPATCH_PROC_EXIT_STATUS)) {
+		du._du->du_has_extended_status = true;
+	}
+	return du;
+}
+
+const dispatch_source_type_s _dispatch_source_type_proc = {
+	.dst_kind       = "proc",
+	.dst_filter     = EVFILT_PROC,
+	.dst_flags      = DISPATCH_EV_DIRECT|EV_CLEAR,
+	.dst_fflags     = DISPATCH_PROC_EXIT,
+	.dst_mask       = DISPATCH_PROC_EXIT|DISPATCH_PROC_EXIT_STATUS,
+	.dst_action     = DISPATCH_UNOTE_ACTION_SOURCE_OR_FFLAGS,
+	.dst_size       = sizeof(struct dispatch_source_refs_s),
+
+	.dst_create     = _dispatch_source_proc_create,
+	.dst_merge_evt  = _dispatch_source_merge_evt,
+};
+
+const dispatch_source_type_s _dispatch_source_type_vnode = {
+	.dst_kind       = "vnode",
+	.dst_filter     = EVFILT_VNODE,
+	.dst_flags      = DISPATCH_EV_DIRECT|EV_CLEAR,
+	.dst_mask       = DISPATCH_VNODE_DELETE|DISPATCH_VNODE_WRITE
+			|DISPATCH_VNODE_EXTEND|DISPATCH_VNODE_ATTRIB|DISPATCH_VNODE_LINK
+			|DISPATCH_VNODE_RENAME|DISPATCH_VNODE_REVOKE,
+	.dst_action     = DISPATCH_UNOTE_ACTION_SOURCE_OR_FFLAGS,
+	.dst_size       = sizeof(struct dispatch_source_refs_s),
+
+	.dst_create     = _dispatch_unote_create_with_fd,
+	.dst_merge_evt  = _dispatch_source_merge_evt,
+};
+
+const dispatch_source_type_s _dispatch_source_type_memorypressure = {
+	.dst_kind       = "memorystatus",
+	.dst_filter     = EVFILT_MEMORYSTATUS,
+	.dst_flags      = DISPATCH_EV_DIRECT|EV_CLEAR,
+	.dst_mask       = DISPATCH_MEMORYPRESSURE_NORMAL
+			|DISPATCH_MEMORYPRESSURE_WARN|DISPATCH_MEMORYPRESSURE_CRITICAL,
+	.dst_action     = DISPATCH_UNOTE_ACTION_SOURCE_OR_FFLAGS,
+	.dst_size       = sizeof(struct dispatch_source_refs_s),
+
+	.dst_create     = _dispatch_unote_create_without_handle,
+	.dst_merge_evt  = _dispatch_source_merge_evt,
+};
+
+#if DISPATCH_USE_MEMORYPRESSURE_SOURCE
+
+/*
+ * Like on Darwin, the library registers a memory pressure source of its own
+ * so that it trims its caches whether or not the process watches memory
+ * pressure. There is a single memory pressure muxnote, so client sources
+ * share the PSI triggers this source arms instead of opening their own.
+ */
+static void
+_dispatch_memorypressure_handler(void *context)
+{
+	dispatch_source_t ds = context;
+	unsigned long memorypressure = dispatch_source_get_data(ds);
+
+	if (memorypressure & DISPATCH_MEMORYPRESSURE_NORMAL) {
+		_dispatch_memory_warn = false;
+		_dispatch_continuation_cache_limit = DISPATCH_CONTINUATION_CACHE_LIMIT;
+	}
+	if (memorypressure & (DISPATCH_MEMORYPRESSURE_WARN |
+			DISPATCH_MEMORYPRESSURE_CRITICAL)) {
+		_dispatch_memory_warn = true;
+		_dispatch_continuation_cache_limit =
+				DISPATCH_CONTINUATION_CACHE_LIMIT_MEMORYPRESSURE_PRESSURE_WARN;
+		// this runs on the manager queue which owns the timer heaps
+		_dispatch_timer_heaps_trim();
+#if defined(__GLIBC__)
+		// give the continuations and buffers freed meanwhile back to the
+		// system, there is no malloc_memory_event_handler() on Linux
+		malloc_trim(0);
+#endif
+	}
+}
+
+/* initialize the default memory pressure notification source */
+static void
+_dispatch_memorypressure_init(void)
+{
+	dispatch_source_t ds = dispatch_source_create(
+			DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+			DISPATCH_MEMORYPRESSURE_NORMAL | DISPATCH_MEMORYPRESSURE_WARN |
+			DISPATCH_MEMORYPRESSURE_CRITICAL, _dispatch_mgr_q._as_dq);
+	dispatch_set_context(ds, ds);
+	dispatch_source_set_event_handler_f(ds, _dispatch_memorypressure_handler);
+	dispatch_activate(ds);
+}
+
+#endif // DISPATCH_USE_MEMORYPRESSURE_SOURCE
+
+#pragma mark dispatch_sync_context_t
+
 void
 _dispatch_event_loop_cancel_waiter(dispatch_sync_context_t dsc)
 {
@@ -680,6 +680,7 @@ _dispatch_timer_unote_compute_missed(dispatch_timer_source_refs_t dt,
 #define DISPATCH_TIMER_IDENT_CANCELED    (~0u)
 
 extern struct dispatch_timer_heap_s _dispatch_timers_heap[DISPATCH_TIMER_COUNT];
+void _dispatch_timer_heaps_trim(void);
 
 dispatch_unote_t _dispatch_unote_create_with_handle(dispatch_source_type_t dst,
 		uintptr_t handle, uintptr_t mask);
@@ -20,6 +20,12 @@
 
 #include "internal.h"
 
+#if HAVE_DISPATCH_WORKQ_SCHED
+#include <linux/capability.h>
+#include <sched.h>
+#include <sys/resource.h>
+#endif
+
 #if DISPATCH_USE_INTERNAL_WORKQUEUE
 
 /*
@@ -64,6 +70,13 @@ typedef struct dispatch_workq_monitor_s {
 	dispatch_unfair_lock_s registered_tid_lock;
 	dispatch_tid *registered_tids;
 	int num_registered_tids;
+
+	/*
+	 * The workers of the overcommit root queue of the same QoS, which are
+	 * only tracked for dispatch_worker_pool_get_health(), same invariant.
+	 */
+	dispatch_tid *overcommit_tids;
+	int num_overcommit_tids;
 } dispatch_workq_monitor_s, *dispatch_workq_monitor_t;
 
 #if HAVE_DISPATCH_WORKQ_MONITORING
@@ -77,6 +90,30 @@ static dispatch_workq_monitor_s _dispatch_workq_monitors[DISPATCH_QOS_NBUCKETS];
 
 static void _dispatch_workq_init_once(void *context DISPATCH_UNUSED);
 static dispatch_once_t _dispatch_workq_init_once_pred;
+#if HAVE_DISPATCH_WORKQ_SCHED
+static void _dispatch_workq_detect_blocked_workers(int *compensated);
+#endif
+
+#if HAVE_DISPATCH_WORKQ_MONITORING
+static dispatch_workq_monitor_t
+_dispatch_workq_monitor_for_queue(dispatch_queue_global_t root_q,
+		bool *overcommit)
+{
+	dispatch_qos_t qos = _dispatch_priority_qos(root_q->dq_priority);
+	if (qos == 0) qos = DISPATCH_QOS_DEFAULT;
+	int bucket = DISPATCH_QOS_BUCKET(qos);
+	dispatch_workq_monitor_t mon = &_dispatch_workq_monitors[bucket];
+
+	*overcommit = root_q->dq_priority & DISPATCH_PRIORITY_FLAG_OVERCOMMIT;
+	if (*overcommit) {
+		// pthread root queues are overcommit and not tracked
+		if (root_q != _dispatch_get_root_queue(qos, true)) return NULL;
+	} else {
+		dispatch_assert(mon->dq == root_q);
+	}
+	return mon;
+}
+#endif // HAVE_DISPATCH_WORKQ_MONITORING
 
 void
 _dispatch_workq_worker_register(dispatch_queue_global_t root_q)
@@ -84,16 +121,22 @@ _dispatch_workq_worker_register(dispatch_queue_global_t root_q)
 	dispatch_once_f(&_dispatch_workq_init_once_pred, NULL, &_dispatch_workq_init_once);
 
 #if HAVE_DISPATCH_WORKQ_MONITORING
-	dispatch_qos_t qos = _dispatch_priority_qos(root_q->dq_priority);
-	if (qos == 0) qos = DISPATCH_QOS_DEFAULT;
-	int bucket = DISPATCH_QOS_BUCKET(qos);
-	dispatch_workq_monitor_t mon = &_dispatch_workq_monitors[bucket];
-	dispatch_assert(mon->dq == root_q);
+	bool overcommit;
+	dispatch_workq_monitor_t mon;
+	mon = _dispatch_workq_monitor_for_queue(root_q, &overcommit);
+	if (!mon) return;
 	dispatch_tid tid = _dispatch_tid_self();
 	_dispatch_unfair_lock_lock(&mon->registered_tid_lock);
-	dispatch_assert(mon->num_registered_tids < WORKQ_MAX_TRACKED_TIDS-1);
-	int worker_id = mon->num_registered_tids++;
-	mon->registered_tids[worker_id] = tid;
+	if (overcommit) {
+		// the overcommit pool isn't bounded by WORKQ_MAX_TRACKED_TIDS
+		if (mon->num_overcommit_tids < WORKQ_MAX_TRACKED_TIDS) {
+			mon->overcommit_tids[mon->num_overcommit_tids++] = tid;
+		}
+	} else {
+		dispatch_assert(mon->num_registered_tids < WORKQ_MAX_TRACKED_TIDS-1);
+		int worker_id = mon->num_registered_tids++;
+		mon->registered_tids[worker_id] = tid;
+	}
 	_dispatch_unfair_lock_unlock(&mon->registered_tid_lock);
 #else
 	(void)root_q;
@@ -104,19 +147,21 @@ void
 _dispatch_workq_worker_unregister(dispatch_queue_global_t root_q)
 {
 #if HAVE_DISPATCH_WORKQ_MONITORING
-	dispatch_qos_t qos = _dispatch_priority_qos(root_q->dq_priority);
-	if (qos == 0) qos = DISPATCH_QOS_DEFAULT;
-	int bucket = DISPATCH_QOS_BUCKET(qos);
-	dispatch_workq_monitor_t mon = &_dispatch_workq_monitors[bucket];
-	dispatch_assert(mon->dq == root_q);
+	bool overcommit;
+	dispatch_workq_monitor_t mon;
+	mon = _dispatch_workq_monitor_for_queue(root_q, &overcommit);
+	if (!mon) return;
 	dispatch_tid tid = _dispatch_tid_self();
 	_dispatch_unfair_lock_lock(&mon->registered_tid_lock);
-	for (int i = 0; i < mon->num_registered_tids; i++) {
-		if (mon->registered_tids[i] == tid) {
-			int last = mon->num_registered_tids - 1;
-			mon->registered_tids[i] = mon->registered_tids[last];
-			mon->registered_tids[last] = 0;
-			mon->num_registered_tids--;
+	dispatch_tid *tids = overcommit ? mon->overcommit_tids : mon->registered_tids;
+	int *num_tids = overcommit ? &mon->num_overcommit_tids :
+			&mon->num_registered_tids;
+	for (int i = 0; i < *num_tids; i++) {
+		if (tids[i] == tid) {
+			int last = *num_tids - 1;
+			tids[i] = tids[last];
+			tids[last] = 0;
+			(*num_tids)--;
 			break;
 		}
 	}
@@ -126,53 +171,64 @@ _dispatch_workq_worker_unregister(dispatch_queue_global_t root_q)
 #endif // HAVE_DISPATCH_WORKQ_MONITORING
 }
 
-
 #if HAVE_DISPATCH_WORKQ_MONITORING
 #if defined(__linux__)
 /*
- * For each pid that is a registered worker, read /proc/[pid]/stat
+ * Reads the state of a thread from /proc/[pid]/stat, see the proc(5) man page
+ * for its format. Returns 0 if the thread doesn't exist, and '?' if its state
+ * couldn't be read.
+ */
+static char
+_dispatch_workq_thread_state(dispatch_tid tid)
+{
+	char path[128];
+	char buf[4096];
+	ssize_t bytes_read;
+	char state;
+
+	int r = snprintf(path, sizeof(path), "/proc/%d/stat", tid);
+	dispatch_assert(r > 0 && r < (int)sizeof(path));
+
+	int fd = open(path, O_RDONLY | O_NONBLOCK);
+	if (unlikely(fd == -1)) {
+		return 0;
+	}
+	bytes_read = read(fd, buf, sizeof(buf)-1);
+	(void)close(fd);
+
+	if (bytes_read <= 0) {
+		_dispatch_debug("workq: Failed to read %s", path);
+		return '?';
+	}
+	buf[bytes_read] = '\0';
+	if (sscanf(buf, "%*d %*s %c", &state) != 1) {
+		_dispatch_debug("workq: sscanf of state failed for %d", tid);
+		return '?';
+	}
+	// _dispatch_debug("workq: Worker %d, state %c\n", tid, state);
+	return state;
+}
+
+/*
+ * For each pid that is a registered worker, read its state
  * to get a count of the number of them that are actually runnable.
- * See the proc(5) man page for the format of the contents of /proc/[pid]/stat
  */
 static void
 _dispatch_workq_count_runnable_workers(dispatch_workq_monitor_t mon)
 {
-	char path[128];
-	char buf[4096];
 	int running_count = 0;
 
 	_dispatch_unfair_lock_lock(&mon->registered_tid_lock);
 
 	for (int i = 0; i < mon->num_registered_tids; i++) {
 		dispatch_tid tid = mon->registered_tids[i];
-		int fd;
-		ssize_t bytes_read = -1;
-
-		int r = snprintf(path, sizeof(path), "/proc/%d/stat", tid);
-		dispatch_assert(r > 0 && r < (int)sizeof(path));
-
-		fd = open(path, O_RDONLY | O_NONBLOCK);
-		if (unlikely(fd == -1)) {
+		char state = _dispatch_workq_thread_state(tid);
+		if (unlikely(state == 0)) {
 			DISPATCH_CLIENT_CRASH(tid,
 					"workq: registered worker exited prematurely");
-		} else {
-			bytes_read = read(fd, buf, sizeof(buf)-1);
-			(void)close(fd);
 		}
-
-		if (bytes_read > 0) {
-			buf[bytes_read] = '\0';
-			char state;
-			if (sscanf(buf, "%*d %*s %c", &state) == 1) {
-				// _dispatch_debug("workq: Worker %d, state %c\n", tid, state);
-				if (state == 'R') {
-					running_count++;
-				}
-			} else {
-				_dispatch_debug("workq: sscanf of state failed for %d", tid);
-			}
-		} else {
-			_dispatch_debug("workq: Failed to read %s", path);
+		if (state == 'R') {
+			running_count++;
 		}
 	}
 
@@ -193,10 +249,19 @@ _dispatch_workq_monitor_pools(void *context DISPATCH_UNUSED)
 {
 	int global_soft_max = WORKQ_OVERSUBSCRIBE_FACTOR * (int)dispatch_hw_config(active_cpus);
 	int global_runnable = 0, i;
+	// workers poked for per bucket by the blocked worker detector
+	int compensated[DISPATCH_QOS_NBUCKETS] = { };
+#if HAVE_DISPATCH_WORKQ_SCHED
+	if (unlikely(_dispatch_workq_blocking_enabled)) {
+		_dispatch_workq_detect_blocked_workers(compensated);
+	}
+#endif
 	foreach_qos_bucket_reverse(i) {
 		dispatch_workq_monitor_t mon = &_dispatch_workq_monitors[i];
 		dispatch_queue_global_t dq = mon->dq;
 
+		// thread creations the pool policy throttled
+		_dispatch_root_queue_respawn(dq);
 		if (!_dispatch_queue_class_probe(dq)) {
 			_dispatch_debug("workq: %s is empty.", dq->dq_label);
 			continue;
@@ -208,7 +273,14 @@ _dispatch_workq_monitor_pools(void *context DISPATCH_UNUSED)
 
 		global_runnable += mon->num_runnable;
 
-		if (mon->num_runnable == 0) {
+		if (compensated[i]) {
+			// The blocked workers were just compensated for, which covers
+			// the poke below that their absence from the runnable count
+			// would trigger.
+			_dispatch_debug("workq: %s got %d workers for blocked ones",
+					dq->dq_label, compensated[i]);
+			global_runnable += compensated[i];
+		} else if (mon->num_runnable == 0) {
 			// We have work, but no worker is runnable.
 			// It is likely the program is stalled. Therefore treat
 			// this as if dq were an overcommit queue and call poke
@@ -246,6 +318,8 @@ _dispatch_workq_init_once(void *context DISPATCH_UNUSED)
 		mon->dq = _dispatch_get_root_queue(DISPATCH_QOS_FOR_BUCKET(i), 0);
 		void *buf = _dispatch_calloc(WORKQ_MAX_TRACKED_TIDS, sizeof(dispatch_tid));
 		mon->registered_tids = buf;
+		mon->overcommit_tids = _dispatch_calloc(WORKQ_MAX_TRACKED_TIDS,
+				sizeof(dispatch_tid));
 		mon->target_runnable = target_runnable;
 	}
 
@@ -260,4 +334,734 @@ _dispatch_workq_init_once(void *context DISPATCH_UNUSED)
 #endif // HAVE_DISPATCH_WORKQ_MONITORING
 }
 
+#if HAVE_DISPATCH_WORKQ_MONITORING
+/*
+ * Threads spinning for work are runnable, and parked threads are sleeping
+ * like blocked ones, so the idle ones are counted from the pool instead, and
+ * the blocked ones are those which are neither idle nor running.
+ */
+void
+_dispatch_workq_get_health(dispatch_qos_t qos,
+		dispatch_worker_pool_health_t health)
+{
+	dispatch_once_f(&_dispatch_workq_init_once_pred, NULL, &_dispatch_workq_init_once);
+
+	dispatch_workq_monitor_t mon = &_dispatch_workq_monitors[DISPATCH_QOS_BUCKET(qos)];
+	dispatch_queue_global_t dq = mon->dq;
+	dispatch_queue_global_t odq = _dispatch_get_root_queue(qos, true);
+	dispatch_pthread_root_queue_context_t pqc = dq->do_ctxt;
+	dispatch_pthread_root_queue_context_t opqc = odq->do_ctxt;
+	dispatch_tid tids[2 * WORKQ_MAX_TRACKED_TIDS];
+	uint32_t threads, othreads, idle, running = 0;
+	int spinners, pending, opending, num_tids;
+
+	// read /proc outside of the lock that the workers take to exit
+	_dispatch_unfair_lock_lock(&mon->registered_tid_lock);
+	num_tids = mon->num_registered_tids;
+	memcpy(tids, mon->registered_tids, (size_t)num_tids * sizeof(tids[0]));
+	memcpy(tids + num_tids, mon->overcommit_tids,
+			(size_t)mon->num_overcommit_tids * sizeof(tids[0]));
+	num_tids += mon->num_overcommit_tids;
+	_dispatch_unfair_lock_unlock(&mon->registered_tid_lock);
+
+	for (int i = 0; i < num_tids; i++) {
+		if (_dispatch_workq_thread_state(tids[i]) == 'R') {
+			running++;
+		}
+	}
+
+	threads = os_atomic_load(&pqc->dpq_threads, relaxed);
+	othreads = os_atomic_load(&opqc->dpq_threads, relaxed);
+	spinners = os_atomic_load(&pqc->dpq_spinners, relaxed) +
+			os_atomic_load(&opqc->dpq_spinners, relaxed);
+	idle = DISPATCH_PARKING_LOT_PARKED(os_atomic_load(
+			&pqc->dpq_parking_lot.dpl_state, relaxed)) +
+			DISPATCH_PARKING_LOT_PARKED(os_atomic_load(
+			&opqc->dpq_parking_lot.dpl_state, relaxed));
+	if (spinners > 0) {
+		idle += (uint32_t)spinners;
+		running = running > (uint32_t)spinners ? running - (uint32_t)spinners : 0;
+	}
+	threads += othreads;
+	idle = MIN(idle, threads);
+	pending = os_atomic_load(&dq->dgq_pending, relaxed);
+	opending = os_atomic_load(&odq->dgq_pending, relaxed);
+	running = MIN(running, threads - idle);
+
+	*health = (dispatch_worker_pool_health_s){
+		.dwph_qos_class = _dispatch_qos_to_qos_class(qos),
+		.dwph_threads = threads,
+		.dwph_overcommit_threads = othreads,
+		.dwph_idle = idle,
+		.dwph_running = running,
+		.dwph_blocked = threads - idle - running,
+		.dwph_target_running = (uint32_t)mon->target_runnable,
+		.dwph_pending = (uint32_t)MAX(pending, 0) + (uint32_t)MAX(opending, 0),
+		.dwph_spawned = os_atomic_load(&pqc->dpq_spawned, relaxed) +
+				os_atomic_load(&opqc->dpq_spawned, relaxed),
+		.dwph_exited = os_atomic_load(&pqc->dpq_exited, relaxed) +
+				os_atomic_load(&opqc->dpq_exited, relaxed),
+		.dwph_overcommit_spawned = os_atomic_load(&opqc->dpq_spawned, relaxed),
+		.dwph_pokes = os_atomic_load(&pqc->dpq_pokes, relaxed) +
+				os_atomic_load(&opqc->dpq_pokes, relaxed),
+	};
+}
+#endif // HAVE_DISPATCH_WORKQ_MONITORING
+
+#pragma mark Scheduling of worker threads
+
+#if HAVE_DISPATCH_WORKQ_SCHED
+/*
+ * Linux has no notion of QoS. Workers of the global root queues are mapped
+ * onto the closest scheduler settings instead: the nice value, the
+ * SCHED_BATCH and SCHED_IDLE policies and, with LIBDISPATCH_QOS_UCLAMP=1 on
+ * kernels that support them, utilization clamps. LIBDISPATCH_QOS_SCHED=0
+ * leaves worker threads alone.
+ *
+ * Nice values are relative to the one of the main thread, so that programs
+ * started with nice(1) keep working. A thread may always lower its priority,
+ * but raising it back takes CAP_SYS_NICE or a large enough RLIMIT_NICE, and
+ * threads inherit the nice value of the thread that created them. When the
+ * process can't bring a thread back to the baseline nice value, nice values
+ * aren't touched at all and SCHED_BATCH stands in for SCHED_IDLE, which
+ * can't be left either.
+ *
+ * Workers apply the settings of the QoS of their pool when they start. When
+ * work at a higher QoS is enqueued on a queue a worker is draining, the
+ * worker is moved to the settings of that QoS until the end of its current
+ * root queue item.
+ */
+
+#define WORKQ_SCHED_MAX_THREADS \
+		(2 * DISPATCH_QOS_NBUCKETS * DISPATCH_WORKQ_MAX_PTHREAD_COUNT)
+
+// <linux/sched/types.h> conflicts with <sched.h>
+#define WORKQ_SCHED_FLAG_KEEP_POLICY	0x08
+#define WORKQ_SCHED_FLAG_KEEP_PARAMS	0x10
+#define WORKQ_SCHED_FLAG_UTIL_CLAMP_MIN	0x20
+#define WORKQ_SCHED_FLAG_UTIL_CLAMP_MAX	0x40
+
+typedef struct dispatch_workq_sched_attr_s {
+	uint32_t size;
+	uint32_t sched_policy;
+	uint64_t sched_flags;
+	int32_t sched_nice;
+	uint32_t sched_priority;
+	uint64_t sched_runtime;
+	uint64_t sched_deadline;
+	uint64_t sched_period;
+	uint32_t sched_util_min;
+	uint32_t sched_util_max;
+} dispatch_workq_sched_attr_s;
+
+typedef struct dispatch_workq_sched_policy_s {
+	int dwsp_policy;
+	int dwsp_nice; // relative to the baseline
+	uint32_t dwsp_util_min; // out of 1024
+	uint32_t dwsp_util_max;
+} dispatch_workq_sched_policy_s;
+
+static const dispatch_workq_sched_policy_s
+_dispatch_workq_sched_policies[DISPATCH_QOS_NBUCKETS] = {
+	[DISPATCH_QOS_BUCKET(DISPATCH_QOS_MAINTENANCE)] = {
+		SCHED_IDLE, 0, 0, 256,
+	},
+	[DISPATCH_QOS_BUCKET(DISPATCH_QOS_BACKGROUND)] = {
+		SCHED_BATCH, 10, 0, 512,
+	},
+	[DISPATCH_QOS_BUCKET(DISPATCH_QOS_UTILITY)] = {
+		SCHED_OTHER, 5, 0, 1024,
+	},
+	[DISPATCH_QOS_BUCKET(DISPATCH_QOS_DEFAULT)] = {
+		SCHED_OTHER, 0, 0, 1024,
+	},
+	[DISPATCH_QOS_BUCKET(DISPATCH_QOS_USER_INITIATED)] = {
+		SCHED_OTHER, -2, 256, 1024,
+	},
+	[DISPATCH_QOS_BUCKET(DISPATCH_QOS_USER_INTERACTIVE)] = {
+		SCHED_OTHER, -5, 512, 1024,
+	},
+};
+
+/*
+ * Counters of the workers of a QoS bucket. The times are those of the
+ * threads which already exited, the live ones are read from /proc.
+ */
+typedef struct dispatch_workq_sched_stats_s {
+	uint32_t dwss_threads;
+	uint64_t dwss_overrides;
+	uint64_t dwss_run_time;
+	uint64_t dwss_runqueue_wait;
+	uint64_t dwss_timeslices;
+} dispatch_workq_sched_stats_s;
+
+static dispatch_once_t _dispatch_workq_sched_pred;
+static bool _dispatch_workq_sched_enabled;
+static bool _dispatch_workq_sched_renice;
+static bool _dispatch_workq_sched_uclamp;
+static int _dispatch_workq_sched_base_nice;
+static int _dispatch_workq_sched_nice_floor;
+
+/*
+ * Registered workers; all accesses must hold lock.
+ * _dispatch_workq_sched_threads[0]...[_dispatch_workq_sched_num_threads-1]
+ * contain all the registered workers, free slots have a dwt_tid of 0. The
+ * registered workers are also hashed by tid, for overrides to find them.
+ */
+static dispatch_unfair_lock_s _dispatch_workq_sched_lock;
+static dispatch_workq_thread_t _dispatch_workq_sched_threads;
+static int _dispatch_workq_sched_num_threads;
+static dispatch_workq_thread_t _dispatch_workq_sched_hash[DSL_HASH_SIZE];
+static dispatch_workq_sched_stats_s
+		_dispatch_workq_sched_stats[DISPATCH_QOS_NBUCKETS];
+
+static bool
+_dispatch_workq_sched_has_cap_sys_nice(void)
+{
+	struct __user_cap_header_struct hdr = {
+		.version = _LINUX_CAPABILITY_VERSION_3,
+	};
+	struct __user_cap_data_struct data[_LINUX_CAPABILITY_U32S_3] = { };
+
+	if (syscall(SYS_capget, &hdr, data) == -1) {
+		return false;
+	}
+	return data[CAP_TO_INDEX(CAP_SYS_NICE)].effective &
+			CAP_TO_MASK(CAP_SYS_NICE);
+}
+
+static void
+_dispatch_workq_sched_init_once(void *context DISPATCH_UNUSED)
+{
+	struct rlimit rl;
+	int base;
+
+	// workers are registered even when they aren't scheduled by QoS, for
+	// the blocked worker detector
+	_dispatch_workq_sched_threads = _dispatch_calloc(WORKQ_SCHED_MAX_THREADS,
+			sizeof(dispatch_workq_thread_s));
+	if (!_dispatch_getenv_bool("LIBDISPATCH_QOS_SCHED", true)) {
+		return;
+	}
+
+	// PRIO_PROCESS with the pid addresses the main thread
+	errno = 0;
+	base = getpriority(PRIO_PROCESS, (id_t)getpid());
+	if (base == -1 && errno) base = 0;
+
+	// without CAP_SYS_NICE, the nice value can't go below 20 - RLIMIT_NICE
+	_dispatch_workq_sched_nice_floor = -20;
+	if (!_dispatch_workq_sched_has_cap_sys_nice() &&
+			getrlimit(RLIMIT_NICE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY) {
+		_dispatch_workq_sched_nice_floor = 20 - (int)MIN(rl.rlim_cur, 40);
+	}
+	_dispatch_workq_sched_base_nice = base;
+	_dispatch_workq_sched_renice = (_dispatch_workq_sched_nice_floor <= base);
+	_dispatch_workq_sched_uclamp =
+			_dispatch_getenv_bool("LIBDISPATCH_QOS_UCLAMP", false);
+	_dispatch_workq_sched_enabled = true;
+}
+
+static void
+_dispatch_workq_sched_apply(dispatch_tid tid, dispatch_qos_t qos)
+{
+	const dispatch_workq_sched_policy_s *dwsp =
+			&_dispatch_workq_sched_policies[DISPATCH_QOS_BUCKET(qos)];
+	struct sched_param param = { .sched_priority = 0 };
+	int policy = dwsp->dwsp_policy;
+
+	if (_dispatch_workq_sched_renice) {
+		int nice = _dispatch_workq_sched_base_nice + dwsp->dwsp_nice;
+		nice = MIN(MAX(nice, _dispatch_workq_sched_nice_floor), 19);
+		// the nice value goes first, as leaving SCHED_IDLE is only allowed
+		// to threads that may set their current nice value
+		if (setpriority(PRIO_PROCESS, (id_t)tid, nice) == -1 &&
+				errno == EPERM) {
+			// a security policy is in the way, stop trying
+			_dispatch_debug("workq: renicing worker %d denied", tid);
+			_dispatch_workq_sched_renice = false;
+		}
+	}
+	if (!_dispatch_workq_sched_renice && policy == SCHED_IDLE) {
+		policy = SCHED_BATCH;
+	}
+	if (sched_setscheduler((pid_t)tid, policy, &param) == -1) {
+		_dispatch_debug("workq: setting the policy of worker %d failed: %d",
+				tid, errno);
+	}
+
+#ifdef SYS_sched_setattr
+	if (_dispatch_workq_sched_uclamp) {
+		dispatch_workq_sched_attr_s attr = {
+			.size = sizeof(attr),
+			.sched_flags = WORKQ_SCHED_FLAG_KEEP_POLICY |
+					WORKQ_SCHED_FLAG_KEEP_PARAMS |
+					WORKQ_SCHED_FLAG_UTIL_CLAMP_MIN |
+					WORKQ_SCHED_FLAG_UTIL_CLAMP_MAX,
+			.sched_util_min = dwsp->dwsp_util_min,
+			.sched_util_max = dwsp->dwsp_util_max,
+		};
+		if (syscall(SYS_sched_setattr, tid, &attr, 0) == -1 &&
+				errno != EPERM) {
+			// kernel built without CONFIG_UCLAMP_TASK
+			_dispatch_debug("workq: utilization clamps unavailable: %d",
+					errno);
+			_dispatch_workq_sched_uclamp = false;
+		}
+	}
+#endif
+}
+
+static void
+_dispatch_workq_sched_read_stats(dispatch_tid tid,
+		dispatch_workq_sched_stats_s *stats)
+{
+	unsigned long long run_time, runqueue_wait, timeslices;
+	char path[64];
+	char buf[128];
+	ssize_t bytes_read;
+	int fd;
+
+	int r = snprintf(path, sizeof(path), "/proc/self/task/%d/schedstat", tid);
+	dispatch_assert(r > 0 && r < (int)sizeof(path));
+
+	// fails when the thread exited, or without CONFIG_SCHED_INFO
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		return;
+	}
+	bytes_read = read(fd, buf, sizeof(buf)-1);
+	(void)close(fd);
+	if (bytes_read <= 0) {
+		return;
+	}
+	buf[bytes_read] = '\0';
+	if (sscanf(buf, "%llu %llu %llu", &run_time, &runqueue_wait,
+			&timeslices) == 3) {
+		stats->dwss_run_time += run_time;
+		stats->dwss_runqueue_wait += runqueue_wait;
+		stats->dwss_timeslices += timeslices;
+	}
+}
+
+void
+_dispatch_workq_worker_sched_start(dispatch_queue_global_t root_q)
+{
+	dispatch_workq_thread_t dwt = NULL;
+	dispatch_tid tid = _dispatch_tid_self();
+	dispatch_qos_t qos;
+
+	dispatch_once_f(&_dispatch_workq_sched_pred, NULL,
+			&_dispatch_workq_sched_init_once);
+
+	// pthread root queues configure their threads themselves, and the
+	// manager thread must not be slowed down by the work it serves
+	if (dx_type(root_q) != DISPATCH_QUEUE_GLOBAL_ROOT_TYPE ||
+			(root_q->dq_priority & DISPATCH_PRIORITY_FLAG_MANAGER)) {
+		return;
+	}
+	qos = _dispatch_priority_qos(root_q->dq_priority);
+	if (qos == 0) qos = DISPATCH_QOS_DEFAULT;
+
+	_dispatch_unfair_lock_lock(&_dispatch_workq_sched_lock);
+	for (int i = 0; i < WORKQ_SCHED_MAX_THREADS; i++) {
+		if (_dispatch_workq_sched_threads[i].dwt_tid == 0) {
+			dwt = &_dispatch_workq_sched_threads[i];
+			if (i >= _dispatch_workq_sched_num_threads) {
+				_dispatch_workq_sched_num_threads = i + 1;
+			}
+			break;
+		}
+	}
+	if (likely(dwt)) {
+		dwt->dwt_tid = tid;
+		dwt->dwt_qos = (uint8_t)qos;
+		dwt->dwt_override_qos = 0;
+		dwt->dwt_callout_start = 0;
+		dwt->dwt_callout_reported = 0;
+		dwt->dwt_hash_next = _dispatch_workq_sched_hash[DSL_HASH(tid)];
+		_dispatch_workq_sched_hash[DSL_HASH(tid)] = dwt;
+		_dispatch_workq_sched_stats[DISPATCH_QOS_BUCKET(qos)].dwss_threads++;
+	}
+	// inherited from the thread which created this one
+	if (_dispatch_workq_sched_enabled) {
+		_dispatch_workq_sched_apply(tid, qos);
+	}
+	_dispatch_unfair_lock_unlock(&_dispatch_workq_sched_lock);
+
+	_dispatch_thread_setspecific(dispatch_workq_thread_key, dwt);
+}
+
+void
+_dispatch_workq_worker_sched_end(dispatch_queue_global_t root_q)
+{
+	dispatch_workq_thread_t dwt;
+	dispatch_workq_sched_stats_s final = { };
+	dispatch_workq_sched_stats_s *stats;
+
+	(void)root_q;
+	dwt = _dispatch_thread_getspecific(dispatch_workq_thread_key);
+	if (!dwt) return;
+
+	_dispatch_workq_sched_read_stats(dwt->dwt_tid, &final);
+	stats = &_dispatch_workq_sched_stats[DISPATCH_QOS_BUCKET(dwt->dwt_qos)];
+
+	_dispatch_unfair_lock_lock(&_dispatch_workq_sched_lock);
+	stats->dwss_threads--;
+	stats->dwss_run_time += final.dwss_run_time;
+	stats->dwss_runqueue_wait += final.dwss_runqueue_wait;
+	stats->dwss_timeslices += final.dwss_timeslices;
+	dispatch_workq_thread_t *dwtp = &_dispatch_workq_sched_hash[
+			DSL_HASH(dwt->dwt_tid)];
+	while (*dwtp != dwt) {
+		dwtp = &(*dwtp)->dwt_hash_next;
+	}
+	*dwtp = dwt->dwt_hash_next;
+	dwt->dwt_tid = 0;
+	_dispatch_unfair_lock_unlock(&_dispatch_workq_sched_lock);
+
+	_dispatch_thread_setspecific(dispatch_workq_thread_key, NULL);
+}
+
+/*
+ * Applies the settings dwt_override_qos asks for, without the scheduling
+ * lock held. A boost and the reset at the end of the item may race, so each
+ * of them checks after its syscalls that the settings it applied are still
+ * the wanted ones, and applies them again otherwise.
+ */
+static void
+_dispatch_workq_override_apply(dispatch_workq_thread_t dwt, dispatch_tid tid)
+{
+	dispatch_qos_t qos;
+
+	do {
+		qos = os_atomic_load(&dwt->dwt_override_qos, relaxed) ?: dwt->dwt_qos;
+		_dispatch_workq_sched_apply(tid, qos);
+	} while (unlikely((os_atomic_load(&dwt->dwt_override_qos, relaxed) ?:
+			dwt->dwt_qos) != qos));
+}
+
+void
+_dispatch_workq_override_start(dispatch_tid tid, dispatch_qos_t qos)
+{
+	dispatch_workq_thread_t dwt;
+	bool boost = false;
+
+	if (!_dispatch_workq_sched_enabled) return;
+	if (qos > DISPATCH_QOS_MAX) qos = DISPATCH_QOS_MAX;
+
+	// the owner may not be a worker (e.g. the main thread), or be done with
+	// the queue by now, which at worst boosts it for one more item
+	_dispatch_unfair_lock_lock(&_dispatch_workq_sched_lock);
+	dwt = _dispatch_workq_sched_hash[DSL_HASH(tid)];
+	while (dwt && dwt->dwt_tid != tid) {
+		dwt = dwt->dwt_hash_next;
+	}
+	if (dwt && qos > MAX(dwt->dwt_qos, dwt->dwt_override_qos)) {
+		os_atomic_store(&dwt->dwt_override_qos, (uint8_t)qos, relaxed);
+		_dispatch_workq_sched_stats[DISPATCH_QOS_BUCKET(dwt->dwt_qos)]
+				.dwss_overrides++;
+		boost = true;
+	}
+	_dispatch_unfair_lock_unlock(&_dispatch_workq_sched_lock);
+
+	// the record of an exiting worker is only reused once it unregistered,
+	// which it does from its own thread after its last reset
+	if (boost) {
+		_dispatch_workq_override_apply(dwt, tid);
+	}
+}
+
+void
+_dispatch_workq_override_reset(void)
+{
+	dispatch_workq_thread_t dwt;
+	bool reset = false;
+
+	dwt = _dispatch_thread_getspecific(dispatch_workq_thread_key);
+	if (!dwt) return;
+
+	_dispatch_unfair_lock_lock(&_dispatch_workq_sched_lock);
+	if (dwt->dwt_override_qos) {
+		os_atomic_store(&dwt->dwt_override_qos, 0, relaxed);
+		reset = true;
+	}
+	_dispatch_unfair_lock_unlock(&_dispatch_workq_sched_lock);
+
+	if (reset) {
+		_dispatch_workq_override_apply(dwt, dwt->dwt_tid);
+	}
+}
+
+void
+_dispatch_workq_get_sched_stats(dispatch_qos_t qos,
+		dispatch_qos_sched_stats_t stats)
+{
+	dispatch_tid tids[2 * DISPATCH_WORKQ_MAX_PTHREAD_COUNT];
+	dispatch_workq_sched_stats_s total;
+	int bucket = DISPATCH_QOS_BUCKET(qos);
+	int count = 0;
+
+	_dispatch_unfair_lock_lock(&_dispatch_workq_sched_lock);
+	total = _dispatch_workq_sched_stats[bucket];
+	for (int i = 0; i < _dispatch_workq_sched_num_threads; i++) {
+		dispatch_workq_thread_t dwt = &_dispatch_workq_sched_threads[i];
+		if (dwt->dwt_tid && dwt->dwt_qos == qos &&
+				count < (int)countof(tids)) {
+			tids[count++] = dwt->dwt_tid;
+		}
+	}
+	_dispatch_unfair_lock_unlock(&_dispatch_workq_sched_lock);
+
+	// don't hold the lock across reads from /proc
+	for (int i = 0; i < count; i++) {
+		_dispatch_workq_sched_read_stats(tids[i], &total);
+	}
+
+	*stats = (dispatch_qos_sched_stats_s){
+		.dqss_threads = total.dwss_threads,
+		.dqss_overrides = total.dwss_overrides,
+		.dqss_run_time = total.dwss_run_time,
+		.dqss_runqueue_wait = total.dwss_runqueue_wait,
+		.dqss_timeslices = total.dwss_timeslices,
+	};
+}
+
+#pragma mark Detection of blocked workers
+
+/*
+ * Workers publish the callout they are in, see dispatch_workq_thread_s, and
+ * the workqueue monitor reads /proc for those which have been in theirs for
+ * longer than the threshold. The registry of the scheduling code is scanned
+ * without its lock: its slots are never freed, and a slot reused by another
+ * worker shows a different callout start.
+ */
+
+typedef struct dispatch_workq_blocking_report_s {
+	void *dwbr_ctxt;
+	dispatch_blocked_worker_handler_t dwbr_handler;
+	dispatch_blocked_worker_s dwbr_worker;
+} *dispatch_workq_blocking_report_t;
+
+bool _dispatch_workq_blocking_enabled;
+static dispatch_unfair_lock_s _dispatch_workq_blocking_lock;
+static uint64_t _dispatch_workq_blocking_threshold; // in uptime units
+static dispatch_blocked_worker_flags_t _dispatch_workq_blocking_flags;
+static void *_dispatch_workq_blocking_ctxt;
+static dispatch_blocked_worker_handler_t _dispatch_workq_blocking_handler;
+
+dispatch_static_assert(sizeof(((dispatch_workq_thread_t)NULL)->
+		dwt_callout_label) == sizeof(((dispatch_blocked_worker_t)NULL)->
+		dbw_label), "callout label size");
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_workq_callout_publish(dispatch_workq_thread_t dwt, uint64_t start,
+		dispatch_function_t func, const char *label)
+{
+	os_atomic_store(&dwt->dwt_callout_start, 0, relaxed);
+	os_atomic_thread_fence(release);
+	os_atomic_store(&dwt->dwt_callout_function, func, relaxed);
+	strlcpy(dwt->dwt_callout_label, label ?: "",
+			sizeof(dwt->dwt_callout_label));
+	os_atomic_store(&dwt->dwt_callout_start, start, release);
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline dispatch_workq_thread_t
+_dispatch_workq_callout_enter(dispatch_workq_thread_s *saved,
+		dispatch_function_t func)
+{
+	dispatch_workq_thread_t dwt;
+	dispatch_queue_t dq;
+
+	dwt = _dispatch_thread_getspecific(dispatch_workq_thread_key);
+	if (unlikely(!dwt)) return NULL;
+
+	// callouts nest when a callout runs a dispatch_sync() inline
+	saved->dwt_callout_start = dwt->dwt_callout_start;
+	saved->dwt_callout_function = dwt->dwt_callout_function;
+	memcpy(saved->dwt_callout_label, dwt->dwt_callout_label,
+			sizeof(saved->dwt_callout_label));
+	dq = _dispatch_queue_get_current();
+	_dispatch_workq_callout_publish(dwt, _dispatch_uptime(), func,
+			dq ? dq->dq_label : NULL);
+	return dwt;
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_workq_callout_leave(dispatch_workq_thread_t dwt,
+		dispatch_workq_thread_s *saved)
+{
+	if (likely(dwt)) {
+		_dispatch_workq_callout_publish(dwt, saved->dwt_callout_start,
+				saved->dwt_callout_function, saved->dwt_callout_label);
+	}
+}
+
+void
+_dispatch_workq_blocking_callout(void *ctxt, dispatch_function_t f)
+{
+	dispatch_workq_thread_s saved;
+	dispatch_workq_thread_t dwt;
+	dispatch_function_t func = f;
+
+#ifdef __BLOCKS__
+	if (f == _dispatch_call_block_and_release && ctxt) {
+		func = _dispatch_Block_invoke(ctxt);
+	}
+#endif
+	dwt = _dispatch_workq_callout_enter(&saved, func);
+#if DISPATCH_USE_CALLOUT_PROFILE
+	if (unlikely(_dispatch_callout_profile_enabled)) {
+		_dispatch_callout_profile_callout(ctxt, f);
+	} else
+#endif
+	{
+		f(ctxt);
+	}
+	_dispatch_workq_callout_leave(dwt, &saved);
+}
+
+void
+_dispatch_workq_blocking_callout2(void *ctxt, size_t i,
+		void (*f)(void *, size_t))
+{
+	dispatch_workq_thread_s saved;
+	dispatch_workq_thread_t dwt;
+
+	dwt = _dispatch_workq_callout_enter(&saved, (dispatch_function_t)f);
+#if DISPATCH_USE_CALLOUT_PROFILE
+	if (unlikely(_dispatch_callout_profile_enabled)) {
+		_dispatch_callout_profile_callout2(ctxt, i, f);
+	} else
+#endif
+	{
+		f(ctxt, i);
+	}
+	_dispatch_workq_callout_leave(dwt, &saved);
+}
+
+static void
+_dispatch_workq_blocking_report(void *ctxt)
+{
+	dispatch_workq_blocking_report_t dwbr = ctxt;
+
+	dwbr->dwbr_handler(dwbr->dwbr_ctxt, &dwbr->dwbr_worker);
+	free(dwbr);
+}
+
+// Reports the workers blocked in a callout for longer than the threshold,
+// and returns in `compensated` how many workers it poked for, per QoS bucket
+static void
+_dispatch_workq_detect_blocked_workers(int *compensated)
+{
+	dispatch_blocked_worker_handler_t handler;
+	dispatch_blocked_worker_flags_t flags;
+	uint64_t threshold, now, start;
+	void *ctxt;
+	int count;
+
+	_dispatch_unfair_lock_lock(&_dispatch_workq_blocking_lock);
+	threshold = _dispatch_workq_blocking_threshold;
+	flags = _dispatch_workq_blocking_flags;
+	ctxt = _dispatch_workq_blocking_ctxt;
+	handler = _dispatch_workq_blocking_handler;
+	_dispatch_unfair_lock_unlock(&_dispatch_workq_blocking_lock);
+	if (!handler) return;
+
+	now = _dispatch_uptime();
+	count = os_atomic_load(&_dispatch_workq_sched_num_threads, relaxed);
+	for (int i = 0; i < count; i++) {
+		dispatch_workq_thread_t dwt = &_dispatch_workq_sched_threads[i];
+		dispatch_blocked_worker_s dbw = { };
+
+		start = os_atomic_load(&dwt->dwt_callout_start, acquire);
+		if (!start || start == dwt->dwt_callout_reported ||
+				now - start < threshold) {
+			continue;
+		}
+		dbw.dbw_thread = os_atomic_load(&dwt->dwt_tid, relaxed);
+		dbw.dbw_function = os_atomic_load(&dwt->dwt_callout_function, relaxed);
+		// the worker may be publishing another callout meanwhile, the copy is
+		// discarded below if it did, the storage itself is never freed
+		memcpy(dbw.dbw_label, dwt->dwt_callout_label, sizeof(dbw.dbw_label));
+		dbw.dbw_label[sizeof(dbw.dbw_label) - 1] = '\0';
+		os_atomic_thread_fence(acquire);
+		if (os_atomic_load(&dwt->dwt_callout_start, relaxed) != start) {
+			continue;
+		}
+
+		dbw.dbw_state = _dispatch_workq_thread_state(dbw.dbw_thread);
+		if (dbw.dbw_state == 0 || dbw.dbw_state == 'R' ||
+				dbw.dbw_state == '?') {
+			continue;
+		}
+		if (os_atomic_load(&dwt->dwt_callout_start, relaxed) != start) {
+			continue;
+		}
+		dwt->dwt_callout_reported = start;
+
+		dispatch_qos_t qos = dwt->dwt_qos;
+		if (flags & DISPATCH_BLOCKED_WORKER_COMPENSATE) {
+			dispatch_workq_monitor_t mon =
+					&_dispatch_workq_monitors[DISPATCH_QOS_BUCKET(qos)];
+			if (_dispatch_queue_class_probe(mon->dq)) {
+				// like _dispatch_workq_monitor_pools() for a stalled pool
+				int32_t floor = mon->target_runnable - WORKQ_MAX_TRACKED_TIDS;
+				_dispatch_debug("workq: worker %d is blocked; poking %s with "
+						"floor %d", dbw.dbw_thread, mon->dq->dq_label, floor);
+				_dispatch_root_queue_poke(mon->dq, 1, floor);
+				compensated[DISPATCH_QOS_BUCKET(qos)]++;
+				dbw.dbw_compensated = true;
+			}
+		}
+		dbw.dbw_qos_class = _dispatch_qos_to_qos_class(qos);
+		dbw.dbw_duration = _dispatch_time_mach2nano(now - start);
+
+		dispatch_workq_blocking_report_t dwbr;
+		dwbr = _dispatch_calloc(1, sizeof(*dwbr));
+		dwbr->dwbr_ctxt = ctxt;
+		dwbr->dwbr_handler = handler;
+		dwbr->dwbr_worker = dbw;
+		dispatch_async_f(_dispatch_get_root_queue(DISPATCH_QOS_UTILITY,
+				true)->_as_dq, dwbr, _dispatch_workq_blocking_report);
+	}
+}
+
+void
+_dispatch_workq_blocking_configure(uint64_t threshold,
+		dispatch_blocked_worker_flags_t flags, void *ctxt,
+		dispatch_blocked_worker_handler_t handler)
+{
+	dispatch_once_f(&_dispatch_workq_sched_pred, NULL,
+			&_dispatch_workq_sched_init_once);
+
+	_dispatch_unfair_lock_lock(&_dispatch_workq_blocking_lock);
+	_dispatch_workq_blocking_threshold = _dispatch_time_nano2mach(threshold);
+	_dispatch_workq_blocking_flags = flags;
+	_dispatch_workq_blocking_ctxt = ctxt;
+	_dispatch_workq_blocking_handler = handler;
+	_dispatch_unfair_lock_unlock(&_dispatch_workq_blocking_lock);
+	os_atomic_store(&_dispatch_workq_blocking_enabled, handler != NULL,
+			relaxed);
+}
+
+#else // HAVE_DISPATCH_WORKQ_SCHED
+
+void
+_dispatch_workq_worker_sched_start(dispatch_queue_global_t root_q)
+{
+	(void)root_q;
+}
+
+void
+_dispatch_workq_worker_sched_end(dispatch_queue_global_t root_q)
+{
+	(void)root_q;
+}
+
+#endif // HAVE_DISPATCH_WORKQ_SCHED
+
 #endif // DISPATCH_USE_INTERNAL_WORKQUEUE
@@ -32,9 +32,61 @@ void _dispatch_workq_worker_unregister(dispatch_queue_global_t root_q);
 
 #if defined(__linux__)
 #define HAVE_DISPATCH_WORKQ_MONITORING 1
+#define HAVE_DISPATCH_WORKQ_SCHED 1
 #else
 #define HAVE_DISPATCH_WORKQ_MONITORING 0
+#define HAVE_DISPATCH_WORKQ_SCHED 0
 #endif
 
+#if HAVE_DISPATCH_WORKQ_MONITORING
+void _dispatch_workq_get_health(dispatch_qos_t qos,
+		dispatch_worker_pool_health_t health);
+#endif
+
+void _dispatch_workq_worker_sched_start(dispatch_queue_global_t root_q);
+void _dispatch_workq_worker_sched_end(dispatch_queue_global_t root_q);
+
+#if HAVE_DISPATCH_WORKQ_SCHED
+/*
+ * Scheduling state of a worker thread, pointed to by its
+ * dispatch_workq_thread_key TSD.
+ *
+ * dwt_override_qos is written under the workqueue scheduling lock by the
+ * threads that boost this worker, and read without it by the worker when it
+ * finishes a work item, to know whether it needs to go back to dwt_qos.
+ * dwt_hash_next links the registered workers hashed by tid, under that lock.
+ *
+ * While the blocked worker detector is enabled, the worker publishes the
+ * callout it is in with dwt_callout_start as a sequence: 0 while the other
+ * dwt_callout fields are written, then the uptime at which the callout
+ * started. The label of the queue is copied into dwt_callout_label, which the
+ * monitor can read at any time, unlike the label of a queue that may be gone.
+ * dwt_callout_reported is only used by the workqueue monitor.
+ */
+typedef struct dispatch_workq_thread_s {
+	uint32_t dwt_tid;
+	uint8_t dwt_qos;
+	uint8_t volatile dwt_override_qos;
+	uint64_t volatile dwt_callout_start;
+	dispatch_function_t volatile dwt_callout_function;
+	uint64_t dwt_callout_reported;
+	char dwt_callout_label[64];
+	struct dispatch_workq_thread_s *dwt_hash_next;
+} dispatch_workq_thread_s, *dispatch_workq_thread_t;
+
+void _dispatch_workq_override_start(uint32_t tid, uint32_t qos);
+void _dispatch_workq_override_reset(void);
+void _dispatch_workq_get_sched_stats(uint32_t qos,
+		dispatch_qos_sched_stats_t stats);
+
+extern bool _dispatch_workq_blocking_enabled;
+void _dispatch_workq_blocking_callout(void *ctxt, dispatch_function_t f);
+void _dispatch_workq_blocking_callout2(void *ctxt, size_t i,
+		void (*f)(void *, size_t));
+void _dispatch_workq_blocking_configure(uint64_t threshold,
+		dispatch_blocked_worker_flags_t flags, void *ctxt,
+		dispatch_blocked_worker_handler_t handler);
+#endif // HAVE_DISPATCH_WORKQ_SCHED
+
 #endif /* __DISPATCH_WORKQUEUE_INTERNAL__ */
 
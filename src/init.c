@@ -146,6 +146,8 @@ pthread_key_t dispatch_deferred_items_key;
 pthread_key_t dispatch_enqueue_key;
 pthread_key_t dispatch_msgv_aux_key;
 pthread_key_t dispatch_set_threadname_key;
+pthread_key_t dispatch_workq_thread_key;
+pthread_key_t dispatch_callout_profile_key;
 pthread_key_t os_workgroup_join_token_key;
 pthread_key_t os_workgroup_key;
 #endif // !DISPATCH_USE_DIRECT_TSD && !DISPATCH_USE_THREAD_LOCAL_STORAGE
@@ -1594,6 +1596,16 @@ DISPATCH_NOINLINE
 void
 _dispatch_client_callout(void *ctxt, dispatch_function_t f)
 {
+#if HAVE_DISPATCH_WORKQ_SCHED
+	if (unlikely(_dispatch_workq_blocking_enabled)) {
+		return _dispatch_workq_blocking_callout(ctxt, f);
+	}
+#endif
+#if DISPATCH_USE_CALLOUT_PROFILE
+	if (unlikely(_dispatch_callout_profile_enabled)) {
+		return _dispatch_callout_profile_callout(ctxt, f);
+	}
+#endif
 	_dispatch_get_tsd_base();
 	void *u = _dispatch_get_unwind_tsd();
 	if (likely(!u)) return f(ctxt);
@@ -1608,6 +1620,16 @@ DISPATCH_NOINLINE
 void
 _dispatch_client_callout2(void *ctxt, size_t i, void (*f)(void *, size_t))
 {
+#if HAVE_DISPATCH_WORKQ_SCHED
+	if (unlikely(_dispatch_workq_blocking_enabled)) {
+		return _dispatch_workq_blocking_callout2(ctxt, i, f);
+	}
+#endif
+#if DISPATCH_USE_CALLOUT_PROFILE
+	if (unlikely(_dispatch_callout_profile_enabled)) {
+		return _dispatch_callout_profile_callout2(ctxt, i, f);
+	}
+#endif
 	_dispatch_get_tsd_base();
 	void *u = _dispatch_get_unwind_tsd();
 	if (likely(!u)) return f(ctxt, i);
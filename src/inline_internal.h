@@ -589,6 +589,8 @@ _dispatch_wqthread_override_start(mach_port_t thread, dispatch_qos_t qos)
 	if (!_dispatch_set_qos_class_enabled) return;
 	(void)_pthread_workqueue_override_start_direct(thread,
 			_dispatch_qos_to_pp(qos));
+#elif HAVE_DISPATCH_WORKQ_SCHED
+	_dispatch_workq_override_start(thread, qos);
 #else
 	(void)thread; (void)qos;
 #endif
@@ -601,6 +603,8 @@ _dispatch_wqthread_override_reset(void)
 #if HAVE_PTHREAD_WORKQUEUE_QOS
 	if (!_dispatch_set_qos_class_enabled) return;
 	(void)_pthread_workqueue_override_reset();
+#elif HAVE_DISPATCH_WORKQ_SCHED
+	_dispatch_workq_override_reset();
 #endif
 }
 
@@ -2200,6 +2204,60 @@ _dispatch_set_pthread_root_queue_observer_hooks(
 			observer_hooks);
 }
 
+DISPATCH_ALWAYS_INLINE
+static inline dispatch_queue_sample_t
+_dispatch_queue_sample_slot(dispatch_queue_sample_t samples,
+		struct dispatch_object_s *dou)
+{
+	// items are at least cacheline aligned continuations or objects
+	uintptr_t hash = (uintptr_t)dou >> 6;
+	hash ^= hash >> 6;
+	return &samples[hash % DISPATCH_QUEUE_SAMPLES];
+}
+
+/*
+ * Records the enqueue time of an item if `sample` is true, this must happen
+ * before the item can be dequeued. Otherwise forgets the sample of an item
+ * that was never started at the same address (e.g. a discarded item).
+ */
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_queue_sample_push(dispatch_queue_sample_t samples,
+		struct dispatch_object_s *dou, bool sample)
+{
+	dispatch_queue_sample_t dqsm = _dispatch_queue_sample_slot(samples, dou);
+	struct dispatch_object_s *cur = os_atomic_load(&dqsm->dqsm_item, relaxed);
+
+	if (sample) {
+		if (cur == NULL || cur == dou) {
+			os_atomic_store(&dqsm->dqsm_time, _dispatch_uptime(), relaxed);
+			os_atomic_store(&dqsm->dqsm_item, dou, release);
+		}
+	} else if (unlikely(cur == dou)) {
+		os_atomic_cmpxchg(&dqsm->dqsm_item, dou, NULL, relaxed);
+	}
+}
+
+// Returns the enqueue time of an item about to start if it was sampled,
+// and 0 otherwise
+DISPATCH_ALWAYS_INLINE
+static inline uint64_t
+_dispatch_queue_sample_take(dispatch_queue_sample_t samples,
+		struct dispatch_object_s *dou)
+{
+	dispatch_queue_sample_t dqsm = _dispatch_queue_sample_slot(samples, dou);
+	uint64_t enqueued;
+
+	if (likely(os_atomic_load(&dqsm->dqsm_item, acquire) != dou)) {
+		return 0;
+	}
+	enqueued = os_atomic_load(&dqsm->dqsm_time, relaxed);
+	if (!os_atomic_cmpxchg(&dqsm->dqsm_item, dou, NULL, relaxed)) {
+		return 0;
+	}
+	return enqueued;
+}
+
 #pragma mark -
 #pragma mark dispatch_priority
 
@@ -2278,6 +2336,12 @@ _dispatch_reset_basepri_override(void)
 		_dispatch_thread_setspecific(dispatch_basepri_key, (void*)(uintptr_t)dbp);
 		return oqos != DISPATCH_QOS_SATURATED;
 	}
+#elif HAVE_DISPATCH_WORKQ_SCHED
+	// there is no basepri to reset, but workers boosted by
+	// _dispatch_workq_override_start() need to go back to their own QoS
+	dispatch_workq_thread_t dwt = (dispatch_workq_thread_t)
+			_dispatch_thread_getspecific(dispatch_workq_thread_key);
+	return dwt && os_atomic_load(&dwt->dwt_override_qos, relaxed);
 #endif
 	return false;
 }
@@ -2752,6 +2816,11 @@ _dispatch_continuation_invoke_inline(dispatch_object_t dou,
 		if (!(dc_flags & DC_FLAG_NO_INTROSPECTION)) {
 			_dispatch_trace_item_pop(dqu, dou);
 		}
+#if DISPATCH_USE_CALLOUT_PROFILE
+		if (unlikely(_dispatch_callout_profile_enabled)) {
+			_dispatch_callout_profile_invoke(dqu._dq, dc);
+		}
+#endif
 		if (dc_flags & DC_FLAG_CONSUME) {
 			dc1 = _dispatch_continuation_free_cacheonly(dc);
 		} else {
@@ -2772,12 +2841,11 @@ _dispatch_continuation_invoke_inline(dispatch_object_t dou,
 
 DISPATCH_ALWAYS_INLINE_NDEBUG
 static inline void
-_dispatch_continuation_pop_inline(dispatch_object_t dou,
+_dispatch_continuation_pop_observed_inline(dispatch_object_t dou,
 		dispatch_invoke_context_t dic, dispatch_invoke_flags_t flags,
-		dispatch_queue_class_t dqu)
+		dispatch_queue_class_t dqu,
+		dispatch_pthread_root_queue_observer_hooks_t observer_hooks)
 {
-	dispatch_pthread_root_queue_observer_hooks_t observer_hooks =
-			_dispatch_get_pthread_root_queue_observer_hooks();
 	if (observer_hooks) observer_hooks->queue_will_execute(dqu._dq);
 	flags &= _DISPATCH_INVOKE_PROPAGATE_MASK;
 	if (_dispatch_object_has_vtable(dou)) {
@@ -2793,6 +2861,16 @@ _dispatch_continuation_pop_inline(dispatch_object_t dou,
 	if (observer_hooks) observer_hooks->queue_did_execute(dqu._dq);
 }
 
+DISPATCH_ALWAYS_INLINE_NDEBUG
+static inline void
+_dispatch_continuation_pop_inline(dispatch_object_t dou,
+		dispatch_invoke_context_t dic, dispatch_invoke_flags_t flags,
+		dispatch_queue_class_t dqu)
+{
+	_dispatch_continuation_pop_observed_inline(dou, dic, flags, dqu,
+			_dispatch_get_pthread_root_queue_observer_hooks());
+}
+
 // used to forward the do_invoke of a continuation with a vtable to its real
 // implementation.
 //
@@ -2919,6 +2997,11 @@ _dispatch_continuation_async(dispatch_queue_class_t dqu,
 	}
 #else
 	(void)dc_flags;
+#endif
+#if DISPATCH_USE_CALLOUT_PROFILE
+	if (unlikely(_dispatch_callout_profile_enabled)) {
+		_dispatch_callout_profile_push(dqu._dq, dc);
+	}
 #endif
 	return dx_push(dqu._dq, dc, qos);
 }
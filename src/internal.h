@@ -257,6 +257,7 @@ upcast(dispatch_object_t dou)
 #include "io_private.h"
 #include "layout_private.h"
 #include "benchmark.h"
+#include "tracebuf_private.h"
 #include "private.h"
 
 #if HAVE_LIBKERN_OSCROSSENDIAN_H
@@ -463,9 +464,11 @@ DISPATCH_EXPORT DISPATCH_NOTHROW void dispatch_atfork_child(void);
 #if __GNUC__
 #define likely(x) __builtin_expect(!!(x), 1)
 #define unlikely(x) __builtin_expect(!!(x), 0)
+#define _dispatch_prefetch(addr) __builtin_prefetch(addr)
 #else
 #define likely(x) (!!(x))
 #define unlikely(x) (!!(x))
+#define _dispatch_prefetch(addr) ((void)(addr))
 #endif // __GNUC__
 
 #define _LIST_IS_ENQUEUED(elm, field) \
@@ -503,6 +506,7 @@ DISPATCH_EXPORT DISPATCH_NOTHROW void dispatch_atfork_child(void);
 #define DISPATCH_MODE_NO_FAULTS (1U << 1)
 #define DISPATCH_COOPERATIVE_POOL_STRICT (1U << 2)
 #define DISPATCH_MODE_VOUCHER_DYNAMIC    (1U << 3)
+#define DISPATCH_MODE_QUEUE_STATS        (1U << 4)
 extern uint8_t _dispatch_mode;
 
 DISPATCH_EXPORT DISPATCH_NOINLINE DISPATCH_COLD
@@ -816,7 +820,7 @@ _dispatch_fork_becomes_unsafe(void)
 #endif
 #endif // !defined(DISPATCH_USE_KEVENT_WORKLOOP)
 
-#ifdef EVFILT_MEMORYSTATUS
+#if defined(EVFILT_MEMORYSTATUS) && DISPATCH_EVENT_BACKEND_KEVENT
 #ifndef DISPATCH_USE_MEMORYSTATUS
 #define DISPATCH_USE_MEMORYSTATUS 1
 #endif
@@ -826,7 +830,8 @@ _dispatch_fork_becomes_unsafe(void)
 #undef DISPATCH_USE_MEMORYPRESSURE_SOURCE
 #define DISPATCH_USE_MEMORYPRESSURE_SOURCE 0
 #endif // TARGET_OS_SIMULATOR
-#if !defined(DISPATCH_USE_MEMORYPRESSURE_SOURCE) && DISPATCH_USE_MEMORYSTATUS
+#if !defined(DISPATCH_USE_MEMORYPRESSURE_SOURCE) && \
+		(DISPATCH_USE_MEMORYSTATUS || DISPATCH_EVENT_BACKEND_EPOLL)
 #define DISPATCH_USE_MEMORYPRESSURE_SOURCE 1
 #endif
 
@@ -885,6 +890,12 @@ extern "C++" {
 #endif
 #endif // DISPATCH_USE_DTRACE || DISPATCH_USE_DTRACE_INTROSPECTION
 
+// Without kdebug, events go to the per-CPU rings of trace_ring.c
+#if !defined(DISPATCH_USE_TRACE_RING) && defined(__linux__) && \
+		!__has_include(<sys/kdebug.h>)
+#define DISPATCH_USE_TRACE_RING 1
+#endif
+
 #if __has_include(<sys/kdebug.h>)
 #include <sys/kdebug.h>
 #ifndef DBG_DISPATCH
@@ -910,7 +921,24 @@ extern "C++" {
 		(DISPATCH_INTROSPECTION || DISPATCH_PROFILE || DISPATCH_DEBUG)
 #define DISPATCH_USE_VOUCHER_KDEBUG_TRACE 1
 #endif
+#elif DISPATCH_USE_TRACE_RING
+// same layout as KDBG_CODE(), so that libdispatch.codes applies
+#define DBG_DISPATCH 46
+#define DBG_FUNC_START 1u
+#define DBG_FUNC_END 2u
+#define DISPATCH_CODE(subclass, code) \
+		((uint32_t)DBG_DISPATCH << 24 | \
+		(uint32_t)DISPATCH_TRACE_SUBCLASS_##subclass << 16 | \
+		((uint32_t)(code) & 0x3fff) << 2)
+#define DISPATCH_CODE_START(subclass, code) \
+		(DISPATCH_CODE(subclass, code) | DBG_FUNC_START)
+#define DISPATCH_CODE_END(subclass, code) \
+		(DISPATCH_CODE(subclass, code) | DBG_FUNC_END)
+#define ARIADNE_ENTER_DISPATCH_MAIN_CODE 0
+#define DISPATCH_USE_VOUCHER_KDEBUG_TRACE 0
+#endif // DISPATCH_USE_TRACE_RING
 
+#if __has_include(<sys/kdebug.h>) || DISPATCH_USE_TRACE_RING
 #define DISPATCH_TRACE_SUBCLASS_DEFAULT 0
 #define DISPATCH_TRACE_SUBCLASS_VOUCHER 1
 #define DISPATCH_TRACE_SUBCLASS_PERF 2
@@ -918,6 +946,7 @@ extern "C++" {
 #define DISPATCH_TRACE_SUBCLASS_PERF_MON 4
 #define DISPATCH_TRACE_SUBCLASS_QOS_TRACE 5
 #define DISPATCH_TRACE_SUBCLASS_FIREHOSE_TRACE 6
+#define DISPATCH_TRACE_SUBCLASS_RUNTIME_TRACE 7
 
 #define DISPATCH_PERF_non_leaf_retarget DISPATCH_CODE(PERF, 1)
 #define DISPATCH_PERF_post_activate_retarget DISPATCH_CODE(PERF, 2)
@@ -961,6 +990,16 @@ extern "C++" {
 #define DISPATCH_FIREHOSE_TRACE_wait_for_logd DISPATCH_CODE(FIREHOSE_TRACE, 4)
 #define DISPATCH_FIREHOSE_TRACE_chunk_install DISPATCH_CODE(FIREHOSE_TRACE, 5)
 
+// codes are the values of enum dispatch_introspection_runtime_event
+#define DISPATCH_RUNTIME_TRACE(evt) \
+		DISPATCH_CODE(RUNTIME_TRACE, dispatch_introspection_runtime_event_##evt)
+#endif // __has_include(<sys/kdebug.h>) || DISPATCH_USE_TRACE_RING
+
+#define _dispatch_cast_to_uint64(e) \
+		__builtin_choose_expr(sizeof(e) > 4, \
+				((uint64_t)(e)), ((uint64_t)(uintptr_t)(e)))
+
+#if __has_include(<sys/kdebug.h>)
 DISPATCH_ALWAYS_INLINE
 static inline void
 _dispatch_ktrace_impl(uint32_t code, uint64_t a, uint64_t b,
@@ -972,19 +1011,35 @@ _dispatch_ktrace_impl(uint32_t code, uint64_t a, uint64_t b,
 #endif
 	kdebug_trace(code, a, b, c, d);
 }
-#define _dispatch_cast_to_uint64(e) \
-		__builtin_choose_expr(sizeof(e) > 4, \
-				((uint64_t)(e)), ((uint64_t)(uintptr_t)(e)))
 #define _dispatch_ktrace(code, a, b, c, d)  _dispatch_ktrace_impl(code, \
 		_dispatch_cast_to_uint64(a), _dispatch_cast_to_uint64(b), \
 		_dispatch_cast_to_uint64(c), _dispatch_cast_to_uint64(d))
 
-#else // __has_include(<sys/kdebug.h>)
+#elif DISPATCH_USE_TRACE_RING
+extern bool _dispatch_trace_ring_enabled;
+void _dispatch_trace_ring_init(void);
+void _dispatch_trace_ring_emit(uint32_t code, uint64_t a, uint64_t b,
+		uint64_t c, uint64_t d);
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_ktrace_impl(uint32_t code, uint64_t a, uint64_t b,
+		uint64_t c, uint64_t d)
+{
+	if (!code) return;
+	if (likely(!_dispatch_trace_ring_enabled)) return;
+	_dispatch_trace_ring_emit(code, a, b, c, d);
+}
+#define _dispatch_ktrace(code, a, b, c, d)  _dispatch_ktrace_impl(code, \
+		_dispatch_cast_to_uint64(a), _dispatch_cast_to_uint64(b), \
+		_dispatch_cast_to_uint64(c), _dispatch_cast_to_uint64(d))
+
+#else // __has_include(<sys/kdebug.h>) || DISPATCH_USE_TRACE_RING
 #define DISPATCH_CODE(subclass, code) 0
 #define ARIADNE_ENTER_DISPATCH_MAIN_CODE 0
 #define DISPATCH_USE_VOUCHER_KDEBUG_TRACE 0
 #define _dispatch_ktrace(code, a, b, c, d)
-#endif // !__has_include(<sys/kdebug.h>)
+#endif // !__has_include(<sys/kdebug.h>) && !DISPATCH_USE_TRACE_RING
 #define _dispatch_ktrace4(code, a, b, c, d) _dispatch_ktrace(code, a, b, c, d)
 #define _dispatch_ktrace3(code, a, b, c)    _dispatch_ktrace(code, a, b, c, 0)
 #define _dispatch_ktrace2(code, a, b)       _dispatch_ktrace(code, a, b, 0, 0)
@@ -1204,6 +1259,7 @@ extern bool _dispatch_thread_bound_kqwl_enabled;
 #include "voucher_internal.h"
 #include "data_internal.h"
 #include "io_internal.h"
+#include "callout_profile_internal.h"
 #include "inline_internal.h"
 #include "firehose/firehose_internal.h"
 
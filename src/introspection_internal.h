@@ -33,6 +33,7 @@ enum dispatch_introspection_runtime_event {
 	dispatch_introspection_runtime_event_worker_unpark = 2,
 	dispatch_introspection_runtime_event_worker_request = 3,
 	dispatch_introspection_runtime_event_worker_park = 4,
+	dispatch_introspection_runtime_event_worker_wakeup = 5,
 
 	dispatch_introspection_runtime_event_sync_wait = 10,
 	dispatch_introspection_runtime_event_async_sync_handoff = 11,
@@ -40,12 +41,13 @@ enum dispatch_introspection_runtime_event {
 	dispatch_introspection_runtime_event_sync_async_handoff = 13,
 };
 
-#if DISPATCH_INTROSPECTION
-
+// flags of the continuation push events of the QOS_TRACE ktrace subclass
 #define DC_BARRIER 0x1
 #define DC_SYNC 0x2
 #define DC_APPLY 0x4
 
+#if DISPATCH_INTROSPECTION
+
 typedef struct dispatch_queue_introspection_context_s {
 	dispatch_queue_class_t dqic_queue;
 	dispatch_function_t dqic_finalizer;
@@ -39,6 +39,11 @@ static void _dispatch_workloop_drain_barrier_waiter(dispatch_workloop_t dwl,
 static inline bool
 _dispatch_async_and_wait_should_always_async(dispatch_queue_class_t dqu,
 		uint64_t dq_state);
+static void _dispatch_queue_init_specific(dispatch_queue_t dq);
+static inline bool _dispatch_lane_is_bounded(dispatch_lane_t dq);
+static uintptr_t _dispatch_lane_bounded_async_reserve(dispatch_lane_t dq);
+static inline void _dispatch_lane_bounded_release(dispatch_lane_t dq,
+		dispatch_object_t dou);
 
 #if DISPATCH_SUPPORTS_THREAD_BOUND_KQWL
 static inline void _dispatch_workloop_bound_thread_init(void);
@@ -803,6 +808,9 @@ dispatch_barrier_async_f(dispatch_queue_t dq, void *ctxt,
 	uintptr_t dc_flags = DC_FLAG_CONSUME | DC_FLAG_BARRIER;
 	dispatch_qos_t qos;
 
+	if (unlikely(_dispatch_lane_is_bounded(upcast(dq)._dl))) {
+		dc_flags |= _dispatch_lane_bounded_async_reserve(upcast(dq)._dl);
+	}
 	if (likely(!dc)) {
 		return _dispatch_async_f_slow(dq, ctxt, func, 0, dc_flags);
 	}
@@ -834,11 +842,162 @@ dispatch_barrier_async(dispatch_queue_t dq, dispatch_block_t work)
 	uintptr_t dc_flags = DC_FLAG_CONSUME | DC_FLAG_BARRIER;
 	dispatch_qos_t qos;
 
+	if (unlikely(_dispatch_lane_is_bounded(upcast(dq)._dl))) {
+		dc_flags |= _dispatch_lane_bounded_async_reserve(upcast(dq)._dl);
+	}
 	qos = _dispatch_continuation_init(dc, dq, work, 0, dc_flags);
 	_dispatch_continuation_async(dq, dc, qos, dc_flags);
 }
 #endif
 
+#pragma mark -
+#pragma mark dispatch_lane_stats
+
+// all the statistics that are enabled, see dispatch_queue_stats_apply_f()
+static TAILQ_HEAD(, dispatch_lane_stats_s) _dispatch_lane_stats_list =
+		TAILQ_HEAD_INITIALIZER(_dispatch_lane_stats_list);
+static uint32_t _dispatch_lane_stats_count;
+static dispatch_unfair_lock_s _dispatch_lane_stats_lock;
+
+DISPATCH_ALWAYS_INLINE
+static inline dispatch_lane_stats_t
+_dispatch_lane_get_stats(dispatch_lane_t dq)
+{
+	dispatch_queue_specific_head_t dqsh;
+
+	// sources and channels drain like lanes but dq_specific_head aliases
+	// their ds_refs
+	if (dx_metatype(dq) != _DISPATCH_LANE_TYPE) {
+		return NULL;
+	}
+	dqsh = os_atomic_load(&dq->dq_specific_head, acquire);
+	return dqsh ? os_atomic_load(&dqsh->dqsh_stats, acquire) : NULL;
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline dispatch_lane_stats_slot_t
+_dispatch_lane_stats_slot(dispatch_lane_stats_t dls)
+{
+	unsigned int idx;
+#if defined(__linux__)
+	int cpu = sched_getcpu();
+	idx = likely(cpu >= 0) ? (unsigned int)cpu : _dispatch_tid_self();
+#else
+	idx = _dispatch_tid_self();
+#endif
+	return &dls->dls_slots[idx % dls->dls_nslots];
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_lane_stats_histogram_record(uint64_t volatile *histogram,
+		uint64_t start, uint64_t end)
+{
+	uint64_t ns = _dispatch_time_mach2nano(end > start ? end - start : 0);
+	unsigned int bucket = 0;
+
+	if (ns >= 1024) {
+		bucket = (unsigned int)(63 - __builtin_clzll(ns)) - 9;
+		bucket = MIN(bucket, DISPATCH_QUEUE_STATS_HISTOGRAM_BUCKETS - 1u);
+	}
+	os_atomic_inc(&histogram[bucket], relaxed);
+}
+
+/*
+ * Accounts for an item about to be pushed onto a lane with statistics
+ * enabled, this must happen before the item can be dequeued.
+ *
+ * One item in DISPATCH_LANE_STATS_SAMPLE_INTERVAL gets its enqueue time
+ * recorded for the latency histogram.
+ */
+DISPATCH_NOINLINE
+static void
+_dispatch_lane_stats_push(dispatch_lane_stats_t dls,
+		struct dispatch_object_s *dou)
+{
+	dispatch_lane_stats_slot_t slot = _dispatch_lane_stats_slot(dls);
+	uint64_t n;
+
+	n = os_atomic_inc_orig(&slot->dlss_enqueued, relaxed);
+	_dispatch_queue_sample_push(dls->dls_samples, dou,
+			n % DISPATCH_LANE_STATS_SAMPLE_INTERVAL == 0);
+}
+
+/*
+ * Accounts for an item of a lane with statistics enabled that is about to
+ * start executing, returns the start time if its execution should be timed,
+ * and 0 otherwise.
+ */
+DISPATCH_NOINLINE
+static uint64_t
+_dispatch_lane_stats_item_start(dispatch_lane_stats_t dls,
+		struct dispatch_object_s *dou)
+{
+	dispatch_lane_stats_slot_t slot = _dispatch_lane_stats_slot(dls);
+	uint64_t n, enqueued, now = 0;
+
+	n = os_atomic_inc_orig(&slot->dlss_dequeued, relaxed);
+	enqueued = _dispatch_queue_sample_take(dls->dls_samples, dou);
+	if (unlikely(enqueued)) {
+		now = _dispatch_uptime();
+		_dispatch_lane_stats_histogram_record(dls->dls_latency, enqueued, now);
+	}
+	if (n % DISPATCH_LANE_STATS_SAMPLE_INTERVAL == 0) {
+		return now ?: _dispatch_uptime();
+	}
+	return 0;
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_lane_stats_item_end(dispatch_lane_stats_t dls, uint64_t start)
+{
+	if (start) {
+		_dispatch_lane_stats_histogram_record(dls->dls_execution, start,
+				_dispatch_uptime());
+	}
+}
+
+DISPATCH_NOINLINE
+static void
+_dispatch_lane_stats_push_list(dispatch_lane_stats_t dls,
+		struct dispatch_object_s *head, struct dispatch_object_s *tail)
+{
+	for (struct dispatch_object_s *dou = head; ; dou = dou->do_next) {
+		_dispatch_lane_stats_push(dls, dou);
+		if (dou == tail) break;
+	}
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_lane_stats_wakeup(dispatch_lane_stats_t dls)
+{
+	os_atomic_inc(&_dispatch_lane_stats_slot(dls)->dlss_wakeups, relaxed);
+}
+
+// Accounts for an item that left a lane with statistics enabled without
+// being executed, see _dispatch_lane_bounded_drop()
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_lane_stats_item_discard(dispatch_lane_t dq)
+{
+	dispatch_lane_stats_t dls = _dispatch_lane_get_stats(dq);
+	if (unlikely(dls)) {
+		os_atomic_inc(&_dispatch_lane_stats_slot(dls)->dlss_dequeued, relaxed);
+	}
+}
+
+static void
+_dispatch_lane_stats_dispose(dispatch_lane_stats_t dls)
+{
+	_dispatch_unfair_lock_lock(&_dispatch_lane_stats_lock);
+	TAILQ_REMOVE(&_dispatch_lane_stats_list, dls, dls_list);
+	_dispatch_lane_stats_count--;
+	_dispatch_unfair_lock_unlock(&_dispatch_lane_stats_lock);
+	free(dls);
+}
+
 #pragma mark -
 #pragma mark dispatch_async
 
@@ -870,8 +1029,16 @@ _dispatch_async_redirect_invoke(dispatch_continuation_t dc,
 
 	uintptr_t dc_flags = DC_FLAG_CONSUME | DC_FLAG_NO_INTROSPECTION;
 	_dispatch_thread_frame_push(&dtf, dq);
+	dispatch_lane_stats_t dls = _dispatch_lane_get_stats(dq);
 	_dispatch_continuation_pop_forwarded(dc, dc_flags, NULL, {
-		_dispatch_continuation_pop(other_dc, dic, flags, dq);
+		if (unlikely(dls)) {
+			uint64_t start = _dispatch_lane_stats_item_start(dls,
+					(struct dispatch_object_s *)other_dc);
+			_dispatch_continuation_pop(other_dc, dic, flags, dq);
+			_dispatch_lane_stats_item_end(dls, start);
+		} else {
+			_dispatch_continuation_pop(other_dc, dic, flags, dq);
+		}
 	});
 	_dispatch_thread_frame_pop(&dtf);
 	if (assumed_rq) _dispatch_queue_set_current(old_dq);
@@ -934,6 +1101,9 @@ _dispatch_async_f(dispatch_queue_t dq, void *ctxt, dispatch_function_t func,
 	uintptr_t dc_flags = DC_FLAG_CONSUME;
 	dispatch_qos_t qos;
 
+	if (unlikely(_dispatch_lane_is_bounded(upcast(dq)._dl))) {
+		dc_flags |= _dispatch_lane_bounded_async_reserve(upcast(dq)._dl);
+	}
 	if (unlikely(!dc)) {
 		return _dispatch_async_f_slow(dq, ctxt, func, flags, dc_flags);
 	}
@@ -965,11 +1135,71 @@ dispatch_async(dispatch_queue_t dq, dispatch_block_t work)
 	uintptr_t dc_flags = DC_FLAG_CONSUME;
 	dispatch_qos_t qos;
 
+	if (unlikely(_dispatch_lane_is_bounded(upcast(dq)._dl))) {
+		dc_flags |= _dispatch_lane_bounded_async_reserve(upcast(dq)._dl);
+	}
 	qos = _dispatch_continuation_init(dc, dq, work, 0, dc_flags);
 	_dispatch_continuation_async(dq, dc, qos, dc->dc_flags);
 }
 #endif
 
+#pragma mark -
+#pragma mark dispatch_lane_readers
+
+// After a barrier had to wait for readers for some time, readers use the
+// regular dispatch_sync() path for this many times as long, so that a steady
+// stream of readers doesn't starve writers.
+#define DISPATCH_LANE_READERS_INHIBIT_FACTOR 9
+#define DISPATCH_LANE_READERS_MAX_SLOTS 256
+
+DISPATCH_ALWAYS_INLINE
+static inline dispatch_lane_readers_t
+_dispatch_lane_get_readers(dispatch_lane_t dq)
+{
+	dispatch_queue_specific_head_t dqsh;
+
+	dqsh = os_atomic_load(&dq->dq_specific_head, acquire);
+	return dqsh ? os_atomic_load(&dqsh->dqsh_readers, acquire) : NULL;
+}
+
+DISPATCH_NOINLINE
+static void
+_dispatch_lane_readers_wait(dispatch_lane_readers_t dlr)
+{
+	uint64_t start, now;
+
+	os_atomic_store(&dlr->dlr_bias, 0, relaxed);
+	// pairs with the fence in dispatch_read_sync_f(): either the reader sees
+	// the bias is off, or we see it in its slot and wait for it
+	os_atomic_thread_fence(seq_cst);
+
+	start = _dispatch_uptime();
+	for (uint32_t i = 0; i < dlr->dlr_nslots; i++) {
+		dispatch_lane_reader_slot_t slot = &dlr->dlr_slots[i];
+		_dispatch_wait_until(os_atomic_load(&slot->dlrs_count, acquire) == 0);
+	}
+	now = _dispatch_uptime();
+	if (now > start) {
+		os_atomic_store(&dlr->dlr_inhibit_until,
+				now + DISPATCH_LANE_READERS_INHIBIT_FACTOR * (now - start),
+				relaxed);
+	}
+}
+
+// Must be called by a barrier owning a concurrent queue before it runs any
+// client code, to let fast path readers out.
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_lane_barrier_wait_for_readers(dispatch_lane_t dq)
+{
+	if (unlikely(dq->dq_width > 1)) {
+		dispatch_lane_readers_t dlr = _dispatch_lane_get_readers(dq);
+		if (unlikely(dlr)) {
+			_dispatch_lane_readers_wait(dlr);
+		}
+	}
+}
+
 #pragma mark -
 #pragma mark _dispatch_sync_invoke / _dispatch_sync_complete
 
@@ -1101,6 +1331,9 @@ _dispatch_sync_invoke_and_complete_recurse(dispatch_queue_class_t dq,
 		void *ctxt, dispatch_function_t func, uintptr_t dc_flags
 		DISPATCH_TRACE_ARG(void *dc))
 {
+	if (dc_flags & DC_FLAG_BARRIER) {
+		_dispatch_lane_barrier_wait_for_readers(dq._dl);
+	}
 	_dispatch_sync_function_invoke_inline(dq, ctxt, func);
 	_dispatch_trace_item_complete(dc);
 	_dispatch_sync_complete_recurse(dq._dq, NULL, dc_flags);
@@ -1125,6 +1358,7 @@ static void
 _dispatch_lane_barrier_sync_invoke_and_complete(dispatch_lane_t dq,
 		void *ctxt, dispatch_function_t func DISPATCH_TRACE_ARG(void *dc))
 {
+	_dispatch_lane_barrier_wait_for_readers(dq);
 	_dispatch_sync_function_invoke_inline(dq, ctxt, func);
 	_dispatch_trace_item_complete(dc);
 	if (unlikely(dq->dq_items_tail || dq->dq_width > 1)) {
@@ -1529,6 +1763,10 @@ _dispatch_lane_drain_non_barriers(dispatch_lane_t dq,
 		if (_dispatch_object_is_waiter(dc)) {
 			_dispatch_non_barrier_waiter_redirect_or_wake(dq, dc);
 		} else {
+			if (unlikely(_dispatch_lane_is_bounded(dq))) {
+				// redirected items are never dropped, they run
+				_dispatch_lane_bounded_release(dq, dc);
+			}
 			_dispatch_continuation_redirect_push(dq, dc,
 					_dispatch_queue_max_qos(dq));
 		}
@@ -1718,6 +1956,15 @@ __DISPATCH_WAIT_FOR_QUEUE__(dispatch_sync_context_t dsc, dispatch_queue_t dq)
 		_dispatch_thread_event_init(&dsc->dsc_event);
 	}
 
+	struct dispatch_sync_waiter_s dsw = {
+		.dsw_kind = DISPATCH_WAIT_SYNC,
+		.dsw_queue = dq,
+		.dsw_top_queue = dsc->dc_other,
+		.dsw_tid = dsc->dsc_waiter,
+		.dsw_start = _dispatch_uptime(),
+	};
+	_dispatch_sync_waiter_register(&dsw);
+
 	_dispatch_set_current_dsc((void *) dsc);
 	dx_push(dq, dsc, _dispatch_qos_from_pp(dsc->dc_priority));
 
@@ -1729,6 +1976,7 @@ __DISPATCH_WAIT_FOR_QUEUE__(dispatch_sync_context_t dsc, dispatch_queue_t dq)
 	}
 
 	_dispatch_clear_current_dsc();
+	_dispatch_sync_waiter_unregister(&dsw);
 
 	if (dsc->dc_data == DISPATCH_WLH_ANON) {
 		_dispatch_thread_event_destroy(&dsc->dsc_event);
@@ -1864,6 +2112,62 @@ _dispatch_sync_recurse(dispatch_lane_t dq, void *ctxt,
 					dq, ctxt, func, dc_flags)));
 }
 
+#if !DISPATCH_USE_KEVENT_WORKLOOP && !DISPATCH_HW_CONFIG_UP
+#define DISPATCH_USE_SYNC_SPIN 1
+#else
+#define DISPATCH_USE_SYNC_SPIN 0
+#endif
+
+#if DISPATCH_USE_SYNC_SPIN
+/*
+ * Without workloops, a dispatch_sync() that finds the queue locked has to
+ * prepare a thread event, push itself on the queue and block until the owner
+ * hands the queue over.
+ *
+ * When the owner is itself a dispatch_sync() and nothing is enqueued, it is
+ * very likely to be done within a few hundred cycles, so spin for a bit first
+ * like an adaptive mutex would. We stop as soon as the queue is owned by a
+ * drainer or has items (including other sync waiters) to not jump ahead of
+ * them.
+ */
+DISPATCH_NOINLINE
+static void
+_dispatch_barrier_sync_f_contended(dispatch_lane_t dl, void *ctxt,
+		dispatch_function_t func, uintptr_t dc_flags, dispatch_tid tid)
+{
+	uint64_t init = DISPATCH_QUEUE_STATE_INIT_VALUE(dl->dq_width);
+	unsigned int spins = _dispatch_contention_spins();
+	uint64_t dq_state;
+
+	for (;;) {
+		dq_state = os_atomic_load(&dl->dq_state, relaxed);
+		if ((dq_state & ~DISPATCH_QUEUE_ROLE_MASK) == init) {
+			if (_dispatch_queue_try_acquire_barrier_sync(dl, tid)) {
+				break;
+			}
+		} else if (!_dq_state_in_uncontended_sync(dq_state) ||
+				_dq_state_drain_locked_by(dq_state, tid) ||
+				os_atomic_load(&dl->dq_items_tail, relaxed)) {
+			spins = 0;
+		}
+		if (spins-- == 0) {
+			return _dispatch_sync_f_slow(dl, ctxt, func, DC_FLAG_BARRIER, dl,
+					DC_FLAG_BARRIER | dc_flags);
+		}
+		dispatch_hardware_pause();
+	}
+
+	if (unlikely(dl->do_targetq->do_targetq)) {
+		return _dispatch_sync_recurse(dl, ctxt, func,
+				DC_FLAG_BARRIER | dc_flags);
+	}
+	_dispatch_introspection_sync_begin(dl);
+	_dispatch_lane_barrier_sync_invoke_and_complete(dl, ctxt, func
+			DISPATCH_TRACE_ARG(_dispatch_trace_item_sync_push_pop(
+					dl, ctxt, func, dc_flags | DC_FLAG_BARRIER)));
+}
+#endif // DISPATCH_USE_SYNC_SPIN
+
 DISPATCH_ALWAYS_INLINE
 static inline void
 _dispatch_barrier_sync_f_inline(dispatch_queue_t dq, void *ctxt,
@@ -1886,8 +2190,13 @@ _dispatch_barrier_sync_f_inline(dispatch_queue_t dq, void *ctxt,
 	// Global concurrent queues and queues bound to non-dispatch threads
 	// always fall into the slow case, see DISPATCH_ROOT_QUEUE_STATE_INIT_VALUE
 	if (unlikely(!_dispatch_queue_try_acquire_barrier_sync(dl, tid))) {
+#if DISPATCH_USE_SYNC_SPIN
+		return _dispatch_barrier_sync_f_contended(dl, ctxt, func, dc_flags,
+				tid);
+#else
 		return _dispatch_sync_f_slow(dl, ctxt, func, DC_FLAG_BARRIER, dl,
 				DC_FLAG_BARRIER | dc_flags);
+#endif
 	}
 
 	if (unlikely(dl->do_targetq->do_targetq)) {
@@ -2018,6 +2327,139 @@ dispatch_sync(dispatch_queue_t dq, dispatch_block_t work)
 }
 #endif // __BLOCKS__
 
+#pragma mark -
+#pragma mark dispatch_read_sync
+
+DISPATCH_NOINLINE
+static dispatch_lane_readers_t
+_dispatch_lane_init_readers(dispatch_lane_t dq)
+{
+	dispatch_queue_specific_head_t dqsh;
+	dispatch_lane_readers_t dlr;
+	uint32_t nslots = MIN(dispatch_hw_config(logical_cpus),
+			DISPATCH_LANE_READERS_MAX_SLOTS);
+
+	if (!dq->dq_specific_head) {
+		_dispatch_queue_init_specific(dq->_as_dq);
+	}
+	dqsh = dq->dq_specific_head;
+
+	dlr = _dispatch_calloc(1, sizeof(struct dispatch_lane_readers_s) +
+			nslots * sizeof(struct dispatch_lane_reader_slot_s));
+	dlr->dlr_nslots = nslots;
+	dlr->dlr_bias = 1;
+	if (unlikely(!os_atomic_cmpxchg(&dqsh->dqsh_readers, NULL, dlr, release))) {
+		free(dlr);
+		dlr = os_atomic_load(&dqsh->dqsh_readers, acquire);
+	}
+	return dlr;
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline dispatch_lane_reader_slot_t
+_dispatch_lane_reader_slot(dispatch_lane_readers_t dlr)
+{
+	unsigned int idx;
+#if defined(__linux__)
+	int cpu = sched_getcpu();
+	idx = likely(cpu >= 0) ? (unsigned int)cpu : _dispatch_tid_self();
+#else
+	idx = _dispatch_tid_self();
+#endif
+	return &dlr->dlr_slots[idx % dlr->dlr_nslots];
+}
+
+typedef struct dispatch_read_sync_context_s {
+	dispatch_lane_readers_t drsc_readers;
+	void *drsc_ctxt;
+	dispatch_function_t drsc_func;
+} *dispatch_read_sync_context_t;
+
+static void
+_dispatch_read_sync_slow_invoke(void *ctxt)
+{
+	dispatch_read_sync_context_t drsc = ctxt;
+	dispatch_lane_readers_t dlr = drsc->drsc_readers;
+
+	// We hold width in the queue, so no barrier is running, and any barrier
+	// that runs after us will turn the bias off and wait for fast readers.
+	if (!os_atomic_load(&dlr->dlr_bias, relaxed) && _dispatch_uptime() >=
+			os_atomic_load(&dlr->dlr_inhibit_until, relaxed)) {
+		os_atomic_store(&dlr->dlr_bias, 1, relaxed);
+	}
+	drsc->drsc_func(drsc->drsc_ctxt);
+}
+
+DISPATCH_NOINLINE
+static void
+_dispatch_read_sync_f_slow(dispatch_lane_t dq, dispatch_lane_readers_t dlr,
+		void *ctxt, dispatch_function_t func)
+{
+	struct dispatch_read_sync_context_s drsc = {
+		.drsc_readers = dlr,
+		.drsc_ctxt = ctxt,
+		.drsc_func = func,
+	};
+	_dispatch_sync_f(dq->_as_dq, &drsc, _dispatch_read_sync_slow_invoke, 0);
+}
+
+/*
+ * Fast path readers never touch dq_state: they register in a per-CPU slot of
+ * the queue reader indicator, and barriers turn the bias off and wait for
+ * all slots to drain before they execute (see
+ * _dispatch_lane_barrier_wait_for_readers()).
+ *
+ * Readers only take the fast path when the queue has no pending items, so
+ * that a read issued after a barrier was submitted still observes its effects,
+ * and is not suspended.
+ */
+DISPATCH_NOINLINE
+void
+dispatch_read_sync_f(dispatch_queue_t dq, void *ctxt,
+		dispatch_function_t func)
+{
+	dispatch_lane_t dl = upcast(dq)._dl;
+	dispatch_lane_readers_t dlr;
+	dispatch_lane_reader_slot_t slot;
+
+	if (unlikely(dx_type(dq) != DISPATCH_QUEUE_CONCURRENT_TYPE ||
+			dq->dq_width == 1 || dq->do_targetq->do_targetq ||
+			!_dispatch_queue_supports_sync(dq))) {
+		return dispatch_sync_f(dq, ctxt, func);
+	}
+
+	dlr = _dispatch_lane_get_readers(dl);
+	if (unlikely(!dlr)) {
+		dlr = _dispatch_lane_init_readers(dl);
+	}
+	if (unlikely(!os_atomic_load(&dlr->dlr_bias, relaxed))) {
+		return _dispatch_read_sync_f_slow(dl, dlr, ctxt, func);
+	}
+
+	slot = _dispatch_lane_reader_slot(dlr);
+	os_atomic_inc(&slot->dlrs_count, relaxed);
+	// pairs with the fence in _dispatch_lane_readers_wait()
+	os_atomic_thread_fence(seq_cst);
+	if (unlikely(!os_atomic_load(&dlr->dlr_bias, relaxed) ||
+			os_atomic_load(&dl->dq_items_tail, relaxed) ||
+			_dq_state_is_suspended(os_atomic_load(&dl->dq_state, relaxed)))) {
+		os_atomic_dec(&slot->dlrs_count, release);
+		return _dispatch_read_sync_f_slow(dl, dlr, ctxt, func);
+	}
+
+	_dispatch_introspection_sync_begin(dl);
+	_dispatch_sync_function_invoke(dl, ctxt, func);
+	os_atomic_dec(&slot->dlrs_count, release);
+}
+
+#ifdef __BLOCKS__
+void
+dispatch_read_sync(dispatch_queue_t dq, dispatch_block_t work)
+{
+	dispatch_read_sync_f(dq, work, _dispatch_Block_invoke(work));
+}
+#endif // __BLOCKS__
+
 #pragma mark -
 #pragma mark dispatch_async_and_wait
 
@@ -2051,6 +2493,10 @@ _dispatch_async_and_wait_invoke_and_complete_recurse(dispatch_queue_t dq,
 	dispatch_invoke_flags_t iflags;
 	dispatch_wlh_t old_wlh = _dispatch_fake_wlh(bottom_q);
 
+	if (top_dc_flags & DC_FLAG_BARRIER) {
+		_dispatch_lane_barrier_wait_for_readers(upcast(dq)._dl);
+	}
+
 	iflags = dsc->dsc_autorelease * DISPATCH_INVOKE_AUTORELEASE_ALWAYS;
 	dispatch_invoke_with_autoreleasepool(iflags, {
 		dispatch_block_flags_t bflags = DISPATCH_BLOCK_HAS_PRIORITY;
@@ -2349,6 +2795,24 @@ _dispatch_queue_specific_head_dispose(dispatch_queue_specific_head_t dqsh)
 	TAILQ_HEAD(, dispatch_queue_specific_s) entries =
 			TAILQ_HEAD_INITIALIZER(entries);
 
+	// pending coalesced work items hold a reference on the queue,
+	// so the table is empty by now
+	free(dqsh->dqsh_coalesced);
+	dqsh->dqsh_coalesced = NULL;
+	free(dqsh->dqsh_readers);
+	dqsh->dqsh_readers = NULL;
+	if (dqsh->dqsh_bounded) {
+		_dispatch_sema4_dispose(&dqsh->dqsh_bounded->dqb_sema,
+				_DSEMA4_POLICY_FIFO);
+		free(dqsh->dqsh_bounded);
+		dqsh->dqsh_bounded = NULL;
+	}
+	if (dqsh->dqsh_stats) {
+		_dispatch_lane_stats_dispose(dqsh->dqsh_stats);
+		dqsh->dqsh_stats = NULL;
+	}
+	free(dqsh->dqsh_callout_samples);
+	dqsh->dqsh_callout_samples = NULL;
 	TAILQ_CONCAT(&entries, &dqsh->dqsh_entries, dqs_entry);
 	TAILQ_FOREACH_SAFE(dqs, &entries, dqs_entry, tmp) {
 		if (dqs->dqs_destructor) {
@@ -2385,117 +2849,675 @@ static inline dispatch_queue_specific_t
 _dispatch_queue_specific_find(dispatch_queue_specific_head_t dqsh,
 		const void *key)
 {
-	dispatch_queue_specific_t dqs;
+	dispatch_queue_specific_t dqs;
+
+	TAILQ_FOREACH(dqs, &dqsh->dqsh_entries, dqs_entry) {
+		if (dqs->dqs_key == key) {
+			return dqs;
+		}
+	}
+	return NULL;
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline bool
+_dispatch_queue_admits_specific(dispatch_queue_t dq)
+{
+	if (dx_metatype(dq) == _DISPATCH_LANE_TYPE) {
+		return (dx_type(dq) == DISPATCH_QUEUE_MAIN_TYPE ||
+			!dx_hastypeflag(dq, QUEUE_BASE));
+	}
+	return dx_metatype(dq) == _DISPATCH_WORKLOOP_TYPE;
+}
+
+DISPATCH_NOINLINE
+void
+dispatch_queue_set_specific(dispatch_queue_t dq, const void *key,
+	void *ctxt, dispatch_function_t destructor)
+{
+	if (unlikely(!key)) {
+		return;
+	}
+	dispatch_queue_t rq = _dispatch_get_default_queue(false);
+	dispatch_queue_specific_head_t dqsh = dq->dq_specific_head;
+	dispatch_queue_specific_t dqs;
+
+	if (unlikely(!_dispatch_queue_admits_specific(dq))) {
+		DISPATCH_CLIENT_CRASH(0,
+				"Queue doesn't support dispatch_queue_set_specific");
+	}
+
+	if (ctxt && !dqsh) {
+		_dispatch_queue_init_specific(dq);
+		dqsh = dq->dq_specific_head;
+	} else if (!dqsh) {
+		return;
+	}
+
+	_dispatch_unfair_lock_lock(&dqsh->dqsh_lock);
+	dqs = _dispatch_queue_specific_find(dqsh, key);
+	if (dqs) {
+		if (dqs->dqs_destructor) {
+			_dispatch_barrier_async_detached_f(rq, dqs->dqs_ctxt,
+					dqs->dqs_destructor);
+		}
+		if (ctxt) {
+			dqs->dqs_ctxt = ctxt;
+			dqs->dqs_destructor = destructor;
+		} else {
+			TAILQ_REMOVE(&dqsh->dqsh_entries, dqs, dqs_entry);
+			free(dqs);
+		}
+	} else if (ctxt) {
+		dqs = _dispatch_calloc(1, sizeof(struct dispatch_queue_specific_s));
+		dqs->dqs_key = key;
+		dqs->dqs_ctxt = ctxt;
+		dqs->dqs_destructor = destructor;
+		TAILQ_INSERT_TAIL(&dqsh->dqsh_entries, dqs, dqs_entry);
+	}
+
+	_dispatch_unfair_lock_unlock(&dqsh->dqsh_lock);
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline void *
+_dispatch_queue_get_specific_inline(dispatch_queue_t dq, const void *key)
+{
+	dispatch_queue_specific_head_t dqsh = dq->dq_specific_head;
+	dispatch_queue_specific_t dqs;
+	void *ctxt = NULL;
+
+	if (likely(_dispatch_queue_admits_specific(dq) && dqsh)) {
+		_dispatch_unfair_lock_lock(&dqsh->dqsh_lock);
+		dqs = _dispatch_queue_specific_find(dqsh, key);
+		if (dqs) ctxt = dqs->dqs_ctxt;
+		_dispatch_unfair_lock_unlock(&dqsh->dqsh_lock);
+	}
+	return ctxt;
+}
+
+DISPATCH_NOINLINE
+void *
+dispatch_queue_get_specific(dispatch_queue_t dq, const void *key)
+{
+	if (unlikely(!key)) {
+		return NULL;
+	}
+	return _dispatch_queue_get_specific_inline(dq, key);
+}
+
+DISPATCH_NOINLINE
+void *
+dispatch_get_specific(const void *key)
+{
+	dispatch_queue_t dq = _dispatch_queue_get_current();
+	void *ctxt = NULL;
+
+	if (likely(key && dq)) {
+		do {
+			ctxt = _dispatch_queue_get_specific_inline(dq, key);
+			dq = dq->do_targetq;
+		} while (unlikely(ctxt == NULL && dq));
+	}
+	return ctxt;
+}
+
+#pragma mark -
+#pragma mark dispatch_lane_bounded
+
+DISPATCH_ALWAYS_INLINE
+static inline dispatch_lane_bounded_t
+_dispatch_lane_get_bounded(dispatch_lane_t dq)
+{
+	return dq->dq_specific_head->dqsh_bounded;
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline bool
+_dispatch_lane_is_bounded(dispatch_lane_t dq)
+{
+	return _dispatch_queue_atomic_flags(dq) & DQF_BOUNDED;
+}
+
+// Submitting to the queue from one of its own work items must not wait for
+// the queue to drain
+DISPATCH_ALWAYS_INLINE
+static inline bool
+_dispatch_lane_bounded_is_reentrant(dispatch_lane_t dq)
+{
+	uint64_t dq_state = os_atomic_load(&dq->dq_state, relaxed);
+	return _dq_state_drain_locked_by_self(dq_state) ||
+			_dispatch_queue_get_current() == dq->_as_dq;
+}
+
+DISPATCH_NOINLINE
+static bool
+_dispatch_lane_bounded_reserve_slow(dispatch_lane_t dq,
+		dispatch_lane_bounded_t dqb, bool wait)
+{
+	// undo the optimistic increment of _dispatch_lane_bounded_reserve()
+	os_atomic_dec(&dqb->dqb_pending, relaxed);
+	if (!wait) {
+		return false;
+	}
+	if (unlikely(_dispatch_lane_bounded_is_reentrant(dq))) {
+		os_atomic_inc(&dqb->dqb_pending, relaxed);
+		return true;
+	}
+
+	_dispatch_sema4_create(&dqb->dqb_sema, _DSEMA4_POLICY_FIFO);
+	for (;;) {
+		os_atomic_inc(&dqb->dqb_waiters, relaxed);
+		// pairs with the fence in _dispatch_lane_bounded_release()
+		os_atomic_thread_fence(seq_cst);
+		if (os_atomic_load(&dqb->dqb_pending, relaxed) >= dqb->dqb_limit) {
+			_dispatch_sema4_wait(&dqb->dqb_sema);
+		}
+		os_atomic_dec(&dqb->dqb_waiters, relaxed);
+		if (os_atomic_inc_orig(&dqb->dqb_pending, relaxed) < dqb->dqb_limit) {
+			return true;
+		}
+		os_atomic_dec(&dqb->dqb_pending, relaxed);
+	}
+}
+
+/*
+ * Accounts for a work item about to be pushed on a bounded queue with
+ * dispatch_async_bounded_f() or dispatch_async(), which flag it
+ * DC_FLAG_BOUNDED_RESERVED.
+ *
+ * Returns false when the queue is full and the caller doesn't want to wait.
+ * In DISPATCH_QUEUE_OVERFLOW_DROP_OLDEST mode, this never waits nor fails,
+ * the drain drops the oldest items instead (see _dispatch_lane_bounded_pop()).
+ */
+DISPATCH_ALWAYS_INLINE
+static inline bool
+_dispatch_lane_bounded_reserve(dispatch_lane_t dq, bool wait)
+{
+	dispatch_lane_bounded_t dqb = _dispatch_lane_get_bounded(dq);
+
+	if (likely(os_atomic_inc_orig(&dqb->dqb_pending, relaxed) < dqb->dqb_limit)) {
+		return true;
+	}
+	if (dqb->dqb_overflow == DISPATCH_QUEUE_OVERFLOW_DROP_OLDEST) {
+		return true;
+	}
+	return _dispatch_lane_bounded_reserve_slow(dq, dqb, wait);
+}
+
+// Only the items flagged DC_FLAG_BOUNDED_RESERVED hold a slot in dqb_pending
+DISPATCH_ALWAYS_INLINE
+static inline bool
+_dispatch_lane_bounded_is_counted(dispatch_object_t dou)
+{
+	return !_dispatch_object_has_vtable(dou) &&
+			(dou._dc->dc_flags & DC_FLAG_BOUNDED_RESERVED);
+}
+
+/*
+ * Accounts for a work item pushed on a bounded queue by the internal pushes
+ * (source handlers, redirections, ...) which didn't go through
+ * _dispatch_lane_bounded_reserve(). These run in contexts that must not
+ * block, so the item is counted, possibly past the limit, but never waits.
+ */
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_lane_bounded_count(dispatch_lane_t dq, dispatch_object_t dou)
+{
+	if (_dispatch_object_has_vtable(dou) || _dispatch_object_is_waiter(dou) ||
+			(dou._dc->dc_flags & DC_FLAG_BOUNDED_RESERVED)) {
+		return;
+	}
+	dou._dc->dc_flags |= DC_FLAG_BOUNDED_RESERVED;
+	os_atomic_inc(&_dispatch_lane_get_bounded(dq)->dqb_pending, relaxed);
+}
+
+/*
+ * Gives back the slot of a counted work item that leaves the queue, and wakes
+ * up the dispatch_async_bounded_f() callers waiting for room.
+ */
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_lane_bounded_release(dispatch_lane_t dq, dispatch_object_t dou)
+{
+	dispatch_lane_bounded_t dqb = _dispatch_lane_get_bounded(dq);
+
+	if (!_dispatch_lane_bounded_is_counted(dou)) {
+		return;
+	}
+	dou._dc->dc_flags &= ~DC_FLAG_BOUNDED_RESERVED;
+	os_atomic_dec(&dqb->dqb_pending, relaxed);
+	// pairs with the fence in _dispatch_lane_bounded_reserve_slow()
+	os_atomic_thread_fence(seq_cst);
+	if (unlikely(os_atomic_load(&dqb->dqb_waiters, relaxed))) {
+		_dispatch_sema4_signal(&dqb->dqb_sema, 1);
+	}
+}
+
+DISPATCH_NOINLINE
+static void
+_dispatch_lane_bounded_drop(dispatch_lane_t dq, dispatch_continuation_t dc)
+{
+	uintptr_t dc_flags = dc->dc_flags;
+
+	if (!(dc_flags & DC_FLAG_NO_INTROSPECTION)) {
+		_dispatch_trace_item_pop(dq, dc);
+		_dispatch_trace_item_complete(dc);
+	}
+#ifdef __BLOCKS__
+	if (dc_flags & DC_FLAG_BLOCK) {
+		Block_release(dc->dc_ctxt);
+	}
+#endif /* __BLOCKS__ */
+	if (dc->dc_voucher && dc->dc_voucher != DISPATCH_NO_VOUCHER) {
+		_voucher_release(dc->dc_voucher);
+		dc->dc_voucher = VOUCHER_INVALID;
+	}
+	if (dc_flags & DC_FLAG_GROUP_ASYNC) {
+		dispatch_group_leave((dispatch_group_t)dc->dc_data);
+	}
+	_dispatch_lane_stats_item_discard(dq);
+	_dispatch_continuation_free(dc);
+}
+
+/*
+ * Accounts for a work item popped off a bounded queue by its drain.
+ *
+ * Returns true if the item was dropped because the queue is over its limit
+ * in DISPATCH_QUEUE_OVERFLOW_DROP_OLDEST mode. Barriers and blocks created
+ * with dispatch_block_create() are never dropped.
+ */
+DISPATCH_NOINLINE
+static bool
+_dispatch_lane_bounded_pop(dispatch_lane_t dq, struct dispatch_object_s *dou)
+{
+	dispatch_lane_bounded_t dqb = _dispatch_lane_get_bounded(dq);
+	dispatch_continuation_t dc = (dispatch_continuation_t)dou;
+	const uintptr_t undroppable = DC_FLAG_BARRIER |
+			DC_FLAG_BLOCK_WITH_PRIVATE_DATA;
+	bool drop = false;
+
+	if (!_dispatch_lane_bounded_is_counted(dou)) {
+		return false;
+	}
+
+	if (dqb->dqb_overflow == DISPATCH_QUEUE_OVERFLOW_DROP_OLDEST) {
+		// nobody waits for room in this mode
+		dc->dc_flags &= ~DC_FLAG_BOUNDED_RESERVED;
+		drop = os_atomic_dec_orig(&dqb->dqb_pending, relaxed) > dqb->dqb_limit &&
+				(dc->dc_flags & DC_FLAG_CONSUME) &&
+				!(dc->dc_flags & undroppable);
+	} else {
+		_dispatch_lane_bounded_release(dq, dou);
+	}
+	if (drop) {
+		_dispatch_lane_bounded_drop(dq, dc);
+	}
+	return drop;
+}
+
+void
+dispatch_queue_set_pending_limit(dispatch_queue_t dq, size_t limit,
+		dispatch_queue_overflow_t overflow)
+{
+	dispatch_lane_t dl = upcast(dq)._dl;
+	dispatch_lane_bounded_t dqb;
+
+	if (unlikely(dx_type(dq) != DISPATCH_QUEUE_SERIAL_TYPE &&
+			dx_type(dq) != DISPATCH_QUEUE_CONCURRENT_TYPE)) {
+		DISPATCH_CLIENT_CRASH(dx_type(dq),
+				"dispatch_queue_set_pending_limit called on invalid queue type");
+	}
+	if (unlikely(limit == 0 || limit > INT32_MAX)) {
+		DISPATCH_CLIENT_CRASH(limit, "Invalid pending limit");
+	}
+	if (unlikely(overflow > DISPATCH_QUEUE_OVERFLOW_DROP_OLDEST)) {
+		DISPATCH_CLIENT_CRASH(overflow, "Invalid overflow behavior");
+	}
+
+	if (!dl->dq_specific_head) {
+		_dispatch_queue_init_specific(dq);
+	}
+	dqb = dl->dq_specific_head->dqsh_bounded;
+	if (!dqb) {
+		dqb = _dispatch_calloc(1, sizeof(struct dispatch_lane_bounded_s));
+		_dispatch_sema4_init(&dqb->dqb_sema, _DSEMA4_POLICY_FIFO);
+		dl->dq_specific_head->dqsh_bounded = dqb;
+	}
+	dqb->dqb_limit = (uint32_t)limit;
+	dqb->dqb_overflow = (uint32_t)overflow;
+	dqb->dqb_pending = 0;
+	_dispatch_queue_atomic_flags_set(dl, DQF_BOUNDED);
+
+	_dispatch_queue_setter_assert_inactive(dq);
+}
+
+/*
+ * Reserves a slot for dispatch_async() and its variants on a bounded queue.
+ * They can't report failure, so they wait for room in the
+ * DISPATCH_QUEUE_OVERFLOW_FAIL mode too.
+ */
+DISPATCH_NOINLINE
+static uintptr_t
+_dispatch_lane_bounded_async_reserve(dispatch_lane_t dq)
+{
+	bool reserved = _dispatch_lane_bounded_reserve(dq, true);
+	dispatch_assert(reserved);
+	return DC_FLAG_BOUNDED_RESERVED;
+}
+
+DISPATCH_NOINLINE
+long
+dispatch_async_bounded_f(dispatch_queue_t dq, void *ctxt,
+		dispatch_function_t func)
+{
+	dispatch_lane_t dl = upcast(dq)._dl;
+	dispatch_continuation_t dc;
+	uintptr_t dc_flags = DC_FLAG_CONSUME;
+	dispatch_qos_t qos;
+
+	if (unlikely(_dispatch_lane_is_bounded(dl))) {
+		dispatch_lane_bounded_t dqb = _dispatch_lane_get_bounded(dl);
+		bool wait = (dqb->dqb_overflow != DISPATCH_QUEUE_OVERFLOW_FAIL);
+		if (!_dispatch_lane_bounded_reserve(dl, wait)) {
+			return 1;
+		}
+		dc_flags |= DC_FLAG_BOUNDED_RESERVED;
+	}
+
+	dc = _dispatch_continuation_alloc();
+	qos = _dispatch_continuation_init_f(dc, dq, ctxt, func, 0, dc_flags);
+	_dispatch_continuation_async(dq, dc, qos, dc->dc_flags);
+	return 0;
+}
+
+#pragma mark -
+#pragma mark dispatch_queue_stats
+
+DISPATCH_NOINLINE
+static void
+_dispatch_lane_stats_init(dispatch_lane_t dq)
+{
+	dispatch_queue_specific_head_t dqsh;
+	dispatch_lane_stats_t dls;
+	uint32_t nslots = MIN(dispatch_hw_config(logical_cpus),
+			DISPATCH_LANE_STATS_MAX_SLOTS);
+	size_t size;
+	void *buf;
+
+	if (!dq->dq_specific_head) {
+		_dispatch_queue_init_specific(dq->_as_dq);
+	}
+	dqsh = dq->dq_specific_head;
+	if (dqsh->dqsh_stats) {
+		return;
+	}
+
+	size = sizeof(struct dispatch_lane_stats_s) +
+			nslots * sizeof(struct dispatch_lane_stats_slot_s);
+	while (unlikely(posix_memalign(&buf, DISPATCH_CACHELINE_SIZE, size))) {
+		_dispatch_temporary_resource_shortage();
+	}
+	dls = memset(buf, 0, size);
+	dls->dls_nslots = nslots;
+	dls->dls_queue = dq;
+	dls->dls_serialnum = dq->dq_serialnum;
+	// the label may be freed before the statistics are
+	if (dq->dq_label) {
+		strlcpy(dls->dls_label, dq->dq_label, sizeof(dls->dls_label));
+	}
+
+	_dispatch_unfair_lock_lock(&_dispatch_lane_stats_lock);
+	TAILQ_INSERT_TAIL(&_dispatch_lane_stats_list, dls, dls_list);
+	_dispatch_lane_stats_count++;
+	_dispatch_unfair_lock_unlock(&_dispatch_lane_stats_lock);
+	if (unlikely(!os_atomic_cmpxchg(&dqsh->dqsh_stats, NULL, dls, release))) {
+		_dispatch_lane_stats_dispose(dls);
+	}
+}
+
+static void
+_dispatch_lane_stats_snapshot(dispatch_lane_stats_t dls,
+		dispatch_queue_stats_t stats)
+{
+	uint64_t enqueued = 0, dequeued = 0, wakeups = 0;
+
+	strlcpy(stats->dqst_label, dls->dls_label, sizeof(stats->dqst_label));
+	stats->dqst_serialnum = dls->dls_serialnum;
+	for (uint32_t i = 0; i < dls->dls_nslots; i++) {
+		dispatch_lane_stats_slot_t slot = &dls->dls_slots[i];
+		enqueued += os_atomic_load(&slot->dlss_enqueued, relaxed);
+		dequeued += os_atomic_load(&slot->dlss_dequeued, relaxed);
+		wakeups += os_atomic_load(&slot->dlss_wakeups, relaxed);
+	}
+	stats->dqst_enqueued = enqueued;
+	stats->dqst_dequeued = dequeued;
+	// items can be counted as dequeued on a CPU that was read before the one
+	// they were counted as enqueued on
+	stats->dqst_depth = enqueued > dequeued ? enqueued - dequeued : 0;
+	stats->dqst_wakeups = wakeups;
+	for (int i = 0; i < DISPATCH_QUEUE_STATS_HISTOGRAM_BUCKETS; i++) {
+		stats->dqst_latency[i] = os_atomic_load(&dls->dls_latency[i], relaxed);
+		stats->dqst_execution[i] =
+				os_atomic_load(&dls->dls_execution[i], relaxed);
+	}
+}
+
+void
+dispatch_queue_enable_stats(dispatch_queue_t dq)
+{
+	if (unlikely(dx_type(dq) != DISPATCH_QUEUE_SERIAL_TYPE &&
+			dx_type(dq) != DISPATCH_QUEUE_CONCURRENT_TYPE)) {
+		DISPATCH_CLIENT_CRASH(dx_type(dq),
+				"dispatch_queue_enable_stats called on invalid queue type");
+	}
+	_dispatch_lane_stats_init(upcast(dq)._dl);
+}
+
+bool
+dispatch_queue_get_stats(dispatch_queue_t dq, dispatch_queue_stats_t stats)
+{
+	dispatch_lane_stats_t dls = _dispatch_lane_get_stats(upcast(dq)._dl);
+
+	if (!dls) {
+		return false;
+	}
+	_dispatch_lane_stats_snapshot(dls, stats);
+	return true;
+}
+
+void
+dispatch_queue_stats_apply_f(void *ctxt, dispatch_queue_stats_applier_t func)
+{
+	dispatch_queue_stats_t buf = NULL;
+	dispatch_lane_stats_t dls;
+	uint32_t cap = 0, n = 0;
+
+	// The applier is called once the lock is dropped, so that it can create
+	// and release queues, the statistics are copied out beforehand
+	_dispatch_unfair_lock_lock(&_dispatch_lane_stats_lock);
+	while (unlikely(cap < _dispatch_lane_stats_count)) {
+		cap = _dispatch_lane_stats_count;
+		_dispatch_unfair_lock_unlock(&_dispatch_lane_stats_lock);
+		free(buf);
+		buf = _dispatch_calloc(cap, sizeof(dispatch_queue_stats_s));
+		_dispatch_unfair_lock_lock(&_dispatch_lane_stats_lock);
+	}
+	TAILQ_FOREACH(dls, &_dispatch_lane_stats_list, dls_list) {
+		_dispatch_lane_stats_snapshot(dls, &buf[n++]);
+	}
+	_dispatch_unfair_lock_unlock(&_dispatch_lane_stats_lock);
+
+	for (uint32_t i = 0; i < n; i++) {
+		func(ctxt, &buf[i]);
+	}
+	free(buf);
+}
+
+// The lanes stay allocated while the registry lock is held: they unregister
+// from _dispatch_queue_dispose(), before _dispatch_dispose() releases their
+// target, but after their label is freed.
+void
+_dispatch_lane_stats_apply_lanes(void *ctxt,
+		void (*func)(void *, dispatch_lane_t, dispatch_queue_stats_t))
+{
+	dispatch_queue_stats_s stats;
+	dispatch_lane_stats_t dls;
+
+	_dispatch_unfair_lock_lock(&_dispatch_lane_stats_lock);
+	TAILQ_FOREACH(dls, &_dispatch_lane_stats_list, dls_list) {
+		_dispatch_lane_stats_snapshot(dls, &stats);
+		func(ctxt, dls->dls_queue, &stats);
+	}
+	_dispatch_unfair_lock_unlock(&_dispatch_lane_stats_lock);
+}
+
+#if DISPATCH_USE_CALLOUT_PROFILE
+#pragma mark -
+#pragma mark dispatch_callout_profile
+
+static struct dispatch_queue_sample_s
+		_dispatch_root_queue_callout_samples[_DISPATCH_ROOT_QUEUE_IDX_COUNT]
+		[DISPATCH_QUEUE_SAMPLES];
+
+/*
+ * Returns the table in which the callout profiler keeps the submission time
+ * of the sampled work items of a queue, creating it if `create` is set.
+ *
+ * Global root queues have a static table each, and queues that admit
+ * specifics keep theirs in their specific head. Items of any other queue
+ * are never sampled and NULL is returned.
+ */
+dispatch_queue_sample_t
+_dispatch_queue_get_callout_samples(dispatch_queue_t dq, bool create)
+{
+	dispatch_queue_specific_head_t dqsh;
+	dispatch_queue_sample_t samples, cur;
+
+	if (dx_hastypeflag(dq, QUEUE_ROOT)) {
+		if (!_dispatch_is_in_root_queues_array(dq)) {
+			return NULL;
+		}
+		return _dispatch_root_queue_callout_samples[
+				upcast(dq)._dgq - _dispatch_root_queues];
+	}
+	if (!_dispatch_queue_admits_specific(dq)) {
+		return NULL;
+	}
+
+	dqsh = os_atomic_load(&dq->dq_specific_head, acquire);
+	if (likely(dqsh)) {
+		samples = os_atomic_load(&dqsh->dqsh_callout_samples, acquire);
+		if (likely(samples) || !create) {
+			return samples;
+		}
+	} else if (!create) {
+		return NULL;
+	} else {
+		_dispatch_queue_init_specific(dq);
+		dqsh = dq->dq_specific_head;
+	}
+
+	samples = _dispatch_calloc(DISPATCH_QUEUE_SAMPLES,
+			sizeof(struct dispatch_queue_sample_s));
+	if (unlikely(!os_atomic_cmpxchgv(&dqsh->dqsh_callout_samples,
+			NULL, samples, &cur, release))) {
+		free(samples);
+		return cur;
+	}
+	return samples;
+}
+#endif // DISPATCH_USE_CALLOUT_PROFILE
+
+#pragma mark -
+#pragma mark dispatch_async_coalesced
+
+DISPATCH_ALWAYS_INLINE
+static inline dispatch_queue_coalesced_bucket_t
+_dispatch_queue_coalesced_bucket(dispatch_queue_specific_head_t dqsh,
+		void *ctxt, dispatch_function_t func)
+{
+	uintptr_t h = (uintptr_t)ctxt ^ ((uintptr_t)func >> 4);
+
+	// contexts are often pointers to similarly aligned objects,
+	// fold the bits above the alignment into the index
+	h ^= h >> 6;
+	h ^= h >> 12;
+	return &dqsh->dqsh_coalesced[h & (DQC_HASH_SIZE - 1)];
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline dispatch_queue_coalesced_t
+_dispatch_queue_coalesced_find(dispatch_queue_coalesced_bucket_t dqcb,
+		void *ctxt, dispatch_function_t func)
+{
+	dispatch_queue_coalesced_t dqc;
 
-	TAILQ_FOREACH(dqs, &dqsh->dqsh_entries, dqs_entry) {
-		if (dqs->dqs_key == key) {
-			return dqs;
+	LIST_FOREACH(dqc, dqcb, dqc_entry) {
+		if (dqc->dqc_func == func && dqc->dqc_ctxt == ctxt) {
+			return dqc;
 		}
 	}
 	return NULL;
 }
 
-DISPATCH_ALWAYS_INLINE
-static inline bool
-_dispatch_queue_admits_specific(dispatch_queue_t dq)
+static void
+_dispatch_queue_coalesced_invoke(void *ctxt)
 {
-	if (dx_metatype(dq) == _DISPATCH_LANE_TYPE) {
-		return (dx_type(dq) == DISPATCH_QUEUE_MAIN_TYPE ||
-			!dx_hastypeflag(dq, QUEUE_BASE));
-	}
-	return dx_metatype(dq) == _DISPATCH_WORKLOOP_TYPE;
+	dispatch_queue_coalesced_t dqc = ctxt;
+	dispatch_queue_specific_head_t dqsh = dqc->dqc_head;
+	dispatch_function_t func = dqc->dqc_func;
+
+	// Submissions made from now on enqueue a new work item, so that the
+	// function always runs after the last one.
+	_dispatch_unfair_lock_lock(&dqsh->dqsh_lock);
+	LIST_REMOVE(dqc, dqc_entry);
+	_dispatch_unfair_lock_unlock(&dqsh->dqsh_lock);
+
+	ctxt = dqc->dqc_ctxt;
+	free(dqc);
+	func(ctxt);
 }
 
 DISPATCH_NOINLINE
 void
-dispatch_queue_set_specific(dispatch_queue_t dq, const void *key,
-	void *ctxt, dispatch_function_t destructor)
+dispatch_async_coalesced_f(dispatch_queue_t dq, void *ctxt,
+		dispatch_function_t func)
 {
-	if (unlikely(!key)) {
-		return;
-	}
-	dispatch_queue_t rq = _dispatch_get_default_queue(false);
-	dispatch_queue_specific_head_t dqsh = dq->dq_specific_head;
-	dispatch_queue_specific_t dqs;
+	dispatch_queue_specific_head_t dqsh;
+	dispatch_queue_coalesced_bucket_t dqcb;
+	dispatch_queue_coalesced_t dqc;
 
-	if (unlikely(!_dispatch_queue_admits_specific(dq))) {
-		DISPATCH_CLIENT_CRASH(0,
-				"Queue doesn't support dispatch_queue_set_specific");
+	if (unlikely(dx_metatype(dq) != _DISPATCH_LANE_TYPE ||
+			!_dispatch_queue_admits_specific(dq))) {
+		return dispatch_async_f(dq, ctxt, func);
 	}
 
-	if (ctxt && !dqsh) {
+	dqsh = os_atomic_load(&dq->dq_specific_head, acquire);
+	if (unlikely(!dqsh)) {
 		_dispatch_queue_init_specific(dq);
 		dqsh = dq->dq_specific_head;
-	} else if (!dqsh) {
-		return;
 	}
 
 	_dispatch_unfair_lock_lock(&dqsh->dqsh_lock);
-	dqs = _dispatch_queue_specific_find(dqsh, key);
-	if (dqs) {
-		if (dqs->dqs_destructor) {
-			_dispatch_barrier_async_detached_f(rq, dqs->dqs_ctxt,
-					dqs->dqs_destructor);
-		}
-		if (ctxt) {
-			dqs->dqs_ctxt = ctxt;
-			dqs->dqs_destructor = destructor;
-		} else {
-			TAILQ_REMOVE(&dqsh->dqsh_entries, dqs, dqs_entry);
-			free(dqs);
-		}
-	} else if (ctxt) {
-		dqs = _dispatch_calloc(1, sizeof(struct dispatch_queue_specific_s));
-		dqs->dqs_key = key;
-		dqs->dqs_ctxt = ctxt;
-		dqs->dqs_destructor = destructor;
-		TAILQ_INSERT_TAIL(&dqsh->dqsh_entries, dqs, dqs_entry);
+	if (unlikely(!dqsh->dqsh_coalesced)) {
+		dqsh->dqsh_coalesced = _dispatch_calloc(DQC_HASH_SIZE,
+				sizeof(struct dispatch_queue_coalesced_bucket_s));
 	}
-
-	_dispatch_unfair_lock_unlock(&dqsh->dqsh_lock);
-}
-
-DISPATCH_ALWAYS_INLINE
-static inline void *
-_dispatch_queue_get_specific_inline(dispatch_queue_t dq, const void *key)
-{
-	dispatch_queue_specific_head_t dqsh = dq->dq_specific_head;
-	dispatch_queue_specific_t dqs;
-	void *ctxt = NULL;
-
-	if (likely(_dispatch_queue_admits_specific(dq) && dqsh)) {
-		_dispatch_unfair_lock_lock(&dqsh->dqsh_lock);
-		dqs = _dispatch_queue_specific_find(dqsh, key);
-		if (dqs) ctxt = dqs->dqs_ctxt;
+	dqcb = _dispatch_queue_coalesced_bucket(dqsh, ctxt, func);
+	dqc = _dispatch_queue_coalesced_find(dqcb, ctxt, func);
+	if (likely(dqc)) {
 		_dispatch_unfair_lock_unlock(&dqsh->dqsh_lock);
+		return;
 	}
-	return ctxt;
-}
-
-DISPATCH_NOINLINE
-void *
-dispatch_queue_get_specific(dispatch_queue_t dq, const void *key)
-{
-	if (unlikely(!key)) {
-		return NULL;
-	}
-	return _dispatch_queue_get_specific_inline(dq, key);
-}
-
-DISPATCH_NOINLINE
-void *
-dispatch_get_specific(const void *key)
-{
-	dispatch_queue_t dq = _dispatch_queue_get_current();
-	void *ctxt = NULL;
+	dqc = _dispatch_calloc(1, sizeof(struct dispatch_queue_coalesced_s));
+	dqc->dqc_head = dqsh;
+	dqc->dqc_ctxt = ctxt;
+	dqc->dqc_func = func;
+	LIST_INSERT_HEAD(dqcb, dqc, dqc_entry);
+	_dispatch_unfair_lock_unlock(&dqsh->dqsh_lock);
 
-	if (likely(key && dq)) {
-		do {
-			ctxt = _dispatch_queue_get_specific_inline(dq, key);
-			dq = dq->do_targetq;
-		} while (unlikely(ctxt == NULL && dq));
-	}
-	return ctxt;
+	_dispatch_async_f(dq, dqc, _dispatch_queue_coalesced_invoke, 0);
 }
 
 #pragma mark -
@@ -2936,6 +3958,9 @@ _dispatch_lane_create_with_target(const char *label, dispatch_queue_attr_t dqa,
 	}
 	_dispatch_retain(tq);
 	dq->do_targetq = tq;
+	if (unlikely(_dispatch_mode & DISPATCH_MODE_QUEUE_STATS)) {
+		_dispatch_lane_stats_init(dq);
+	}
 	_dispatch_object_debug(dq, "%s", __func__);
 	return _dispatch_trace_queue_create(dq)._dq;
 }
@@ -3799,6 +4824,71 @@ dispatch_swift_job_should_yield(void)
 }
 #endif
 
+#pragma mark -
+#pragma mark dispatch_lane_drain_prefetch
+
+// How many work items ahead of the one being invoked the serial drain
+// prefetches, along with their contexts
+#define DISPATCH_LANE_DRAIN_PREFETCH_DISTANCE 4
+
+typedef struct dispatch_lane_drain_prefetch_s {
+	struct dispatch_object_s *dldp_cursor;
+	unsigned int dldp_ahead;
+} dispatch_lane_drain_prefetch_s, *dispatch_lane_drain_prefetch_t;
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_lane_drain_prefetch(dispatch_lane_drain_prefetch_t dldp)
+{
+	struct dispatch_object_s *pf, *next;
+
+	// Move the cursor up to two items per invocation so that it gets ahead
+	// of the drain, each hop only touches a line prefetched one item earlier.
+	//
+	// The items between the head and the cursor are still on the queue, and
+	// only the drainer pops and frees them, so following their do_next is safe.
+	for (int i = 0; i < 2; i++) {
+		pf = dldp->dldp_cursor;
+		if (dldp->dldp_ahead >= DISPATCH_LANE_DRAIN_PREFETCH_DISTANCE || !pf) {
+			return;
+		}
+		if (!_dispatch_object_has_vtable(pf)) {
+			_dispatch_prefetch(((dispatch_continuation_t)pf)->dc_ctxt);
+		}
+		next = os_atomic_load(&pf->do_next, relaxed);
+		if (unlikely(!next)) {
+			return; // tail of the queue, or the enqueuer hasn't linked it yet
+		}
+		_dispatch_prefetch(next);
+		dldp->dldp_cursor = next;
+		dldp->dldp_ahead++;
+	}
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_lane_drain_prefetch_start(dispatch_lane_drain_prefetch_t dldp,
+		struct dispatch_object_s *head)
+{
+	dldp->dldp_cursor = head;
+	dldp->dldp_ahead = 0;
+	_dispatch_lane_drain_prefetch(dldp);
+}
+
+// Called once the head has been popped, `next_dc` being the new head
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_lane_drain_prefetch_advance(dispatch_lane_drain_prefetch_t dldp,
+		struct dispatch_object_s *next_dc)
+{
+	if (dldp->dldp_ahead) {
+		dldp->dldp_ahead--;
+	} else {
+		dldp->dldp_cursor = next_dc;
+	}
+	_dispatch_lane_drain_prefetch(dldp);
+}
+
 /*
  * Drain comes in 2 flavours (serial/concurrent) and 2 modes
  * (redirecting or not).
@@ -3814,6 +4904,11 @@ dispatch_swift_job_should_yield(void)
  * Going through a serial drain prevents any recursive drain from being
  * redirecting.
  *
+ * Serial drain pops work items one by one off the queue, and prefetches a few
+ * of the items ahead of the one it invokes along with their contexts (see
+ * dispatch_lane_drain_prefetch_s), as these were usually allocated and
+ * enqueued by other threads.
+ *
  * Concurrent
  * ~~~~~~~~~~
  * When in non-redirecting mode (meaning one of the target queues is serial),
@@ -3832,6 +4927,10 @@ _dispatch_lane_drain(dispatch_lane_t dq, dispatch_invoke_context_t dic,
 		dispatch_invoke_flags_t flags, uint64_t *owned_ptr, bool serial_drain)
 {
 	dispatch_queue_t orig_tq = dq->do_targetq;
+	dispatch_pthread_root_queue_observer_hooks_t observer_hooks;
+	dispatch_lane_drain_prefetch_s dldp = { };
+	const bool bounded = _dispatch_lane_is_bounded(dq);
+	const dispatch_lane_stats_t stats = _dispatch_lane_get_stats(dq);
 	dispatch_thread_frame_s dtf;
 	struct dispatch_object_s *dc = NULL, *next_dc;
 	uint64_t dq_state, owned = *owned_ptr;
@@ -3853,7 +4952,11 @@ _dispatch_lane_drain(dispatch_lane_t dq, dispatch_invoke_context_t dic,
 		_dispatch_return_to_kernel();
 	}
 
+	observer_hooks = _dispatch_get_pthread_root_queue_observer_hooks();
 	dc = _dispatch_queue_get_head(dq);
+	if (serial_drain) {
+		_dispatch_lane_drain_prefetch_start(&dldp, dc);
+	}
 	goto first_iteration;
 
 	for (;;) {
@@ -3864,6 +4967,9 @@ _dispatch_lane_drain(dispatch_lane_t dq, dispatch_invoke_context_t dic,
 				break;
 			}
 			dc = _dispatch_queue_get_head(dq);
+			if (serial_drain) {
+				_dispatch_lane_drain_prefetch_start(&dldp, dc);
+			}
 		}
 		if (unlikely(_dispatch_needs_to_return_to_kernel())) {
 			_dispatch_return_to_kernel();
@@ -3903,7 +5009,16 @@ first_iteration:
 				dic->dic_barrier_waiter = dc;
 				goto out_with_barrier_waiter;
 			}
+			if (!serial_drain) {
+				_dispatch_lane_barrier_wait_for_readers(dq);
+			}
 			next_dc = _dispatch_queue_pop_head(dq, dc);
+			if (serial_drain) {
+				_dispatch_lane_drain_prefetch_advance(&dldp, next_dc);
+			}
+			if (unlikely(bounded) && _dispatch_lane_bounded_pop(dq, dc)) {
+				continue;
+			}
 		} else {
 			if (owned == DISPATCH_QUEUE_IN_BARRIER) {
 				// we just ran barrier work items, we have to make their
@@ -3928,6 +5043,9 @@ first_iteration:
 				_dispatch_non_barrier_waiter_redirect_or_wake(dq, dc);
 				continue;
 			}
+			if (unlikely(bounded) && _dispatch_lane_bounded_pop(dq, dc)) {
+				continue;
+			}
 
 			if (flags & DISPATCH_INVOKE_REDIRECTING_DRAIN) {
 				owned -= DISPATCH_QUEUE_WIDTH_INTERVAL;
@@ -3942,7 +5060,17 @@ first_iteration:
 			}
 		}
 
-		_dispatch_continuation_pop_inline(dc, dic, flags, dq);
+		// thread-bound sync waiters never went through
+		// _dispatch_lane_stats_push(), see _dispatch_lane_push_waiter()
+		if (unlikely(stats) && !_dispatch_object_is_waiter(dc)) {
+			uint64_t start = _dispatch_lane_stats_item_start(stats, dc);
+			_dispatch_continuation_pop_observed_inline(dc, dic, flags, dq,
+					observer_hooks);
+			_dispatch_lane_stats_item_end(stats, start);
+			continue;
+		}
+		_dispatch_continuation_pop_observed_inline(dc, dic, flags, dq,
+				observer_hooks);
 	}
 
 	if (owned == DISPATCH_QUEUE_IN_BARRIER) {
@@ -5577,6 +6705,16 @@ _dispatch_queue_wakeup(dispatch_queue_class_t dqu, dispatch_qos_t qos,
 					flags);
 		}
 	}
+#elif HAVE_DISPATCH_WORKQ_SCHED
+	if (unlikely((old_state ^ new_state) & DISPATCH_QUEUE_MAX_QOS_MASK)) {
+		// Without kernel workqueue support, the thread currently draining
+		// this queue is the only one we know to boost.
+		if (_dq_state_drain_locked(new_state) &&
+				!_dq_state_is_suspended(new_state)) {
+			_dispatch_wqthread_override_start(_dq_state_drain_owner(new_state),
+					_dq_state_max_qos(new_state));
+		}
+	}
 #endif // HAVE_PTHREAD_WORKQUEUE_QOS
 done:
 	if (likely(flags & DISPATCH_WAKEUP_CONSUME_2)) {
@@ -5712,13 +6850,21 @@ _dispatch_lane_push(dispatch_lane_t dq, dispatch_object_t dou,
 {
 	dispatch_wakeup_flags_t flags = 0;
 	struct dispatch_object_s *prev;
+	dispatch_lane_stats_t dls;
 
 	if (unlikely(_dispatch_object_is_waiter(dou))) {
 		return _dispatch_lane_push_waiter(dq, dou._dsc, qos);
 	}
 
 	dispatch_assert(!_dispatch_object_is_global(dq));
+	if (unlikely(_dispatch_lane_is_bounded(dq))) {
+		_dispatch_lane_bounded_count(dq, dou);
+	}
 	qos = _dispatch_queue_push_qos(dq, qos);
+	dls = _dispatch_lane_get_stats(dq);
+	if (unlikely(dls)) {
+		_dispatch_lane_stats_push(dls, dou._do);
+	}
 
 	// If we are going to call dx_wakeup(), the queue must be retained before
 	// the item we're pushing can be dequeued, which means:
@@ -5732,6 +6878,7 @@ _dispatch_lane_push(dispatch_lane_t dq, dispatch_object_t dou,
 	if (unlikely(os_mpsc_push_was_empty(prev))) {
 		_dispatch_retain_2_unsafe(dq);
 		flags = DISPATCH_WAKEUP_CONSUME_2 | DISPATCH_WAKEUP_MAKE_DIRTY;
+		if (unlikely(dls)) _dispatch_lane_stats_wakeup(dls);
 	} else if (unlikely(_dispatch_queue_need_override(dq, qos))) {
 		// There's a race here, _dispatch_queue_need_override may read a stale
 		// dq_state value.
@@ -5751,6 +6898,46 @@ _dispatch_lane_push(dispatch_lane_t dq, dispatch_object_t dou,
 	}
 }
 
+DISPATCH_NOINLINE
+static void
+_dispatch_lane_push_list(dispatch_lane_t dq, dispatch_object_t _head,
+		dispatch_object_t _tail, dispatch_qos_t qos)
+{
+	struct dispatch_object_s *hd = _head._do, *tl = _tail._do, *prev;
+	dispatch_wakeup_flags_t flags = 0;
+	dispatch_lane_stats_t dls = _dispatch_lane_get_stats(dq);
+
+	dispatch_assert(!_dispatch_object_is_global(dq));
+	if (unlikely(_dispatch_lane_is_bounded(dq))) {
+		struct dispatch_object_s *dc = hd;
+		for (;;) {
+			_dispatch_lane_bounded_count(dq, dc);
+			if (dc == tl) break;
+			dc = dc->do_next;
+		}
+	}
+	qos = _dispatch_queue_push_qos(dq, qos);
+	if (unlikely(dls)) {
+		_dispatch_lane_stats_push_list(dls, hd, tl);
+	}
+
+	// See _dispatch_lane_push() for why the queue must be retained before
+	// the list is made visible to drainers
+	prev = os_mpsc_push_update_tail(os_mpsc(dq, dq_items), tl, do_next);
+	if (unlikely(os_mpsc_push_was_empty(prev))) {
+		_dispatch_retain_2_unsafe(dq);
+		flags = DISPATCH_WAKEUP_CONSUME_2 | DISPATCH_WAKEUP_MAKE_DIRTY;
+		if (unlikely(dls)) _dispatch_lane_stats_wakeup(dls);
+	} else if (unlikely(_dispatch_queue_need_override(dq, qos))) {
+		_dispatch_retain_2_unsafe(dq);
+		flags = DISPATCH_WAKEUP_CONSUME_2;
+	}
+	os_mpsc_push_update_prev(os_mpsc(dq, dq_items), prev, hd, do_next);
+	if (flags) {
+		return dx_wakeup(dq, qos, flags);
+	}
+}
+
 DISPATCH_NOINLINE
 void
 _dispatch_lane_concurrent_push(dispatch_lane_t dq, dispatch_object_t dou,
@@ -5771,6 +6958,15 @@ _dispatch_lane_concurrent_push(dispatch_lane_t dq, dispatch_object_t dou,
 			!_dispatch_object_is_waiter(dou) &&
 			!_dispatch_object_is_barrier(dou) &&
 			_dispatch_queue_try_acquire_async(dq)) {
+		dispatch_lane_stats_t dls = _dispatch_lane_get_stats(dq);
+		if (unlikely(dls)) {
+			_dispatch_lane_stats_push(dls, dou._do);
+		}
+		if (unlikely(_dispatch_lane_is_bounded(dq))) {
+			// the item runs right away, it doesn't keep the slot that
+			// dispatch_async_bounded_f() reserved for it
+			_dispatch_lane_bounded_release(dq, dou);
+		}
 		return _dispatch_continuation_redirect_push(dq, dou, qos);
 	}
 
@@ -6863,6 +8059,31 @@ static void *_dispatch_worker_thread(void *context);
 #if defined(_WIN32)
 static unsigned WINAPI _dispatch_worker_thread_thunk(LPVOID lpParameter);
 #endif
+
+// Maximum time an idle worker polls its root queue before parking, and
+// how many workers of a given root queue may do so at the same time.
+// Overridden by LIBDISPATCH_WORKER_SPIN_USEC and LIBDISPATCH_WORKER_SPINNERS.
+#ifndef DISPATCH_WORKER_SPIN_USEC
+#define DISPATCH_WORKER_SPIN_USEC 50
+#endif
+#ifndef DISPATCH_WORKER_SPINNERS
+#define DISPATCH_WORKER_SPINNERS 1
+#endif
+
+// Time an idle worker waits for work before it exits, unless the pool policy
+// of its root queue says otherwise.
+#define DISPATCH_WORKER_IDLE_TIMEOUT (5ull * NSEC_PER_SEC)
+
+DISPATCH_STATIC_GLOBAL(uint64_t _dispatch_worker_spin_max);
+DISPATCH_STATIC_GLOBAL(int _dispatch_worker_spinners_max);
+static void _dispatch_worker_spin_note_poke(
+		dispatch_pthread_root_queue_context_t pqc);
+static int _dispatch_worker_spawn_budget(
+		dispatch_pthread_root_queue_context_t pqc, int n, uint64_t *delay);
+static void _dispatch_worker_spawn_later(
+		dispatch_pthread_root_queue_context_t pqc, int n, uint64_t delay);
+static int _dispatch_worker_respawn_take(
+		dispatch_pthread_root_queue_context_t pqc);
 #endif // DISPATCH_USE_PTHREAD_POOL
 
 #if DISPATCH_DEBUG && DISPATCH_ROOT_QUEUE_DEBUG
@@ -6881,55 +8102,19 @@ _dispatch_debug_root_queue(dispatch_queue_class_t dqu, const char *str)
 #define _dispatch_debug_root_queue(...)
 #endif // DISPATCH_DEBUG && DISPATCH_ROOT_QUEUE_DEBUG
 
+#if DISPATCH_USE_PTHREAD_POOL
 DISPATCH_NOINLINE
 static void
-_dispatch_root_queue_poke_slow(dispatch_queue_global_t dq, int n, int floor)
+_dispatch_root_queue_spawn_workers(dispatch_queue_global_t dq,
+		dispatch_pthread_root_queue_context_t pqc, int remaining, int floor,
+		bool prewarm)
 {
-	int remaining = n;
 #if !defined(_WIN32)
-	int r = ENOSYS;
-#endif
-
-	_dispatch_root_queues_init();
-	_dispatch_debug_root_queue(dq, __func__);
-	_dispatch_trace_runtime_event(worker_request, dq, (uint64_t)n);
-
-#if !DISPATCH_USE_INTERNAL_WORKQUEUE
-#if DISPATCH_USE_PTHREAD_ROOT_QUEUES
-	if (dx_type(dq) == DISPATCH_QUEUE_GLOBAL_ROOT_TYPE)
+	int r;
 #endif
-	{
-		_dispatch_root_queue_debug("requesting new worker thread for global "
-				"queue: %p", dq);
-		r = _pthread_workqueue_addthreads(remaining,
-				_dispatch_priority_to_pp_prefer_fallback(dq->dq_priority));
-		(void)dispatch_assume_zero(r);
-		return;
-#if DISPATCH_USE_COOPERATIVE_WORKQUEUE
-	} else if (dx_type(dq) == DISPATCH_QUEUE_COOPERATIVE_ROOT_TYPE) {
-		_dispatch_root_queue_debug("requesting new worker thread for cooperative global "
-				"queue: %p", dq);
-		r = _pthread_workqueue_add_cooperativethreads(remaining,
-				_dispatch_priority_to_pp_prefer_fallback(dq->dq_priority));
-		(void)dispatch_assume_zero(r);
-		return;
-#endif /* DISPATCH_USE_COOPERATIVE_WORKQUEUE */
-	}
-#endif // !DISPATCH_USE_INTERNAL_WORKQUEUE
-#if DISPATCH_USE_PTHREAD_POOL
-	dispatch_pthread_root_queue_context_t pqc = dq->do_ctxt;
-	if (likely(pqc->dpq_thread_mediator.do_vtable)) {
-		while (dispatch_semaphore_signal(&pqc->dpq_thread_mediator)) {
-			_dispatch_root_queue_debug("signaled sleeping worker for "
-					"global queue: %p", dq);
-			if (!--remaining) {
-				return;
-			}
-		}
-	}
-
 	bool overcommit = dq->dq_priority & DISPATCH_PRIORITY_FLAG_OVERCOMMIT;
-	if (overcommit) {
+	// prewarmed threads aren't asked for by a poke, and don't replace one
+	if (overcommit || prewarm) {
 		os_atomic_add(&dq->dgq_pending, remaining, relaxed);
 	} else {
 		if (!os_atomic_cmpxchg(&dq->dgq_pending, 0, remaining, relaxed)) {
@@ -6940,6 +8125,18 @@ _dispatch_root_queue_poke_slow(dispatch_queue_global_t dq, int n, int floor)
 	}
 
 	int can_request, t_count;
+	uint64_t delay;
+	can_request = _dispatch_worker_spawn_budget(pqc, remaining, &delay);
+	if (unlikely(remaining > can_request)) {
+		_dispatch_root_queue_debug("pthread pool throttling request from %d "
+				"to %d", remaining, can_request);
+		os_atomic_sub(&dq->dgq_pending, remaining - can_request, relaxed);
+		_dispatch_worker_spawn_later(pqc, remaining - can_request, delay);
+		if (!(remaining = can_request)) {
+			return;
+		}
+	}
+
 	// seq_cst with atomic store to tail <rdar://problem/16932833>
 	t_count = os_atomic_load(&dq->dgq_thread_pool_size, ordered);
 	do {
@@ -6958,6 +8155,9 @@ _dispatch_root_queue_poke_slow(dispatch_queue_global_t dq, int n, int floor)
 	} while (!os_atomic_cmpxchgv(&dq->dgq_thread_pool_size, t_count,
 			t_count - remaining, &t_count, acquire));
 
+	os_atomic_add(&pqc->dpq_threads, (uint32_t)remaining, relaxed);
+	os_atomic_add(&pqc->dpq_spawned, (uint64_t)remaining, relaxed);
+
 #if !defined(_WIN32)
 	pthread_attr_t *attr = &pqc->dpq_thread_attr;
 	pthread_t tid, *pthr = &tid;
@@ -6998,6 +8198,76 @@ _dispatch_root_queue_poke_slow(dispatch_queue_global_t dq, int n, int floor)
 		CloseHandle((HANDLE)hThread);
 	} while (--remaining);
 #endif // defined(_WIN32)
+}
+#endif // DISPATCH_USE_PTHREAD_POOL
+
+DISPATCH_NOINLINE
+static void
+_dispatch_root_queue_poke_slow(dispatch_queue_global_t dq, int n, int floor)
+{
+	int remaining = n;
+#if !defined(_WIN32) && !DISPATCH_USE_INTERNAL_WORKQUEUE
+	int r = ENOSYS;
+#endif
+
+	_dispatch_root_queues_init();
+	_dispatch_debug_root_queue(dq, __func__);
+	_dispatch_trace_runtime_event(worker_request, dq, (uint64_t)n);
+
+#if !DISPATCH_USE_INTERNAL_WORKQUEUE
+#if DISPATCH_USE_PTHREAD_ROOT_QUEUES
+	if (dx_type(dq) == DISPATCH_QUEUE_GLOBAL_ROOT_TYPE)
+#endif
+	{
+		_dispatch_root_queue_debug("requesting new worker thread for global "
+				"queue: %p", dq);
+		r = _pthread_workqueue_addthreads(remaining,
+				_dispatch_priority_to_pp_prefer_fallback(dq->dq_priority));
+		(void)dispatch_assume_zero(r);
+		return;
+#if DISPATCH_USE_COOPERATIVE_WORKQUEUE
+	} else if (dx_type(dq) == DISPATCH_QUEUE_COOPERATIVE_ROOT_TYPE) {
+		_dispatch_root_queue_debug("requesting new worker thread for cooperative global "
+				"queue: %p", dq);
+		r = _pthread_workqueue_add_cooperativethreads(remaining,
+				_dispatch_priority_to_pp_prefer_fallback(dq->dq_priority));
+		(void)dispatch_assume_zero(r);
+		return;
+#endif /* DISPATCH_USE_COOPERATIVE_WORKQUEUE */
+	}
+#endif // !DISPATCH_USE_INTERNAL_WORKQUEUE
+#if DISPATCH_USE_PTHREAD_POOL
+	dispatch_pthread_root_queue_context_t pqc = dq->do_ctxt;
+	os_atomic_inc(&pqc->dpq_pokes, relaxed);
+	if (unlikely(os_atomic_load(&pqc->dpq_respawn, relaxed))) {
+		// ask for the threads a previous poke was throttled on as well
+		remaining += _dispatch_worker_respawn_take(pqc);
+	}
+	if (_dispatch_worker_spin_max) {
+		_dispatch_worker_spin_note_poke(pqc);
+		// pairs with the fence in _dispatch_worker_spin(): either the spinner
+		// sees the item, or we see the spinner and don't wake anyone for it
+		os_atomic_thread_fence(seq_cst);
+		int spinners = os_atomic_load(&pqc->dpq_spinners, relaxed);
+		if (spinners > 0) {
+			_dispatch_root_queue_debug("%d spinning workers for global "
+					"queue: %p", spinners, dq);
+			if ((remaining -= spinners) <= 0) {
+				return;
+			}
+		}
+	}
+	uint32_t woken = _dispatch_parking_lot_wake(&pqc->dpq_parking_lot,
+			(uint32_t)remaining);
+	if (woken) {
+		_dispatch_root_queue_debug("woke %u sleeping workers for "
+				"global queue: %p", woken, dq);
+		if (!(remaining -= (int)woken)) {
+			return;
+		}
+	}
+
+	_dispatch_root_queue_spawn_workers(dq, pqc, remaining, floor, false);
 #else
 	(void)floor;
 #endif // DISPATCH_USE_PTHREAD_POOL
@@ -7419,6 +8689,10 @@ _dispatch_root_queue_drain(dispatch_queue_global_t dq,
 		_dispatch_ack_quantum_expiry_action();
 #endif
 	}
+#if HAVE_DISPATCH_WORKQ_SCHED
+	// there is no kernel to undo our overrides when the thread parks
+	if (reset) _dispatch_wqthread_override_reset();
+#endif
 
 	// overcommit or not. worker thread
 	if (pri & DISPATCH_PRIORITY_FLAG_OVERCOMMIT) {
@@ -7490,6 +8764,94 @@ _dispatch_worker_thread2(pthread_priority_t pp)
 #endif // !DISPATCH_USE_INTERNAL_WORKQUEUE
 
 #if DISPATCH_USE_PTHREAD_POOL
+static void
+_dispatch_worker_spin_init(void)
+{
+	unsigned long usec = DISPATCH_WORKER_SPIN_USEC;
+	int spinners = DISPATCH_WORKER_SPINNERS;
+	char *e;
+
+	if ((e = getenv("LIBDISPATCH_WORKER_SPIN_USEC"))) {
+		usec = strtoul(e, NULL, 0);
+	}
+	if ((e = getenv("LIBDISPATCH_WORKER_SPINNERS"))) {
+		spinners = atoi(e);
+	}
+	if (spinners <= 0) {
+		usec = 0;
+	}
+	_dispatch_worker_spin_max = _dispatch_time_nano2mach(usec * NSEC_PER_USEC);
+	_dispatch_worker_spinners_max = spinners;
+}
+
+DISPATCH_NOINLINE
+static void
+_dispatch_worker_spin_note_poke(dispatch_pthread_root_queue_context_t pqc)
+{
+	uint64_t now = _dispatch_uptime();
+	uint64_t last = os_atomic_xchg(&pqc->dpq_last_poke, now, relaxed);
+	uint64_t interval, delta;
+
+	if (unlikely(!last || now <= last)) {
+		return;
+	}
+	// Anything much longer than the spin budget is "idle", clamp it so that a
+	// single long pause doesn't take ages to be forgotten
+	delta = MIN(now - last, 8 * _dispatch_worker_spin_max);
+	interval = os_atomic_load(&pqc->dpq_poke_interval, relaxed);
+	interval = interval ? interval - interval / 8 + delta / 8 : delta;
+	os_atomic_store(&pqc->dpq_poke_interval, interval, relaxed);
+}
+
+/*
+ * Poll the root queue for a while before parking, so that a worker is
+ * immediately available for work that arrives in quick succession, without
+ * the enqueuer paying for a semaphore signal and the worker for a wakeup.
+ *
+ * The spin duration adapts to the average time between pokes of the queue:
+ * there is no spinning if work arrives less often than the spin budget, and
+ * otherwise workers spin for about twice the inter-arrival time. Only a few
+ * workers per root queue may spin at a time to bound the CPU cost.
+ */
+static bool
+_dispatch_worker_spin(dispatch_queue_global_t dq,
+		dispatch_pthread_root_queue_context_t pqc)
+{
+	uint64_t interval, deadline;
+	bool found = false;
+
+	if (!_dispatch_worker_spin_max) {
+		return false;
+	}
+	interval = os_atomic_load(&pqc->dpq_poke_interval, relaxed);
+	if (!interval || interval > _dispatch_worker_spin_max) {
+		return false;
+	}
+	if (os_atomic_inc(&pqc->dpq_spinners, relaxed) >
+			_dispatch_worker_spinners_max) {
+		os_atomic_dec(&pqc->dpq_spinners, relaxed);
+		return false;
+	}
+
+	deadline = _dispatch_uptime() + MIN(2 * interval, _dispatch_worker_spin_max);
+	do {
+		if (_dispatch_queue_class_probe(dq)) {
+			found = true;
+			break;
+		}
+		dispatch_hardware_pause();
+	} while (_dispatch_uptime() < deadline);
+
+	os_atomic_dec(&pqc->dpq_spinners, relaxed);
+	if (!found) {
+		// pairs with the fence in _dispatch_root_queue_poke_slow(), an
+		// enqueuer that saw us spinning hasn't woken anyone for us
+		os_atomic_thread_fence(seq_cst);
+		found = _dispatch_queue_class_probe(dq);
+	}
+	return found;
+}
+
 static inline void
 _dispatch_root_queue_init_pthread_pool(dispatch_queue_global_t dq,
 		int pool_size, dispatch_priority_t pri)
@@ -7501,6 +8863,9 @@ _dispatch_root_queue_init_pthread_pool(dispatch_queue_global_t dq,
 	}
 	if (pool_size && pool_size < thread_pool_size) thread_pool_size = pool_size;
 	dq->dgq_thread_pool_size = thread_pool_size;
+	pqc->dpq_default_max_threads = (uint32_t)thread_pool_size;
+	pqc->dpq_max_threads = (uint32_t)thread_pool_size;
+	pqc->dpq_idle_timeout = DISPATCH_WORKER_IDLE_TIMEOUT;
 	qos_class_t cls = _dispatch_qos_to_qos_class(_dispatch_priority_qos(pri) ?:
 			_dispatch_priority_fallback_qos(pri));
 	if (cls) {
@@ -7516,10 +8881,145 @@ _dispatch_root_queue_init_pthread_pool(dispatch_queue_global_t dq,
 		dispatch_assume_zero(r);
 #endif // HAVE_PTHREAD_WORKQUEUE_QOS
 	}
-	_dispatch_sema4_t *sema = &pqc->dpq_thread_mediator.dsema_sema;
-	pqc->dpq_thread_mediator.do_vtable = DISPATCH_VTABLE(semaphore);
-	_dispatch_sema4_init(sema, _DSEMA4_POLICY_LIFO);
-	_dispatch_sema4_create(sema, _DSEMA4_POLICY_LIFO);
+	_dispatch_parking_lot_init(&pqc->dpq_parking_lot);
+}
+
+// Returns how many of n threads can be created now, and in delay how long
+// to wait before asking for the others
+static int
+_dispatch_worker_spawn_budget(dispatch_pthread_root_queue_context_t pqc,
+		int n, uint64_t *delay)
+{
+	uint64_t interval = os_atomic_load(&pqc->dpq_spawn_interval, relaxed);
+	uint64_t now, last;
+
+	*delay = interval;
+	if (likely(!interval)) {
+		return n;
+	}
+	// never throttle the first thread, nothing would drain the queue
+	if (os_atomic_load(&pqc->dpq_threads, relaxed) == 0) {
+		os_atomic_store(&pqc->dpq_last_spawn, _dispatch_uptime(), relaxed);
+		return 1;
+	}
+	now = _dispatch_uptime();
+	last = os_atomic_load(&pqc->dpq_last_spawn, relaxed);
+	if (now - last < interval) {
+		*delay = interval - (now - last);
+		os_atomic_inc(&pqc->dpq_throttled, relaxed);
+		return 0;
+	}
+	if (!os_atomic_cmpxchg(&pqc->dpq_last_spawn, last, now, relaxed)) {
+		// another thread was just created
+		os_atomic_inc(&pqc->dpq_throttled, relaxed);
+		return 0;
+	}
+	return 1;
+}
+
+// Creates the threads the pool policy wants to keep around, if missing
+static void
+_dispatch_worker_prewarm(dispatch_queue_global_t dq,
+		dispatch_pthread_root_queue_context_t pqc)
+{
+	uint32_t min_threads = os_atomic_load(&pqc->dpq_min_threads, relaxed);
+	uint32_t threads = os_atomic_load(&pqc->dpq_threads, relaxed);
+
+	if (threads < min_threads) {
+		_dispatch_root_queue_spawn_workers(dq, pqc,
+				(int)(min_threads - threads), 0, true);
+	}
+}
+
+// Defers thread creations the spawn interval throttled. They are asked for
+// again by the next poke of the root queue, or by the workqueue monitor, once
+// the delay elapsed, see _dispatch_root_queue_respawn().
+static void
+_dispatch_worker_spawn_later(dispatch_pthread_root_queue_context_t pqc,
+		int n, uint64_t delay)
+{
+	if (os_atomic_add_orig(&pqc->dpq_respawn, n, relaxed) == 0) {
+		os_atomic_store(&pqc->dpq_respawn_at, _dispatch_uptime() + delay,
+				relaxed);
+	}
+}
+
+// Returns the deferred thread creations which are due
+static int
+_dispatch_worker_respawn_take(dispatch_pthread_root_queue_context_t pqc)
+{
+	if (!os_atomic_load(&pqc->dpq_respawn, relaxed) || _dispatch_uptime() <
+			os_atomic_load(&pqc->dpq_respawn_at, relaxed)) {
+		return 0;
+	}
+	return os_atomic_xchg(&pqc->dpq_respawn, 0, relaxed);
+}
+
+void
+_dispatch_root_queue_respawn(dispatch_queue_global_t dq)
+{
+	dispatch_pthread_root_queue_context_t pqc = dq->do_ctxt;
+	int n = _dispatch_worker_respawn_take(pqc);
+
+	if (likely(!n)) {
+		return;
+	}
+	// the busy workers may have drained the queue meanwhile
+	if (_dispatch_queue_class_probe(dq)) {
+		_dispatch_root_queue_poke_slow(dq, n, 0);
+	}
+	_dispatch_worker_prewarm(dq, pqc);
+}
+
+static bool
+_dispatch_worker_retire(dispatch_pthread_root_queue_context_t pqc)
+{
+	uint32_t old_threads, new_threads;
+
+	os_atomic_rmw_loop(&pqc->dpq_threads, old_threads, new_threads, relaxed, {
+		if (old_threads <= os_atomic_load(&pqc->dpq_min_threads, relaxed)) {
+			os_atomic_rmw_loop_give_up(return false);
+		}
+		new_threads = old_threads - 1;
+	});
+	os_atomic_inc(&pqc->dpq_exited, relaxed);
+	return true;
+}
+
+static bool
+_dispatch_worker_park(dispatch_queue_global_t dq,
+		dispatch_pthread_root_queue_context_t pqc)
+{
+	dispatch_parking_lot_t dpl = &pqc->dpq_parking_lot;
+	dispatch_time_t deadline;
+	uint64_t latency = 0, timeout;
+	uint32_t key;
+
+	for (;;) {
+		key = _dispatch_parking_lot_prepare(dpl);
+		if (unlikely(_dispatch_queue_class_probe(dq))) {
+			// the enqueuer may have missed us, and may not have woken anyone
+			_dispatch_parking_lot_cancel(dpl);
+			return true;
+		}
+		timeout = os_atomic_load(&pqc->dpq_idle_timeout, relaxed);
+		deadline = DISPATCH_TIME_FOREVER;
+		if (timeout < INT64_MAX) {
+			deadline = dispatch_time(0, (int64_t)timeout);
+		}
+		if (_dispatch_parking_lot_wait(dpl, key, deadline, &latency)) {
+			break;
+		}
+		if (_dispatch_worker_retire(pqc)) {
+			return false;
+		}
+		// the pool policy wants this thread to stay warm
+	}
+
+	os_atomic_inc(&pqc->dpq_wakeups, relaxed);
+	os_atomic_add(&pqc->dpq_wake_latency, latency, relaxed);
+	_dispatch_trace_runtime_event(worker_wakeup, dq, latency);
+	return true;
 }
 
 // 6618342 Contact the team that owns the Instrument DTrace probe before
@@ -7556,7 +9056,6 @@ _dispatch_worker_thread(void *context)
 #endif
 	_dispatch_introspection_thread_add();
 
-	const int64_t timeout = 5ull * NSEC_PER_SEC;
 	pthread_priority_t pp = _dispatch_get_priority();
 	dispatch_priority_t pri = dq->dq_priority;
 
@@ -7578,20 +9077,22 @@ _dispatch_worker_thread(void *context)
 	}
 
 #if DISPATCH_USE_INTERNAL_WORKQUEUE
-	bool monitored = ((pri & (DISPATCH_PRIORITY_FLAG_OVERCOMMIT |
-			DISPATCH_PRIORITY_FLAG_MANAGER)) == 0);
+	bool monitored = !(pri & DISPATCH_PRIORITY_FLAG_MANAGER);
 	if (monitored) _dispatch_workq_worker_register(dq);
+	_dispatch_workq_worker_sched_start(dq);
 #endif
 
+	bool spin = !(pri & DISPATCH_PRIORITY_FLAG_MANAGER);
 	do {
 		_dispatch_trace_runtime_event(worker_unpark, dq, 0);
 		_dispatch_root_queue_drain(dq, pri, DISPATCH_INVOKE_REDIRECTING_DRAIN);
 		_dispatch_reset_priority_and_voucher(pp, NULL);
 		_dispatch_trace_runtime_event(worker_park, NULL, 0);
-	} while (dispatch_semaphore_wait(&pqc->dpq_thread_mediator,
-			dispatch_time(0, timeout)) == 0);
+	} while ((spin && _dispatch_worker_spin(dq, pqc)) ||
+			_dispatch_worker_park(dq, pqc));
 
 #if DISPATCH_USE_INTERNAL_WORKQUEUE
+	_dispatch_workq_worker_sched_end(dq);
 	if (monitored) _dispatch_workq_worker_unregister(dq);
 #endif
 	(void)os_atomic_inc(&dq->dgq_thread_pool_size, release);
@@ -7682,6 +9183,91 @@ _dispatch_root_queue_push(dispatch_queue_global_t rq, dispatch_object_t dou,
 	_dispatch_root_queue_push_inline(rq, dou, dou, 1);
 }
 
+#pragma mark -
+#pragma mark dispatch_async_batch_f
+
+DISPATCH_NOINLINE
+static void
+_dispatch_async_batch_push(dispatch_queue_t dq, dispatch_continuation_t head,
+		dispatch_continuation_t tail, size_t count, dispatch_qos_t qos)
+{
+	switch (dx_type(dq)) {
+	case DISPATCH_QUEUE_GLOBAL_ROOT_TYPE:
+#if DISPATCH_USE_PTHREAD_ROOT_QUEUES
+	case DISPATCH_QUEUE_PTHREAD_ROOT_TYPE:
+#endif
+	{
+		dispatch_queue_global_t rq = upcast(dq)._dgq;
+#if HAVE_PTHREAD_WORKQUEUE_QOS
+		if (_dispatch_root_queue_push_needs_override(rq, qos)) {
+			// overrides are per item, the list can't be published at once
+			dispatch_continuation_t dc = head, next;
+			do {
+				next = dc->do_next;
+				_dispatch_root_queue_push_override(rq, dc, qos);
+			} while (dc != tail && (dc = next));
+			return;
+		}
+#endif
+		// there is no point in asking for more threads than there are CPUs,
+		// the thread pool caps the request anyway
+		int n = (int)MIN(count, (size_t)dispatch_hw_config(active_cpus));
+		return _dispatch_root_queue_push_inline(rq, head, tail, n);
+	}
+	default:
+		return _dispatch_lane_push_list(upcast(dq)._dl, head, tail, qos);
+	}
+}
+
+DISPATCH_NOINLINE
+void
+dispatch_async_batch_f(dispatch_queue_t dq, size_t count,
+		void *_Nullable const *contexts, dispatch_function_t func)
+{
+	dispatch_continuation_t dc, head = NULL, tail = NULL;
+	uintptr_t dc_flags = DC_FLAG_CONSUME;
+	dispatch_qos_t qos = 0;
+
+	switch (dx_type(dq)) {
+	case DISPATCH_QUEUE_SERIAL_TYPE:
+	case DISPATCH_QUEUE_CONCURRENT_TYPE:
+	case DISPATCH_QUEUE_GLOBAL_ROOT_TYPE:
+#if DISPATCH_USE_PTHREAD_ROOT_QUEUES
+	case DISPATCH_QUEUE_PTHREAD_ROOT_TYPE:
+#endif
+		break;
+	default:
+		// workloops, the main and manager queues have their own push
+		// semantics, enqueue items one at a time
+		for (size_t i = 0; i < count; i++) {
+			dispatch_async_f(dq, contexts[i], func);
+		}
+		return;
+	}
+
+	if (unlikely(count == 0)) {
+		return;
+	}
+
+	// Link the continuations privately, they only become visible to
+	// drainers when the whole list is published with a single exchange
+	for (size_t i = 0; i < count; i++) {
+		dc = _dispatch_continuation_alloc();
+		qos = _dispatch_continuation_init_f(dc, dq, contexts[i], func, 0,
+				dc_flags);
+#if DISPATCH_INTROSPECTION
+		_dispatch_trace_item_push(dq, dc);
+#endif
+		if (tail) {
+			tail->do_next = dc;
+		} else {
+			head = dc;
+		}
+		tail = dc;
+	}
+	_dispatch_async_batch_push(dq, head, tail, count, qos);
+}
+
 #pragma mark -
 #pragma mark dispatch_pthread_root_queue
 #if DISPATCH_USE_PTHREAD_ROOT_QUEUES
@@ -7799,7 +9385,7 @@ _dispatch_pthread_root_queue_dispose(dispatch_queue_global_t dq,
 #if !defined(_WIN32)
 	pthread_attr_destroy(&pqc->dpq_thread_attr);
 #endif
-	_dispatch_semaphore_dispose(&pqc->dpq_thread_mediator, NULL);
+	_dispatch_parking_lot_destroy(&pqc->dpq_parking_lot);
 	if (pqc->dpq_thread_configure) {
 		Block_release(pqc->dpq_thread_configure);
 	}
@@ -7808,6 +9394,261 @@ _dispatch_pthread_root_queue_dispose(dispatch_queue_global_t dq,
 }
 
 #endif // DISPATCH_USE_PTHREAD_ROOT_QUEUES
+#pragma mark -
+#pragma mark dispatch_pthread_pool_policy
+#if DISPATCH_USE_PTHREAD_POOL
+
+static dispatch_pthread_root_queue_context_t
+_dispatch_pthread_pool_context(dispatch_queue_global_t dq)
+{
+	switch (dx_type(dq)) {
+#if DISPATCH_USE_INTERNAL_WORKQUEUE
+	case DISPATCH_QUEUE_GLOBAL_ROOT_TYPE:
+		_dispatch_root_queues_init();
+		return dq->do_ctxt;
+#endif
+#if DISPATCH_USE_PTHREAD_ROOT_QUEUES
+	case DISPATCH_QUEUE_PTHREAD_ROOT_TYPE:
+		return dq->do_ctxt;
+#endif
+	default:
+		DISPATCH_CLIENT_CRASH(dx_type(dq),
+				"Queue is not serviced by a pthread pool");
+	}
+}
+
+void
+dispatch_pthread_pool_set_policy(dispatch_queue_global_t dq,
+		const dispatch_pthread_pool_policy_s *policy)
+{
+	dispatch_pthread_root_queue_context_t pqc;
+	uint32_t max_threads = policy->dpp_max_threads, old_max_threads;
+	uint64_t idle_timeout = policy->dpp_idle_timeout;
+
+	if (unlikely(policy->dpp_version != DISPATCH_PTHREAD_POOL_POLICY_VERSION)) {
+		DISPATCH_CLIENT_CRASH(policy->dpp_version,
+				"Invalid pthread pool policy version");
+	}
+	pqc = _dispatch_pthread_pool_context(dq);
+	if (!max_threads) {
+		max_threads = pqc->dpq_default_max_threads;
+	}
+	if (max_threads > DISPATCH_WORKQ_MAX_PTHREAD_COUNT) {
+		max_threads = DISPATCH_WORKQ_MAX_PTHREAD_COUNT;
+	}
+	if (unlikely(policy->dpp_min_threads > max_threads)) {
+		DISPATCH_CLIENT_CRASH(policy->dpp_min_threads,
+				"Pthread pool minimum exceeds its maximum");
+	}
+
+	os_atomic_store(&pqc->dpq_min_threads, policy->dpp_min_threads, relaxed);
+	os_atomic_store(&pqc->dpq_idle_timeout,
+			idle_timeout ?: DISPATCH_WORKER_IDLE_TIMEOUT, relaxed);
+	os_atomic_store(&pqc->dpq_spawn_interval,
+			_dispatch_time_nano2mach(policy->dpp_spawn_interval), relaxed);
+
+	// dgq_thread_pool_size is the number of threads that can still be
+	// created, it goes negative when shrinking a pool with busy threads
+	old_max_threads = os_atomic_xchg(&pqc->dpq_max_threads, max_threads,
+			relaxed);
+	if (max_threads != old_max_threads) {
+		os_atomic_add(&dq->dgq_thread_pool_size,
+				(int)max_threads - (int)old_max_threads, release);
+		if (max_threads > old_max_threads) {
+			_dispatch_root_queue_poke(dq, 1, 0);
+		}
+	}
+	_dispatch_worker_prewarm(dq, pqc);
+	_dispatch_object_debug(dq, "%s", __func__);
+}
+
+void
+dispatch_pthread_pool_get_policy(dispatch_queue_global_t dq,
+		dispatch_pthread_pool_policy_t policy)
+{
+	dispatch_pthread_root_queue_context_t pqc;
+
+	pqc = _dispatch_pthread_pool_context(dq);
+	*policy = (dispatch_pthread_pool_policy_s){
+		.dpp_version = DISPATCH_PTHREAD_POOL_POLICY_VERSION,
+		.dpp_min_threads = os_atomic_load(&pqc->dpq_min_threads, relaxed),
+		.dpp_max_threads = os_atomic_load(&pqc->dpq_max_threads, relaxed),
+		.dpp_idle_timeout = os_atomic_load(&pqc->dpq_idle_timeout, relaxed),
+		.dpp_spawn_interval = _dispatch_time_mach2nano(
+				os_atomic_load(&pqc->dpq_spawn_interval, relaxed)),
+	};
+}
+
+void
+dispatch_pthread_pool_get_stats(dispatch_queue_global_t dq,
+		dispatch_pthread_pool_stats_t stats)
+{
+	dispatch_pthread_root_queue_context_t pqc;
+
+	pqc = _dispatch_pthread_pool_context(dq);
+	*stats = (dispatch_pthread_pool_stats_s){
+		.dpps_threads = os_atomic_load(&pqc->dpq_threads, relaxed),
+		.dpps_spawned = os_atomic_load(&pqc->dpq_spawned, relaxed),
+		.dpps_exited = os_atomic_load(&pqc->dpq_exited, relaxed),
+		.dpps_throttled = os_atomic_load(&pqc->dpq_throttled, relaxed),
+	};
+}
+
+#else // DISPATCH_USE_PTHREAD_POOL
+
+void
+dispatch_pthread_pool_set_policy(dispatch_queue_global_t dq,
+		const dispatch_pthread_pool_policy_s *policy)
+{
+	(void)policy;
+	DISPATCH_CLIENT_CRASH(dx_type(dq), "Queue is not serviced by a pthread pool");
+}
+
+void
+dispatch_pthread_pool_get_policy(dispatch_queue_global_t dq,
+		dispatch_pthread_pool_policy_t policy)
+{
+	(void)policy;
+	DISPATCH_CLIENT_CRASH(dx_type(dq), "Queue is not serviced by a pthread pool");
+}
+
+void
+dispatch_pthread_pool_get_stats(dispatch_queue_global_t dq,
+		dispatch_pthread_pool_stats_t stats)
+{
+	(void)stats;
+	DISPATCH_CLIENT_CRASH(dx_type(dq), "Queue is not serviced by a pthread pool");
+}
+
+#endif // DISPATCH_USE_PTHREAD_POOL
+
+void
+dispatch_qos_get_sched_stats(dispatch_qos_class_t qos_class,
+		dispatch_qos_sched_stats_t stats)
+{
+	dispatch_qos_t qos = _dispatch_qos_from_qos_class(qos_class);
+
+	if (unlikely(qos == DISPATCH_QOS_UNSPECIFIED || qos > DISPATCH_QOS_MAX)) {
+		DISPATCH_CLIENT_CRASH(qos_class, "Invalid QoS class");
+	}
+#if HAVE_DISPATCH_WORKQ_SCHED
+	_dispatch_workq_get_sched_stats(qos, stats);
+#else
+	(void)stats;
+	DISPATCH_CLIENT_CRASH(qos_class, "Worker threads aren't scheduled by QoS "
+			"class by libdispatch on this platform");
+#endif
+}
+
+size_t
+dispatch_worker_pool_get_health(dispatch_worker_pool_health_t health,
+		size_t count)
+{
+#if HAVE_DISPATCH_WORKQ_MONITORING
+	size_t n = MIN(count, (size_t)DISPATCH_QOS_NBUCKETS);
+	for (size_t i = 0; i < n; i++) {
+		_dispatch_workq_get_health(DISPATCH_QOS_FOR_BUCKET(i), &health[i]);
+	}
+	return n;
+#else
+	(void)health;
+	DISPATCH_CLIENT_CRASH(count, "Worker pool health isn't available "
+			"on this platform");
+#endif
+}
+
+#if HAVE_DISPATCH_WORKQ_MONITORING
+typedef struct dispatch_worker_pool_health_ctxt_s {
+	void *dwphc_ctxt;
+	dispatch_worker_pool_health_handler_t dwphc_handler;
+} *dispatch_worker_pool_health_ctxt_t;
+
+static dispatch_unfair_lock_s _dispatch_worker_pool_health_lock;
+static dispatch_source_t _dispatch_worker_pool_health_source;
+
+static void
+_dispatch_worker_pool_health_fire(void *ctxt)
+{
+	dispatch_worker_pool_health_ctxt_t dwphc = ctxt;
+	dispatch_worker_pool_health_s health[DISPATCH_QOS_NBUCKETS];
+	size_t n;
+
+	n = dispatch_worker_pool_get_health(health, countof(health));
+	dwphc->dwphc_handler(dwphc->dwphc_ctxt, health, n);
+}
+#endif // HAVE_DISPATCH_WORKQ_MONITORING
+
+void
+dispatch_worker_pool_set_health_handler_f(uint64_t interval, void *ctxt,
+		dispatch_worker_pool_health_handler_t handler)
+{
+#if HAVE_DISPATCH_WORKQ_MONITORING
+	dispatch_source_t ds = NULL, old_ds;
+
+	if (handler) {
+		if (unlikely(interval == 0 || interval > INT64_MAX)) {
+			DISPATCH_CLIENT_CRASH(interval, "Invalid health handler interval");
+		}
+		dispatch_worker_pool_health_ctxt_t dwphc;
+		dwphc = _dispatch_calloc(1, sizeof(*dwphc));
+		dwphc->dwphc_ctxt = ctxt;
+		dwphc->dwphc_handler = handler;
+
+		// overcommit, so that starving the pool doesn't starve the handler
+		ds = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0,
+				_dispatch_get_root_queue(DISPATCH_QOS_UTILITY, true)->_as_dq);
+		dispatch_set_context(ds, dwphc);
+		dispatch_set_finalizer_f(ds, free);
+		dispatch_source_set_event_handler_f(ds,
+				_dispatch_worker_pool_health_fire);
+		dispatch_source_set_timer(ds,
+				dispatch_time(DISPATCH_TIME_NOW, (int64_t)interval),
+				interval, interval / 10);
+	}
+
+	_dispatch_unfair_lock_lock(&_dispatch_worker_pool_health_lock);
+	old_ds = _dispatch_worker_pool_health_source;
+	_dispatch_worker_pool_health_source = ds;
+	_dispatch_unfair_lock_unlock(&_dispatch_worker_pool_health_lock);
+
+	if (old_ds) {
+		dispatch_source_cancel(old_ds);
+		dispatch_release(old_ds);
+	}
+	if (ds) {
+		dispatch_activate(ds);
+	}
+#else
+	(void)interval; (void)ctxt;
+	if (handler) {
+		DISPATCH_CLIENT_CRASH(0, "Worker pool health isn't available "
+				"on this platform");
+	}
+#endif
+}
+
+bool
+dispatch_blocked_worker_detector_enable(uint64_t threshold,
+		dispatch_blocked_worker_flags_t flags, void *ctxt,
+		dispatch_blocked_worker_handler_t handler)
+{
+#if HAVE_DISPATCH_WORKQ_SCHED
+	_dispatch_workq_blocking_configure(threshold, flags, ctxt, handler);
+	return true;
+#else
+	(void)threshold; (void)flags; (void)ctxt; (void)handler;
+	return false;
+#endif
+}
+
+void
+dispatch_blocked_worker_detector_disable(void)
+{
+#if HAVE_DISPATCH_WORKQ_SCHED
+	_dispatch_workq_blocking_configure(0, 0, NULL, NULL);
+#endif
+}
+
 #pragma mark -
 #pragma mark dispatch_runloop_queue
 
@@ -8768,6 +10609,14 @@ libdispatch_init(void)
 		_dispatch_mode |= DISPATCH_COOPERATIVE_POOL_STRICT;
 	}
 
+	if (_dispatch_getenv_bool("LIBDISPATCH_QUEUE_STATS", false)) {
+		_dispatch_mode |= DISPATCH_MODE_QUEUE_STATS;
+	}
+
+#if DISPATCH_USE_PTHREAD_POOL
+	_dispatch_worker_spin_init();
+#endif
+
 
 #if DISPATCH_DEBUG || DISPATCH_PROFILE
 #if DISPATCH_USE_KEVENT_WORKQUEUE
@@ -8815,6 +10664,13 @@ libdispatch_init(void)
 	_dispatch_thread_key_create(&dispatch_enqueue_key, NULL);
 	_dispatch_thread_key_create(&dispatch_msgv_aux_key, free);
 	_dispatch_thread_key_create(&dispatch_set_threadname_key, NULL);
+#if HAVE_DISPATCH_WORKQ_SCHED
+	_dispatch_thread_key_create(&dispatch_workq_thread_key, NULL);
+#endif
+#if DISPATCH_USE_CALLOUT_PROFILE
+	_dispatch_thread_key_create(&dispatch_callout_profile_key,
+			_dispatch_callout_profile_thread_cleanup);
+#endif
 #endif
 #if DISPATCH_USE_RESOLVERS // rdar://problem/8541707
 	_dispatch_main_q.do_targetq = _dispatch_get_default_queue(true);
@@ -8832,6 +10688,12 @@ libdispatch_init(void)
 #endif
 	_dispatch_hw_config_init();
 	_dispatch_time_init();
+#if DISPATCH_USE_TRACE_RING
+	_dispatch_trace_ring_init();
+#endif
+#if DISPATCH_USE_CALLOUT_PROFILE
+	_dispatch_callout_profile_init();
+#endif
 	_dispatch_vtable_init();
 	_os_object_init();
 	_voucher_init();
@@ -8839,6 +10701,7 @@ libdispatch_init(void)
 	_workgroup_init();
 #endif
 	_dispatch_introspection_init();
+	_dispatch_queue_graph_init();
 }
 
 #if DISPATCH_USE_THREAD_LOCAL_STORAGE
@@ -8967,6 +10830,11 @@ _libdispatch_tsd_cleanup(void *ctx)
 	_tsd_call_cleanup(dispatch_enqueue_key, NULL);
 	_tsd_call_cleanup(dispatch_msgv_aux_key, free);
 	_tsd_call_cleanup(dispatch_set_threadname_key, NULL);
+	_tsd_call_cleanup(dispatch_workq_thread_key, NULL);
+#if DISPATCH_USE_CALLOUT_PROFILE
+	_tsd_call_cleanup(dispatch_callout_profile_key,
+			_dispatch_callout_profile_thread_cleanup);
+#endif
 	_tsd_call_cleanup(dispatch_dsc_key, NULL);
 #ifdef __ANDROID__
 	if (_dispatch_thread_detach_callback) {
@@ -0,0 +1,1015 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+#include "internal.h"
+#if __has_include(<execinfo.h>)
+#include <execinfo.h>
+#define DISPATCH_WAIT_ANALYZER_USE_BACKTRACE 1
+#endif
+
+/*
+ * The queue graph is a snapshot of the target queue hierarchy:
+ * - the root queues, the main queue and the manager queue,
+ * - every queue in introspection builds, or else the queues with statistics
+ *   enabled, see dispatch_queue_enable_stats(),
+ * - the targets of all of these,
+ * along with the threads blocked in dispatch_sync() and friends, and in group
+ * and semaphore waits while the wait analyzer is enabled.
+ *
+ * The snapshot is taken with the registries locked, which keeps their queues
+ * allocated, and is printed after they are unlocked. The target of every
+ * described queue is retained by the snapshot, as it may be changed while the
+ * snapshot is taken (see _dispatch_lane_legacy_set_target_queue()), which
+ * keeps the whole hierarchy allocated until the snapshot is disposed of.
+ *
+ * Nodes are found by queue address with an open addressed hash table holding
+ * node indexes + 1, twice as large as the node array. Once the snapshot is
+ * complete, the nodes targeting each node are linked in a list by index + 1
+ * as well, for the text output.
+ */
+
+#define DISPATCH_QUEUE_GRAPH_LABEL_SIZE 64
+
+typedef struct dispatch_queue_graph_node_s {
+	dispatch_queue_t dqgn_queue;
+	dispatch_queue_t dqgn_target;
+	const char *dqgn_kind;
+	char dqgn_label[DISPATCH_QUEUE_GRAPH_LABEL_SIZE];
+	unsigned long dqgn_serialnum;
+	uint64_t dqgn_state;
+	uint64_t dqgn_depth;
+	size_t dqgn_first_child;
+	size_t dqgn_next_sibling;
+	int32_t dqgn_thread_requests;
+	int32_t dqgn_pool_size;
+	uint16_t dqgn_width;
+	bool dqgn_is_root;
+	bool dqgn_has_depth;
+} *dispatch_queue_graph_node_t;
+
+typedef struct dispatch_queue_graph_waiter_s {
+	dispatch_wait_kind_t dqgw_kind;
+	const void *dqgw_object;
+	dispatch_queue_t dqgw_queue;
+	dispatch_queue_t dqgw_top_queue;
+	dispatch_tid dqgw_tid;
+	uint64_t dqgw_duration;
+} *dispatch_queue_graph_waiter_t;
+
+typedef struct dispatch_queue_graph_s {
+	dispatch_queue_graph_node_t dqg_nodes;
+	size_t *dqg_index;
+	size_t dqg_count;
+	size_t dqg_size;
+	dispatch_queue_graph_waiter_t dqg_waiters;
+	size_t dqg_nwaiters;
+} *dispatch_queue_graph_t;
+
+#pragma mark -
+#pragma mark waiters
+
+static dispatch_unfair_lock_s _dispatch_sync_waiters_lock;
+static TAILQ_HEAD(, dispatch_sync_waiter_s) _dispatch_sync_waiters =
+		TAILQ_HEAD_INITIALIZER(_dispatch_sync_waiters);
+static size_t _dispatch_sync_waiters_count;
+// set once something may look at the waiters, which registering costs a lock
+static bool _dispatch_sync_waiters_tracked;
+bool _dispatch_wait_analyzer_enabled;
+
+static dispatch_qos_t
+_dispatch_wait_analyzer_root_qos(dispatch_queue_t dq)
+{
+	for (; dq; dq = dq->do_targetq) {
+		if (_dispatch_queue_is_thread_bound(dq)) {
+			return DISPATCH_QOS_UNSPECIFIED;
+		}
+		if (dx_hastypeflag(dq, QUEUE_ROOT)) {
+			return _dispatch_priority_qos(dq->dq_priority);
+		}
+	}
+	return DISPATCH_QOS_UNSPECIFIED;
+}
+
+void
+_dispatch_sync_waiter_register(dispatch_sync_waiter_t dsw)
+{
+	if (likely(!os_atomic_load(&_dispatch_sync_waiters_tracked, relaxed))) {
+		return;
+	}
+	dsw->dsw_registered = true;
+
+	if (unlikely(os_atomic_load(&_dispatch_wait_analyzer_enabled, relaxed))) {
+		// threads without a QoS run at the one of their root queue
+		dsw->dsw_qos = _dispatch_qos_from_pp(_dispatch_get_priority());
+		if (!dsw->dsw_qos) {
+			dsw->dsw_qos = _dispatch_wait_analyzer_root_qos(
+					_dispatch_queue_get_current());
+		}
+#if DISPATCH_WAIT_ANALYZER_USE_BACKTRACE
+		dsw->dsw_frames = _dispatch_calloc(DISPATCH_WAIT_REPORT_FRAMES,
+				sizeof(void *));
+		int n = backtrace(dsw->dsw_frames, DISPATCH_WAIT_REPORT_FRAMES);
+		dsw->dsw_nframes = (uint32_t)MAX(n, 0);
+#endif
+	}
+
+	_dispatch_unfair_lock_lock(&_dispatch_sync_waiters_lock);
+	TAILQ_INSERT_TAIL(&_dispatch_sync_waiters, dsw, dsw_list);
+	_dispatch_sync_waiters_count++;
+	_dispatch_unfair_lock_unlock(&_dispatch_sync_waiters_lock);
+}
+
+void
+_dispatch_sync_waiter_unregister(dispatch_sync_waiter_t dsw)
+{
+	// tracking may have started while this thread was waiting
+	if (likely(!dsw->dsw_registered)) {
+		return;
+	}
+	_dispatch_unfair_lock_lock(&_dispatch_sync_waiters_lock);
+	TAILQ_REMOVE(&_dispatch_sync_waiters, dsw, dsw_list);
+	_dispatch_sync_waiters_count--;
+	_dispatch_unfair_lock_unlock(&_dispatch_sync_waiters_lock);
+	free(dsw->dsw_frames);
+}
+
+static const char *
+_dispatch_wait_kind_name(dispatch_wait_kind_t kind)
+{
+	switch (kind) {
+	case DISPATCH_WAIT_SYNC:
+		return "sync";
+	case DISPATCH_WAIT_GROUP:
+		return "group";
+	case DISPATCH_WAIT_SEMAPHORE:
+		return "semaphore";
+	}
+	return "unknown";
+}
+
+#pragma mark -
+#pragma mark snapshot
+
+DISPATCH_ALWAYS_INLINE
+static inline size_t
+_dispatch_queue_graph_hash(dispatch_queue_graph_t dqg, dispatch_queue_t dq)
+{
+	// queues are at least 16 bytes aligned, and the index has 2 * dqg_size
+	// slots, a power of 2
+	uintptr_t h = (uintptr_t)dq >> 4;
+	return (size_t)(h ^ (h >> 11) ^ (h >> 23)) & (2 * dqg->dqg_size - 1);
+}
+
+static dispatch_queue_graph_node_t
+_dispatch_queue_graph_find(dispatch_queue_graph_t dqg, dispatch_queue_t dq)
+{
+	size_t i, idx;
+
+	if (!dqg->dqg_size) {
+		return NULL;
+	}
+	for (i = _dispatch_queue_graph_hash(dqg, dq); (idx = dqg->dqg_index[i]);
+			i = (i + 1) & (2 * dqg->dqg_size - 1)) {
+		if (dqg->dqg_nodes[idx - 1].dqgn_queue == dq) {
+			return &dqg->dqg_nodes[idx - 1];
+		}
+	}
+	return NULL;
+}
+
+static void
+_dispatch_queue_graph_index_insert(dispatch_queue_graph_t dqg, size_t idx)
+{
+	size_t i = _dispatch_queue_graph_hash(dqg, dqg->dqg_nodes[idx].dqgn_queue);
+
+	while (dqg->dqg_index[i]) {
+		i = (i + 1) & (2 * dqg->dqg_size - 1);
+	}
+	dqg->dqg_index[i] = idx + 1;
+}
+
+static dispatch_queue_graph_node_t
+_dispatch_queue_graph_node_alloc(dispatch_queue_graph_t dqg,
+		dispatch_queue_t dq)
+{
+	if (dqg->dqg_count == dqg->dqg_size) {
+		size_t size = dqg->dqg_size ? 2 * dqg->dqg_size : 64;
+		dispatch_queue_graph_node_t nodes;
+
+		nodes = _dispatch_calloc(size, sizeof(struct dispatch_queue_graph_node_s));
+		if (dqg->dqg_count) {
+			memcpy(nodes, dqg->dqg_nodes,
+					dqg->dqg_count * sizeof(struct dispatch_queue_graph_node_s));
+		}
+		free(dqg->dqg_nodes);
+		free(dqg->dqg_index);
+		dqg->dqg_nodes = nodes;
+		dqg->dqg_size = size;
+		dqg->dqg_index = _dispatch_calloc(2 * size, sizeof(size_t));
+		for (size_t i = 0; i < dqg->dqg_count; i++) {
+			_dispatch_queue_graph_index_insert(dqg, i);
+		}
+	}
+	dqg->dqg_nodes[dqg->dqg_count].dqgn_queue = dq;
+	_dispatch_queue_graph_index_insert(dqg, dqg->dqg_count);
+	return &dqg->dqg_nodes[dqg->dqg_count++];
+}
+
+// Returns a reference on the target of dq, released by
+// _dispatch_queue_graph_dispose()
+static dispatch_queue_t
+_dispatch_queue_graph_retain_target(dispatch_queue_t dq)
+{
+	unsigned long metatype = dx_metatype(dq);
+	dispatch_queue_t tq;
+	bool locked = false;
+
+	// the legacy retarget of an active queue swaps do_targetq with the
+	// sidelock held and releases the former target after dropping it, other
+	// queues can't change their target once they are active
+	if ((metatype == _DISPATCH_LANE_TYPE || metatype == _DISPATCH_SOURCE_TYPE) &&
+			!dx_hastypeflag(dq, QUEUE_ROOT) && _dispatch_queue_is_mutable(dq)) {
+		_dispatch_queue_sidelock_lock(upcast(dq)._dl);
+		locked = true;
+	}
+	tq = os_atomic_load(&dq->do_targetq, relaxed);
+	if (tq) _dispatch_retain(tq);
+	if (locked) {
+		_dispatch_queue_sidelock_unlock(upcast(dq)._dl);
+	}
+	return tq;
+}
+
+static void
+_dispatch_queue_graph_dispose(dispatch_queue_graph_t dqg)
+{
+	for (size_t i = 0; i < dqg->dqg_count; i++) {
+		if (dqg->dqg_nodes[i].dqgn_target) {
+			_dispatch_release(dqg->dqg_nodes[i].dqgn_target);
+		}
+	}
+	free(dqg->dqg_nodes);
+	free(dqg->dqg_index);
+	free(dqg->dqg_waiters);
+}
+
+// label is passed for the queues whose own label may already be freed
+static void
+_dispatch_queue_graph_add(dispatch_queue_graph_t dqg, dispatch_queue_t dq,
+		const char *label, dispatch_queue_stats_t stats)
+{
+	dispatch_queue_graph_node_t dqgn;
+
+	for (; dq; dq = dqgn->dqgn_target, label = NULL, stats = NULL) {
+		dqgn = _dispatch_queue_graph_find(dqg, dq);
+		if (dqgn) {
+			// the targets were added with it
+			return;
+		}
+
+		dqgn = _dispatch_queue_graph_node_alloc(dqg, dq);
+		dqgn->dqgn_target = _dispatch_queue_graph_retain_target(dq);
+		dqgn->dqgn_kind = _dispatch_object_class_name(dq);
+		if (!label) label = dq->dq_label;
+		if (label) {
+			strlcpy(dqgn->dqgn_label, label, sizeof(dqgn->dqgn_label));
+		}
+		dqgn->dqgn_serialnum = dq->dq_serialnum;
+		dqgn->dqgn_state = os_atomic_load(&dq->dq_state, relaxed);
+		dqgn->dqgn_width = dq->dq_width;
+		dqgn->dqgn_is_root = dx_hastypeflag(dq, QUEUE_ROOT);
+		if (dqgn->dqgn_is_root) {
+			dispatch_queue_global_t dgq = upcast(dq)._dgq;
+			dqgn->dqgn_thread_requests =
+					os_atomic_load(&dgq->dgq_pending, relaxed);
+			dqgn->dqgn_pool_size =
+					os_atomic_load(&dgq->dgq_thread_pool_size, relaxed);
+		}
+		if (stats) {
+			dqgn->dqgn_has_depth = true;
+			dqgn->dqgn_depth = stats->dqst_depth;
+		}
+	}
+}
+
+static void
+_dispatch_queue_graph_add_lane(void *ctxt, dispatch_lane_t dq,
+		dispatch_queue_stats_t stats)
+{
+	_dispatch_queue_graph_add(ctxt, dq->_as_dq, stats->dqst_label, stats);
+}
+
+static void
+_dispatch_queue_graph_snapshot(dispatch_queue_graph_t dqg)
+{
+	dispatch_sync_waiter_t dsw;
+	uint64_t now;
+
+	for (size_t i = 0; i < DISPATCH_ROOT_QUEUE_COUNT; i++) {
+		_dispatch_queue_graph_add(dqg, _dispatch_root_queues[i]._as_dq,
+				NULL, NULL);
+	}
+	_dispatch_queue_graph_add(dqg, _dispatch_main_q._as_dq, NULL, NULL);
+	_dispatch_queue_graph_add(dqg, _dispatch_mgr_q._as_dq, NULL, NULL);
+
+#if DISPATCH_INTROSPECTION
+	dispatch_queue_introspection_context_t dqic;
+	dispatch_queue_stats_s stats;
+
+	_dispatch_unfair_lock_lock(&_dispatch_introspection.queues_lock);
+	LIST_FOREACH(dqic, &_dispatch_introspection.queues, dqic_list) {
+		dispatch_queue_t dq = dqic->dqic_queue._dq;
+		bool has_stats = (dx_type(dq) == DISPATCH_QUEUE_SERIAL_TYPE ||
+				dx_type(dq) == DISPATCH_QUEUE_CONCURRENT_TYPE) &&
+				dispatch_queue_get_stats(dq, &stats);
+		_dispatch_queue_graph_add(dqg, dq, NULL, has_stats ? &stats : NULL);
+	}
+	_dispatch_unfair_lock_unlock(&_dispatch_introspection.queues_lock);
+#else
+	_dispatch_lane_stats_apply_lanes(dqg, _dispatch_queue_graph_add_lane);
+#endif
+
+	_dispatch_unfair_lock_lock(&_dispatch_sync_waiters_lock);
+	now = _dispatch_uptime();
+	dqg->dqg_waiters = _dispatch_calloc(_dispatch_sync_waiters_count ?: 1,
+			sizeof(struct dispatch_queue_graph_waiter_s));
+	TAILQ_FOREACH(dsw, &_dispatch_sync_waiters, dsw_list) {
+		dispatch_queue_graph_waiter_t dqgw =
+				&dqg->dqg_waiters[dqg->dqg_nwaiters++];
+		dqgw->dqgw_kind = dsw->dsw_kind;
+		dqgw->dqgw_object = dsw->dsw_object;
+		dqgw->dqgw_queue = dsw->dsw_queue;
+		dqgw->dqgw_top_queue = dsw->dsw_top_queue;
+		dqgw->dqgw_tid = dsw->dsw_tid;
+		dqgw->dqgw_duration = _dispatch_time_mach2nano(now - dsw->dsw_start);
+	}
+	// the queues waited for are retained by the callers of dispatch_sync()
+	for (size_t i = 0; i < dqg->dqg_nwaiters; i++) {
+		_dispatch_queue_graph_add(dqg, dqg->dqg_waiters[i].dqgw_top_queue,
+				NULL, NULL);
+	}
+	_dispatch_unfair_lock_unlock(&_dispatch_sync_waiters_lock);
+
+	// walked backwards so that children are listed in snapshot order
+	for (size_t i = dqg->dqg_count; i-- > 0; ) {
+		dispatch_queue_graph_node_t dqgn = &dqg->dqg_nodes[i], parent;
+
+		if (!dqgn->dqgn_target) continue;
+		parent = _dispatch_queue_graph_find(dqg, dqgn->dqgn_target);
+		if (parent) {
+			dqgn->dqgn_next_sibling = parent->dqgn_first_child;
+			parent->dqgn_first_child = i + 1;
+		}
+	}
+}
+
+#pragma mark -
+#pragma mark text output
+
+static void
+_dispatch_queue_graph_print_node_text(FILE *out, dispatch_queue_graph_t dqg,
+		dispatch_queue_graph_node_t dqgn, int depth)
+{
+	uint64_t dq_state = dqgn->dqgn_state;
+	dispatch_tid owner;
+	dispatch_qos_t qos;
+
+	fprintf(out, "%*s%s[%p] = { %s, serial = %lu, width = 0x%x", 2 * depth, "",
+			dqgn->dqgn_label[0] ? dqgn->dqgn_label : dqgn->dqgn_kind,
+			dqgn->dqgn_queue, dqgn->dqgn_kind, dqgn->dqgn_serialnum,
+			dqgn->dqgn_width);
+	if (dqgn->dqgn_is_root) {
+		fprintf(out, ", thread requests = %d, pool size = %d }\n",
+				dqgn->dqgn_thread_requests, dqgn->dqgn_pool_size);
+		goto children;
+	}
+
+	fprintf(out, ", state = 0x%016llx", (unsigned long long)dq_state);
+	if (_dq_state_is_suspended(dq_state)) {
+		fprintf(out, ", suspended = %d", _dq_state_suspend_cnt(dq_state));
+	}
+	if (_dq_state_is_inactive(dq_state)) {
+		fprintf(out, ", inactive");
+	}
+	if (_dq_state_is_enqueued(dq_state)) {
+		fprintf(out, ", enqueued");
+	}
+	if (_dq_state_is_dirty(dq_state)) {
+		fprintf(out, ", dirty");
+	}
+	qos = _dq_state_max_qos(dq_state);
+	if (qos) {
+		fprintf(out, ", max qos %d", qos);
+	}
+	owner = _dq_state_drain_owner(dq_state);
+	if (owner) {
+		fprintf(out, ", draining on 0x%x", owner);
+	}
+	if (_dq_state_is_in_barrier(dq_state)) {
+		fprintf(out, ", in-barrier");
+	} else {
+		fprintf(out, ", in-flight = %d",
+				_dq_state_used_width(dq_state, dqgn->dqgn_width));
+	}
+	if (_dq_state_has_pending_barrier(dq_state)) {
+		fprintf(out, ", pending-barrier");
+	}
+	if (dqgn->dqgn_has_depth) {
+		fprintf(out, ", pending = %llu", (unsigned long long)dqgn->dqgn_depth);
+	}
+	fprintf(out, " }\n");
+
+children:
+	for (size_t i = dqgn->dqgn_first_child; i;
+			i = dqg->dqg_nodes[i - 1].dqgn_next_sibling) {
+		_dispatch_queue_graph_print_node_text(out, dqg,
+				&dqg->dqg_nodes[i - 1], depth + 1);
+	}
+}
+
+static void
+_dispatch_queue_graph_print_text(FILE *out, dispatch_queue_graph_t dqg)
+{
+	fprintf(out, "=== queue graph of %d: %zu queues, %zu waiting threads ===\n",
+			getpid(), dqg->dqg_count, dqg->dqg_nwaiters);
+	for (size_t i = 0; i < dqg->dqg_count; i++) {
+		if (!dqg->dqg_nodes[i].dqgn_target) {
+			_dispatch_queue_graph_print_node_text(out, dqg,
+					&dqg->dqg_nodes[i], 0);
+		}
+	}
+	for (size_t i = 0; i < dqg->dqg_nwaiters; i++) {
+		dispatch_queue_graph_waiter_t dqgw = &dqg->dqg_waiters[i];
+		dispatch_queue_graph_node_t dqgn, top;
+
+		if (dqgw->dqgw_kind != DISPATCH_WAIT_SYNC) {
+			fprintf(out, "thread 0x%x waiting for %s[%p] for %llums\n",
+					dqgw->dqgw_tid, _dispatch_wait_kind_name(dqgw->dqgw_kind),
+					dqgw->dqgw_object,
+					(unsigned long long)(dqgw->dqgw_duration / NSEC_PER_MSEC));
+			continue;
+		}
+		dqgn = _dispatch_queue_graph_find(dqg, dqgw->dqgw_queue);
+		top = _dispatch_queue_graph_find(dqg, dqgw->dqgw_top_queue);
+		fprintf(out, "thread 0x%x waiting for %s[%p] for %llums",
+				dqgw->dqgw_tid, dqgn ? dqgn->dqgn_label : "",
+				dqgw->dqgw_queue,
+				(unsigned long long)(dqgw->dqgw_duration / NSEC_PER_MSEC));
+		if (dqgw->dqgw_top_queue != dqgw->dqgw_queue) {
+			fprintf(out, " to sync onto %s[%p]", top ? top->dqgn_label : "",
+					dqgw->dqgw_top_queue);
+		}
+		fprintf(out, "\n");
+	}
+}
+
+#pragma mark -
+#pragma mark JSON output
+
+static void
+_dispatch_queue_graph_print_json_string(FILE *out, const char *s)
+{
+	fputc('"', out);
+	for (; *s; s++) {
+		unsigned char c = (unsigned char)*s;
+		if (c == '"' || c == '\\') {
+			fprintf(out, "\\%c", c);
+		} else if (c < 0x20) {
+			fprintf(out, "\\u%04x", c);
+		} else {
+			fputc(c, out);
+		}
+	}
+	fputc('"', out);
+}
+
+static void
+_dispatch_queue_graph_print_json(FILE *out, dispatch_queue_graph_t dqg)
+{
+	fprintf(out, "{\"pid\":%d,\"queues\":[", getpid());
+	for (size_t i = 0; i < dqg->dqg_count; i++) {
+		dispatch_queue_graph_node_t dqgn = &dqg->dqg_nodes[i];
+		uint64_t dq_state = dqgn->dqgn_state;
+
+		fprintf(out, "%s{\"address\":\"%p\",\"label\":", i ? "," : "",
+				dqgn->dqgn_queue);
+		_dispatch_queue_graph_print_json_string(out, dqgn->dqgn_label);
+		fprintf(out, ",\"kind\":\"%s\",\"serialnum\":%lu,\"width\":%u,",
+				dqgn->dqgn_kind, dqgn->dqgn_serialnum, dqgn->dqgn_width);
+		if (dqgn->dqgn_target) {
+			fprintf(out, "\"target\":\"%p\",", dqgn->dqgn_target);
+		} else {
+			fprintf(out, "\"target\":null,");
+		}
+		if (dqgn->dqgn_is_root) {
+			fprintf(out, "\"thread_requests\":%d,\"pool_size\":%d}",
+					dqgn->dqgn_thread_requests, dqgn->dqgn_pool_size);
+			continue;
+		}
+		fprintf(out, "\"state\":\"0x%016llx\",\"suspended\":%d,"
+				"\"inactive\":%s,\"enqueued\":%s,\"dirty\":%s,"
+				"\"in_barrier\":%s,\"in_flight\":%d,\"pending_barrier\":%s,"
+				"\"max_qos\":%d,\"drain_owner\":%u",
+				(unsigned long long)dq_state,
+				_dq_state_suspend_cnt(dq_state),
+				_dq_state_is_inactive(dq_state) ? "true" : "false",
+				_dq_state_is_enqueued(dq_state) ? "true" : "false",
+				_dq_state_is_dirty(dq_state) ? "true" : "false",
+				_dq_state_is_in_barrier(dq_state) ? "true" : "false",
+				_dq_state_is_in_barrier(dq_state) ? 0 :
+						_dq_state_used_width(dq_state, dqgn->dqgn_width),
+				_dq_state_has_pending_barrier(dq_state) ? "true" : "false",
+				_dq_state_max_qos(dq_state),
+				_dq_state_drain_owner(dq_state));
+		if (dqgn->dqgn_has_depth) {
+			fprintf(out, ",\"pending\":%llu",
+					(unsigned long long)dqgn->dqgn_depth);
+		}
+		fprintf(out, "}");
+	}
+	fprintf(out, "],\"sync_waiters\":[");
+	for (size_t i = 0; i < dqg->dqg_nwaiters; i++) {
+		dispatch_queue_graph_waiter_t dqgw = &dqg->dqg_waiters[i];
+		fprintf(out, "%s{\"thread\":%u,\"kind\":\"%s\",", i ? "," : "",
+				dqgw->dqgw_tid, _dispatch_wait_kind_name(dqgw->dqgw_kind));
+		if (dqgw->dqgw_kind == DISPATCH_WAIT_SYNC) {
+			fprintf(out, "\"queue\":\"%p\",\"top_queue\":\"%p\",",
+					dqgw->dqgw_queue, dqgw->dqgw_top_queue);
+		} else {
+			fprintf(out, "\"object\":\"%p\",", dqgw->dqgw_object);
+		}
+		fprintf(out, "\"duration_ns\":%llu}",
+				(unsigned long long)dqgw->dqgw_duration);
+	}
+	fprintf(out, "]}\n");
+}
+
+#pragma mark -
+#pragma mark dispatch_queue_graph_dump
+
+bool
+dispatch_queue_graph_dump(int fd, dispatch_queue_graph_format_t format)
+{
+	struct dispatch_queue_graph_s dqg = { };
+	FILE *out;
+	int dupfd;
+	bool ok;
+
+	if (unlikely(format != DISPATCH_QUEUE_GRAPH_TEXT &&
+			format != DISPATCH_QUEUE_GRAPH_JSON)) {
+		DISPATCH_CLIENT_CRASH(format,
+				"Invalid format passed to dispatch_queue_graph_dump");
+	}
+	os_atomic_store(&_dispatch_sync_waiters_tracked, true, relaxed);
+	dupfd = dup(fd);
+	if (dupfd == -1) {
+		return false;
+	}
+	out = fdopen(dupfd, "w");
+	if (!out) {
+		(void)close(dupfd);
+		return false;
+	}
+
+	_dispatch_queue_graph_snapshot(&dqg);
+	if (format == DISPATCH_QUEUE_GRAPH_JSON) {
+		_dispatch_queue_graph_print_json(out, &dqg);
+	} else {
+		_dispatch_queue_graph_print_text(out, &dqg);
+	}
+	ok = !ferror(out);
+	ok = (fclose(out) == 0) && ok;
+	_dispatch_queue_graph_dispose(&dqg);
+	return ok;
+}
+
+typedef struct dispatch_queue_graph_signal_s {
+	int dqgs_fd;
+	dispatch_queue_graph_format_t dqgs_format;
+} *dispatch_queue_graph_signal_t;
+
+static dispatch_unfair_lock_s _dispatch_queue_graph_signal_lock;
+static dispatch_source_t _dispatch_queue_graph_signal_source;
+
+static void
+_dispatch_queue_graph_signal_handler(void *ctxt)
+{
+	dispatch_queue_graph_signal_t dqgs = ctxt;
+
+	(void)dispatch_queue_graph_dump(dqgs->dqgs_fd, dqgs->dqgs_format);
+}
+
+void
+dispatch_queue_graph_dump_on_signal(int signo, int fd,
+		dispatch_queue_graph_format_t format)
+{
+	dispatch_source_t ds = NULL, old_ds;
+
+	if (signo) {
+		dispatch_queue_graph_signal_t dqgs;
+
+		os_atomic_store(&_dispatch_sync_waiters_tracked, true, relaxed);
+		dqgs = _dispatch_calloc(1, sizeof(*dqgs));
+		dqgs->dqgs_fd = fd;
+		dqgs->dqgs_format = format;
+
+		// overcommit, so that the dump happens when all workers are blocked
+		ds = dispatch_source_create(DISPATCH_SOURCE_TYPE_SIGNAL,
+				(uintptr_t)signo, 0, _dispatch_get_root_queue(
+				DISPATCH_QOS_UTILITY, true)->_as_dq);
+		if (unlikely(!ds)) {
+			DISPATCH_CLIENT_CRASH(signo, "Invalid signal passed to "
+					"dispatch_queue_graph_dump_on_signal");
+		}
+		dispatch_set_context(ds, dqgs);
+		dispatch_set_finalizer_f(ds, free);
+		dispatch_source_set_event_handler_f(ds,
+				_dispatch_queue_graph_signal_handler);
+	}
+
+	_dispatch_unfair_lock_lock(&_dispatch_queue_graph_signal_lock);
+	old_ds = _dispatch_queue_graph_signal_source;
+	_dispatch_queue_graph_signal_source = ds;
+	_dispatch_unfair_lock_unlock(&_dispatch_queue_graph_signal_lock);
+
+	if (old_ds) {
+		dispatch_source_cancel(old_ds);
+		dispatch_release(old_ds);
+	}
+	if (ds) {
+		dispatch_activate(ds);
+	}
+}
+
+#pragma mark -
+#pragma mark wait analyzer
+
+/*
+ * The wait-for graph has the registered waiters as nodes, and at most one edge
+ * from every node, since a thread is blocked in one wait at a time: the node
+ * of the thread draining the queue it waits for, or one of its targets.
+ * Cycles are found by following these edges until a node is visited again.
+ *
+ * The graph is built and analyzed with the waiters lock held, which keeps the
+ * queues of sync waiters retained by their callers, and the reports are
+ * delivered after it is dropped.
+ */
+
+#define DISPATCH_WAIT_ANALYZER_DEFAULT_THRESHOLD NSEC_PER_SEC
+#define DISPATCH_WAIT_ANALYZER_MIN_INTERVAL (10 * NSEC_PER_MSEC)
+
+typedef struct dispatch_wait_analyzer_s {
+	uint64_t dwa_threshold;
+	void *dwa_ctxt;
+	dispatch_wait_report_handler_t dwa_handler;
+} *dispatch_wait_analyzer_t;
+
+typedef struct dispatch_wait_analyzer_node_s {
+	dispatch_sync_waiter_t dwan_waiter;
+	dispatch_tid dwan_owner;
+	dispatch_qos_t dwan_owner_qos;
+	size_t dwan_next; // SIZE_MAX if the owner isn't waiting
+	size_t dwan_mark;
+	uint64_t dwan_duration;
+} *dispatch_wait_analyzer_node_t;
+
+typedef struct dispatch_wait_analyzer_report_s {
+	struct dispatch_wait_analyzer_report_s *dwar_next;
+	dispatch_wait_report_s dwar_report;
+	dispatch_wait_report_entry_s dwar_entries[];
+} *dispatch_wait_analyzer_report_t;
+
+static dispatch_unfair_lock_s _dispatch_wait_analyzer_lock;
+static dispatch_source_t _dispatch_wait_analyzer_source;
+
+// Finds the first queue draining in the hierarchy of the queue a waiter waits
+// on, and the QoS of the root queue that queue runs on, see
+// _dispatch_wait_analyzer_root_qos(). Each hop is retained as the legacy
+// retarget of an active queue may release the former target under us.
+static void
+_dispatch_wait_analyzer_find_owner(dispatch_wait_analyzer_node_t dwan)
+{
+	dispatch_queue_t dq = dwan->dwan_waiter->dsw_queue, tq;
+	dispatch_tid owner = 0;
+
+	// the waiter can't unregister while the waiters lock is held,
+	// so the queue it waits on is alive
+	_dispatch_retain(dq);
+	while (dq) {
+		if (!owner && !dx_hastypeflag(dq, QUEUE_ROOT)) {
+			owner = DISPATCH_QUEUE_DRAIN_OWNER(dq);
+		}
+		if (owner && _dispatch_queue_is_thread_bound(dq)) {
+			break;
+		}
+		if (dx_hastypeflag(dq, QUEUE_ROOT)) {
+			if (owner) {
+				dwan->dwan_owner_qos = _dispatch_priority_qos(dq->dq_priority);
+			}
+			break;
+		}
+		tq = _dispatch_queue_graph_retain_target(dq);
+		_dispatch_release(dq);
+		dq = tq;
+	}
+	if (dq) _dispatch_release(dq);
+	dwan->dwan_owner = owner;
+}
+
+static void
+_dispatch_wait_analyzer_fill_entry(dispatch_wait_report_entry_s *dwre,
+		dispatch_wait_analyzer_node_t dwan)
+{
+	dispatch_sync_waiter_t dsw = dwan->dwan_waiter;
+
+	dwre->dwre_kind = dsw->dsw_kind;
+	if (dsw->dsw_kind == DISPATCH_WAIT_SYNC) {
+		dwre->dwre_object = dsw->dsw_queue;
+		if (dsw->dsw_queue->dq_label) {
+			strlcpy(dwre->dwre_label, dsw->dsw_queue->dq_label,
+					sizeof(dwre->dwre_label));
+		}
+	} else {
+		dwre->dwre_object = dsw->dsw_object;
+	}
+	dwre->dwre_thread = dsw->dsw_tid;
+	dwre->dwre_owner = dwan->dwan_owner;
+	dwre->dwre_qos_class = _dispatch_qos_to_qos_class(dsw->dsw_qos);
+	dwre->dwre_owner_qos_class =
+			_dispatch_qos_to_qos_class(dwan->dwan_owner_qos);
+	dwre->dwre_duration = _dispatch_time_mach2nano(dwan->dwan_duration);
+	if (dsw->dsw_frames) {
+		dwre->dwre_nframes = dsw->dsw_nframes;
+		memcpy(dwre->dwre_frames, dsw->dsw_frames,
+				dsw->dsw_nframes * sizeof(void *));
+	}
+}
+
+// Reports the count nodes reached from nodes[first] by following the edges
+static dispatch_wait_analyzer_report_t
+_dispatch_wait_analyzer_report_create(dispatch_wait_report_kind_t kind,
+		dispatch_wait_analyzer_node_t nodes, size_t first, size_t count)
+{
+	dispatch_wait_analyzer_report_t dwar;
+
+	dwar = _dispatch_calloc(1, sizeof(struct dispatch_wait_analyzer_report_s) +
+			count * sizeof(dispatch_wait_report_entry_s));
+	dwar->dwar_report.dwr_kind = kind;
+	dwar->dwar_report.dwr_count = count;
+	dwar->dwar_report.dwr_entries = dwar->dwar_entries;
+	for (size_t i = 0, j = first; i < count; i++, j = nodes[j].dwan_next) {
+		_dispatch_wait_analyzer_fill_entry(&dwar->dwar_entries[i], &nodes[j]);
+	}
+	return dwar;
+}
+
+static dispatch_wait_analyzer_report_t
+_dispatch_wait_analyzer_find_deadlocks(dispatch_wait_analyzer_node_t nodes,
+		size_t n, uint64_t threshold, dispatch_wait_analyzer_report_t head)
+{
+	for (size_t i = 0; i < n; i++) {
+		size_t j = i, count = 0;
+		bool reported = true, old_enough = true;
+
+		if (nodes[i].dwan_mark) continue;
+		while (j != SIZE_MAX && !nodes[j].dwan_mark) {
+			nodes[j].dwan_mark = i + 1;
+			j = nodes[j].dwan_next;
+		}
+		if (j == SIZE_MAX || nodes[j].dwan_mark != i + 1) {
+			// the walk ended, or reached a node visited by an earlier walk
+			continue;
+		}
+
+		// nodes[j] is in a cycle which wasn't seen before
+		size_t k = j;
+		do {
+			dispatch_sync_waiter_t dsw = nodes[k].dwan_waiter;
+			reported &= !!(dsw->dsw_reported & DSW_REPORTED_DEADLOCK);
+			old_enough &= nodes[k].dwan_duration >= threshold;
+			count++;
+			k = nodes[k].dwan_next;
+		} while (k != j);
+		if (reported || !old_enough) continue;
+
+		do {
+			nodes[k].dwan_waiter->dsw_reported |= DSW_REPORTED_DEADLOCK;
+			k = nodes[k].dwan_next;
+		} while (k != j);
+		dispatch_wait_analyzer_report_t dwar;
+		dwar = _dispatch_wait_analyzer_report_create(
+				DISPATCH_WAIT_REPORT_DEADLOCK, nodes, j, count);
+		dwar->dwar_next = head;
+		head = dwar;
+	}
+	return head;
+}
+
+static dispatch_wait_analyzer_report_t
+_dispatch_wait_analyzer_find_inversions(dispatch_wait_analyzer_node_t nodes,
+		size_t n, uint64_t threshold, dispatch_wait_analyzer_report_t head)
+{
+	for (size_t i = 0; i < n; i++) {
+		dispatch_sync_waiter_t dsw = nodes[i].dwan_waiter;
+		size_t j = i, count = 1;
+
+		if (dsw->dsw_reported || !dsw->dsw_qos ||
+				nodes[i].dwan_duration < threshold) {
+			continue;
+		}
+		// the chain either ends, or loops in at most n steps
+		while (count <= n) {
+			dispatch_qos_t owner_qos = nodes[j].dwan_owner_qos;
+			if (nodes[j].dwan_next != SIZE_MAX &&
+					nodes[nodes[j].dwan_next].dwan_waiter->dsw_qos) {
+				owner_qos = nodes[nodes[j].dwan_next].dwan_waiter->dsw_qos;
+			}
+			if (owner_qos && owner_qos < dsw->dsw_qos) {
+				break;
+			}
+			j = nodes[j].dwan_next;
+			if (j == SIZE_MAX || j == i) {
+				count = n + 1;
+				break;
+			}
+			count++;
+		}
+		if (count > n) continue;
+
+		dsw->dsw_reported |= DSW_REPORTED_INVERSION;
+		dispatch_wait_analyzer_report_t dwar;
+		dwar = _dispatch_wait_analyzer_report_create(
+				DISPATCH_WAIT_REPORT_QOS_INVERSION, nodes, i, count);
+		dwar->dwar_next = head;
+		head = dwar;
+	}
+	return head;
+}
+
+static void
+_dispatch_wait_analyzer_fire(void *ctxt)
+{
+	dispatch_wait_analyzer_t dwa = ctxt;
+	dispatch_wait_analyzer_report_t dwar, head = NULL;
+	dispatch_wait_analyzer_node_t nodes = NULL;
+	dispatch_sync_waiter_t dsw;
+	uint64_t now;
+	size_t n = 0;
+
+	_dispatch_unfair_lock_lock(&_dispatch_sync_waiters_lock);
+	if (_dispatch_sync_waiters_count) {
+		nodes = _dispatch_calloc(_dispatch_sync_waiters_count,
+				sizeof(struct dispatch_wait_analyzer_node_s));
+	}
+	now = _dispatch_uptime();
+	TAILQ_FOREACH(dsw, &_dispatch_sync_waiters, dsw_list) {
+		nodes[n].dwan_waiter = dsw;
+		nodes[n].dwan_next = SIZE_MAX;
+		nodes[n].dwan_duration = now - dsw->dsw_start;
+		if (dsw->dsw_kind == DISPATCH_WAIT_SYNC) {
+			_dispatch_wait_analyzer_find_owner(&nodes[n]);
+		}
+		n++;
+	}
+	for (size_t i = 0; i < n; i++) {
+		if (!nodes[i].dwan_owner) continue;
+		for (size_t j = 0; j < n; j++) {
+			if (nodes[j].dwan_waiter->dsw_tid == nodes[i].dwan_owner) {
+				nodes[i].dwan_next = j;
+				break;
+			}
+		}
+	}
+	head = _dispatch_wait_analyzer_find_deadlocks(nodes, n,
+			dwa->dwa_threshold, head);
+	head = _dispatch_wait_analyzer_find_inversions(nodes, n,
+			dwa->dwa_threshold, head);
+	_dispatch_unfair_lock_unlock(&_dispatch_sync_waiters_lock);
+	free(nodes);
+
+	while ((dwar = head)) {
+		head = dwar->dwar_next;
+		dwa->dwa_handler(dwa->dwa_ctxt, &dwar->dwar_report);
+		free(dwar);
+	}
+}
+
+static void
+_dispatch_wait_analyzer_log(DISPATCH_UNUSED void *ctxt,
+		const dispatch_wait_report_s *report)
+{
+	_dispatch_log("wait analyzer: %s between %zu threads",
+			report->dwr_kind == DISPATCH_WAIT_REPORT_DEADLOCK ?
+			"deadlock" : "QoS inversion", report->dwr_count);
+	for (size_t i = 0; i < report->dwr_count; i++) {
+		const dispatch_wait_report_entry_s *dwre = &report->dwr_entries[i];
+		_dispatch_log("  thread 0x%llx (qos 0x%x) blocked in %s on %s[%p] "
+				"for %llums, owned by 0x%llx (qos 0x%x)",
+				(unsigned long long)dwre->dwre_thread, dwre->dwre_qos_class,
+				_dispatch_wait_kind_name(dwre->dwre_kind), dwre->dwre_label,
+				dwre->dwre_object,
+				(unsigned long long)(dwre->dwre_duration / NSEC_PER_MSEC),
+				(unsigned long long)dwre->dwre_owner,
+				dwre->dwre_owner_qos_class);
+		for (uint32_t k = 0; k < dwre->dwre_nframes; k++) {
+			_dispatch_log("    #%u %p", k, dwre->dwre_frames[k]);
+		}
+	}
+}
+
+void
+dispatch_wait_analyzer_enable(uint64_t threshold, void *ctxt,
+		dispatch_wait_report_handler_t handler)
+{
+	dispatch_wait_analyzer_t dwa;
+	dispatch_source_t ds, old_ds;
+	uint64_t interval;
+
+	if (threshold == 0) {
+		threshold = DISPATCH_WAIT_ANALYZER_DEFAULT_THRESHOLD;
+	} else if (unlikely(threshold > INT64_MAX)) {
+		DISPATCH_CLIENT_CRASH(threshold, "Invalid wait analyzer threshold");
+	}
+	interval = MAX(threshold / 2, DISPATCH_WAIT_ANALYZER_MIN_INTERVAL);
+
+	dwa = _dispatch_calloc(1, sizeof(*dwa));
+	dwa->dwa_threshold = _dispatch_time_nano2mach(threshold);
+	dwa->dwa_ctxt = ctxt;
+	dwa->dwa_handler = handler;
+
+	// overcommit, so that deadlocked worker threads don't prevent reports
+	ds = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0,
+			_dispatch_get_root_queue(DISPATCH_QOS_UTILITY, true)->_as_dq);
+	dispatch_set_context(ds, dwa);
+	dispatch_set_finalizer_f(ds, free);
+	dispatch_source_set_event_handler_f(ds, _dispatch_wait_analyzer_fire);
+	dispatch_source_set_timer(ds,
+			dispatch_time(DISPATCH_TIME_NOW, (int64_t)interval),
+			interval, interval / 10);
+
+	_dispatch_unfair_lock_lock(&_dispatch_wait_analyzer_lock);
+	old_ds = _dispatch_wait_analyzer_source;
+	_dispatch_wait_analyzer_source = ds;
+	os_atomic_store(&_dispatch_sync_waiters_tracked, true, relaxed);
+	os_atomic_store(&_dispatch_wait_analyzer_enabled, true, relaxed);
+	_dispatch_unfair_lock_unlock(&_dispatch_wait_analyzer_lock);
+
+	if (old_ds) {
+		dispatch_source_cancel(old_ds);
+		dispatch_release(old_ds);
+	}
+	dispatch_activate(ds);
+}
+
+void
+dispatch_wait_analyzer_disable(void)
+{
+	dispatch_source_t old_ds;
+
+	_dispatch_unfair_lock_lock(&_dispatch_wait_analyzer_lock);
+	old_ds = _dispatch_wait_analyzer_source;
+	_dispatch_wait_analyzer_source = NULL;
+	os_atomic_store(&_dispatch_wait_analyzer_enabled, false, relaxed);
+	_dispatch_unfair_lock_unlock(&_dispatch_wait_analyzer_lock);
+
+	if (old_ds) {
+		dispatch_source_cancel(old_ds);
+		dispatch_release(old_ds);
+	}
+}
+
+void
+_dispatch_queue_graph_init(void)
+{
+	const char *s = getenv("LIBDISPATCH_QUEUE_GRAPH_SIGNAL");
+	int signo = s ? (int)strtol(s, NULL, 0) : 0;
+
+	if (signo > 0) {
+		dispatch_queue_graph_dump_on_signal(signo, STDERR_FILENO,
+				DISPATCH_QUEUE_GRAPH_TEXT);
+	}
+
+	s = getenv("LIBDISPATCH_WAIT_ANALYZER");
+	if (s) {
+		uint64_t msecs = strtoull(s, NULL, 0);
+		dispatch_wait_analyzer_enable(msecs * NSEC_PER_MSEC, NULL,
+				_dispatch_wait_analyzer_log);
+	}
+}
@@ -53,6 +53,8 @@ DISPATCH_OPTIONS(dispatch_queue_flags, uint32_t,
 	// queue is targetting a specially configured wlh at the bottom.  DQF_MUTABLE
 	// must be false.
 	DQF_TARGET_SPECIAL_WLH  = 0x01000000,
+	// queue has a pending work items limit, see dispatch_lane_bounded_s
+	DQF_BOUNDED             = 0x02000000,
 
 	//
 	// Only applies to sources
@@ -459,9 +461,92 @@ typedef struct dispatch_queue_specific_s {
 	TAILQ_ENTRY(dispatch_queue_specific_s) dqs_entry;
 } *dispatch_queue_specific_t;
 
+// Reader indicator of concurrent queues used with dispatch_read_sync_f()
+typedef struct dispatch_lane_reader_slot_s {
+	unsigned long volatile dlrs_count;
+	char _dlrs_pad[DISPATCH_CACHELINE_SIZE - sizeof(unsigned long)];
+} *dispatch_lane_reader_slot_t;
+
+typedef struct dispatch_lane_readers_s {
+	uint32_t volatile dlr_bias; // readers may skip dq_state
+	uint32_t dlr_nslots;
+	uint64_t volatile dlr_inhibit_until;
+	struct dispatch_lane_reader_slot_s dlr_slots[];
+} *dispatch_lane_readers_t;
+
+// Pending work items limit of lanes set up with
+// dispatch_queue_set_pending_limit()
+typedef struct dispatch_lane_bounded_s {
+	uint32_t volatile dqb_pending;
+	uint32_t dqb_limit;
+	uint32_t dqb_overflow;
+	uint32_t volatile dqb_waiters;
+	_dispatch_sema4_t dqb_sema;
+} *dispatch_lane_bounded_t;
+
+// Enqueue time of a sampled work item until it starts, kept in tables of
+// DISPATCH_QUEUE_SAMPLES entries hashed by item address,
+// see _dispatch_queue_sample_push()
+#define DISPATCH_QUEUE_SAMPLES 64
+
+typedef struct dispatch_queue_sample_s {
+	struct dispatch_object_s *volatile dqsm_item;
+	uint64_t volatile dqsm_time;
+} *dispatch_queue_sample_t;
+
+// Statistics of lanes set up with dispatch_queue_enable_stats()
+//
+// Counters are per-CPU, the histograms are only updated for one work item
+// in DISPATCH_LANE_STATS_SAMPLE_INTERVAL and are shared. Enqueue times of
+// sampled items are kept in dls_samples until the item starts. Thread-bound
+// sync waiters are not accounted for at all.
+//
+// The statistics are allocated cacheline aligned so that each slot sits on
+// its own cacheline, see _dispatch_lane_stats_init().
+#define DISPATCH_LANE_STATS_SAMPLE_INTERVAL 16
+#define DISPATCH_LANE_STATS_LABEL_SIZE 64
+#define DISPATCH_LANE_STATS_MAX_SLOTS 256
+
+typedef struct dispatch_lane_stats_slot_s {
+	uint64_t volatile dlss_enqueued;
+	uint64_t volatile dlss_dequeued;
+	uint64_t volatile dlss_wakeups;
+} DISPATCH_CACHELINE_ALIGN *dispatch_lane_stats_slot_t;
+
+typedef struct dispatch_lane_stats_s {
+	TAILQ_ENTRY(dispatch_lane_stats_s) dls_list;
+	dispatch_lane_t dls_queue;
+	unsigned long dls_serialnum;
+	uint32_t dls_nslots;
+	char dls_label[DISPATCH_LANE_STATS_LABEL_SIZE];
+	uint64_t volatile dls_latency[DISPATCH_QUEUE_STATS_HISTOGRAM_BUCKETS];
+	uint64_t volatile dls_execution[DISPATCH_QUEUE_STATS_HISTOGRAM_BUCKETS];
+	struct dispatch_queue_sample_s dls_samples[DISPATCH_QUEUE_SAMPLES];
+	struct dispatch_lane_stats_slot_s dls_slots[];
+} *dispatch_lane_stats_t;
+
+// Pending work item submitted with dispatch_async_coalesced_f()
+typedef struct dispatch_queue_coalesced_s {
+	struct dispatch_queue_specific_head_s *dqc_head;
+	void *dqc_ctxt;
+	dispatch_function_t dqc_func;
+	LIST_ENTRY(dispatch_queue_coalesced_s) dqc_entry;
+} *dispatch_queue_coalesced_t;
+
+#define DQC_HASH_SIZE 64u // must be a power of two
+
+LIST_HEAD(dispatch_queue_coalesced_bucket_s, dispatch_queue_coalesced_s);
+typedef struct dispatch_queue_coalesced_bucket_s
+		*dispatch_queue_coalesced_bucket_t;
+
 typedef struct dispatch_queue_specific_head_s {
 	dispatch_unfair_lock_s dqsh_lock;
 	TAILQ_HEAD(, dispatch_queue_specific_s) dqsh_entries;
+	dispatch_queue_coalesced_bucket_t dqsh_coalesced; // [DQC_HASH_SIZE]
+	dispatch_lane_readers_t volatile dqsh_readers;
+	dispatch_lane_bounded_t dqsh_bounded;
+	dispatch_lane_stats_t volatile dqsh_stats;
+	dispatch_queue_sample_t volatile dqsh_callout_samples;
 } *dispatch_queue_specific_head_t;
 
 #define DISPATCH_WORKLOOP_ATTR_HAS_SCHED         0x0001u
@@ -637,7 +722,6 @@ struct dispatch_workloop_s {
 
 typedef struct dispatch_lane_s {
 	DISPATCH_LANE_CLASS_HEADER(lane);
-	/* 32bit hole on LP64 */
 } DISPATCH_ATOMIC64_ALIGN *dispatch_lane_t;
 
 // Cache aligned type for static queues (main queue, manager)
@@ -733,8 +817,27 @@ typedef struct dispatch_pthread_root_queue_context_s {
 	pthread_attr_t dpq_thread_attr;
 #endif
 	dispatch_block_t dpq_thread_configure;
-	struct dispatch_semaphore_s dpq_thread_mediator;
+	dispatch_parking_lot_s dpq_parking_lot;
 	dispatch_pthread_root_queue_observer_hooks_s dpq_observer_hooks;
+	uint64_t volatile dpq_last_poke;
+	uint64_t volatile dpq_poke_interval; // moving average, in uptime units
+	int volatile dpq_spinners;
+	uint64_t volatile dpq_wakeups;
+	uint64_t volatile dpq_wake_latency; // cumulative wake-to-run time, in ns
+	// pool policy, see dispatch_pthread_pool_set_policy()
+	uint32_t volatile dpq_min_threads;
+	uint32_t volatile dpq_max_threads;
+	uint32_t dpq_default_max_threads;
+	uint64_t volatile dpq_idle_timeout; // in ns
+	uint64_t volatile dpq_spawn_interval; // in uptime units
+	uint64_t volatile dpq_last_spawn;
+	int32_t volatile dpq_respawn; // throttled threads to ask for again
+	uint64_t volatile dpq_respawn_at; // once the uptime reaches this
+	uint32_t volatile dpq_threads;
+	uint64_t volatile dpq_spawned;
+	uint64_t volatile dpq_exited;
+	uint64_t volatile dpq_throttled;
+	uint64_t volatile dpq_pokes;
 } *dispatch_pthread_root_queue_context_t;
 #endif // DISPATCH_USE_PTHREAD_POOL
 
@@ -869,6 +972,9 @@ bool _dispatch_workloop_uses_bound_thread(dispatch_workloop_t dwl);
 
 void _dispatch_root_queue_poke(dispatch_queue_global_t dq, int n, int floor);
 void _dispatch_root_queue_poke_and_wakeup(dispatch_queue_global_t dq, int n, int floor);
+#if DISPATCH_USE_PTHREAD_POOL
+void _dispatch_root_queue_respawn(dispatch_queue_global_t dq);
+#endif
 void _dispatch_root_queue_wakeup(dispatch_queue_global_t dq, dispatch_qos_t qos,
 		dispatch_wakeup_flags_t flags);
 void _dispatch_root_queue_push(dispatch_queue_global_t dq,
@@ -1117,6 +1223,8 @@ dispatch_queue_attr_info_t _dispatch_queue_attr_to_info(dispatch_queue_attr_t);
 #define DC_FLAG_NO_INTROSPECTION		0x200ul
 // The item is a channel item, not a continuation
 #define DC_FLAG_CHANNEL_ITEM			0x400ul
+// continuation holds a slot in the dqb_pending count of a DQF_BOUNDED queue
+#define DC_FLAG_BOUNDED_RESERVED		0x800ul
 
 typedef struct dispatch_continuation_s {
 	DISPATCH_CONTINUATION_HEADER(continuation);
@@ -1174,6 +1282,35 @@ typedef struct dispatch_sync_context_s {
 	uint16_t dsc_from_async : 1;
 } *dispatch_sync_context_t;
 
+#define DSW_REPORTED_DEADLOCK	0x1
+#define DSW_REPORTED_INVERSION	0x2
+
+// Thread blocked in __DISPATCH_WAIT_FOR_QUEUE__(), or in a group or semaphore
+// wait while the wait analyzer is enabled, see queue_graph.c
+typedef struct dispatch_sync_waiter_s {
+	TAILQ_ENTRY(dispatch_sync_waiter_s) dsw_list;
+	dispatch_wait_kind_t dsw_kind;
+	dispatch_queue_t dsw_queue; // the queue the thread waits for
+	dispatch_queue_t dsw_top_queue; // the queue passed to dispatch_sync()
+	const void *dsw_object; // the group or semaphore
+	dispatch_tid dsw_tid;
+	dispatch_qos_t dsw_qos;
+	uint64_t dsw_start;
+	bool dsw_registered;
+	// protected by the waiters lock, and only set by the wait analyzer
+	uint32_t dsw_reported;
+	uint32_t dsw_nframes;
+	// DISPATCH_WAIT_REPORT_FRAMES, if registered while the analyzer is enabled
+	void **dsw_frames;
+} *dispatch_sync_waiter_t;
+
+extern bool _dispatch_wait_analyzer_enabled;
+void _dispatch_sync_waiter_register(dispatch_sync_waiter_t dsw);
+void _dispatch_sync_waiter_unregister(dispatch_sync_waiter_t dsw);
+void _dispatch_queue_graph_init(void);
+void _dispatch_lane_stats_apply_lanes(void *ctxt,
+		void (*func)(void *, dispatch_lane_t, dispatch_queue_stats_t));
+
 typedef struct dispatch_continuation_vtable_s {
 	_OS_OBJECT_CLASS_HEADER();
 	DISPATCH_OBJECT_VTABLE_HEADER(dispatch_continuation);
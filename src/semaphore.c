@@ -80,10 +80,18 @@ _dispatch_semaphore_debug(dispatch_object_t dou, char *buf, size_t bufsiz)
 	return offset;
 }
 
+static void _dispatch_semaphore_wake_one(dispatch_semaphore_t dsema);
+
 DISPATCH_NOINLINE
 intptr_t
 _dispatch_semaphore_signal_slow(dispatch_semaphore_t dsema)
 {
+	// pairs with the decrement of _dispatch_semaphore_acquire_async()
+	os_atomic_thread_fence(acquire);
+	if (unlikely(os_atomic_load(&dsema->dsema_has_async, relaxed))) {
+		_dispatch_semaphore_wake_one(dsema);
+		return 1;
+	}
 	_dispatch_sema4_create(&dsema->dsema_sema, _DSEMA4_POLICY_FIFO);
 	_dispatch_sema4_signal(&dsema->dsema_sema, 1);
 	return 1;
@@ -135,6 +143,25 @@ _dispatch_semaphore_wait_slow(dispatch_semaphore_t dsema,
 	return 0;
 }
 
+DISPATCH_NOINLINE
+static intptr_t
+_dispatch_semaphore_wait_analyzed(dispatch_semaphore_t dsema,
+		dispatch_time_t timeout)
+{
+	struct dispatch_sync_waiter_s dsw = {
+		.dsw_kind = DISPATCH_WAIT_SEMAPHORE,
+		.dsw_object = dsema,
+		.dsw_tid = _dispatch_tid_self(),
+		.dsw_start = _dispatch_uptime(),
+	};
+	intptr_t rc;
+
+	_dispatch_sync_waiter_register(&dsw);
+	rc = _dispatch_semaphore_wait_slow(dsema, timeout);
+	_dispatch_sync_waiter_unregister(&dsw);
+	return rc;
+}
+
 intptr_t
 dispatch_semaphore_wait(dispatch_semaphore_t dsema, dispatch_time_t timeout)
 {
@@ -142,9 +169,120 @@ dispatch_semaphore_wait(dispatch_semaphore_t dsema, dispatch_time_t timeout)
 	if (likely(value >= 0)) {
 		return 0;
 	}
+	if (unlikely(os_atomic_load(&_dispatch_wait_analyzer_enabled, relaxed))) {
+		return _dispatch_semaphore_wait_analyzed(dsema, timeout);
+	}
 	return _dispatch_semaphore_wait_slow(dsema, timeout);
 }
 
+#pragma mark -
+#pragma mark dispatch_semaphore_acquire_async
+
+/*
+ * Asynchronous acquirers decrement dsema_value like threads do, and the
+ * signals which find a negative value owe a wakeup to one of them or to a
+ * waiting thread. An acquirer decrements the value and, if it went negative,
+ * enqueues itself on a FIFO with dsema_async_lock held. Once a semaphore has
+ * had asynchronous acquirers, the signals which owe a wakeup take the same
+ * lock and hand it to the head of the FIFO, or to a thread blocked in
+ * dispatch_semaphore_wait() when the FIFO is empty.
+ *
+ * Because the decrement and the enqueue happen under the lock, the FIFO
+ * always holds exactly the asynchronous acquirers which are still owed a
+ * wakeup, and every other wakeup is signaled on the sema4, which is what
+ * _dispatch_semaphore_wait_slow() relies on when it times out.
+ */
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_semaphore_async_fire(dispatch_continuation_t dc)
+{
+	dispatch_queue_t dq = (dispatch_queue_t)dc->dc_data;
+
+	_dispatch_continuation_async(dq, dc, _dispatch_qos_from_pp(dc->dc_priority),
+			dc->dc_flags);
+	_dispatch_release(dq);
+}
+
+DISPATCH_NOINLINE
+static void
+_dispatch_semaphore_wake_one(dispatch_semaphore_t dsema)
+{
+	dispatch_continuation_t dc;
+
+	_dispatch_unfair_lock_lock(&dsema->dsema_async_lock);
+	dc = dsema->dsema_async_head;
+	if (dc) {
+		dsema->dsema_async_head = dc->do_next;
+		if (!dc->do_next) dsema->dsema_async_tail = NULL;
+	}
+	_dispatch_unfair_lock_unlock(&dsema->dsema_async_lock);
+
+	if (dc) {
+		_dispatch_semaphore_async_fire(dc);
+	} else {
+		_dispatch_sema4_create(&dsema->dsema_sema, _DSEMA4_POLICY_FIFO);
+		_dispatch_sema4_signal(&dsema->dsema_sema, 1);
+	}
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_semaphore_acquire_async(dispatch_semaphore_t dsema,
+		dispatch_queue_t dq, dispatch_continuation_t dc, dispatch_qos_t qos)
+{
+	long value;
+
+	if (unlikely(!dsema->dsema_has_async)) {
+		os_atomic_store(&dsema->dsema_has_async, true, relaxed);
+	}
+
+	_dispatch_unfair_lock_lock(&dsema->dsema_async_lock);
+	// release publishes dsema_has_async to _dispatch_semaphore_signal_slow()
+	value = os_atomic_dec(&dsema->dsema_value, acq_rel);
+	if (value < 0) {
+		dc->dc_data = dq;
+		_dispatch_retain(dq);
+		dc->do_next = NULL;
+		if (dsema->dsema_async_tail) {
+			dsema->dsema_async_tail->do_next = dc;
+		} else {
+			dsema->dsema_async_head = dc;
+		}
+		dsema->dsema_async_tail = dc;
+	}
+	_dispatch_unfair_lock_unlock(&dsema->dsema_async_lock);
+
+	if (value >= 0) {
+		_dispatch_continuation_async(dq, dc, qos, dc->dc_flags);
+	}
+}
+
+DISPATCH_NOINLINE
+void
+dispatch_semaphore_acquire_async_f(dispatch_semaphore_t dsema,
+		dispatch_queue_t dq, void *ctxt, dispatch_function_t func)
+{
+	dispatch_continuation_t dc = _dispatch_continuation_alloc();
+	dispatch_qos_t qos;
+
+	qos = _dispatch_continuation_init_f(dc, dq, ctxt, func, 0, DC_FLAG_CONSUME);
+	_dispatch_semaphore_acquire_async(dsema, dq, dc, qos);
+}
+
+#ifdef __BLOCKS__
+void
+dispatch_semaphore_acquire_async(dispatch_semaphore_t dsema,
+		dispatch_queue_t dq, dispatch_block_t db)
+{
+	dispatch_continuation_t dc = _dispatch_continuation_alloc();
+	dispatch_qos_t qos;
+
+	qos = _dispatch_continuation_init(dc, dq, db, 0, DC_FLAG_CONSUME);
+	_dispatch_semaphore_acquire_async(dsema, dq, dc, qos);
+}
+#endif
+
 #pragma mark -
 #pragma mark dispatch_group_t
 
@@ -221,6 +359,25 @@ _dispatch_group_wait_slow(dispatch_group_t dg, uint32_t gen,
 	}
 }
 
+DISPATCH_NOINLINE
+static intptr_t
+_dispatch_group_wait_analyzed(dispatch_group_t dg, uint32_t gen,
+		dispatch_time_t timeout)
+{
+	struct dispatch_sync_waiter_s dsw = {
+		.dsw_kind = DISPATCH_WAIT_GROUP,
+		.dsw_object = dg,
+		.dsw_tid = _dispatch_tid_self(),
+		.dsw_start = _dispatch_uptime(),
+	};
+	intptr_t rc;
+
+	_dispatch_sync_waiter_register(&dsw);
+	rc = _dispatch_group_wait_slow(dg, gen, timeout);
+	_dispatch_sync_waiter_unregister(&dsw);
+	return rc;
+}
+
 intptr_t
 dispatch_group_wait(dispatch_group_t dg, dispatch_time_t timeout)
 {
@@ -239,6 +396,10 @@ dispatch_group_wait(dispatch_group_t dg, dispatch_time_t timeout)
 		}
 	});
 
+	if (unlikely(os_atomic_load(&_dispatch_wait_analyzer_enabled, relaxed))) {
+		return _dispatch_group_wait_analyzed(dg, _dg_state_gen(new_state),
+				timeout);
+	}
 	return _dispatch_group_wait_slow(dg, _dg_state_gen(new_state), timeout);
 }
 
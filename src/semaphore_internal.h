@@ -35,6 +35,11 @@ struct dispatch_semaphore_s {
 	intptr_t volatile dsema_value;
 	intptr_t dsema_orig;
 	_dispatch_sema4_t dsema_sema;
+	// dispatch_semaphore_acquire_async() state, see semaphore.c
+	bool volatile dsema_has_async;
+	dispatch_unfair_lock_s dsema_async_lock;
+	struct dispatch_continuation_s *dsema_async_head;
+	struct dispatch_continuation_s *dsema_async_tail;
 };
 
 /*
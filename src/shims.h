@@ -50,6 +50,7 @@
 #include "event/workqueue_internal.h"
 #elif HAVE_PTHREAD_WORKQUEUES
 #include <pthread/workqueue_private.h>
+#define HAVE_DISPATCH_WORKQ_SCHED 0
 #else
 #error Unsupported configuration
 #endif
@@ -530,6 +530,110 @@ _dispatch_wake_by_address(uint32_t volatile *address)
 #endif
 }
 
+#pragma mark - parking lot
+
+// Consumes a wakeup if one was handed out, otherwise unparks the thread when
+// `unpark` is set. Returns whether a wakeup was consumed.
+DISPATCH_ALWAYS_INLINE
+static inline bool
+_dispatch_parking_lot_consume(dispatch_parking_lot_t dpl, bool unpark)
+{
+	uint64_t old_state, new_state;
+	bool woken = false;
+
+	os_atomic_rmw_loop(&dpl->dpl_state, old_state, new_state, acquire, {
+		woken = DISPATCH_PARKING_LOT_WAKEUPS(old_state) != 0;
+		if (woken) {
+			new_state = old_state - DISPATCH_PARKING_LOT_WAKEUP;
+		} else if (unpark) {
+			new_state = old_state - 1;
+		} else {
+			os_atomic_rmw_loop_give_up(return false);
+		}
+	});
+	return woken;
+}
+
+uint32_t
+_dispatch_parking_lot_wake(dispatch_parking_lot_t dpl, uint32_t n)
+{
+	uint64_t old_state, new_state;
+	uint32_t woken = 0;
+
+	// pairs with the fence in _dispatch_parking_lot_prepare()
+	os_atomic_thread_fence(seq_cst);
+	os_atomic_rmw_loop(&dpl->dpl_state, old_state, new_state, relaxed, {
+		woken = MIN(n, DISPATCH_PARKING_LOT_PARKED(old_state));
+		if (!woken) {
+			os_atomic_rmw_loop_give_up(return 0);
+		}
+		new_state = old_state - woken + woken * DISPATCH_PARKING_LOT_WAKEUP;
+	});
+
+	os_atomic_store(&dpl->dpl_wake_time, _dispatch_uptime(), relaxed);
+#if HAVE_FUTEX
+	// parked threads which aren't in the kernel yet will see the epoch change
+	os_atomic_inc(&dpl->dpl_epoch, release);
+	_dispatch_futex_wake((uint32_t *)&dpl->dpl_epoch, (int)woken,
+			FUTEX_PRIVATE_FLAG);
+#else
+	_dispatch_sema4_signal(&dpl->dpl_sema, woken);
+#endif
+	return woken;
+}
+
+bool
+_dispatch_parking_lot_cancel(dispatch_parking_lot_t dpl)
+{
+	return _dispatch_parking_lot_consume(dpl, true);
+}
+
+bool
+_dispatch_parking_lot_wait(dispatch_parking_lot_t dpl, uint32_t key,
+		dispatch_time_t timeout, uint64_t *wake_latency)
+{
+	bool timedout = false;
+
+	for (;;) {
+#if HAVE_FUTEX
+		uint64_t nsecs = _dispatch_timeout(timeout);
+		if (nsecs == 0) {
+			timedout = true;
+		} else if (nsecs == DISPATCH_TIME_FOREVER) {
+			_dispatch_futex_wait((uint32_t *)&dpl->dpl_epoch, key, NULL,
+					FUTEX_PRIVATE_FLAG);
+		} else {
+			struct timespec ts = {
+				.tv_sec = (__typeof__(ts.tv_sec))(nsecs / NSEC_PER_SEC),
+				.tv_nsec = (__typeof__(ts.tv_nsec))(nsecs % NSEC_PER_SEC),
+			};
+			_dispatch_futex_wait((uint32_t *)&dpl->dpl_epoch, key, &ts,
+					FUTEX_PRIVATE_FLAG);
+		}
+		// a wakeup handed out after this load will change the epoch again
+		key = os_atomic_load(&dpl->dpl_epoch, acquire);
+#else
+		(void)key;
+		timedout = _dispatch_sema4_timedwait(&dpl->dpl_sema, timeout);
+#endif
+		if (_dispatch_parking_lot_consume(dpl, timedout)) {
+			break;
+		}
+		if (timedout) {
+			return false;
+		}
+		// woken without a wakeup to consume (another parked thread took it,
+		// or EINTR), go back to sleep
+	}
+
+	if (wake_latency) {
+		uint64_t now = _dispatch_uptime();
+		uint64_t then = os_atomic_load(&dpl->dpl_wake_time, relaxed);
+		*wake_latency = now > then ? _dispatch_time_mach2nano(now - then) : 0;
+	}
+	return true;
+}
+
 #pragma mark - thread event
 
 void
@@ -251,6 +251,90 @@ int _dispatch_wait_on_address(uint32_t volatile *address, uint32_t value,
 		dispatch_time_t timeout, dispatch_lock_options_t flags);
 void _dispatch_wake_by_address(uint32_t volatile *address);
 
+#pragma mark - parking lot
+/*!
+ * @typedef dispatch_parking_lot_t
+ *
+ * @abstract
+ * Dispatch Parking Lots are eventcounts used to park idle pool threads.
+ *
+ * @discussion
+ * A thread announces that it is about to park with
+ * _dispatch_parking_lot_prepare(), re-checks for work, and then either calls
+ * _dispatch_parking_lot_cancel() or _dispatch_parking_lot_wait() with the key
+ * returned by prepare.
+ *
+ * _dispatch_parking_lot_wake() only hands wakeups to threads that announced
+ * themselves and returns how many it handed out, so that the caller knows
+ * how many threads it still has to create. Unlike a semaphore, wakeups are
+ * never banked for threads that aren't parked yet.
+ *
+ * With futexes, all the threads a call to _dispatch_parking_lot_wake() hands
+ * wakeups to are woken by a single FUTEX_WAKE, and a thread woken without a
+ * wakeup to consume goes back to sleep rather than reporting a spurious wake.
+ */
+typedef struct dispatch_parking_lot_s {
+	// low 32 bits: threads parked without a wakeup handed to them
+	// high 32 bits: wakeups handed out and not yet consumed
+	uint64_t volatile dpl_state;
+#if HAVE_FUTEX
+	uint32_t volatile dpl_epoch;
+#else
+	_dispatch_sema4_t dpl_sema;
+#endif
+	uint64_t volatile dpl_wake_time;
+} dispatch_parking_lot_s, *dispatch_parking_lot_t;
+
+#define DISPATCH_PARKING_LOT_PARKED(state)  ((uint32_t)(state))
+#define DISPATCH_PARKING_LOT_WAKEUPS(state) ((uint32_t)((state) >> 32))
+#define DISPATCH_PARKING_LOT_WAKEUP         (1ull << 32)
+
+uint32_t _dispatch_parking_lot_wake(dispatch_parking_lot_t dpl, uint32_t n);
+bool _dispatch_parking_lot_wait(dispatch_parking_lot_t dpl, uint32_t key,
+		dispatch_time_t timeout, uint64_t *wake_latency);
+bool _dispatch_parking_lot_cancel(dispatch_parking_lot_t dpl);
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_parking_lot_init(dispatch_parking_lot_t dpl)
+{
+	dpl->dpl_state = 0;
+	dpl->dpl_wake_time = 0;
+#if HAVE_FUTEX
+	dpl->dpl_epoch = 0;
+#else
+	_dispatch_sema4_init(&dpl->dpl_sema, _DSEMA4_POLICY_LIFO);
+	_dispatch_sema4_create(&dpl->dpl_sema, _DSEMA4_POLICY_LIFO);
+#endif
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_parking_lot_destroy(dispatch_parking_lot_t dpl)
+{
+#if HAVE_FUTEX
+	(void)dpl;
+#else
+	_dispatch_sema4_dispose(&dpl->dpl_sema, _DSEMA4_POLICY_LIFO);
+#endif
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline uint32_t
+_dispatch_parking_lot_prepare(dispatch_parking_lot_t dpl)
+{
+	uint32_t key = 0;
+#if HAVE_FUTEX
+	// must be read before we're visible to _dispatch_parking_lot_wake()
+	key = os_atomic_load(&dpl->dpl_epoch, acquire);
+#endif
+	os_atomic_inc(&dpl->dpl_state, relaxed);
+	// pairs with the fence in _dispatch_parking_lot_wake(): either the waker
+	// sees us parked, or we see whatever it published before waking us
+	os_atomic_thread_fence(seq_cst);
+	return key;
+}
+
 #pragma mark - thread event
 /*!
  * @typedef dispatch_thread_event_t
@@ -172,6 +172,8 @@ struct dispatch_tsd {
 	void *dispatch_enqueue_key;
 	void *dispatch_msgv_aux_key;
 	void *dispatch_set_threadname_key;
+	void *dispatch_workq_thread_key;
+	void *dispatch_callout_profile_key;
 
 	void *os_workgroup_join_token_key;
 	void *os_workgroup_key;
@@ -236,6 +238,8 @@ extern pthread_key_t dispatch_dsc_key;
 extern pthread_key_t dispatch_enqueue_key;
 extern pthread_key_t dispatch_msgv_aux_key;
 extern pthread_key_t dispatch_set_threadname_key;
+extern pthread_key_t dispatch_workq_thread_key;
+extern pthread_key_t dispatch_callout_profile_key;
 
 extern pthread_key_t os_workgroup_join_token_key;
 extern pthread_key_t os_workgroup_key;
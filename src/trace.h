@@ -97,6 +97,11 @@ _dispatch_trace_client_callout3_a(void *ctxt, size_t i, size_t w, void (*f)(void
 #define _dispatch_only_if_ktrace_enabled(...) (void)0
 #endif /* DISPATCH_INTROSPECTION */
 
+#elif DISPATCH_USE_TRACE_RING
+#define DISPATCH_KTRACE_ENABLED (_dispatch_trace_ring_enabled)
+#define _dispatch_only_if_ktrace_enabled(...) \
+		if (unlikely(DISPATCH_KTRACE_ENABLED)) ({ __VA_ARGS__; })
+
 #else /* _COMM_PAGE_KDEBUG_ENABLE */
 
 #define DISPATCH_KTRACE_ENABLED 0
@@ -142,14 +147,15 @@ _dispatch_trace_client_callout3_a(void *ctxt, size_t i, size_t w, void (*f)(void
 		} \
 		_t(_dq, _label, _do, _kind, _func, _ctxt); \
 	} while (0)
-#elif DISPATCH_INTROSPECTION
+#elif DISPATCH_INTROSPECTION || DISPATCH_USE_TRACE_RING
 #define _dispatch_trace_continuation(_q, _o, _t) \
 		do { (void)(_q); (void)(_o); } while(0)
 #define DISPATCH_QUEUE_PUSH_ENABLED() 0
 #define DISPATCH_QUEUE_POP_ENABLED() 0
 #endif // DISPATCH_USE_DTRACE_INTROSPECTION || DISPATCH_INTROSPECTION
 
-#if DISPATCH_USE_DTRACE_INTROSPECTION || DISPATCH_INTROSPECTION
+#if DISPATCH_USE_DTRACE_INTROSPECTION || DISPATCH_INTROSPECTION || \
+		DISPATCH_USE_TRACE_RING
 
 DISPATCH_ALWAYS_INLINE
 static inline dispatch_queue_class_t
@@ -249,7 +255,7 @@ _dispatch_trace_firehose_chunk_install(uint64_t ask0, uint64_t ask1,
 			old_state, new_state);
 }
 
-/* Implemented in introspection.c */
+/* Implemented in introspection.c, or trace_ring.c */
 void
 _dispatch_trace_item_push_internal(dispatch_queue_t dq, dispatch_object_t dou);
 
@@ -288,7 +294,7 @@ _dispatch_trace_item_push(dispatch_queue_class_t dqu, dispatch_object_t _tail)
 	_dispatch_introspection_queue_push(dqu, _tail);
 }
 
-/* Implemented in introspection.c */
+/* Implemented in introspection.c, or trace_ring.c */
 void
 _dispatch_trace_item_pop_internal(dispatch_queue_t dq, dispatch_object_t dou);
 
@@ -335,7 +341,7 @@ _dispatch_trace_item_sync_push_pop(dispatch_queue_class_t dqu,
 			f, dc_flags);
 }
 
-/* Implemented in introspection.c */
+/* Implemented in introspection.c, or trace_ring.c */
 void
 _dispatch_trace_source_callout_entry_internal(dispatch_source_t ds, long kind,
 		dispatch_queue_t dq, dispatch_continuation_t dc);
@@ -345,9 +351,17 @@ _dispatch_trace_source_callout_entry_internal(dispatch_source_t ds, long kind,
 			_dispatch_trace_source_callout_entry_internal(__VA_ARGS__); \
 		})
 
+#if DISPATCH_USE_TRACE_RING
+#define _dispatch_trace_runtime_event(evt, ptr, value) ({ \
+		_dispatch_ktrace2(DISPATCH_RUNTIME_TRACE(evt), ptr, value); \
+		_dispatch_introspection_runtime_event(\
+				dispatch_introspection_runtime_event_##evt, ptr, value); \
+	})
+#else
 #define _dispatch_trace_runtime_event(evt, ptr, value) \
 		_dispatch_introspection_runtime_event(\
 				dispatch_introspection_runtime_event_##evt, ptr, value)
+#endif
 
 #define DISPATCH_TRACE_ARG(arg) , arg
 #else
@@ -390,7 +404,7 @@ _dispatch_trace_source_callout_entry_internal(dispatch_source_t ds, long kind,
 #define _dispatch_trace_runtime_event(evt, ptr, value) \
 		do { (void)(ptr); (void)(value); } while(0)
 #define DISPATCH_TRACE_ARG(arg)
-#endif // DISPATCH_USE_DTRACE_INTROSPECTION || DISPATCH_INTROSPECTION
+#endif // DISPATCH_USE_DTRACE_INTROSPECTION || DISPATCH_INTROSPECTION || ...
 
 #if DISPATCH_USE_DTRACE
 static inline dispatch_function_t
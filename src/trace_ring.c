@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+#include "internal.h"
+
+#if DISPATCH_USE_TRACE_RING
+#include <sys/mman.h>
+#include "trace_ring_internal.h"
+
+/*
+ * Trace rings: where the kdebug events of libdispatch go on platforms without
+ * kdebug.
+ *
+ * Setting LIBDISPATCH_TRACE_RING to a directory (e.g. /dev/shm) makes the
+ * process map <directory>/libdispatch.<pid>.trace, and record the events
+ * into one ring per CPU in it, see trace_ring_internal.h for the layout.
+ * LIBDISPATCH_TRACE_RING_ENTRIES sets the number of events kept per CPU.
+ *
+ * The rings are a flight recorder: they can be read while the process runs
+ * or after it exited, and only keep the most recent events.
+ * tools/dispatch_trace_convert turns them into Chrome trace JSON.
+ */
+
+#define DISPATCH_TRACE_RING_DEFAULT_ENTRIES (1u << 14)
+#define DISPATCH_TRACE_RING_MIN_ENTRIES (1u << 8)
+#define DISPATCH_TRACE_RING_MAX_ENTRIES (1u << 24)
+// the header and every ring start on their own page
+#define DISPATCH_TRACE_RING_ALIGN 0x4000ull
+
+DISPATCH_GLOBAL(bool _dispatch_trace_ring_enabled);
+static char *_dispatch_trace_ring_base;
+static uint64_t _dispatch_trace_ring_size;
+static uint32_t _dispatch_trace_ring_ncpus;
+static uint32_t _dispatch_trace_ring_mask;
+
+static uint32_t
+_dispatch_trace_ring_entries(void)
+{
+	const char *s = getenv("LIBDISPATCH_TRACE_RING_ENTRIES");
+	unsigned long n = s ? strtoul(s, NULL, 0) : 0;
+	uint32_t entries = DISPATCH_TRACE_RING_MIN_ENTRIES;
+
+	if (!n) {
+		return DISPATCH_TRACE_RING_DEFAULT_ENTRIES;
+	}
+	while (entries < n && entries < DISPATCH_TRACE_RING_MAX_ENTRIES) {
+		entries <<= 1;
+	}
+	return entries;
+}
+
+void
+_dispatch_trace_ring_init(void)
+{
+	const char *dir = getenv("LIBDISPATCH_TRACE_RING");
+	dispatch_trace_ring_header_t dtrh;
+	uint32_t ncpus = dispatch_hw_config(logical_cpus);
+	uint32_t nentries = _dispatch_trace_ring_entries();
+	uint64_t ring_size, size;
+	char path[PATH_MAX];
+	void *base;
+	int fd;
+
+	if (!dir || !*dir) {
+		return;
+	}
+
+	ring_size = sizeof(dispatch_trace_ring_s) +
+			nentries * sizeof(dispatch_trace_entry_s);
+	ring_size = (ring_size + DISPATCH_TRACE_RING_ALIGN - 1) &
+			~(DISPATCH_TRACE_RING_ALIGN - 1);
+	size = DISPATCH_TRACE_RING_ALIGN + ncpus * ring_size;
+
+	// the directory may be shared (e.g. /dev/shm), never follow a link or
+	// reuse a file someone else planted there, and keep the events private
+	snprintf(path, sizeof(path), "%s/libdispatch.%d.trace", dir, getpid());
+	fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+	if (fd == -1) {
+		_dispatch_log("libdispatch: unable to create trace file %s: %d",
+				path, errno);
+		return;
+	}
+	if (ftruncate(fd, (off_t)size) == -1) {
+		_dispatch_log("libdispatch: unable to size trace file %s: %d",
+				path, errno);
+		close(fd);
+		return;
+	}
+	base = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		_dispatch_log("libdispatch: unable to map trace file %s: %d",
+				path, errno);
+		return;
+	}
+
+	dtrh = base;
+	dtrh->dtrh_version = DISPATCH_TRACE_RING_VERSION;
+	dtrh->dtrh_ncpus = ncpus;
+	dtrh->dtrh_nentries = nentries;
+	dtrh->dtrh_entry_size = sizeof(dispatch_trace_entry_s);
+	dtrh->dtrh_ring_offset = DISPATCH_TRACE_RING_ALIGN;
+	dtrh->dtrh_ring_size = ring_size;
+	dtrh->dtrh_pid = (uint64_t)getpid();
+	dtrh->dtrh_start_time = _dispatch_time_mach2nano(_dispatch_uptime());
+	strlcpy(dtrh->dtrh_procname, getprogname() ?: "",
+			sizeof(dtrh->dtrh_procname));
+	// the magic tells readers that the header is complete
+	os_atomic_store(&dtrh->dtrh_magic, DISPATCH_TRACE_RING_MAGIC, release);
+
+	_dispatch_trace_ring_base = (char *)base + DISPATCH_TRACE_RING_ALIGN;
+	_dispatch_trace_ring_size = ring_size;
+	_dispatch_trace_ring_ncpus = ncpus;
+	_dispatch_trace_ring_mask = nentries - 1;
+	_dispatch_trace_ring_enabled = true;
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline dispatch_trace_ring_t
+_dispatch_trace_ring_current(void)
+{
+	int cpu = sched_getcpu();
+	uint32_t idx = likely(cpu >= 0) ? (uint32_t)cpu :
+			(uint32_t)_dispatch_tid_self();
+	idx %= _dispatch_trace_ring_ncpus;
+	return (dispatch_trace_ring_t)(_dispatch_trace_ring_base +
+			idx * _dispatch_trace_ring_size);
+}
+
+void
+_dispatch_trace_ring_emit(uint32_t code, uint64_t a, uint64_t b,
+		uint64_t c, uint64_t d)
+{
+	dispatch_trace_ring_t dtr = _dispatch_trace_ring_current();
+	uint64_t idx = os_atomic_inc_orig(&dtr->dtr_head, relaxed);
+	dispatch_trace_entry_t dte;
+
+	// a thread preempted or migrated after picking its ring only shares it
+	// with writers that claimed other indices, readers of a ring that wraps
+	// around faster than a writer finishes will discard the entry
+	dte = &dtr->dtr_entries[idx & _dispatch_trace_ring_mask];
+	os_atomic_store(&dte->dte_seq, 0, relaxed);
+	os_atomic_thread_fence(release);
+	dte->dte_timestamp = _dispatch_time_mach2nano(_dispatch_uptime());
+	dte->dte_code = code;
+	dte->dte_tid = (uint32_t)_dispatch_tid_self();
+	dte->dte_args[0] = a;
+	dte->dte_args[1] = b;
+	dte->dte_args[2] = c;
+	dte->dte_args[3] = d;
+	os_atomic_store(&dte->dte_seq, idx + 1, release);
+}
+
+#if !DISPATCH_INTROSPECTION
+#pragma mark -
+#pragma mark trace hooks
+
+// The introspection version of these decodes work items with
+// dispatch_introspection_queue_item_get_info(), which only exists in the
+// introspection build. These emit the same events from the continuation.
+
+static uintptr_t
+_dispatch_trace_ring_dc_flags(dispatch_continuation_t dc)
+{
+	uintptr_t flags = 0;
+	if (dc->dc_flags & DC_FLAG_BARRIER) flags |= DC_BARRIER;
+	return flags;
+}
+
+static dispatch_function_t
+_dispatch_trace_ring_source_handler(dispatch_source_t ds)
+{
+	dispatch_continuation_t dc;
+	dc = os_atomic_load(&ds->ds_refs->ds_handler[DS_EVENT_HANDLER], relaxed);
+	return dc ? dc->dc_func : NULL;
+}
+
+void
+_dispatch_trace_item_push_internal(dispatch_queue_t dq,
+		dispatch_object_t dou)
+{
+	dispatch_continuation_t dc = dou._dc;
+
+	if (dx_metatype(dq) != _DISPATCH_LANE_TYPE) {
+		return;
+	}
+	if (_dispatch_object_has_vtable(dou)) {
+		if (dx_metatype(dou._do) == _DISPATCH_SOURCE_TYPE) {
+			_dispatch_ktrace4(DISPATCH_QOS_TRACE_source_push,
+					dou._do_value, dou._ds->ds_refs->du_filter,
+					_dispatch_trace_ring_source_handler(dou._ds),
+					dq->dq_serialnum);
+		}
+		/* Only track user continuations */
+		return;
+	}
+	if (dc->dc_flags & DC_FLAG_SYNC_WAITER) {
+		return;
+	}
+
+	if (dc->dc_flags & DC_FLAG_BLOCK_WITH_PRIVATE_DATA) {
+		_dispatch_ktrace4(DISPATCH_QOS_TRACE_continuation_push_eb,
+				dou._do_value, dc->dc_ctxt,
+				BITPACK_UINT32_PAIR(dq->dq_serialnum,
+						_dispatch_trace_ring_dc_flags(dc)),
+				BITPACK_UINT32_PAIR(_dispatch_get_priority(),
+						dc->dc_priority));
+	} else if (dc->dc_flags & DC_FLAG_BLOCK) {
+		_dispatch_ktrace4(DISPATCH_QOS_TRACE_continuation_push_ab,
+				dou._do_value, _dispatch_Block_invoke(dc->dc_ctxt),
+				BITPACK_UINT32_PAIR(dq->dq_serialnum,
+						_dispatch_trace_ring_dc_flags(dc)),
+				BITPACK_UINT32_PAIR(_dispatch_get_priority(),
+						dc->dc_priority));
+	} else {
+		_dispatch_ktrace4(DISPATCH_QOS_TRACE_continuation_push_f,
+				dou._do_value, dc->dc_func,
+				BITPACK_UINT32_PAIR(dq->dq_serialnum,
+						_dispatch_trace_ring_dc_flags(dc)),
+				BITPACK_UINT32_PAIR(_dispatch_get_priority(),
+						dc->dc_priority));
+	}
+}
+
+void
+_dispatch_trace_item_pop_internal(dispatch_queue_t dq,
+		dispatch_object_t dou)
+{
+	if (dx_metatype(dq) != _DISPATCH_LANE_TYPE) {
+		return;
+	}
+	if (_dispatch_object_has_vtable(dou)) {
+		if (dx_metatype(dou._do) == _DISPATCH_SOURCE_TYPE) {
+			_dispatch_ktrace2(DISPATCH_QOS_TRACE_source_pop,
+					dou._do_value, dq->dq_serialnum);
+		}
+		return;
+	}
+	if (dou._dc->dc_flags & DC_FLAG_SYNC_WAITER) {
+		return;
+	}
+	_dispatch_ktrace3(DISPATCH_QOS_TRACE_continuation_pop,
+			dou._do_value, _dispatch_get_priority(), dq->dq_serialnum);
+}
+
+void
+_dispatch_trace_source_callout_entry_internal(dispatch_source_t ds, long kind,
+		dispatch_queue_t dq, dispatch_continuation_t dc)
+{
+	if (dx_metatype(dq) != _DISPATCH_LANE_TYPE) {
+		return;
+	}
+
+	_dispatch_ktrace3(DISPATCH_QOS_TRACE_src_callout,
+			(uintptr_t)ds, (uintptr_t)dc, kind);
+
+	_dispatch_trace_item_push_internal(dq, (dispatch_object_t)dc);
+}
+#endif // !DISPATCH_INTROSPECTION
+
+#endif // DISPATCH_USE_TRACE_RING
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * IMPORTANT: This header file describes INTERNAL interfaces to libdispatch
+ * which are subject to change in future releases of Mac OS X. Any applications
+ * relying on these interfaces WILL break.
+ */
+
+#ifndef __DISPATCH_TRACE_RING_INTERNAL__
+#define __DISPATCH_TRACE_RING_INTERNAL__
+
+/*
+ * Layout of the trace file written when LIBDISPATCH_TRACE_RING is set, this
+ * header is shared with tools/dispatch_trace_convert.c and must only depend
+ * on <stdint.h>.
+ *
+ * The file is a dispatch_trace_ring_header_s, followed by dtrh_ncpus rings
+ * dtrh_ring_size bytes apart starting at dtrh_ring_offset. Each ring is a
+ * dispatch_trace_ring_s followed by dtrh_nentries entries, and is written by
+ * the threads running on that CPU: a writer claims index dtr_head++ and owns
+ * entry (index % dtrh_nentries), overwriting the oldest events.
+ *
+ * Entries are published with a sequence number: dte_seq is zeroed before the
+ * payload is written, then set to index + 1. Readers must load dte_seq
+ * before and after copying the payload and discard the entry unless both
+ * loads return the index they expect.
+ *
+ * Events use the kdebug codes of libdispatch.codes, timestamps are
+ * CLOCK_MONOTONIC nanoseconds.
+ */
+#define DISPATCH_TRACE_RING_MAGIC 0x676e697274707364ull // "dsptring"
+#define DISPATCH_TRACE_RING_VERSION 1
+#define DISPATCH_TRACE_RING_PROCNAME_SIZE 64
+
+typedef struct dispatch_trace_ring_header_s {
+	uint64_t volatile dtrh_magic;
+	uint32_t dtrh_version;
+	uint32_t dtrh_ncpus;
+	uint32_t dtrh_nentries;
+	uint32_t dtrh_entry_size;
+	uint64_t dtrh_ring_offset;
+	uint64_t dtrh_ring_size;
+	uint64_t dtrh_pid;
+	uint64_t dtrh_start_time;
+	char dtrh_procname[DISPATCH_TRACE_RING_PROCNAME_SIZE];
+} dispatch_trace_ring_header_s, *dispatch_trace_ring_header_t;
+
+typedef struct dispatch_trace_entry_s {
+	uint64_t volatile dte_seq;
+	uint64_t dte_timestamp;
+	uint32_t dte_code;
+	uint32_t dte_tid;
+	uint64_t dte_args[4];
+} dispatch_trace_entry_s, *dispatch_trace_entry_t;
+
+typedef struct dispatch_trace_ring_s {
+	uint64_t volatile dtr_head;
+	uint8_t _dtr_pad[64 - sizeof(uint64_t)];
+	dispatch_trace_entry_s dtr_entries[];
+} dispatch_trace_ring_s, *dispatch_trace_ring_t;
+
+// Decoding of the kdebug codes, see DISPATCH_CODE()
+#define DISPATCH_TRACE_CODE_CLASS(code)     (((code) >> 24) & 0xffu)
+#define DISPATCH_TRACE_CODE_SUBCLASS(code)  (((code) >> 16) & 0xffu)
+#define DISPATCH_TRACE_CODE_CODE(code)      (((code) >> 2) & 0x3fffu)
+#define DISPATCH_TRACE_CODE_FUNC(code)      ((code) & 0x3u)
+
+#endif // __DISPATCH_TRACE_RING_INTERNAL__
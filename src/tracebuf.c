@@ -0,0 +1,559 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+#include "internal.h"
+
+#if !defined(_WIN32)
+#include "tracebuf_internal.h"
+
+#define DISPATCH_TRACEBUF_TRACEPOINT_ALIGN 8u
+#define DISPATCH_TRACEBUF_ROUND_UP(x, n) \
+		(((x) + (n) - 1) & ~((uint64_t)(n) - 1))
+#define DISPATCH_TRACEBUF_HEADER_SIZE \
+		((uint16_t)sizeof(struct dispatch_tracebuf_chunk_s))
+
+dispatch_static_assert(DISPATCH_TRACEBUF_TRACEPOINT_MAX_SIZE ==
+		DISPATCH_TRACEBUF_CHUNK_SIZE - sizeof(struct dispatch_tracebuf_chunk_s) -
+		sizeof(dispatch_tracepoint_s), "tracepoint max size");
+dispatch_static_assert(sizeof(dispatch_tracepoint_s) %
+		DISPATCH_TRACEBUF_TRACEPOINT_ALIGN == 0, "tracepoint alignment");
+
+struct dispatch_tracebuf_s {
+	dispatch_tracebuf_header_t dtb_header;
+	uint64_t volatile *dtb_ring;
+	dispatch_tracebuf_stream_t dtb_streams;
+	char *dtb_chunks;
+	uint32_t dtb_ring_mask;
+	uint32_t dtb_nstreams;
+	uint32_t dtb_nchunks;
+	size_t dtb_size;
+	int dtb_fd;
+};
+
+struct dispatch_tracebuf_reader_s {
+	struct dispatch_tracebuf_s dtr_tb;
+	char dtr_name[DISPATCH_TRACEBUF_NAME_SIZE];
+};
+
+DISPATCH_ALWAYS_INLINE
+static inline dispatch_tracebuf_chunk_t
+_dispatch_tracebuf_chunk(dispatch_tracebuf_t tb, uint32_t idx)
+{
+	return (dispatch_tracebuf_chunk_t)(tb->dtb_chunks +
+			(size_t)idx * DISPATCH_TRACEBUF_CHUNK_SIZE);
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline uint32_t
+_dispatch_tracebuf_chunk_idx(dispatch_tracebuf_t tb, void *ptr)
+{
+	return (uint32_t)(((uintptr_t)ptr - (uintptr_t)tb->dtb_chunks) /
+			DISPATCH_TRACEBUF_CHUNK_SIZE);
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline dispatch_tracebuf_stream_t
+_dispatch_tracebuf_stream_current(dispatch_tracebuf_t tb)
+{
+	uint32_t idx;
+#if defined(__linux__)
+	int cpu = sched_getcpu();
+	idx = likely(cpu >= 0) ? (uint32_t)cpu : (uint32_t)_dispatch_tid_self();
+#else
+	idx = (uint32_t)_dispatch_tid_self();
+#endif
+	return &tb->dtb_streams[idx % tb->dtb_nstreams];
+}
+
+// The layout is taken from `hdr` rather than from the mapping, which readers
+// share with a process that could rewrite it after it was validated
+static void
+_dispatch_tracebuf_init(dispatch_tracebuf_t tb, void *base,
+		const struct dispatch_tracebuf_header_s *hdr, int fd)
+{
+	tb->dtb_header = base;
+	tb->dtb_size = (size_t)hdr->dtbh_size;
+	tb->dtb_fd = fd;
+	tb->dtb_ring = (uint64_t volatile *)((char *)base +
+			hdr->dtbh_ring_offset);
+	tb->dtb_streams = (dispatch_tracebuf_stream_t)((char *)base +
+			hdr->dtbh_streams_offset);
+	tb->dtb_chunks = (char *)base + hdr->dtbh_chunks_offset;
+	tb->dtb_ring_mask = hdr->dtbh_ring_size - 1;
+	tb->dtb_nstreams = hdr->dtbh_nstreams;
+	tb->dtb_nchunks = hdr->dtbh_nchunks;
+}
+
+#pragma mark -
+#pragma mark dispatch_tracebuf_t
+
+static int
+_dispatch_tracebuf_shm_create(const char *name)
+{
+#if HAVE_MEMFD_CREATE
+	return memfd_create(name, MFD_CLOEXEC);
+#else
+	static unsigned int volatile _dispatch_tracebuf_shm_counter;
+	char path[64];
+	int fd;
+
+	(void)name;
+	snprintf(path, sizeof(path), "/dispatch.tracebuf.%d.%u", getpid(),
+			os_atomic_inc(&_dispatch_tracebuf_shm_counter, relaxed));
+	fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd != -1) {
+		shm_unlink(path);
+	}
+	return fd;
+#endif
+}
+
+dispatch_tracebuf_t
+dispatch_tracebuf_create(const char *name, size_t size)
+{
+	uint32_t nstreams = dispatch_hw_config(logical_cpus);
+	uint32_t nchunks, ring_size = 1;
+	uint64_t ring_offset, streams_offset, chunks_offset, total;
+	dispatch_tracebuf_header_t dtbh;
+	dispatch_tracebuf_t tb;
+	int fd, err;
+
+	if (nstreams > UINT16_MAX) nstreams = UINT16_MAX;
+	size /= DISPATCH_TRACEBUF_CHUNK_SIZE;
+	if (size < 2 * nstreams) size = 2 * nstreams;
+	if (size > DISPATCH_TRACEBUF_MAX_CHUNKS) size = DISPATCH_TRACEBUF_MAX_CHUNKS;
+	nchunks = (uint32_t)size;
+	while (ring_size < nchunks) ring_size <<= 1;
+
+	ring_offset = DISPATCH_TRACEBUF_ROUND_UP(
+			sizeof(struct dispatch_tracebuf_header_s), DISPATCH_CACHELINE_SIZE);
+	streams_offset = ring_offset + ring_size * sizeof(uint64_t);
+	chunks_offset = DISPATCH_TRACEBUF_ROUND_UP(streams_offset +
+			nstreams * sizeof(struct dispatch_tracebuf_stream_s),
+			DISPATCH_TRACEBUF_CHUNK_SIZE);
+	total = chunks_offset + (uint64_t)nchunks * DISPATCH_TRACEBUF_CHUNK_SIZE;
+
+	fd = _dispatch_tracebuf_shm_create(name);
+	if (fd == -1) {
+		return NULL;
+	}
+	if (ftruncate(fd, (off_t)total) == -1) {
+		goto fail;
+	}
+
+	dtbh = mmap(NULL, (size_t)total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (dtbh == MAP_FAILED) {
+		goto fail;
+	}
+	dtbh->dtbh_version = DISPATCH_TRACEBUF_VERSION;
+	dtbh->dtbh_chunk_size = DISPATCH_TRACEBUF_CHUNK_SIZE;
+	dtbh->dtbh_nchunks = nchunks;
+	dtbh->dtbh_ring_size = ring_size;
+	dtbh->dtbh_nstreams = nstreams;
+	dtbh->dtbh_pid = (uint32_t)getpid();
+	dtbh->dtbh_size = total;
+	dtbh->dtbh_ring_offset = ring_offset;
+	dtbh->dtbh_streams_offset = streams_offset;
+	dtbh->dtbh_chunks_offset = chunks_offset;
+	strlcpy(dtbh->dtbh_name, name, sizeof(dtbh->dtbh_name));
+
+	tb = _dispatch_calloc(1, sizeof(struct dispatch_tracebuf_s));
+	_dispatch_tracebuf_init(tb, dtbh, dtbh, fd);
+	// every chunk starts free, and sealed so that nothing reserves in it
+	for (uint32_t i = 0; i < nchunks; i++) {
+		_dispatch_tracebuf_chunk(tb, i)->dtc_pos.dtcp_atomic_pos =
+				DTCP_FLAG_SEALED;
+		tb->dtb_ring[i] = DTR_SLOT(i, i);
+	}
+	dtbh->dtbh_ring_tail = 0;
+	dtbh->dtbh_ring_flushed = nchunks;
+	dtbh->dtbh_ring_head = nchunks;
+	os_atomic_store(&dtbh->dtbh_magic, DISPATCH_TRACEBUF_MAGIC, release);
+	return tb;
+
+fail:
+	err = errno;
+	close(fd);
+	errno = err;
+	return NULL;
+}
+
+int
+dispatch_tracebuf_get_fd(dispatch_tracebuf_t tb)
+{
+	return tb->dtb_fd;
+}
+
+void
+dispatch_tracebuf_dispose(dispatch_tracebuf_t tb)
+{
+	munmap(tb->dtb_header, tb->dtb_size);
+	close(tb->dtb_fd);
+	free(tb);
+}
+
+#pragma mark -
+#pragma mark chunk ring
+
+static void
+_dispatch_tracebuf_ring_enqueue(dispatch_tracebuf_t tb, uint32_t chunk)
+{
+	dispatch_tracebuf_header_t dtbh = tb->dtb_header;
+	uint32_t pos = os_atomic_inc_orig(&dtbh->dtbh_ring_head, relaxed);
+
+	// publishes the tracepoints of the chunk that the last reference
+	// acquired, until then the reader stops at this position
+	os_atomic_store(&tb->dtb_ring[pos & tb->dtb_ring_mask],
+			DTR_SLOT(pos, chunk), release);
+}
+
+// returns the index + 1 of a free chunk, or 0 if the reader is behind
+static uint32_t
+_dispatch_tracebuf_chunk_alloc(dispatch_tracebuf_t tb)
+{
+	dispatch_tracebuf_header_t dtbh = tb->dtb_header;
+	uint32_t tail = os_atomic_load(&dtbh->dtbh_ring_tail, relaxed);
+	uint64_t slot;
+
+	for (;;) {
+		// acquire pairs with the reader being done with the chunks
+		if (tail == os_atomic_load(&dtbh->dtbh_ring_flushed, acquire)) {
+			return 0;
+		}
+		// no enqueue can reuse this slot until tail moves past it
+		slot = os_atomic_load(&tb->dtb_ring[tail & tb->dtb_ring_mask],
+				relaxed);
+		if (os_atomic_cmpxchgv(&dtbh->dtbh_ring_tail, tail, tail + 1, &tail,
+				relaxed)) {
+			return DTR_SLOT_CHUNK(slot) + 1;
+		}
+	}
+}
+
+// drops the reference of the stream on its chunk, and enqueues the chunk
+// if it was the last one
+static void
+_dispatch_tracebuf_chunk_seal(dispatch_tracebuf_t tb, uint32_t chunk)
+{
+	dispatch_tracebuf_chunk_t dtc = _dispatch_tracebuf_chunk(tb, chunk);
+	uint64_t opos, npos;
+
+	os_atomic_rmw_loop(&dtc->dtc_pos.dtcp_atomic_pos, opos, npos, acq_rel, {
+		npos = (opos | DTCP_FLAG_SEALED) - DTCP_REFCNT_INC;
+	});
+	if (DTCP_REFCNT(npos) == 0) {
+		_dispatch_tracebuf_ring_enqueue(tb, chunk);
+	}
+}
+
+// replaces the chunk of a stream seen in state `state`, returns false if
+// there is no free chunk
+DISPATCH_NOINLINE
+static bool
+_dispatch_tracebuf_stream_refill(dispatch_tracebuf_t tb,
+		dispatch_tracebuf_stream_t dtbs, uint64_t state)
+{
+	uint64_t new_state;
+	uint32_t chunk;
+
+	if (state & DTSS_INSTALLING) {
+		_dispatch_wait_until(!(os_atomic_load(&dtbs->dtbs_state, relaxed) &
+				DTSS_INSTALLING));
+		return true;
+	}
+	new_state = (state & DTSS_GEN_MASK) | DTSS_INSTALLING;
+	if (!os_atomic_cmpxchg(&dtbs->dtbs_state, state, new_state, acquire)) {
+		// someone else replaced it
+		return true;
+	}
+	if (state & DTSS_CHUNK_MASK) {
+		_dispatch_tracebuf_chunk_seal(tb,
+				(uint32_t)(state & DTSS_CHUNK_MASK) - 1);
+	}
+
+	chunk = _dispatch_tracebuf_chunk_alloc(tb);
+	if (chunk) {
+		dispatch_tracebuf_chunk_t dtc = _dispatch_tracebuf_chunk(tb, chunk - 1);
+		dispatch_tracebuf_chunk_pos_u pos = {
+			.dtcp_next_offs = DISPATCH_TRACEBUF_HEADER_SIZE,
+			.dtcp_refcnt = 1,
+			.dtcp_stream = (uint16_t)(dtbs - tb->dtb_streams),
+		};
+		os_atomic_store(&dtc->dtc_pos.dtcp_atomic_pos, pos.dtcp_atomic_pos,
+				release);
+	}
+	new_state = (state & DTSS_GEN_MASK) + DTSS_GEN_INC + chunk;
+	os_atomic_store(&dtbs->dtbs_state, new_state, release);
+	return chunk != 0;
+}
+
+#pragma mark -
+#pragma mark tracepoints
+
+dispatch_tracepoint_t
+dispatch_tracebuf_tracepoint_reserve(dispatch_tracebuf_t tb, size_t length)
+{
+	dispatch_tracebuf_stream_t dtbs = _dispatch_tracebuf_stream_current(tb);
+	uint64_t size, state, opos, npos;
+	dispatch_tracebuf_chunk_t dtc;
+	dispatch_tracepoint_t tp;
+
+	if (unlikely(length > DISPATCH_TRACEBUF_TRACEPOINT_MAX_SIZE)) {
+		DISPATCH_CLIENT_CRASH(length, "Tracepoint too large");
+	}
+	size = DISPATCH_TRACEBUF_ROUND_UP(sizeof(dispatch_tracepoint_s) + length,
+			DISPATCH_TRACEBUF_TRACEPOINT_ALIGN);
+
+	for (;;) {
+		state = os_atomic_load(&dtbs->dtbs_state, acquire);
+		if (likely(state & DTSS_CHUNK_MASK)) {
+			dtc = _dispatch_tracebuf_chunk(tb,
+					(uint32_t)(state & DTSS_CHUNK_MASK) - 1);
+			opos = os_atomic_load(&dtc->dtc_pos.dtcp_atomic_pos, relaxed);
+			// the chunk may be sealed, or even recycled by now, reserving in
+			// a chunk that is installed elsewhere is harmless, and acquire
+			// orders our writes after the ones of its previous use
+			while (!(opos & DTCP_FLAG_SEALED) &&
+					DTCP_NEXT_OFFS(opos) + size <= DISPATCH_TRACEBUF_CHUNK_SIZE) {
+				npos = opos + size + DTCP_REFCNT_INC;
+				if (os_atomic_cmpxchgvw(&dtc->dtc_pos.dtcp_atomic_pos, opos,
+						npos, &opos, acquire)) {
+					goto reserved;
+				}
+			}
+		}
+		if (!_dispatch_tracebuf_stream_refill(tb, dtbs, state)) {
+			os_atomic_inc(&tb->dtb_header->dtbh_lost, relaxed);
+			return NULL;
+		}
+	}
+
+reserved:
+	tp = (dispatch_tracepoint_t)((char *)dtc + DTCP_NEXT_OFFS(opos));
+	tp->dtp_id = 0;
+	tp->dtp_stamp = _dispatch_time_mach2nano(_dispatch_uptime());
+	tp->dtp_tid = (uint32_t)_dispatch_tid_self();
+	tp->dtp_length = (uint16_t)length;
+	tp->_dtp_unused = 0;
+	return tp;
+}
+
+void
+dispatch_tracebuf_tracepoint_flush(dispatch_tracebuf_t tb,
+		dispatch_tracepoint_t tp, uint64_t id)
+{
+	dispatch_tracebuf_chunk_t dtc;
+	uint64_t pos;
+
+	if (unlikely(!id)) {
+		DISPATCH_CLIENT_CRASH(0, "Tracepoint flushed with a 0 identifier");
+	}
+	dtc = (dispatch_tracebuf_chunk_t)((uintptr_t)tp &
+			~(uintptr_t)(DISPATCH_TRACEBUF_CHUNK_SIZE - 1));
+	os_atomic_store(&tp->dtp_id, id, relaxed);
+	// acquire for the tracepoints of the other references when this is the
+	// last one, only sealed chunks can lose it
+	pos = os_atomic_sub(&dtc->dtc_pos.dtcp_atomic_pos, DTCP_REFCNT_INC,
+			acq_rel);
+	if (unlikely(DTCP_REFCNT(pos) == 0)) {
+		_dispatch_tracebuf_ring_enqueue(tb,
+				_dispatch_tracebuf_chunk_idx(tb, dtc));
+	}
+}
+
+bool
+dispatch_tracebuf_write(dispatch_tracebuf_t tb, uint64_t id,
+		const void *data, size_t length)
+{
+	dispatch_tracepoint_t tp = dispatch_tracebuf_tracepoint_reserve(tb, length);
+	if (unlikely(!tp)) {
+		return false;
+	}
+	if (length) memcpy(tp->dtp_data, data, length);
+	dispatch_tracebuf_tracepoint_flush(tb, tp, id);
+	return true;
+}
+
+void
+dispatch_tracebuf_push(dispatch_tracebuf_t tb)
+{
+	for (uint32_t i = 0; i < tb->dtb_nstreams; i++) {
+		dispatch_tracebuf_stream_t dtbs = &tb->dtb_streams[i];
+		uint64_t state = os_atomic_load(&dtbs->dtbs_state, relaxed);
+		uint32_t chunk = (uint32_t)(state & DTSS_CHUNK_MASK);
+		dispatch_tracebuf_chunk_t dtc;
+
+		if (!chunk || (state & DTSS_INSTALLING)) {
+			continue;
+		}
+		dtc = _dispatch_tracebuf_chunk(tb, chunk - 1);
+		if (DTCP_NEXT_OFFS(os_atomic_load(&dtc->dtc_pos.dtcp_atomic_pos,
+				relaxed)) == DISPATCH_TRACEBUF_HEADER_SIZE) {
+			continue;
+		}
+		// the next tracepoint of the stream installs a new chunk
+		if (os_atomic_cmpxchg(&dtbs->dtbs_state, state,
+				(state & DTSS_GEN_MASK) + DTSS_GEN_INC, acquire)) {
+			_dispatch_tracebuf_chunk_seal(tb, chunk - 1);
+		}
+	}
+}
+
+#pragma mark -
+#pragma mark dispatch_tracebuf_reader_t
+
+DISPATCH_ALWAYS_INLINE
+static inline bool
+_dispatch_tracebuf_range_is_valid(uint64_t offset, uint64_t length,
+		uint64_t size)
+{
+	return offset <= size && length <= size - offset;
+}
+
+// The file may come from another process, check that everything the header
+// points at lies within the file before anything is dereferenced
+static bool
+_dispatch_tracebuf_header_is_valid(const struct dispatch_tracebuf_header_s *hdr,
+		uint64_t size)
+{
+	if (hdr->dtbh_magic != DISPATCH_TRACEBUF_MAGIC ||
+			hdr->dtbh_version != DISPATCH_TRACEBUF_VERSION ||
+			hdr->dtbh_chunk_size != DISPATCH_TRACEBUF_CHUNK_SIZE ||
+			hdr->dtbh_size != size) {
+		return false;
+	}
+	if (!hdr->dtbh_nstreams || hdr->dtbh_nstreams > UINT16_MAX ||
+			!hdr->dtbh_nchunks || hdr->dtbh_nchunks > hdr->dtbh_ring_size ||
+			(hdr->dtbh_ring_size & (hdr->dtbh_ring_size - 1))) {
+		return false;
+	}
+	if (hdr->dtbh_ring_offset < sizeof(struct dispatch_tracebuf_header_s) ||
+			hdr->dtbh_ring_offset % sizeof(uint64_t) ||
+			hdr->dtbh_streams_offset % sizeof(uint64_t) ||
+			hdr->dtbh_chunks_offset % DISPATCH_TRACEBUF_CHUNK_SIZE) {
+		return false;
+	}
+	return _dispatch_tracebuf_range_is_valid(hdr->dtbh_ring_offset,
+			(uint64_t)hdr->dtbh_ring_size * sizeof(uint64_t), size) &&
+			_dispatch_tracebuf_range_is_valid(hdr->dtbh_streams_offset,
+			(uint64_t)hdr->dtbh_nstreams *
+			sizeof(struct dispatch_tracebuf_stream_s), size) &&
+			_dispatch_tracebuf_range_is_valid(hdr->dtbh_chunks_offset,
+			(uint64_t)hdr->dtbh_nchunks * DISPATCH_TRACEBUF_CHUNK_SIZE, size);
+}
+
+dispatch_tracebuf_reader_t
+dispatch_tracebuf_reader_create(int fd)
+{
+	struct dispatch_tracebuf_header_s hdr;
+	dispatch_tracebuf_reader_t reader;
+	struct stat st;
+	void *base;
+
+	if (fstat(fd, &st) == -1) {
+		return NULL;
+	}
+	if (st.st_size < (off_t)sizeof(hdr) ||
+			pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+			!_dispatch_tracebuf_header_is_valid(&hdr, (uint64_t)st.st_size)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	// the reader moves the flushed marker of the ring
+	base = mmap(NULL, (size_t)hdr.dtbh_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		return NULL;
+	}
+	reader = _dispatch_calloc(1, sizeof(struct dispatch_tracebuf_reader_s));
+	_dispatch_tracebuf_init(&reader->dtr_tb, base, &hdr, -1);
+	memcpy(reader->dtr_name, hdr.dtbh_name, sizeof(reader->dtr_name));
+	reader->dtr_name[sizeof(reader->dtr_name) - 1] = '\0';
+	return reader;
+}
+
+size_t
+dispatch_tracebuf_reader_drain_f(dispatch_tracebuf_reader_t reader,
+		void *context, dispatch_tracebuf_reader_function_t function)
+{
+	dispatch_tracebuf_t tb = &reader->dtr_tb;
+	dispatch_tracebuf_header_t dtbh = tb->dtb_header;
+	uint32_t pos = os_atomic_load(&dtbh->dtbh_ring_flushed, relaxed);
+	uint32_t head = os_atomic_load(&dtbh->dtbh_ring_head, relaxed);
+	size_t count = 0;
+
+	for (; pos != head; pos++) {
+		uint64_t slot = os_atomic_load(&tb->dtb_ring[pos & tb->dtb_ring_mask],
+				acquire);
+		dispatch_tracebuf_chunk_t dtc;
+		uint64_t cpos;
+		uint32_t offs, end;
+
+		// the writer that claimed this position hasn't stored it yet
+		if (DTR_SLOT_POS(slot) != pos ||
+				DTR_SLOT_CHUNK(slot) >= tb->dtb_nchunks) {
+			break;
+		}
+		dtc = _dispatch_tracebuf_chunk(tb, DTR_SLOT_CHUNK(slot));
+		cpos = os_atomic_load(&dtc->dtc_pos.dtcp_atomic_pos, relaxed);
+		end = DTCP_NEXT_OFFS(cpos);
+		if (end > DISPATCH_TRACEBUF_CHUNK_SIZE) {
+			end = DISPATCH_TRACEBUF_CHUNK_SIZE;
+		}
+		for (offs = DISPATCH_TRACEBUF_HEADER_SIZE;
+				offs + sizeof(dispatch_tracepoint_s) <= end;) {
+			dispatch_tracepoint_t tp = (dispatch_tracepoint_t)
+					((char *)dtc + offs);
+			if (offs + sizeof(dispatch_tracepoint_s) + tp->dtp_length > end) {
+				break;
+			}
+			if (tp->dtp_id) {
+				function(context, tp, DTCP_STREAM(cpos));
+				count++;
+			}
+			offs += (uint32_t)DISPATCH_TRACEBUF_ROUND_UP(sizeof(dispatch_tracepoint_s) +
+					tp->dtp_length, DISPATCH_TRACEBUF_TRACEPOINT_ALIGN);
+		}
+		// hands the chunk back to the writers
+		os_atomic_store(&dtbh->dtbh_ring_flushed, pos + 1, release);
+	}
+	return count;
+}
+
+const char *
+dispatch_tracebuf_reader_get_info(dispatch_tracebuf_reader_t reader,
+		pid_t *pid, uint64_t *lost)
+{
+	dispatch_tracebuf_header_t dtbh = reader->dtr_tb.dtb_header;
+
+	if (pid) *pid = (pid_t)dtbh->dtbh_pid;
+	if (lost) *lost = os_atomic_load(&dtbh->dtbh_lost, relaxed);
+	return reader->dtr_name;
+}
+
+void
+dispatch_tracebuf_reader_dispose(dispatch_tracebuf_reader_t reader)
+{
+	munmap(reader->dtr_tb.dtb_header, reader->dtr_tb.dtb_size);
+	free(reader);
+}
+
+#endif // !defined(_WIN32)
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * IMPORTANT: This header file describes INTERNAL interfaces to libdispatch
+ * which are subject to change in future releases of Mac OS X. Any applications
+ * relying on these interfaces WILL break.
+ */
+
+#ifndef __DISPATCH_TRACEBUF_INTERNAL__
+#define __DISPATCH_TRACEBUF_INTERNAL__
+
+#define DISPATCH_TRACEBUF_MAGIC 0x6675626563617274ull // "tracebuf"
+#define DISPATCH_TRACEBUF_VERSION 1
+#define DISPATCH_TRACEBUF_CHUNK_SIZE 4096u
+#define DISPATCH_TRACEBUF_MAX_CHUNKS 0x10000u
+#define DISPATCH_TRACEBUF_NAME_SIZE 64
+
+/*
+ * A chunk position packs, like firehose_chunk_pos_u:
+ * - the offset of the next tracepoint to reserve,
+ * - the number of references on the chunk: one per tracepoint reserved and
+ *   not flushed yet, and one for the stream while it is installed,
+ * - whether the chunk was sealed, after which nothing can be reserved in it,
+ * - the stream it was installed in.
+ *
+ * Chunks are sealed when they are full or pushed, and go to the ring once
+ * sealed with no references left. Free chunks stay sealed until installed.
+ */
+typedef union {
+	uint64_t dtcp_atomic_pos;
+	struct {
+		uint16_t dtcp_next_offs;
+		uint16_t dtcp_refcnt;
+		uint16_t dtcp_flags;
+		uint16_t dtcp_stream;
+	};
+} dispatch_tracebuf_chunk_pos_u;
+
+#define DTCP_REFCNT_INC (1ull << 16)
+#define DTCP_FLAG_SEALED (1ull << 32)
+#define DTCP_NEXT_OFFS(pos) ((uint16_t)(pos))
+#define DTCP_REFCNT(pos) ((uint16_t)((pos) >> 16))
+#define DTCP_STREAM(pos) ((uint16_t)((pos) >> 48))
+
+typedef struct dispatch_tracebuf_chunk_s {
+	dispatch_tracebuf_chunk_pos_u volatile dtc_pos;
+	uint64_t _dtc_unused;
+	uint8_t dtc_data[];
+} *dispatch_tracebuf_chunk_t;
+
+/*
+ * The state of a stream: the chunk installed in it (index + 1, 0 when none),
+ * whether a thread is installing a new one, and a generation bumped by every
+ * installation, like the one of firehose_stream_state_u.
+ */
+#define DTSS_CHUNK_MASK 0x00000000ffffffffull
+#define DTSS_INSTALLING 0x0000000100000000ull
+#define DTSS_GEN_INC 0x0000000200000000ull
+#define DTSS_GEN_MASK (~(DTSS_CHUNK_MASK | DTSS_INSTALLING))
+
+typedef struct dispatch_tracebuf_stream_s {
+	uint64_t volatile dtbs_state;
+} DISPATCH_CACHELINE_ALIGN *dispatch_tracebuf_stream_t;
+
+/*
+ * The ring holds chunk references tagged with the position they were
+ * enqueued at, there are 3 markers on it, like on the firehose rings:
+ *
+ *   tail <= flushed <= head
+ *
+ * - head is where writers enqueue the chunks they seal,
+ * - the reader consumes chunks between flushed and head,
+ * - writers take free chunks between tail and flushed.
+ *
+ * The ring has at least as many slots as there are chunks, so head never
+ * laps tail. Initially every chunk is free: positions [0, nchunks) hold all
+ * the chunks, and flushed == head == nchunks.
+ */
+typedef struct dispatch_tracebuf_header_s {
+	uint64_t volatile dtbh_magic;
+	uint32_t dtbh_version;
+	uint32_t dtbh_chunk_size;
+	uint32_t dtbh_nchunks;
+	uint32_t dtbh_ring_size;
+	uint32_t dtbh_nstreams;
+	uint32_t dtbh_pid;
+	uint64_t dtbh_size;
+	uint64_t dtbh_ring_offset;
+	uint64_t dtbh_streams_offset;
+	uint64_t dtbh_chunks_offset;
+	uint64_t volatile dtbh_lost;
+	char dtbh_name[DISPATCH_TRACEBUF_NAME_SIZE];
+
+	uint32_t volatile dtbh_ring_head DISPATCH_CACHELINE_ALIGN;
+	uint32_t volatile dtbh_ring_flushed DISPATCH_CACHELINE_ALIGN;
+	uint32_t volatile dtbh_ring_tail DISPATCH_CACHELINE_ALIGN;
+} DISPATCH_CACHELINE_ALIGN *dispatch_tracebuf_header_t;
+
+#define DTR_SLOT(pos, chunk) ((uint64_t)(pos) << 32 | (chunk))
+#define DTR_SLOT_POS(slot) ((uint32_t)((slot) >> 32))
+#define DTR_SLOT_CHUNK(slot) ((uint32_t)(slot))
+
+#endif // __DISPATCH_TRACEBUF_INTERNAL__
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * Pending limits of dispatch_queue_set_pending_limit(): every case parks the
+ * queue in a work item that waits for a gate, fills it, and looks at what
+ * happens to the next submissions.
+ */
+
+#include "dispatch_test.h"
+
+#define DROP_ITEMS 5
+#define DROP_LIMIT 2
+
+typedef struct bounded_test_s {
+	dispatch_queue_t bt_queue;
+	dispatch_semaphore_t bt_started;
+	dispatch_semaphore_t bt_gate;
+	dispatch_semaphore_t bt_done;
+	long volatile bt_ran;
+	long bt_order[DROP_ITEMS];
+} *bounded_test_t;
+
+static bounded_test_t
+bounded_test_create(size_t limit, dispatch_queue_overflow_t overflow)
+{
+	bounded_test_t bt = calloc(1, sizeof(*bt));
+
+	bt->bt_queue = dispatch_queue_create("com.apple.test.bounded",
+			dispatch_queue_attr_make_initially_inactive(DISPATCH_QUEUE_SERIAL));
+	dispatch_queue_set_pending_limit(bt->bt_queue, limit, overflow);
+	dispatch_activate(bt->bt_queue);
+	bt->bt_started = dispatch_semaphore_create(0);
+	bt->bt_gate = dispatch_semaphore_create(0);
+	bt->bt_done = dispatch_semaphore_create(0);
+	return bt;
+}
+
+static void
+bounded_test_dispose(bounded_test_t bt)
+{
+	dispatch_release(bt->bt_queue);
+	dispatch_release(bt->bt_started);
+	dispatch_release(bt->bt_gate);
+	dispatch_release(bt->bt_done);
+	free(bt);
+}
+
+static void
+blocker(void *ctxt)
+{
+	bounded_test_t bt = ctxt;
+
+	dispatch_semaphore_signal(bt->bt_started);
+	dispatch_semaphore_wait(bt->bt_gate, DISPATCH_TIME_FOREVER);
+}
+
+static void
+count(void *ctxt)
+{
+	bounded_test_t bt = ctxt;
+
+	__atomic_fetch_add(&bt->bt_ran, 1, __ATOMIC_RELAXED);
+}
+
+static void
+done(void *ctxt)
+{
+	bounded_test_t bt = ctxt;
+
+	dispatch_semaphore_signal(bt->bt_done);
+}
+
+// makes the queue busy, nothing submitted after this starts executing until
+// the gate opens
+static void
+park(bounded_test_t bt)
+{
+	dispatch_async_f(bt->bt_queue, bt, blocker);
+	test_wait("blocker started", bt->bt_started);
+}
+
+static void
+test_fail(void)
+{
+	bounded_test_t bt = bounded_test_create(2, DISPATCH_QUEUE_OVERFLOW_FAIL);
+
+	park(bt);
+	test_long("fail: first item fits",
+			dispatch_async_bounded_f(bt->bt_queue, bt, count), 0);
+	test_long("fail: second item fits",
+			dispatch_async_bounded_f(bt->bt_queue, bt, count), 0);
+	test_check(dispatch_async_bounded_f(bt->bt_queue, bt, count) != 0,
+			"fail: third item is refused");
+	dispatch_semaphore_signal(bt->bt_gate);
+	dispatch_sync_f(bt->bt_queue, bt, count);
+	test_long("fail: refused item never ran", bt->bt_ran, 3);
+	// the slots are given back as the items start
+	test_long("fail: room again once drained",
+			dispatch_async_bounded_f(bt->bt_queue, bt, done), 0);
+	test_wait("fail: item submitted after draining ran", bt->bt_done);
+	bounded_test_dispose(bt);
+}
+
+static void
+async_from_other_thread(void *ctxt)
+{
+	bounded_test_t bt = ctxt;
+
+	dispatch_async_f(bt->bt_queue, bt, count);
+	dispatch_semaphore_signal(bt->bt_done);
+}
+
+static void
+test_block(dispatch_queue_overflow_t overflow, const char *name)
+{
+	bounded_test_t bt = bounded_test_create(1, overflow);
+	char desc[128];
+
+	park(bt);
+	dispatch_async_f(bt->bt_queue, bt, count);
+	// dispatch_async() can't fail, it waits for room in both modes
+	dispatch_async_f(dispatch_get_global_queue(0, 0), bt,
+			async_from_other_thread);
+	snprintf(desc, sizeof(desc), "%s: dispatch_async waits on a full queue",
+			name);
+	test_no_signal(desc, bt->bt_done, 200 * NSEC_PER_MSEC);
+	dispatch_semaphore_signal(bt->bt_gate);
+	snprintf(desc, sizeof(desc), "%s: dispatch_async returns once drained",
+			name);
+	test_wait(desc, bt->bt_done);
+	dispatch_sync_f(bt->bt_queue, bt, count);
+	snprintf(desc, sizeof(desc), "%s: every item ran", name);
+	test_long(desc, bt->bt_ran, 3);
+	bounded_test_dispose(bt);
+}
+
+typedef struct drop_item_s {
+	bounded_test_t di_test;
+	long di_index;
+} drop_item_s;
+
+static void
+record(void *ctxt)
+{
+	drop_item_s *di = ctxt;
+	bounded_test_t bt = di->di_test;
+
+	bt->bt_order[bt->bt_ran++] = di->di_index;
+}
+
+static void
+test_drop_oldest(void)
+{
+	bounded_test_t bt = bounded_test_create(DROP_LIMIT,
+			DISPATCH_QUEUE_OVERFLOW_DROP_OLDEST);
+	drop_item_s items[DROP_ITEMS];
+
+	park(bt);
+	for (long i = 0; i < DROP_ITEMS; i++) {
+		items[i] = (drop_item_s){ .di_test = bt, .di_index = i };
+		dispatch_async_f(bt->bt_queue, &items[i], record);
+	}
+	dispatch_semaphore_signal(bt->bt_gate);
+	// sync waiters aren't counted, and can't be dropped
+	dispatch_sync_f(bt->bt_queue, bt, done);
+	test_wait("drop: sync item ran", bt->bt_done);
+	if (test_long("drop: only the newest items ran", bt->bt_ran, DROP_LIMIT)) {
+		for (long i = 0; i < DROP_LIMIT; i++) {
+			test_long("drop: in submission order", bt->bt_order[i],
+					DROP_ITEMS - DROP_LIMIT + i);
+		}
+	}
+	bounded_test_dispose(bt);
+}
+
+int
+main(void)
+{
+	test_fail();
+	test_block(DISPATCH_QUEUE_OVERFLOW_BLOCK, "block");
+	test_block(DISPATCH_QUEUE_OVERFLOW_FAIL, "fail");
+	test_drop_oldest();
+	return test_finish("dispatch_bounded");
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * dispatch_queue_graph_dump(): a small hierarchy of queues with statistics
+ * enabled must show up under its target in the text output, with the
+ * threads blocked in dispatch_sync() on them, and in the JSON output.
+ */
+
+#include "dispatch_test.h"
+#include <string.h>
+
+#define PARENT_LABEL "com.apple.test.graph.parent"
+#define CHILD1_LABEL "com.apple.test.graph.child1"
+#define CHILD2_LABEL "com.apple.test.graph.child2"
+
+// returns the whole output of a dump, to be freed by the caller
+static char *
+dump(dispatch_queue_graph_format_t format)
+{
+	FILE *f = tmpfile();
+	char *buf;
+	long size;
+
+	if (!f) {
+		perror("tmpfile");
+		exit(EXIT_FAILURE);
+	}
+	test_check(dispatch_queue_graph_dump(fileno(f), format), "dump succeeds");
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	rewind(f);
+	buf = calloc(1, (size_t)size + 1);
+	if (fread(buf, 1, (size_t)size, f) != (size_t)size) {
+		perror("fread");
+		exit(EXIT_FAILURE);
+	}
+	fclose(f);
+	return buf;
+}
+
+// returns the indentation of the line describing a queue, or -1
+static long
+indentation(const char *text, const char *label, const char **line)
+{
+	const char *s = strstr(text, label), *start;
+
+	if (!s) return -1;
+	for (start = s; start > text && start[-1] != '\n'; start--);
+	*line = start;
+	return (long)strspn(start, " ");
+}
+
+static bool
+line_has(const char *line, const char *s)
+{
+	const char *found = strstr(line, s), *eol = strchr(line, '\n');
+
+	return found && (!eol || found < eol);
+}
+
+static void
+sync_noop(void *ctxt)
+{
+	(void)ctxt;
+}
+
+static void
+sync_waiter(void *ctxt)
+{
+	dispatch_queue_t dq = ctxt;
+
+	dispatch_sync_f(dq, NULL, sync_noop);
+}
+
+static void
+test_text(dispatch_queue_t child1)
+{
+	const char *parent_line, *child1_line, *child2_line;
+	dispatch_group_t dg = dispatch_group_create();
+	char *text = dump(DISPATCH_QUEUE_GRAPH_TEXT);
+	long parent, c1, c2;
+	bool found = false;
+
+	parent = indentation(text, PARENT_LABEL "[", &parent_line);
+	c1 = indentation(text, CHILD1_LABEL "[", &child1_line);
+	c2 = indentation(text, CHILD2_LABEL "[", &child2_line);
+	if (test_check(parent >= 0 && c1 >= 0 && c2 >= 0,
+			"text: every queue is described")) {
+		test_long("text: first child is nested under its target", c1,
+				parent + 2);
+		test_long("text: second child is nested under its target", c2,
+				parent + 2);
+		test_check(parent_line < child1_line && child1_line < child2_line,
+				"text: children follow their target in creation order");
+		test_check(line_has(child1_line, "suspended = 1"),
+				"text: the suspended child is reported suspended");
+		test_check(!line_has(child2_line, "suspended"),
+				"text: the other child isn't");
+	}
+	free(text);
+
+	// the first dump started tracking the threads blocked in dispatch_sync()
+	dispatch_group_async_f(dg, dispatch_get_global_queue(0, 0), child1,
+			sync_waiter);
+	for (int i = 0; i < 1000 && !found; i++) {
+		text = dump(DISPATCH_QUEUE_GRAPH_TEXT);
+		found = strstr(text, "waiting for " CHILD1_LABEL "[") != NULL;
+		free(text);
+		if (!found) usleep(10000);
+	}
+	test_check(found, "text: the thread blocked in dispatch_sync is listed");
+	dispatch_resume(child1);
+	test_long("text: the blocked thread resumes",
+			dispatch_group_wait(dg, dispatch_time(DISPATCH_TIME_NOW,
+			(int64_t)TEST_WAIT_TIMEOUT)), 0);
+	dispatch_release(dg);
+}
+
+static void
+test_json(dispatch_queue_t parent)
+{
+	char *json = dump(DISPATCH_QUEUE_GRAPH_JSON);
+	char target[64];
+
+	snprintf(target, sizeof(target), "\"target\":\"%p\"", (void *)parent);
+	test_check(strncmp(json, "{\"pid\":", 7) == 0, "json: is an object");
+	test_check(strstr(json, "\"queues\":[") &&
+			strstr(json, "\"sync_waiters\":["),
+			"json: has the queues and the sync waiters");
+	test_check(strstr(json, "\"label\":\"" CHILD1_LABEL "\"") != NULL,
+			"json: describes the child");
+	test_check(strstr(json, target) != NULL,
+			"json: the child refers to its target by address");
+	test_check(strlen(json) > 3 &&
+			strcmp(json + strlen(json) - 3, "]}\n") == 0, "json: is complete");
+	free(json);
+}
+
+int
+main(void)
+{
+	dispatch_queue_t parent, child1, child2;
+
+	parent = dispatch_queue_create(PARENT_LABEL, DISPATCH_QUEUE_CONCURRENT);
+	child1 = dispatch_queue_create_with_target(CHILD1_LABEL,
+			DISPATCH_QUEUE_SERIAL, parent);
+	child2 = dispatch_queue_create_with_target(CHILD2_LABEL,
+			DISPATCH_QUEUE_SERIAL, parent);
+	dispatch_queue_enable_stats(parent);
+	dispatch_queue_enable_stats(child1);
+	dispatch_queue_enable_stats(child2);
+	dispatch_suspend(child1);
+
+	test_text(child1);
+	test_json(parent);
+
+	dispatch_release(child1);
+	dispatch_release(child2);
+	dispatch_release(parent);
+	return test_finish("dispatch_queue_graph");
+}
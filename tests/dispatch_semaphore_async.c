@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * dispatch_semaphore_acquire_async_f(): acquirers run right away when the
+ * semaphore is available, are handed the semaphore in FIFO order by
+ * dispatch_semaphore_signal(), ahead of blocked threads, and mix with timed
+ * waits without losing or stealing a signal.
+ */
+
+#include "dispatch_test.h"
+
+#define ACQUIRERS 64
+#define TIMEOUT_ROUNDS 200
+
+typedef struct acquire_test_s {
+	dispatch_semaphore_t at_sema;
+	dispatch_semaphore_t at_done;
+	long volatile at_ran;
+	long at_order[ACQUIRERS];
+} acquire_test_s;
+
+typedef struct acquirer_s {
+	acquire_test_s *a_test;
+	long a_index;
+} acquirer_s;
+
+static void
+noop(void *ctxt)
+{
+	(void)ctxt;
+}
+
+static void
+acquired(void *ctxt)
+{
+	acquire_test_s *at = ctxt;
+
+	__atomic_fetch_add(&at->at_ran, 1, __ATOMIC_RELAXED);
+	dispatch_semaphore_signal(at->at_done);
+}
+
+static void
+acquired_in_order(void *ctxt)
+{
+	acquirer_s *a = ctxt;
+	acquire_test_s *at = a->a_test;
+
+	at->at_order[at->at_ran++] = a->a_index;
+	dispatch_semaphore_signal(at->at_done);
+}
+
+static void
+acquired_and_release(void *ctxt)
+{
+	acquire_test_s *at = ctxt;
+
+	dispatch_semaphore_signal(at->at_sema);
+	dispatch_semaphore_signal(at->at_done);
+}
+
+static void
+test_available(void)
+{
+	acquire_test_s at = {
+		.at_sema = dispatch_semaphore_create(1),
+		.at_done = dispatch_semaphore_create(0),
+	};
+
+	dispatch_semaphore_acquire_async_f(at.at_sema,
+			dispatch_get_global_queue(0, 0), &at, acquired);
+	test_wait("available: acquirer runs without a signal", at.at_done);
+	test_check(dispatch_semaphore_wait(at.at_sema, DISPATCH_TIME_NOW) != 0,
+			"available: the acquirer holds the semaphore");
+	dispatch_semaphore_signal(at.at_sema);
+	test_long("available: released by a signal",
+			dispatch_semaphore_wait(at.at_sema, DISPATCH_TIME_NOW), 0);
+	// a semaphore must be back to its initial value when it is released
+	dispatch_semaphore_signal(at.at_sema);
+	dispatch_release(at.at_sema);
+	dispatch_release(at.at_done);
+}
+
+static void
+test_fifo(void)
+{
+	acquire_test_s at = {
+		.at_sema = dispatch_semaphore_create(0),
+		.at_done = dispatch_semaphore_create(0),
+	};
+	// a serial queue keeps the order in which the semaphore was handed over
+	dispatch_queue_t dq = dispatch_queue_create("com.apple.test.sema", NULL);
+	acquirer_s acquirers[ACQUIRERS];
+	bool in_order = true;
+
+	for (long i = 0; i < ACQUIRERS; i++) {
+		acquirers[i] = (acquirer_s){ .a_test = &at, .a_index = i };
+		dispatch_semaphore_acquire_async_f(at.at_sema, dq, &acquirers[i],
+				acquired_in_order);
+	}
+	test_no_signal("fifo: nobody runs before a signal", at.at_done,
+			50 * NSEC_PER_MSEC);
+	for (long i = 0; i < ACQUIRERS; i++) {
+		dispatch_semaphore_signal(at.at_sema);
+		if (!test_wait("fifo: one acquirer per signal", at.at_done)) break;
+	}
+	dispatch_sync_f(dq, NULL, noop);
+	test_long("fifo: every acquirer ran", at.at_ran, ACQUIRERS);
+	for (long i = 0; i < at.at_ran; i++) {
+		if (at.at_order[i] != i) in_order = false;
+	}
+	test_check(in_order, "fifo: acquirers are served in submission order");
+	dispatch_release(dq);
+	dispatch_release(at.at_sema);
+	dispatch_release(at.at_done);
+}
+
+static void
+blocked_waiter(void *ctxt)
+{
+	acquire_test_s *at = ctxt;
+
+	dispatch_semaphore_wait(at->at_sema, DISPATCH_TIME_FOREVER);
+	__atomic_fetch_add(&at->at_ran, 100, __ATOMIC_RELAXED);
+	dispatch_semaphore_signal(at->at_done);
+}
+
+static void
+test_before_waiters(void)
+{
+	acquire_test_s at = {
+		.at_sema = dispatch_semaphore_create(0),
+		.at_done = dispatch_semaphore_create(0),
+	};
+
+	// whether the thread blocks before or after the acquirer is queued,
+	// the first signal goes to the acquirer
+	dispatch_async_f(dispatch_get_global_queue(0, 0), &at, blocked_waiter);
+	dispatch_semaphore_acquire_async_f(at.at_sema,
+			dispatch_get_global_queue(0, 0), &at, acquired);
+	dispatch_semaphore_signal(at.at_sema);
+	test_wait("waiters: a signal is handed over", at.at_done);
+	test_long("waiters: the acquirer was served first", at.at_ran, 1);
+	dispatch_semaphore_signal(at.at_sema);
+	test_wait("waiters: the next signal wakes the thread", at.at_done);
+	test_long("waiters: the thread was served second", at.at_ran, 101);
+	dispatch_release(at.at_sema);
+	dispatch_release(at.at_done);
+}
+
+static void
+test_timeouts(void)
+{
+	acquire_test_s at = {
+		.at_sema = dispatch_semaphore_create(0),
+		.at_done = dispatch_semaphore_create(0),
+	};
+	long failures = 0;
+
+	for (int i = 0; i < TIMEOUT_ROUNDS; i++) {
+		// the timed out waiter must give its decrement back without
+		// consuming the signal meant for the acquirer queued before it
+		dispatch_semaphore_acquire_async_f(at.at_sema,
+				dispatch_get_global_queue(0, 0), &at, acquired_and_release);
+		if (!dispatch_semaphore_wait(at.at_sema,
+				dispatch_time(DISPATCH_TIME_NOW, 1000))) {
+			failures++;
+			break;
+		}
+		dispatch_semaphore_signal(at.at_sema);
+		if (dispatch_semaphore_wait(at.at_done,
+				dispatch_time(DISPATCH_TIME_NOW, (int64_t)TEST_WAIT_TIMEOUT))) {
+			failures++;
+			break;
+		}
+		// the acquirer released the semaphore, a timed wait gets it back
+		if (dispatch_semaphore_wait(at.at_sema,
+				dispatch_time(DISPATCH_TIME_NOW, (int64_t)TEST_WAIT_TIMEOUT))) {
+			failures++;
+			break;
+		}
+	}
+	test_long("timeouts: timed waits and acquirers hand over every signal",
+			failures, 0);
+	dispatch_release(at.at_sema);
+	dispatch_release(at.at_done);
+}
+
+int
+main(void)
+{
+	test_available();
+	test_fifo();
+	test_before_waiters();
+	test_timeouts();
+	return test_finish("dispatch_semaphore_async");
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * Helpers shared by the unit tests.
+ *
+ * Every test is a program run by ctest, which reports each check on its own
+ * line, starting with PASS or FAIL, and exits with a non-zero status if any
+ * check failed. Waits are bounded by test_wait() so that a hang fails the
+ * test instead of stalling the run.
+ */
+
+#ifndef __DISPATCH_TEST_H__
+#define __DISPATCH_TEST_H__
+
+#include <dispatch/dispatch.h>
+#include <dispatch/private.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// how long test_wait() waits before failing a check
+#define TEST_WAIT_TIMEOUT (10 * NSEC_PER_SEC)
+
+static unsigned int test_failures;
+
+static inline bool
+test_check(bool ok, const char *desc)
+{
+	printf("%s: %s\n", ok ? "PASS" : "FAIL", desc);
+	if (!ok) test_failures++;
+	return ok;
+}
+
+static inline bool
+test_long(const char *desc, long actual, long expected)
+{
+	if (actual != expected) {
+		printf("FAIL: %s (got %ld, expected %ld)\n", desc, actual, expected);
+		test_failures++;
+		return false;
+	}
+	printf("PASS: %s\n", desc);
+	return true;
+}
+
+// waits for a semaphore the code under test signals, failing after
+// TEST_WAIT_TIMEOUT
+static inline bool
+test_wait(const char *desc, dispatch_semaphore_t dsema)
+{
+	return test_check(!dispatch_semaphore_wait(dsema,
+			dispatch_time(DISPATCH_TIME_NOW, TEST_WAIT_TIMEOUT)), desc);
+}
+
+// checks that a semaphore is not signaled within the given time
+static inline bool
+test_no_signal(const char *desc, dispatch_semaphore_t dsema, uint64_t ns)
+{
+	return test_check(dispatch_semaphore_wait(dsema,
+			dispatch_time(DISPATCH_TIME_NOW, (int64_t)ns)) != 0, desc);
+}
+
+static inline int
+test_finish(const char *name)
+{
+	printf("%s: %s\n", test_failures ? "FAIL" : "PASS", name);
+	return test_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif // __DISPATCH_TEST_H__
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * dispatch_wait_analyzer_enable(): two serial queues whose work items call
+ * dispatch_sync() on each other must be reported as a deadlock. The two
+ * threads stay blocked, and are left behind when the test exits.
+ */
+
+#include "dispatch_test.h"
+#include <string.h>
+
+#define THRESHOLD (100 * NSEC_PER_MSEC)
+
+typedef struct deadlock_test_s {
+	dispatch_queue_t dt_q1, dt_q2;
+	dispatch_semaphore_t dt_started;
+	dispatch_semaphore_t dt_go;
+	dispatch_semaphore_t dt_reported;
+	dispatch_wait_report_entry_s dt_entries[2];
+	size_t volatile dt_count;
+} deadlock_test_s;
+
+static void
+noop(void *ctxt)
+{
+	(void)ctxt;
+}
+
+// runs on one queue and blocks on the other
+static void
+lock_q2(void *ctxt)
+{
+	deadlock_test_s *dt = ctxt;
+
+	dispatch_semaphore_signal(dt->dt_started);
+	dispatch_semaphore_wait(dt->dt_go, DISPATCH_TIME_FOREVER);
+	dispatch_sync_f(dt->dt_q2, NULL, noop);
+}
+
+static void
+lock_q1(void *ctxt)
+{
+	deadlock_test_s *dt = ctxt;
+
+	dispatch_semaphore_signal(dt->dt_started);
+	dispatch_semaphore_wait(dt->dt_go, DISPATCH_TIME_FOREVER);
+	dispatch_sync_f(dt->dt_q1, NULL, noop);
+}
+
+static void
+report(void *ctxt, const dispatch_wait_report_s *dwr)
+{
+	deadlock_test_s *dt = ctxt;
+
+	if (dwr->dwr_kind != DISPATCH_WAIT_REPORT_DEADLOCK || dt->dt_count) {
+		return;
+	}
+	if (dwr->dwr_count == 2) {
+		memcpy(dt->dt_entries, dwr->dwr_entries, sizeof(dt->dt_entries));
+	}
+	dt->dt_count = dwr->dwr_count;
+	dispatch_semaphore_signal(dt->dt_reported);
+}
+
+int
+main(void)
+{
+	deadlock_test_s dt = {
+		.dt_q1 = dispatch_queue_create("com.apple.test.wait.q1", NULL),
+		.dt_q2 = dispatch_queue_create("com.apple.test.wait.q2", NULL),
+		.dt_started = dispatch_semaphore_create(0),
+		.dt_go = dispatch_semaphore_create(0),
+		.dt_reported = dispatch_semaphore_create(0),
+	};
+
+	dispatch_wait_analyzer_enable(THRESHOLD, &dt, report);
+	dispatch_async_f(dt.dt_q1, &dt, lock_q2);
+	dispatch_async_f(dt.dt_q2, &dt, lock_q1);
+	// both queues are drained by their thread before either blocks
+	test_wait("first work item started", dt.dt_started);
+	test_wait("second work item started", dt.dt_started);
+	dispatch_semaphore_signal(dt.dt_go);
+	dispatch_semaphore_signal(dt.dt_go);
+
+	if (test_wait("deadlock reported", dt.dt_reported) &&
+			test_long("both threads are in the cycle", (long)dt.dt_count, 2)) {
+		dispatch_wait_report_entry_s *e = dt.dt_entries;
+
+		test_long("first thread waits in dispatch_sync",
+				(long)e[0].dwre_kind, DISPATCH_WAIT_SYNC);
+		test_long("second thread waits in dispatch_sync",
+				(long)e[1].dwre_kind, DISPATCH_WAIT_SYNC);
+		test_check(e[0].dwre_owner == e[1].dwre_thread,
+				"first thread waits for the second one");
+		test_check(e[1].dwre_owner == e[0].dwre_thread,
+				"second thread waits for the first one");
+		test_check((e[0].dwre_object == dt.dt_q1 &&
+				e[1].dwre_object == dt.dt_q2) ||
+				(e[0].dwre_object == dt.dt_q2 &&
+				e[1].dwre_object == dt.dt_q1),
+				"the queues waited for are reported");
+		test_check(e[0].dwre_duration >= THRESHOLD &&
+				e[1].dwre_duration >= THRESHOLD,
+				"only waits past the threshold are reported");
+	}
+	dispatch_wait_analyzer_disable();
+	return test_finish("dispatch_wait_analyzer");
+}
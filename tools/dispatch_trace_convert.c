@@ -0,0 +1,699 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_START@
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * @APPLE_APACHE_LICENSE_HEADER_END@
+ */
+
+/*
+ * Converts the trace rings written by a process run with
+ * LIBDISPATCH_TRACE_RING=<directory> to the Chrome trace event format, which
+ * chrome://tracing and Perfetto load.
+ *
+ * Work items are slices named after their function, on the thread that ran
+ * them, with a flow arrow from the thread that enqueued them. Worker threads
+ * get a "worker" slice from unpark to park. Other events are instants.
+ *
+ * The rings of the busiest CPUs wrap around first, by default only the time
+ * window that every ring still covers is converted, -a keeps everything.
+ * Functions are not symbolicated.
+ *
+ * usage: dispatch_trace_convert [-a] [-o output.json] trace_file
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace_ring_internal.h"
+
+// see DISPATCH_CODE() and libdispatch.codes
+#define DBG_DISPATCH 46
+#define TRACE_CODE(subclass, code) \
+		((uint32_t)DBG_DISPATCH << 24 | (uint32_t)(subclass) << 16 | \
+		(uint32_t)(code) << 2)
+#define TRACE_SUBCLASS_PERF 2
+#define TRACE_SUBCLASS_PERF_MON 4
+#define TRACE_SUBCLASS_QOS_TRACE 5
+#define TRACE_SUBCLASS_RUNTIME_TRACE 7
+
+#define QOS_TRACE_queue_creation TRACE_CODE(TRACE_SUBCLASS_QOS_TRACE, 1)
+#define QOS_TRACE_queue_dispose TRACE_CODE(TRACE_SUBCLASS_QOS_TRACE, 2)
+#define QOS_TRACE_continuation_push_eb TRACE_CODE(TRACE_SUBCLASS_QOS_TRACE, 5)
+#define QOS_TRACE_continuation_push_ab TRACE_CODE(TRACE_SUBCLASS_QOS_TRACE, 6)
+#define QOS_TRACE_continuation_push_f TRACE_CODE(TRACE_SUBCLASS_QOS_TRACE, 7)
+#define QOS_TRACE_source_push TRACE_CODE(TRACE_SUBCLASS_QOS_TRACE, 8)
+#define QOS_TRACE_continuation_pop TRACE_CODE(TRACE_SUBCLASS_QOS_TRACE, 9)
+#define QOS_TRACE_source_pop TRACE_CODE(TRACE_SUBCLASS_QOS_TRACE, 10)
+#define QOS_TRACE_queue_item_complete TRACE_CODE(TRACE_SUBCLASS_QOS_TRACE, 11)
+#define QOS_TRACE_src_callout TRACE_CODE(TRACE_SUBCLASS_QOS_TRACE, 12)
+#define QOS_TRACE_src_dispose TRACE_CODE(TRACE_SUBCLASS_QOS_TRACE, 13)
+#define RUNTIME_TRACE_worker_unpark TRACE_CODE(TRACE_SUBCLASS_RUNTIME_TRACE, 2)
+#define RUNTIME_TRACE_worker_park TRACE_CODE(TRACE_SUBCLASS_RUNTIME_TRACE, 4)
+
+#define DBG_FUNC_START 1
+#define DBG_FUNC_END 2
+
+static const char *const runtime_event_names[] = {
+	[1] = "worker_event_delivery",
+	[2] = "worker_unpark",
+	[3] = "worker_request",
+	[4] = "worker_park",
+	[5] = "worker_wakeup",
+	[10] = "sync_wait",
+	[11] = "async_sync_handoff",
+	[12] = "sync_sync_handoff",
+	[13] = "sync_async_handoff",
+};
+
+static const char *const perf_event_names[] = {
+	[1] = "non_leaf_retarget",
+	[2] = "post_activate_retarget",
+	[3] = "post_activate_mutation",
+	[4] = "delayed_registration",
+	[5] = "mutable_target",
+	[6] = "strict_bg_timer",
+	[7] = "suspended_timer_fire",
+	[8] = "handlerless_source_fire",
+	[9] = "source_registration_without_qos",
+};
+
+// serial numbers of the static queues, see queue_internal.h
+static const char *const static_queue_labels[] = {
+	[1] = "com.apple.main-thread",
+	[2] = "com.apple.libdispatch-manager",
+	[3] = "com.apple.root.libdispatch-manager",
+};
+
+struct entry {
+	dispatch_trace_entry_s dte;
+	uint32_t cpu;
+};
+
+struct map_entry {
+	uint64_t key;
+	bool used;
+	char label[4 * sizeof(uint64_t) + 1];
+	uint64_t func;
+	uint64_t serialnum;
+	uint64_t flow;
+};
+
+struct map {
+	struct map_entry *entries;
+	size_t capacity;
+	size_t count;
+};
+
+struct frame {
+	uint64_t item;
+	uint64_t func;
+	uint64_t serialnum;
+	uint64_t start;
+};
+
+struct thread {
+	uint32_t tid;
+	bool creating_queue;
+	uint64_t creating_serialnum;
+	bool active;
+	uint64_t active_start;
+	uint64_t active_root;
+	struct frame *frames;
+	size_t nframes;
+	size_t frames_capacity;
+};
+
+static FILE *out;
+static bool first_event = true;
+static uint64_t pid;
+static uint64_t start_time;
+static struct map queues;
+static struct map items;
+static struct thread *threads;
+static size_t nthreads;
+static uint64_t next_flow = 1;
+
+static void *
+xcalloc(size_t n, size_t size)
+{
+	void *p = calloc(n, size);
+	if (!p) {
+		perror("calloc");
+		exit(1);
+	}
+	return p;
+}
+
+static void *
+xrealloc(void *p, size_t size)
+{
+	p = realloc(p, size);
+	if (!p) {
+		perror("realloc");
+		exit(1);
+	}
+	return p;
+}
+
+#pragma mark -
+#pragma mark maps
+
+static struct map_entry *
+map_find(struct map *m, uint64_t key, bool create)
+{
+	size_t i;
+
+	if (create && (m->count + 1) * 2 > m->capacity) {
+		struct map old = *m;
+		m->capacity = old.capacity ? old.capacity * 2 : 1024;
+		m->entries = xcalloc(m->capacity, sizeof(struct map_entry));
+		m->count = 0;
+		for (i = 0; i < old.capacity; i++) {
+			if (old.entries[i].used) {
+				*map_find(m, old.entries[i].key, true) = old.entries[i];
+			}
+		}
+		free(old.entries);
+	}
+	if (!m->capacity) {
+		return NULL;
+	}
+	i = (size_t)((key * 0x9e3779b97f4a7c15ull) >> 32) & (m->capacity - 1);
+	while (m->entries[i].used) {
+		if (m->entries[i].key == key) {
+			return &m->entries[i];
+		}
+		i = (i + 1) & (m->capacity - 1);
+	}
+	if (!create) {
+		return NULL;
+	}
+	m->entries[i].used = true;
+	m->entries[i].key = key;
+	m->count++;
+	return &m->entries[i];
+}
+
+static struct thread *
+thread_find(uint32_t tid)
+{
+	for (size_t i = 0; i < nthreads; i++) {
+		if (threads[i].tid == tid) return &threads[i];
+	}
+	threads = xrealloc(threads, (nthreads + 1) * sizeof(struct thread));
+	memset(&threads[nthreads], 0, sizeof(struct thread));
+	threads[nthreads].tid = tid;
+	return &threads[nthreads++];
+}
+
+static const char *
+queue_label(uint64_t serialnum, char *buf, size_t size)
+{
+	struct map_entry *me = map_find(&queues, serialnum, false);
+
+	if (me && me->label[0]) return me->label;
+	if (serialnum < sizeof(static_queue_labels) / sizeof(static_queue_labels[0])
+			&& static_queue_labels[serialnum]) {
+		return static_queue_labels[serialnum];
+	}
+	snprintf(buf, size, "queue #%" PRIu64, serialnum);
+	return buf;
+}
+
+#pragma mark -
+#pragma mark output
+
+static void
+print_string(const char *s)
+{
+	fputc('"', out);
+	for (; *s; s++) {
+		unsigned char c = (unsigned char)*s;
+		if (c == '"' || c == '\\') {
+			fprintf(out, "\\%c", c);
+		} else if (c < 0x20) {
+			fprintf(out, "\\u%04x", c);
+		} else {
+			fputc(c, out);
+		}
+	}
+	fputc('"', out);
+}
+
+// starts an event, the caller prints its remaining fields and closes it
+static void
+event_begin(const char *name, const char *ph, uint64_t ts, uint32_t tid)
+{
+	uint64_t rel = ts > start_time ? ts - start_time : 0;
+
+	fputs(first_event ? "\n" : ",\n", out);
+	first_event = false;
+	fputs("{\"name\":", out);
+	print_string(name);
+	fprintf(out, ",\"cat\":\"dispatch\",\"ph\":\"%s\",\"ts\":%" PRIu64 ".%03u,"
+			"\"pid\":%" PRIu64 ",\"tid\":%" PRIu32, ph, rel / 1000,
+			(unsigned)(rel % 1000), pid, tid);
+}
+
+static void
+event_instant(const char *name, const struct entry *e)
+{
+	event_begin(name, "i", e->dte.dte_timestamp, e->dte.dte_tid);
+	fprintf(out, ",\"s\":\"t\",\"args\":{\"cpu\":%" PRIu32 ","
+			"\"a\":\"0x%" PRIx64 "\",\"b\":\"0x%" PRIx64 "\","
+			"\"c\":\"0x%" PRIx64 "\",\"d\":\"0x%" PRIx64 "\"}}", e->cpu,
+			e->dte.dte_args[0], e->dte.dte_args[1], e->dte.dte_args[2],
+			e->dte.dte_args[3]);
+}
+
+static void
+event_slice(const char *name, uint32_t tid, uint64_t start, uint64_t end,
+		const char *queue, uint64_t item)
+{
+	uint64_t dur = end > start ? end - start : 0;
+	char buf[64];
+
+	event_begin(name, "X", start, tid);
+	fprintf(out, ",\"dur\":%" PRIu64 ".%03u,\"args\":{\"queue\":",
+			dur / 1000, (unsigned)(dur % 1000));
+	print_string(queue);
+	if (item) {
+		snprintf(buf, sizeof(buf), "0x%" PRIx64, item);
+		fputs(",\"item\":", out);
+		print_string(buf);
+	}
+	fputs("}}", out);
+}
+
+static void
+event_flow(const char *ph, uint64_t flow, uint64_t ts, uint32_t tid)
+{
+	event_begin("enqueue", ph, ts, tid);
+	fprintf(out, ",\"id\":%" PRIu64 "%s}", flow,
+			ph[0] == 'f' ? ",\"bp\":\"e\"" : "");
+}
+
+#pragma mark -
+#pragma mark conversion
+
+static void
+convert_push(const struct entry *e)
+{
+	uint64_t item = e->dte.dte_args[0];
+	uint64_t serialnum = e->dte.dte_args[2] >> 32;
+	struct map_entry *me = map_find(&items, item, true);
+	char name[64], buf[64];
+
+	me->func = e->dte.dte_args[1];
+	me->serialnum = serialnum;
+	me->flow = next_flow++;
+
+	// a zero length slice for the flow to start from
+	snprintf(name, sizeof(name), "push 0x%" PRIx64, me->func);
+	event_slice(name, e->dte.dte_tid, e->dte.dte_timestamp,
+			e->dte.dte_timestamp, queue_label(serialnum, buf, sizeof(buf)),
+			item);
+	event_flow("s", me->flow, e->dte.dte_timestamp, e->dte.dte_tid);
+}
+
+static void
+convert_pop(const struct entry *e, struct thread *th)
+{
+	uint64_t item = e->dte.dte_args[0];
+	struct map_entry *me = map_find(&items, item, false);
+	struct frame *f;
+
+	if (th->nframes == th->frames_capacity) {
+		th->frames_capacity = th->frames_capacity ? th->frames_capacity * 2 : 8;
+		th->frames = xrealloc(th->frames,
+				th->frames_capacity * sizeof(struct frame));
+	}
+	f = &th->frames[th->nframes++];
+	f->item = item;
+	f->func = me ? me->func : 0;
+	f->serialnum = e->dte.dte_args[2];
+	f->start = e->dte.dte_timestamp;
+	if (me && me->flow) {
+		event_flow("f", me->flow, e->dte.dte_timestamp, e->dte.dte_tid);
+		me->flow = 0;
+	}
+}
+
+static void
+convert_frame_end(struct thread *th, struct frame *f, uint64_t end)
+{
+	char name[64], buf[64];
+
+	if (f->func) {
+		snprintf(name, sizeof(name), "0x%" PRIx64, f->func);
+	} else {
+		snprintf(name, sizeof(name), "item 0x%" PRIx64, f->item);
+	}
+	event_slice(name, th->tid, f->start, end,
+			queue_label(f->serialnum, buf, sizeof(buf)), f->item);
+}
+
+static void
+convert_complete(const struct entry *e, struct thread *th)
+{
+	uint64_t item = e->dte.dte_args[0];
+	size_t i = th->nframes;
+
+	// synchronous items complete without having been popped
+	if (!item) return;
+	while (i > 0 && th->frames[i - 1].item != item) i--;
+	if (i == 0) return;
+	// items above it lost their completion when their ring wrapped
+	while (th->nframes >= i) {
+		convert_frame_end(th, &th->frames[--th->nframes],
+				e->dte.dte_timestamp);
+	}
+}
+
+static void
+convert_runtime(const struct entry *e, struct thread *th, uint32_t code)
+{
+	uint32_t evt = DISPATCH_TRACE_CODE_CODE(code);
+	char name[64], buf[64];
+
+	if (code == RUNTIME_TRACE_worker_unpark) {
+		th->active = true;
+		th->active_start = e->dte.dte_timestamp;
+		th->active_root = e->dte.dte_args[0];
+		return;
+	}
+	if (code == RUNTIME_TRACE_worker_park) {
+		if (th->active) {
+			snprintf(buf, sizeof(buf), "0x%" PRIx64, th->active_root);
+			event_slice("worker", th->tid, th->active_start,
+					e->dte.dte_timestamp, buf, 0);
+			th->active = false;
+		}
+		return;
+	}
+	if (evt < sizeof(runtime_event_names) / sizeof(runtime_event_names[0]) &&
+			runtime_event_names[evt]) {
+		event_instant(runtime_event_names[evt], e);
+	} else {
+		snprintf(name, sizeof(name), "runtime event %" PRIu32, evt);
+		event_instant(name, e);
+	}
+}
+
+static void
+convert_entry(const struct entry *e)
+{
+	uint32_t code = e->dte.dte_code & ~3u;
+	uint32_t func = DISPATCH_TRACE_CODE_FUNC(e->dte.dte_code);
+	uint32_t subclass = DISPATCH_TRACE_CODE_SUBCLASS(code);
+	struct thread *th = thread_find(e->dte.dte_tid);
+	struct map_entry *me;
+	char name[64];
+
+	switch (code) {
+	case QOS_TRACE_queue_creation:
+		// the label follows in the end event, on the same thread
+		if (func == DBG_FUNC_START) {
+			th->creating_queue = true;
+			th->creating_serialnum = e->dte.dte_args[0];
+		} else if (func == DBG_FUNC_END && th->creating_queue) {
+			me = map_find(&queues, th->creating_serialnum, true);
+			memcpy(me->label, e->dte.dte_args, sizeof(me->label) - 1);
+			me->label[sizeof(me->label) - 1] = '\0';
+			th->creating_queue = false;
+		}
+		return;
+	case QOS_TRACE_continuation_push_eb:
+	case QOS_TRACE_continuation_push_ab:
+	case QOS_TRACE_continuation_push_f:
+		return convert_push(e);
+	case QOS_TRACE_continuation_pop:
+		return convert_pop(e, th);
+	case QOS_TRACE_queue_item_complete:
+		return convert_complete(e, th);
+	case QOS_TRACE_queue_dispose:
+		return event_instant("queue_dispose", e);
+	case QOS_TRACE_source_push:
+		return event_instant("source_push", e);
+	case QOS_TRACE_source_pop:
+		return event_instant("source_pop", e);
+	case QOS_TRACE_src_callout:
+		return event_instant("source_callout", e);
+	case QOS_TRACE_src_dispose:
+		return event_instant("source_dispose", e);
+	}
+
+	if (DISPATCH_TRACE_CODE_CLASS(code) != DBG_DISPATCH) {
+		snprintf(name, sizeof(name), "0x%08" PRIx32, e->dte.dte_code);
+	} else if (subclass == TRACE_SUBCLASS_RUNTIME_TRACE) {
+		return convert_runtime(e, th, code);
+	} else if (subclass == TRACE_SUBCLASS_PERF &&
+			DISPATCH_TRACE_CODE_CODE(code) <
+			sizeof(perf_event_names) / sizeof(perf_event_names[0]) &&
+			perf_event_names[DISPATCH_TRACE_CODE_CODE(code)]) {
+		snprintf(name, sizeof(name), "perf: %s",
+				perf_event_names[DISPATCH_TRACE_CODE_CODE(code)]);
+	} else {
+		snprintf(name, sizeof(name), "0x%08" PRIx32, e->dte.dte_code);
+	}
+	event_instant(name, e);
+}
+
+// closes what is still running at the end of the trace
+static void
+convert_finish(uint64_t end)
+{
+	char buf[64];
+
+	for (size_t i = 0; i < nthreads; i++) {
+		struct thread *th = &threads[i];
+		while (th->nframes) {
+			convert_frame_end(th, &th->frames[--th->nframes], end);
+		}
+		if (th->active) {
+			snprintf(buf, sizeof(buf), "0x%" PRIx64, th->active_root);
+			event_slice("worker", th->tid, th->active_start, end, buf, 0);
+		}
+		free(th->frames);
+	}
+}
+
+#pragma mark -
+#pragma mark rings
+
+static int
+compare_entries(const void *a, const void *b)
+{
+	const struct entry *x = a, *y = b;
+
+	if (x->dte.dte_timestamp != y->dte.dte_timestamp) {
+		return x->dte.dte_timestamp < y->dte.dte_timestamp ? -1 : 1;
+	}
+	if (x->cpu != y->cpu) {
+		return x->cpu < y->cpu ? -1 : 1;
+	}
+	return x->dte.dte_seq < y->dte.dte_seq ? -1 : x->dte.dte_seq > y->dte.dte_seq;
+}
+
+// like _dispatch_tracebuf_range_is_valid(), without overflowing
+static bool
+range_is_valid(uint64_t offset, uint64_t length, uint64_t size)
+{
+	return offset <= size && length <= size - offset;
+}
+
+// checks that the rings the header describes lie within the file, returns a
+// description of the first problem found or NULL
+static const char *
+check_header(const dispatch_trace_ring_header_s *dtrh, uint64_t size)
+{
+	uint64_t ring_min;
+
+	if (dtrh->dtrh_version != DISPATCH_TRACE_RING_VERSION) {
+		return "unsupported trace version";
+	}
+	if (dtrh->dtrh_entry_size != sizeof(dispatch_trace_entry_s)) {
+		return "unexpected entry size";
+	}
+	if (!dtrh->dtrh_nentries ||
+			(dtrh->dtrh_nentries & (dtrh->dtrh_nentries - 1))) {
+		return "ring length is not a power of two";
+	}
+	if (!dtrh->dtrh_ncpus) {
+		return "trace has no rings";
+	}
+	if (dtrh->dtrh_ring_offset < sizeof(dispatch_trace_ring_header_s) ||
+			dtrh->dtrh_ring_offset % sizeof(uint64_t) ||
+			dtrh->dtrh_ring_size % sizeof(uint64_t)) {
+		return "misaligned rings";
+	}
+	ring_min = sizeof(dispatch_trace_ring_s) +
+			(uint64_t)dtrh->dtrh_nentries * dtrh->dtrh_entry_size;
+	if (dtrh->dtrh_ring_size < ring_min) {
+		return "rings are smaller than their entries";
+	}
+	if (!range_is_valid(dtrh->dtrh_ring_offset, 0, size) ||
+			dtrh->dtrh_ring_size > (size - dtrh->dtrh_ring_offset) /
+			dtrh->dtrh_ncpus) {
+		return "file is truncated";
+	}
+	return NULL;
+}
+
+// copies the complete entries of a ring, returns the oldest timestamp if the
+// ring wrapped around and lost events, 0 otherwise
+static uint64_t
+read_ring(const dispatch_trace_ring_header_s *dtrh, const char *base,
+		uint32_t cpu, struct entry *entries, size_t *count)
+{
+	dispatch_trace_ring_t dtr = (dispatch_trace_ring_t)(base +
+			dtrh->dtrh_ring_offset + cpu * dtrh->dtrh_ring_size);
+	uint64_t n = dtrh->dtrh_nentries;
+	uint64_t head = __atomic_load_n(&dtr->dtr_head, __ATOMIC_ACQUIRE);
+	uint64_t idx = head > n ? head - n : 0;
+	uint64_t oldest = 0;
+
+	for (; idx < head; idx++) {
+		dispatch_trace_entry_t dte = &dtr->dtr_entries[idx & (n - 1)];
+		struct entry *e = &entries[*count];
+		uint64_t seq = __atomic_load_n(&dte->dte_seq, __ATOMIC_ACQUIRE);
+
+		if (seq != idx + 1) continue;
+		memcpy(&e->dte, (const void *)dte, sizeof(e->dte));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&dte->dte_seq, __ATOMIC_RELAXED) != seq) continue;
+		e->cpu = cpu;
+		if (!oldest && head > n) oldest = e->dte.dte_timestamp;
+		(*count)++;
+	}
+	return oldest;
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *output = NULL;
+	const dispatch_trace_ring_header_s *dtrh;
+	const char *error;
+	char procname[DISPATCH_TRACE_RING_PROCNAME_SIZE + 1] = { };
+	struct entry *entries;
+	size_t count = 0, i = 0;
+	uint64_t cutoff = 0, end = 0;
+	bool keep_all = false;
+	struct stat st;
+	void *base;
+	int ch, fd;
+
+	while ((ch = getopt(argc, argv, "ao:")) != -1) {
+		switch (ch) {
+		case 'a':
+			keep_all = true;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind + 1 != argc) {
+usage:
+		fprintf(stderr, "usage: %s [-a] [-o output.json] trace_file\n",
+				argv[0]);
+		return 1;
+	}
+
+	fd = open(argv[optind], O_RDONLY);
+	if (fd == -1 || fstat(fd, &st) == -1) {
+		fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+		return 1;
+	}
+	if ((size_t)st.st_size < sizeof(dispatch_trace_ring_header_s)) {
+		fprintf(stderr, "%s: not a libdispatch trace\n", argv[optind]);
+		return 1;
+	}
+	base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+		return 1;
+	}
+	close(fd);
+
+	dtrh = base;
+	if (__atomic_load_n(&dtrh->dtrh_magic, __ATOMIC_ACQUIRE) !=
+			DISPATCH_TRACE_RING_MAGIC) {
+		fprintf(stderr, "%s: not a libdispatch trace\n", argv[optind]);
+		return 1;
+	}
+	if ((error = check_header(dtrh, (uint64_t)st.st_size))) {
+		if (dtrh->dtrh_version != DISPATCH_TRACE_RING_VERSION) {
+			fprintf(stderr, "%s: %s %u\n", argv[optind], error,
+					dtrh->dtrh_version);
+		} else {
+			fprintf(stderr, "%s: %s\n", argv[optind], error);
+		}
+		return 1;
+	}
+
+	entries = xcalloc((size_t)dtrh->dtrh_ncpus * dtrh->dtrh_nentries,
+			sizeof(struct entry));
+	for (uint32_t cpu = 0; cpu < dtrh->dtrh_ncpus; cpu++) {
+		uint64_t oldest = read_ring(dtrh, base, cpu, entries, &count);
+		if (oldest > cutoff) cutoff = oldest;
+	}
+	qsort(entries, count, sizeof(struct entry), compare_entries);
+	if (!keep_all) {
+		while (i < count && entries[i].dte.dte_timestamp < cutoff) i++;
+	}
+
+	out = output ? fopen(output, "w") : stdout;
+	if (!out) {
+		fprintf(stderr, "%s: %s\n", output, strerror(errno));
+		return 1;
+	}
+	pid = dtrh->dtrh_pid;
+	start_time = dtrh->dtrh_start_time;
+
+	fputs("{\"traceEvents\":[", out);
+	event_begin("process_name", "M", start_time, 0);
+	fputs(",\"args\":{\"name\":", out);
+	memcpy(procname, dtrh->dtrh_procname, sizeof(dtrh->dtrh_procname));
+	print_string(procname[0] ? procname : "process");
+	fputs("}}", out);
+	for (; i < count; i++) {
+		convert_entry(&entries[i]);
+		end = entries[i].dte.dte_timestamp;
+	}
+	convert_finish(end);
+	fputs("\n],\"displayTimeUnit\":\"ns\"}\n", out);
+
+	if (output && fclose(out)) {
+		fprintf(stderr, "%s: %s\n", output, strerror(errno));
+		return 1;
+	}
+	free(entries);
+	munmap(base, (size_t)st.st_size);
+	return 0;
+}